@@ -0,0 +1,99 @@
+#pragma once
+
+#include "main.h"
+#include "stdint.h"
+#include "Config.hpp"
+
+// 故障黑匣子：在62.5kHz中断中把最近BLACKBOX_SAMPLE_NUM个采样点写入CCM RAM环形缓冲区，
+// 故障触发后再记录postTrigger个点后冻结，功率级关闭后在主循环中保存到Flash，可通过CAN下载
+
+#define BLACKBOX_SAMPLE_NUM             256U    // 需为2的幂，62.5kHz下约4.1ms
+#define BLACKBOX_DEFAULT_POST_TRIGGER   64U
+#define BLACKBOX_MAGIC                  0x58424253U    // "SBBX"
+#define BLACKBOX_VERSION                1U
+#define BLACKBOX_FRAMES_PER_TICK        2U      // 下载时每1kHz周期最多发送的帧数
+
+struct BlackBoxSample
+{
+    int16_t vA, vB;                 // 单位0.01V
+    int16_t iA, iB, iR;             // 单位0.01A
+    int16_t iLTarget;               // 单位0.01A
+    uint8_t dcdcMode;               // DCDCMode
+    uint8_t flags;                  // bit0 outputABEnabled, bit7:4 limitFactor
+} __attribute__((packed));
+
+struct BlackBoxHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t headerSize;
+    uint16_t sampleNum;             // 记录中的采样点数，最后一个为最新的点
+    uint16_t validNum;              // 有效采样点数，上电后不足sampleNum时只有最后validNum个点有效
+    uint16_t postTrigger;           // 触发后的采样点数（含触发时刻）
+    uint16_t triggerCode;           // 触发的错误位，0为手动触发
+    uint16_t errorCode;             // 保存时的errorData
+    uint8_t errorLevel;
+    uint8_t reserved;
+    uint32_t triggerTick;           // 触发时的vTick，单位ms
+    float errorVoltage;
+    float errorCurrent;
+    uint32_t crc;                   // crc置0后对整个记录计算的CRC-32
+} __attribute__((packed));
+
+struct BlackBoxRecord
+{
+    BlackBoxHeader header;
+    BlackBoxSample samples[BLACKBOX_SAMPLE_NUM];
+} __attribute__((packed));
+
+enum BlackBoxState
+{
+    BLACKBOX_RECORDING = 0,
+    BLACKBOX_TRIGGERED = 1,         // 已触发，正在记录触发后的采样点
+    BLACKBOX_FROZEN = 2,            // 已冻结，等待功率级关闭后保存
+};
+
+struct BlackBoxCmd;
+
+struct BlackBoxData
+{
+    volatile BlackBoxState state = BLACKBOX_RECORDING;
+    uint16_t writeIndex = 0;
+    uint16_t validNum = 0;
+    uint16_t postTrigger = BLACKBOX_DEFAULT_POST_TRIGGER;
+    volatile uint16_t postCnt = 0;
+    uint16_t triggerCode = 0;
+    uint32_t triggerTick = 0;
+    bool prepared = false;          // 冻结后已旋转缓冲区并填写头部，等待写入Flash
+
+    bool recordValid = false;       // Flash中有有效记录
+    volatile bool infoRequest = false;
+    volatile bool eraseRequest = false;
+    volatile bool reading = false;
+    uint16_t readOffset = 0;
+};
+
+extern BlackBoxData blackBoxData;
+
+namespace BlackBox
+{
+
+// 校验Flash中的记录
+void init();
+
+// 在62.5kHz中断末尾调用
+void record();
+
+// 在错误触发时调用，只有第一次触发有效
+void trigger(uint16_t errorBit);
+
+// 上位机指令，在1kHz任务中调用
+void command(const BlackBoxCmd &cmd);
+
+// 在1kHz任务中调用，发送状态和下载数据
+void update();
+
+// 在主循环中调用，保存冻结的记录和擦除Flash
+void process();
+
+} // namespace BlackBox
@@ -46,6 +46,10 @@
 #define HARDWARE_UID_W1     0x534B5009
 #define HARDWARE_UID_W2     0x20343732
 
+// 多板并联时定义节点号和节点数，见Parallel.hpp
+//#define HARDWARE_NODE_ID        0U
+//#define HARDWARE_PARALLEL_NUM   2U
+
 #define ADC_VA_K        0.002850088173729f
 #define ADC_VA_B        -0.067354875f
 #define ADC_VB_K        0.002851284425586f
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "main.h"
+#include "stdint.h"
+#include "Config.hpp"
+
+// 电容组健康趋势：统计每次上电期间的容量、ESR、峰值温度、充放电电荷量和电压范围，
+// 功率级关闭后在主循环中追加写入Flash，上位机按上电次数读取各次的统计值观察老化趋势
+
+#define HEALTH_RECORD_SIZE          32U
+#define HEALTH_KEEP_NUM             64U     // 存储区写满时保留的最近上电次数
+#define HEALTH_SAVE_INTERVAL        30000U  // 两次写入Flash的最小间隔，单位ms
+#define HEALTH_ESR_MIN_STEP         2.0f    // 参与ESR估计的最小电流阶跃（1ms内），单位A
+#define HEALTH_ESR_MIN_SAMPLES      16U     // ESR估计所需的最少阶跃次数
+#define HEALTH_FRAMES_PER_TICK      2U      // 下载时每1kHz周期最多发送的帧数
+
+struct HealthRecord
+{
+    uint32_t seq;                   // 写入序号，全1为空记录
+    uint16_t bootCount;             // 上电次数，与事件日志一致，同一次上电的多条记录以seq最大的为准
+    uint8_t capSamples;             // 容量估计次数，饱和于255
+    uint8_t esrSamples;             // 电流阶跃次数，饱和于255
+    uint16_t duration;              // 上电时长，单位s
+    uint16_t capacitance;           // 容量估计的平均值，单位0.01F，0为无有效估计
+    uint16_t esr;                   // ESR估计，单位0.1mΩ，0为无有效估计
+    uint16_t vCapMax;               // 输出开启期间电容电压最大值，单位0.01V
+    uint16_t vCapMin;               // 输出开启期间电容电压最小值，单位0.01V
+    uint32_t chargeIn;              // 充入电荷量，单位0.1C
+    uint32_t chargeOut;             // 放出电荷量，单位0.1C
+    uint8_t tempPeak[3];            // 热模型A/B半桥和电感的峰值温度，单位℃
+    uint8_t resv;
+    uint16_t check;                 // 前30字节CRC-32的低16位
+} __attribute__((packed));
+
+struct HealthCmd;
+
+struct CapHealthData
+{
+    // 本次上电的统计值，在1kHz任务中更新
+    float capSum = 0.0f;
+    uint32_t capCnt = 0;
+    float esrSxy = 0.0f;            // ESR最小二乘: sum(dV * dI)
+    float esrSxx = 0.0f;            // sum(dI * dI)
+    uint32_t esrCnt = 0;
+    float lastVB = 0.0f;
+    float lastICap = 0.0f;
+    bool lastValid = false;
+    float chargeIn = 0.0f;          // 单位C
+    float chargeOut = 0.0f;
+    float vCapMax = 0.0f;
+    float vCapMin = 0.0f;
+    bool vCapValid = false;
+    float tempPeak[3] = {0.0f};
+
+    volatile bool dirty = false;    // 有未写入Flash的统计值
+    uint32_t lastSaveTick = 0;
+
+    uint32_t nextSeq = 0;
+    uint16_t headSlot = 0;          // 下一条记录写入的位置，存储区按写入顺序排列
+    uint16_t recordNum = 0;         // Flash中的有效记录数
+
+    volatile bool infoRequest = false;
+    volatile bool clearRequest = false;
+    volatile bool reading = false;
+    uint16_t readSlot = 0;          // 等于headSlot时发送本次上电的实时统计
+    uint8_t readPart = 0;
+    HealthRecord readRecord;
+};
+
+extern CapHealthData capHealthData;
+
+namespace CapHealth
+{
+
+// 扫描Flash恢复写入位置，需在EventLog::init之后调用
+void init();
+
+// 在estimateCapacity得到有效容量估计时调用
+void addCapacitySample(float capacity);
+
+// 在1kHz任务中调用，更新本次上电的统计值
+void updateStats();
+
+// 上位机指令，在1kHz任务中调用
+void command(const HealthCmd &cmd);
+
+// 在1kHz任务中调用，发送状态和下载数据
+void update();
+
+// 在主循环中调用，功率级关闭时把统计值写入Flash
+void process();
+
+} // namespace CapHealth
@@ -67,7 +67,7 @@ struct RxData {
     uint16_t refereePowerLimit;             // 裁判限制功率，单位W
     uint16_t refereeEnergyBuffer;           // 裁判能量缓冲，单位J
     uint8_t activeChargingLimitRatio;       // 主动充电限制比例（能量），0-255
-    int16_t resv2;
+    uint16_t burstQueryPower;               // 放电时间预测的目标功率，单位W，0为默认值
 } __attribute__((packed));
 
 extern RxData rxData;
@@ -88,18 +88,478 @@ struct TxDataNew {                  // 0x052 (useNewFeedbackMessage = 1)
     uint8_t capEnergy;              // 电容现有能量，0-255
 } __attribute__((packed));
 
+struct TxBurstData {                // 0x053 (useNewFeedbackMessage = 1, 100Hz)
+    uint16_t queryPower;            // 预测使用的底盘功率，单位W
+    uint16_t queryDuration;         // 可维持queryPower的时间，单位ms，0xFFFF为裁判系统即可满足
+    uint16_t maxPowerDuration;      // 可维持chassisPowerLimit的时间，单位ms
+    uint16_t usableEnergy;          // 电容组放电到CAPARR_LOW_VOLTAGE可用的能量，单位J
+} __attribute__((packed));
+
+struct TimeSyncCmd {                // 0x063，主控发送，时间同步请求
+    uint8_t seq;                    // 请求序号，原样回复
+    uint8_t enableTimestamp: 1;     // 开启0x052之后的时间戳帧
+    uint8_t resv0: 7;
+    uint8_t resv[6];
+} __attribute__((packed));
+
+enum TimeDataType
+{
+    TIME_DATA_SYNC = 0,             // 时间同步回复
+    TIME_DATA_FEEDBACK = 1,         // 紧跟0x052发送，为该帧数据的采样时刻
+};
+
+struct TxTimeData {                 // 0x050，时间单位均为本机的us计数（TIM5）
+    uint8_t type;                   // TimeDataType
+    uint8_t seq;                    // SYNC: 请求序号; FEEDBACK: vTick低8位
+    uint16_t delay;                 // SYNC: 收到请求到回复写入TX FIFO的时间t3-t2; FEEDBACK: 0
+    uint32_t time;                  // SYNC: 收到请求的时刻t2; FEEDBACK: 采样时刻
+} __attribute__((packed));
+
+struct TxPeerData {                 // 0x040+节点号，多板并联时各节点1kHz广播，见Parallel.hpp
+    int16_t iCap;                   // 电容电流（一阶滤波），单位0.01A，充电为正
+    uint16_t vCap;                  // 电容电压，单位0.01V
+    int16_t pReferee;               // 裁判系统功率（一阶滤波），单位0.01W
+    uint8_t seq;                    // 帧序号
+    uint8_t sharing: 1;             // 输出开启，参与功率分配
+    uint8_t errorLevel: 2;
+    uint8_t resv0: 5;
+} __attribute__((packed));
+
+// 反馈帧（0x051/0x052）在4kHz任务中判断是否发送：周期到达，或状态、错误、limitFactor、功率、能量变化
+// 状态和错误变化不受最小间隔限制，最坏延时为一个4kHz周期（250us）
+#define FEEDBACK_MIN_INTERVAL   1000U   // us，limitFactor、功率和能量变化触发的最小发送间隔
+#define FEEDBACK_LIMIT_MASK     0x0CU   // statusCode中的limitFactor位，阈值附近可能频繁跳变
+
+enum FeedbackReason
+{
+    FEEDBACK_PERIODIC = 0,          // 周期到达
+    FEEDBACK_STATUS = 1,            // statusCode中limitFactor以外的位变化
+    FEEDBACK_ERROR = 2,             // errorCode变化，包括WARNING
+    FEEDBACK_POWER = 3,             // 底盘功率变化超过powerDelta
+    FEEDBACK_ENERGY = 4,            // capEnergy变化超过energyDelta
+    FEEDBACK_LIMIT = 5,             // statusCode中的limitFactor变化
+    FEEDBACK_REASON_NUM
+};
+
+struct FeedbackData
+{
+    // 运行时参数，见Param.cpp
+    uint16_t period = 1;            // 周期发送间隔，单位ms，1~10（1kHz~100Hz）
+    float powerDelta = 0.0f;        // 底盘功率变化超过该值时发送，单位W，0为不触发
+    uint16_t energyDelta = 0;       // capEnergy变化超过该值时发送，0为不触发
+
+    uint8_t lastStatus = 0;         // 上次发送的值
+    uint16_t lastErrorCode = 0;
+    float lastPower = 0.0f;
+    uint8_t lastEnergy = 0;
+    uint32_t lastTime = 0;          // 上次发送的us计数
+    uint32_t sentCnt[FEEDBACK_REASON_NUM] = {0};
+
+    uint16_t diagPeriod = 0;        // 诊断帧0x05B的发送间隔，单位ms，0为不发送，见Param.cpp
+    uint32_t lastDiagTick = 0;
+};
+
+extern FeedbackData feedbackData;
+
+// 诊断帧0x05B：0x052的statusCode中limitFactor只有2位、没有errorCode，需要时开启该帧查看完整状态
+// 每次发送TxDiagError、TxDiagLoop、TxDiagBus、TxDiagTx四帧，作为上位机回复排队，队列满时下一个1kHz周期重试
+#define DIAG_MIN_PERIOD         20U     // ms，diagPeriod小于该值时按该值发送
+
+enum DiagPage
+{
+    DIAG_PAGE_ERROR = 0,
+    DIAG_PAGE_LOOP = 1,
+    DIAG_PAGE_BUS = 2,
+    DIAG_PAGE_TX = 3,
+};
+
+struct TxDiagError {                // 0x05B (page = DIAG_PAGE_ERROR)
+    uint8_t page: 2;                // DiagPage
+    uint8_t limitFactor: 3;         // LimitFactor，完整值
+    uint8_t errorLevel: 3;          // ErrorLevel
+    uint16_t errorCode;             // 完整的错误位，包括WARNING
+    int16_t errorVoltage;           // 最近一次保护触发时的电压，单位0.01V
+    int16_t errorCurrent;           // 最近一次保护触发时的电流，单位0.01A
+    uint8_t dcdcMode;               // DCDCMode
+} __attribute__((packed));
+
+struct TxDiagLoop {                 // 0x05B (page = DIAG_PAGE_LOOP)
+    uint8_t page: 2;
+    uint8_t limitFactor: 3;
+    uint8_t errorLevel: 3;
+    uint8_t irqLoad;                // 上次发送后62.5kHz中断占用率的最大值，单位0.5%
+    int16_t iLTarget;               // 单位0.01A
+    uint16_t capacitance;           // 电容组容量估计，单位0.001F
+    uint16_t rxTimeoutCnt;          // 主控指令超时次数
+} __attribute__((packed));
+
+// CANBusData中的计数器只发送低位，溢出后回绕，上位机按相邻两帧的差值统计
+struct TxDiagBus {                  // 0x05B (page = DIAG_PAGE_BUS)
+    uint8_t page: 2;
+    uint8_t limitFactor: 3;
+    uint8_t errorLevel: 3;
+    uint8_t tec;
+    uint8_t rec;
+    uint8_t busOffCnt;
+    uint8_t errorPassiveCnt;
+    uint8_t recoverCnt;
+    uint16_t coalesced;
+} __attribute__((packed));
+
+struct TxDiagTx {                   // 0x05B (page = DIAG_PAGE_TX)
+    uint8_t page: 2;
+    uint8_t limitFactor: 3;
+    uint8_t errorLevel: 3;
+    uint16_t txFeedback;            // 写入TX FIFO的帧数，对应CANBusData::txCnt
+    uint16_t txReply;
+    uint16_t txTelemetry;
+    uint8_t rejected;
+} __attribute__((packed));
+
+// 接收的帧在FDCAN中断中放入队列，在1kHz任务中处理
+#define CAN_RX_QUEUE_SIZE       16U     // 需为2的幂
+
+struct CANRxFrame
+{
+    uint32_t tick;                  // 接收时的vTick
+    uint32_t time;                  // 接收时的us计数
+    uint16_t id;
+    uint8_t data[8];
+};
+
+struct CANRxQueue
+{
+    volatile uint8_t head = 0;      // FDCAN中断写入
+    volatile uint8_t tail = 0;      // 1kHz任务读出
+    uint8_t highWater = 0;          // 队列中同时存在的最大帧数
+    volatile uint16_t overflow = 0; // 队列满丢弃的累计帧数
+    uint16_t overflowLogged = 0;    // 已记录到事件日志的丢弃帧数
+};
+
+extern CANRxQueue canRxQueue;
+
+// 发送经软件队列调度：硬件TX FIFO只有3个位置，按优先级从高到低补充，发送完成中断中继续补充
+// 反馈帧每类只保留最新值；上位机回复按顺序排队；遥测帧只保留一帧，发送后才接受下一帧
+#define CAN_TX_QUEUE_SIZE           8U      // 上位机回复队列，需为2的幂
+#define CAN_BUSOFF_MIN_DELAY        8U      // 首次bus-off后等待的时间，单位ms
+#define CAN_BUSOFF_MAX_SHIFT        6U      // 连续bus-off时等待时间加倍，最长8ms << 6 = 512ms
+#define CAN_BUSOFF_STABLE_TIME      1000U   // 恢复后持续正常的时间，单位ms，之后等待时间重新从最短开始
+
+enum CANTxPriority
+{
+    CAN_TX_FEEDBACK = 0,            // 0x050-0x053反馈给主控，0x040+节点号并联广播
+    CAN_TX_DIAG = 1,                // 上位机指令的回复
+    CAN_TX_TELEMETRY = 2,           // CAN-FD遥测帧
+    CAN_TX_PRIORITY_NUM
+};
+
+enum CANFeedbackSlot
+{
+    CAN_FEEDBACK_OLD = 0,           // 0x051
+    CAN_FEEDBACK_NEW = 1,           // 0x052
+    CAN_FEEDBACK_BURST = 2,         // 0x053
+    CAN_FEEDBACK_TIME = 3,          // 0x050 FEEDBACK，排在0x052之后
+    CAN_FEEDBACK_TIMESYNC = 4,      // 0x050 SYNC，写入TX FIFO时填入t3-t2
+    CAN_FEEDBACK_PEER = 5,          // 0x040+节点号，多板并联广播
+    CAN_FEEDBACK_NUM
+};
+
+enum CANBusState
+{
+    CAN_BUS_ACTIVE = 0,
+    CAN_BUS_WARNING = 1,            // 错误计数器超过96
+    CAN_BUS_PASSIVE = 2,            // 错误计数器超过127，停止发送遥测
+    CAN_BUS_OFF = 3,                // 等待后再开始恢复，期间不写入TX FIFO
+    CAN_BUS_RECOVERING = 4,         // 已清除INIT，等待128次11个隐性位
+};
+
+struct CANBusData
+{
+    uint8_t state = CAN_BUS_ACTIVE; // CANBusState
+    uint8_t tec = 0;                // 发送错误计数器
+    uint8_t rec = 0;                // 接收错误计数器
+    uint8_t backoffShift = 0;       // 下次bus-off的等待时间为CAN_BUSOFF_MIN_DELAY << backoffShift
+    uint16_t busOffCnt = 0;
+    uint16_t errorPassiveCnt = 0;
+    uint16_t recoverCnt = 0;
+    uint32_t stateTick = 0;         // 进入当前状态的vTick
+
+    uint32_t txCnt[CAN_TX_PRIORITY_NUM] = {0};  // 写入TX FIFO的帧数
+    uint32_t coalesced = 0;         // 发送前被新值覆盖的反馈帧数
+    uint16_t rejected = 0;          // 队列满时拒绝的上位机回复和遥测帧数，调用方会重试
+    uint8_t queueHighWater = 0;     // 上位机回复队列中同时存在的最大帧数
+};
+
+extern CANBusData canBusData;
+
+// 节点号不为0时，除0x061和0x040~0x043外的ID加上节点号 × PARALLEL_CAN_ID_STRIDE，见Parallel.hpp
+#define CAN_ID_COMMAND          0x061   // 所有节点共用
+// 上位机服务指令 0x062，byte0为指令类型
+#define CAN_ID_SERVICE          0x062
+#define CAN_ID_TIMESYNC_REQ     0x063
+#define CAN_ID_TIME             0x050
+#define CAN_ID_BODE             0x054
+#define CAN_ID_BLACKBOX         0x055
+#define CAN_ID_EVENTLOG         0x056
+#define CAN_ID_HEALTH           0x057
+#define CAN_ID_LOSSMAP          0x058
+#define CAN_ID_TELEMETRY        0x059   // CAN-FD，64字节，数据段2Mbit/s
+#define CAN_ID_PARAM            0x05A
+#define CAN_ID_DIAG             0x05B
+#define CAN_ID_PEER             0x040   // +节点号，不加偏移
+
+enum ServiceCmdId
+{
+    SERVICE_BODE = 0x01,            // 环路频率响应测量
+    SERVICE_BLACKBOX = 0x02,        // 故障黑匣子
+    SERVICE_EVENTLOG = 0x03,        // 事件日志
+    SERVICE_HEALTH = 0x04,          // 电容组健康趋势
+    SERVICE_LOSSMAP = 0x05,         // 损耗分布图
+    SERVICE_TELEMETRY = 0x06,       // 高速遥测
+    SERVICE_PARAM = 0x07,           // 运行时参数
+};
+
+struct BodeCmd {                    // 0x062 (cmd = SERVICE_BODE)
+    uint8_t cmd;
+    uint8_t target;                 // AnalyzerTarget，0为停止测量
+    uint8_t amplitude;              // 注入幅值，iLTarget: 0.02A/LSB，pRefereeTarget: 0.2W/LSB
+    uint16_t startFreq;             // 起始频率，单位Hz
+    uint16_t stopFreq;              // 终止频率，单位Hz
+    uint8_t pointNum;               // 频点数，对数均匀分布
+} __attribute__((packed));
+
+#define BODE_STATUS_TARGET_MASK 0x03
+#define BODE_STATUS_ABORTED     0x40
+#define BODE_STATUS_LAST        0x80
+
+struct TxBodeData {                 // 0x054 (每个频点测量完成后发送)
+    uint8_t pointIndex;             // 频点序号
+    uint8_t status;                 // bit1:0 AnalyzerTarget, bit6 测量中止, bit7 最后一个频点
+    uint16_t frequency;             // 频点频率，单位Hz
+    int16_t magnitude;              // 幅值，单位0.01dB
+    int16_t phase;                  // 相位，单位0.01度
+} __attribute__((packed));
+
+
+enum BlackBoxOp
+{
+    BLACKBOX_OP_INFO = 0,           // 发送状态帧
+    BLACKBOX_OP_READ = 1,           // 从arg字节偏移开始下载Flash中的记录
+    BLACKBOX_OP_SET_POST_TRIGGER = 2,   // 设置触发后采样点数为arg
+    BLACKBOX_OP_TRIGGER = 3,        // 手动触发
+    BLACKBOX_OP_ERASE = 4,          // 擦除Flash中的记录
+};
+
+struct BlackBoxCmd {                // 0x062 (cmd = SERVICE_BLACKBOX)
+    uint8_t cmd;
+    uint8_t op;                     // BlackBoxOp
+    uint16_t arg;
+    uint8_t resv[4];
+} __attribute__((packed));
+
+#define BLACKBOX_INFO_OFFSET    0xFFFF
+
+struct TxBlackBoxData {             // 0x055
+    uint16_t offset;                // 数据在记录中的字节偏移，BLACKBOX_INFO_OFFSET为状态帧
+    uint8_t data[6];                // 状态帧: state, recordValid, recordSize(u16), postTrigger(u16)
+} __attribute__((packed));
+
+enum EventLogOp
+{
+    EVENTLOG_OP_INFO = 0,           // 发送状态帧
+    EVENTLOG_OP_READ = 1,           // 下载最近的arg条记录，0为全部
+    EVENTLOG_OP_CLEAR = 2,          // 擦除日志，保留序号和上电次数
+};
+
+struct EventLogCmd {                // 0x062 (cmd = SERVICE_EVENTLOG)
+    uint8_t cmd;
+    uint8_t op;                     // EventLogOp
+    uint16_t arg;
+    uint8_t resv[4];
+} __attribute__((packed));
+
+#define EVENTLOG_INFO_MARKER    0xFFFFFFFFU
+
+// 0x056，状态帧为TxEventLogInfo，记录按EventRecord的前后8字节分两帧连续发送
+struct TxEventLogInfo {
+    uint32_t marker;                // EVENTLOG_INFO_MARKER，记录的seq不会为此值
+    uint16_t recordNum;             // Flash中的有效记录数
+    uint16_t bootCount;             // 本次上电次数
+} __attribute__((packed));
+
+struct EventRecord;
+
+enum HealthOp
+{
+    HEALTH_OP_INFO = 0,             // 发送状态帧
+    HEALTH_OP_READ = 1,             // 下载全部记录，最后一条为本次上电的实时统计
+    HEALTH_OP_CLEAR = 2,            // 擦除记录（更换电容组后），保留序号
+};
+
+struct HealthCmd {                  // 0x062 (cmd = SERVICE_HEALTH)
+    uint8_t cmd;
+    uint8_t op;                     // HealthOp
+    uint16_t arg;
+    uint8_t resv[4];
+} __attribute__((packed));
+
+#define HEALTH_PART_INFO        0x80
+#define HEALTH_PART_NUM         5U      // 每条HealthRecord分5帧，每帧7字节
+
+struct TxHealthData {               // 0x057
+    uint8_t part;                   // 记录的分段序号0~4，HEALTH_PART_INFO为状态帧
+    uint8_t data[7];                // 状态帧: recordNum(u16), boardId(u32, UID的CRC-32), resv
+} __attribute__((packed));
+
+enum LossMapOp
+{
+    LOSSMAP_OP_INFO = 0,            // 发送状态帧
+    LOSSMAP_OP_READ = 1,            // 下载有数据的格
+    LOSSMAP_OP_CLEAR = 2,           // 清空统计
+};
+
+struct LossMapCmd {                 // 0x062 (cmd = SERVICE_LOSSMAP)
+    uint8_t cmd;
+    uint8_t op;                     // LossMapOp
+    uint16_t arg;
+    uint8_t resv[4];
+} __attribute__((packed));
+
+#define LOSSMAP_INFO_MARKER     0xFF
+
+struct TxLossMapInfo {              // 0x058 状态帧
+    uint8_t marker;                 // LOSSMAP_INFO_MARKER
+    uint8_t modeNum;
+    uint8_t binNum;                 // 每个模式和方向的功率格数
+    uint8_t resv;
+    uint16_t powerStep;             // 每格输入功率宽度，单位W
+    uint16_t activeCells;           // 有数据的格数，即READ发送的帧数
+} __attribute__((packed));
+
+struct TxLossMapData {              // 0x058
+    uint32_t cell: 8;               // (dcdcMode * 2 + 放电) * binNum + 功率格
+    uint32_t time: 24;              // 累计时间，单位10ms
+    uint16_t pIn;                   // 平均输入功率，单位0.1W
+    int16_t loss;                   // 平均损耗（输入-输出），单位0.01W
+} __attribute__((packed));
+
+struct TelemetryCmd {               // 0x062 (cmd = SERVICE_TELEMETRY)
+    uint8_t cmd;
+    uint8_t channelMask;            // bit n为TelemetryChannel n，0为停止
+    uint16_t decimation;            // 采样间隔，单位16us，不小于TELEMETRY_MIN_DECIMATION
+    uint8_t resv[4];
+} __attribute__((packed));
+
+struct TelemetryFrame;
+
+enum ParamOp
+{
+    PARAM_OP_INFO = 0,              // 发送状态帧
+    PARAM_OP_GET = 1,               // 读取id的当前值
+    PARAM_OP_SET = 2,               // 检查范围后写入暂存区
+    PARAM_OP_APPLY = 3,             // 检查约束，在下一个62.5kHz周期开始时应用全部暂存值
+    PARAM_OP_DISCARD = 4,           // 清空暂存区
+    PARAM_OP_SAVE = 5,              // 功率级关闭后将当前值写入Flash
+    PARAM_OP_DEFAULT = 6,           // 将全部默认值写入暂存区，需APPLY
+    PARAM_OP_LIST = 7,              // 发送全部参数的当前值、范围和默认值
+};
+
+struct ParamCmd {                   // 0x062 (cmd = SERVICE_PARAM)
+    uint8_t cmd;
+    uint8_t op;                     // ParamOp
+    uint8_t id;                     // ParamId
+    uint8_t resv;
+    uint32_t value;                 // float或整数，按参数类型解释
+} __attribute__((packed));
+
+enum ParamField
+{
+    PARAM_FIELD_VALUE = 0,
+    PARAM_FIELD_STAGED = 1,
+    PARAM_FIELD_MIN = 2,
+    PARAM_FIELD_MAX = 3,
+    PARAM_FIELD_DEFAULT = 4,
+};
+
+enum ParamStatus
+{
+    PARAM_OK = 0,
+    PARAM_ERR_ID = 1,               // id不存在
+    PARAM_ERR_RANGE = 2,            // 超出范围，或为NaN
+    PARAM_ERR_CONSTRAINT = 3,       // 违反参数之间的约束，id为其中之一
+    PARAM_ERR_BUSY = 4,             // 上一次APPLY尚未生效
+    PARAM_ERR_FLASH = 5,
+};
+
+struct TxParamData {                // 0x05A
+    uint8_t op;                     // 回复的ParamOp
+    uint8_t id;                     // INFO时为参数个数
+    uint8_t field: 4;               // ParamField，INFO时bit0 Flash有效，bit1 当前值未保存
+    uint8_t type: 4;                // ParamType
+    uint8_t status;                 // ParamStatus
+    uint32_t value;                 // INFO/APPLY/DEFAULT时为暂存或应用的参数位图
+} __attribute__((packed));
+
 
 // 开启DCDC:1 错误状态:2 
 
 extern TxData txData;
 extern TxDataNew txDataNew;
+extern TxBurstData txBurstData;
 
 namespace CANcomm 
 {
     void init();
 
-    void sendSCData();
+    // 在1kHz任务中调用，更新总线状态，bus-off后按等待时间恢复
+    void updateBus();
+
+    // 在发送完成中断和updateBus()中调用，按优先级补充TX FIFO
+    void pumpTx();
+
+    // 在4kHz任务中调用，需要时发送反馈帧，放电预测帧仍为100Hz
+    void updateFeedback();
+
+    void sendSCData(FeedbackReason reason);
+
+    // 在1kHz任务中调用，按diagPeriod发送诊断帧
+    void updateDiag();
+
+    // 在FDCAN中断中调用，只保留8字节标准数据帧（ID已由硬件过滤），time为接收时的us计数
+    void pushRx(const FDCAN_RxHeaderTypeDef &header, const uint8_t *data, uint32_t time);
+
+    // 在1kHz任务中调用，处理FDCAN中断放入队列的帧
+    void processRx();
 
     void rxDataHandler(const RxData &rd);
 
+    void serviceHandler(const uint8_t *data);
+
+    // 以下为上位机回复，队列满时返回false，由调用方下次重试
+    bool sendBodeData(const TxBodeData &td);
+
+    bool sendBlackBoxData(const TxBlackBoxData &td);
+
+    bool sendEventLogInfo(const TxEventLogInfo &td);
+
+    // 一条记录的两帧需连续发送，队列剩余空间不足时返回false
+    bool sendEventLogRecord(const EventRecord &rec);
+
+    bool sendHealthData(const TxHealthData &td);
+
+    bool sendLossMapInfo(const TxLossMapInfo &td);
+
+    bool sendLossMapData(const TxLossMapData &td);
+
+    // 64字节CAN-FD帧，只在4kHz任务中调用，上一帧尚未写入TX FIFO时返回false
+    bool sendTelemetry(const TelemetryFrame &frame);
+
+    bool sendParamData(const TxParamData &td);
+
+    // 时间同步回复，与反馈帧同一优先级
+    void sendTimeSync(const TxTimeData &td);
+
+    // 多板并联广播，与反馈帧同一优先级，只保留最新值
+    void sendPeerData(const TxPeerData &td);
+
 }  // namespace Communication
\ No newline at end of file
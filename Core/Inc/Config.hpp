@@ -49,18 +49,46 @@
 #define SCP_VOLTAGE             5.0f
 #define SCP_CURRENT             5.0f
 #define SCP_RECOVER_TIME        1000
+// 去抖为累积计数：条件成立时加SCP_x_HIT，不成立时每次62.5kHz检查减1，超过SCP_LEAK_TRIP触发
+// 与原来1kHz下A端+600、B端+300、每ms减1、超过1700触发相同：约100ms内A端3次或B端6次
+#define SCP_A_HIT               37500U
+#define SCP_B_HIT               18750U
+#define SCP_LEAK_TRIP           106251U
+// 快速短路检测：相邻两次62.5kHz采样间电流上升且电压跌落同时超过阈值时立即触发
+#define SCP_DI_STEP             4.0f    // A/采样周期
+#define SCP_DV_STEP             2.0f    // V/采样周期
+#define SCP_RATE_GAP_CYCLES     6000U   // 两次检查间隔超过此CPU周期数时（输出刚开启）不计算变化率
 // 裁判系统欠压关断
 #define REFEREE_UVLO_LIMIT      18.0f //狗腿特殊阈值15V，正常阈值18V
 #define REFEREE_UVLO_RECOVERY   20.0f
-// Low Efficiency Protection
-#define LOW_EFFICIENCY_RATIO    0.75f
+#define REFEREE_POWER_OFF_TIME  2000U   // vA低于UVLO持续时间，ms，超过后认为裁判系统断电并清除错误
+// 能量回收时vA钳位电压，高于此值时将回收能量导入电容组，需低于OVP_A
+#define VA_CLAMP_VOLTAGE        27.0f
 
 #define BATTERY_LOW_LIMIT       20.92f
 #define BATTERY_LOW_RECOVERY    21.6f
+#define BATTERY_LOW_DEBOUNCE    1000U   // 1kHz检查次数
 
 #define MAX_INDUCTOR_CURRENT    25.0f
 #define SOFT_START_TIME         8
 
+/*-------- THERMAL --------*/
+// 损耗估计参数，按实际器件标定
+#define THERMAL_AMBIENT_TEMP        40.0f   // 环境温度，取机器人内部的保守值
+#define THERMAL_MOS_RDSON           0.003f  // 单管导通电阻（热态），Ω
+#define THERMAL_SW_LOSS_COEF        0.0025f // 开关损耗 = COEF * V * |iL|，0.5*(tr+tf)*fsw，W/(V*A)
+#define THERMAL_INDUCTOR_DCR        0.002f  // 电感直流电阻，Ω
+// 降额温度，低于BURST温度时允许短时电流，之后线性降到持续电流，超过DERATE温度后继续降到最小电流
+#define THERMAL_BURST_TEMP          80.0f
+#define THERMAL_DERATE_TEMP         100.0f
+#define THERMAL_MAX_TEMP            120.0f
+#define THERMAL_IB_BURST_CURRENT    20.0f   // 需低于OCP_CAPARR
+// 电容组没有单独的热模型，高于CAPARR_MAX_CURRENT的部分按I²t预算限时：满预算可以BURST电流持续此时间
+// 电流低于CAPARR_MAX_CURRENT时预算恢复，预算用完前最后20%内线性降回CAPARR_MAX_CURRENT
+#define THERMAL_IB_BURST_TIME       2.0f    // s
+#define THERMAL_IB_MIN_CURRENT      5.0f
+#define THERMAL_IL_MIN_CURRENT      8.0f
+
 
 /*-------- DEFUALT --------*/
 #define REFEREE_DEFUALT_POWER   37.0f
@@ -82,6 +110,11 @@
 #define CAPARR_MAX_VOLTAGE      28.8f//
 #define CAPARR_MAX_CURRENT      15.0f
 #define CM01_CURRENT_LIMIT      15.0f
+// 放电功率预测
+#define CAPARR_DISCHARGE_EFFICIENCY 0.92f   // 电容放电到底盘的估计效率
+#define BURST_DEFAULT_QUERY_POWER   200U    // 主控未指定时的预测功率，单位W
+#define BURST_PREDICT_PERIOD        10U     // 100Hz
+#define BURST_DURATION_UNLIMITED    0xFFFFU // 裁判系统即可满足该功率
 
 
 // ERROR_UNRECOVERABLE
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "main.h"
+#include "stdint.h"
+#include "Config.hpp"
+
+// 事件日志：定长记录循环写入Flash存储区，写满一个擦除单元后擦除最旧的单元继续写入（磨损均衡）
+// 事件先写入CCM RAM中的暂存队列，功率级关闭后在主循环中写入Flash，暂存队列在软件复位后保留
+
+#define EVENTLOG_RECORD_SIZE        16U
+#define EVENTLOG_QUEUE_SIZE         32U     // 需为2的幂
+#define EVENTLOG_QUEUE_MAGIC        0x51474F4CU    // "LOGQ"
+#define EVENTLOG_RECORDS_PER_TICK   1U      // 下载时每1kHz周期最多发送的记录数，每条两帧
+#define EVENTLOG_SLOTS_PER_TICK     16U     // 下载时每1kHz周期最多检查的位置数
+
+enum EventType
+{
+    EVENT_BOOT = 1,                 // 上电，payload: RCC_CSR复位标志 bit31:24
+    EVENT_RESET_REQUEST = 2,        // 软件复位请求，payload: ResetSource
+    EVENT_ERROR = 3,                // 触发错误或警告，payload: 错误位，level: ErrorLevel
+    EVENT_ERROR_CLEAR = 4,          // 清除错误，payload: 清除前的errorCode，level: 清除前的ErrorLevel
+    EVENT_REFEREE_POWER_OFF = 5,    // 裁判系统断电，payload: vA，单位0.01V
+    EVENT_REFEREE_POWER_ON = 6,     // 裁判系统恢复供电，payload: 断电时长，单位100ms
+    EVENT_QUEUE_OVERFLOW = 7,       // 暂存队列溢出，payload: 丢弃的事件数
+    EVENT_WATCHDOG_RESET = 8,       // 上次为看门狗复位，payload: 超时的SupervisorTask掩码，或SUPERVISOR_STALL_FLAG | 最后完成的1kHz时隙
+    EVENT_DEADLINE_MISS = 9,        // 任务超过期限，payload: 新超时的SupervisorTask掩码
+    EVENT_CAN_RX_OVERFLOW = 10,     // CAN接收队列溢出，payload: 上次记录后丢弃的帧数
+    EVENT_CAN_BUS_OFF = 11,         // CAN bus-off，payload: 本次上电后的累计次数
+    EVENT_PARALLEL_PEER_LOST = 12,  // 并联节点的广播超时，payload: 节点号
+    EVENT_PARALLEL_NODE_CONFLICT = 13,  // 收到与本节点相同节点号的广播，payload: 节点号
+};
+
+enum ResetSource
+{
+    RESET_SOURCE_CAN = 1,           // 主控板systemRestart
+    RESET_SOURCE_BUTTON = 2,        // 长按按键
+};
+
+struct EventRecord
+{
+    uint32_t seq;                   // 写入序号，全1为空记录
+    uint32_t timestamp;             // 本次上电后的时间，单位ms
+    uint16_t bootCount;             // 上电次数
+    uint8_t type;                   // EventType
+    uint8_t level;                  // ErrorLevel，非错误事件为0
+    uint16_t payload;
+    uint16_t check;                 // 前14字节CRC-32的低16位
+} __attribute__((packed));
+
+struct EventLogCmd;
+
+struct EventLogData
+{
+    uint16_t bootCount = 0;
+    uint32_t nextSeq = 0;
+    uint16_t headSlot = 0;          // 下一条记录写入的位置
+    uint16_t recordNum = 0;         // Flash中的有效记录数
+    uint16_t dropped = 0;           // 暂存队列溢出丢弃的事件数
+
+    volatile bool infoRequest = false;
+    volatile bool clearRequest = false;
+    volatile bool reading = false;
+    uint16_t readSlot = 0;
+};
+
+extern EventLogData eventLogData;
+
+namespace EventLog
+{
+
+// 扫描Flash恢复写入位置和上电次数，记录上电事件，需在其他模块之前调用
+void init();
+
+// 可在任意中断中调用
+void log(EventType type, uint16_t payload, uint8_t level = 0);
+
+// 上位机指令，在1kHz任务中调用
+void command(const EventLogCmd &cmd);
+
+// 在1kHz任务中调用，发送状态和下载数据
+void update();
+
+// 在主循环中调用，把暂存队列写入Flash
+void process();
+
+} // namespace EventLog
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "main.h"
+#include "stdint.h"
+#include "Config.hpp"
+
+// 环路频率响应测量（扫频注入正弦小信号，逐点单频DFT相关）
+// 注入和相关在62.5kHz中断中完成，每个频点的幅相计算和发送在1kHz任务中完成
+
+#define ANALYZER_SAMPLE_FREQ    62500.0f
+#define ANALYZER_SIN_TABLE_SIZE 256U
+#define ANALYZER_SETTLE_CYCLES  4U      // 每个频点开始相关前等待的周期数
+#define ANALYZER_MEASURE_CYCLES 8U      // 每个频点相关的周期数
+#define ANALYZER_MIN_FREQ       1U
+#define ANALYZER_MAX_FREQ       10000U
+
+enum AnalyzerTarget
+{
+    ANALYZER_OFF = 0,
+    ANALYZER_IL_TARGET = 1,         // 注入psData.iLTarget，测量环路增益 -B/A
+    ANALYZER_REFEREE_TARGET = 2,    // 注入pRefereeTarget，测量闭环响应 pReferee/pRefereeTarget
+};
+
+struct BodeCmd;
+
+struct LoopAnalyzerData
+{
+    AnalyzerTarget target = ANALYZER_OFF;
+    volatile bool running = false;      // 中断中正在注入当前频点
+    volatile bool pointDone = false;    // 当前频点相关完成，等待1kHz任务处理
+
+    float amplitude = 0.0f;             // 注入幅值，A或W
+    float injection = 0.0f;             // 本周期注入量
+    float pRefereeInjection = 0.0f;     // 叠加到pRefereeTarget上的注入量
+    float iLApplied = 0.0f;             // 上周期实际叠加到iLTarget上的注入量
+    float sinValue = 0.0f, cosValue = 0.0f;
+
+    uint32_t phase = 0;
+    uint32_t phaseInc = 0;
+    uint32_t sampleCnt = 0;
+    uint32_t settleSamples = 0;
+    uint32_t totalSamples = 0;
+
+    float sumA[2] = {0.0f};             // 注入点之后信号的DFT (re, im)
+    float sumB[2] = {0.0f};             // 环路返回信号的DFT (re, im)
+
+    float startFreq = 0.0f;
+    float stopFreq = 0.0f;
+    float frequency = 0.0f;
+    uint8_t pointIndex = 0;
+    uint8_t pointNum = 0;
+};
+
+extern LoopAnalyzerData analyzerData;
+
+namespace LoopAnalyzer
+{
+
+void init();
+
+void start(const BodeCmd &cmd);
+
+void stop();
+
+// 在updateMFLoop之前调用，恢复上周期的iLTarget注入并计算本周期注入量
+void beginMF();
+
+// 在updateMFLoop之后、setInductorCurrent之前调用，叠加iLTarget注入并进行相关
+void endMF();
+
+// 在1kHz任务中调用，处理完成的频点并开始下一个频点
+void update();
+
+} // namespace LoopAnalyzer
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "main.h"
+#include "stdint.h"
+#include "Config.hpp"
+
+// 损耗分布图：按DCDC模式、充放电方向和输入功率分格，统计各工况下的输入/输出功率，
+// 上位机由此得到各工况的平均损耗和效率，用于调整模式切换阈值和死区
+// 62.5kHz中断中只做乘加，累加到双缓冲的短期和中，1kHz任务交换缓冲并累加到长期和
+
+#define LOSSMAP_SAMPLE_FREQ     62500U
+#define LOSSMAP_MODE_NUM        4U      // BUCK, BUCKBOOST, BOOSTBUCK, BOOST
+#define LOSSMAP_DIR_NUM         2U      // 0: 充电 A->B, 1: 放电 B->A
+#define LOSSMAP_POWER_BIN_NUM   8U
+#define LOSSMAP_POWER_STEP      40.0f   // 每格输入功率宽度，W，最后一格包括更高的功率
+#define LOSSMAP_MIN_POWER       2.0f    // 输入功率低于此值时效率无意义，不统计
+#define LOSSMAP_CELL_NUM        (LOSSMAP_MODE_NUM * LOSSMAP_DIR_NUM * LOSSMAP_POWER_BIN_NUM)
+#define LOSSMAP_FRAMES_PER_TICK 2U
+
+struct LossMapCmd;
+
+// 62.5kHz中断写入的短期和，每1ms交换
+struct LossMapBank
+{
+    float pIn[LOSSMAP_CELL_NUM];
+    float pOut[LOSSMAP_CELL_NUM];
+    uint16_t count[LOSSMAP_CELL_NUM];
+};
+
+struct LossMapData
+{
+    volatile uint8_t activeBank = 0;
+
+    int64_t pInSum[LOSSMAP_CELL_NUM] = {0};     // 单位mW·采样
+    int64_t pOutSum[LOSSMAP_CELL_NUM] = {0};
+    uint32_t count[LOSSMAP_CELL_NUM] = {0};     // 采样数，62.5kHz
+
+    volatile bool infoRequest = false;
+    volatile bool clearRequest = false;
+    volatile bool reading = false;
+    uint8_t readCell = 0;
+};
+
+extern LossMapData lossMapData;
+
+namespace LossMap
+{
+
+// 在62.5kHz中断中调用
+void accumulate();
+
+// 上位机指令，在1kHz任务中调用
+void command(const LossMapCmd &cmd);
+
+// 在1kHz任务中调用，合并短期和并发送数据
+void update();
+
+} // namespace LossMap
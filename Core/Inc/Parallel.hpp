@@ -0,0 +1,78 @@
+#pragma once
+
+#include "main.h"
+#include "stdint.h"
+#include "Config.hpp"
+#include "Calibration.hpp"
+
+// 多板并联：大型机器人上多块控制板的A侧并联，裁判系统电源经各板的iR采样电阻供电，各板连接自己的电容组
+// 节点号和节点数在校准记录中给出（HARDWARE_NODE_ID、HARDWARE_PARALLEL_NUM），与UID绑定
+// 0号节点使用原有的CAN ID，其余节点的发送ID和0x062/0x063加上节点号 × PARALLEL_CAN_ID_STRIDE，主控指令0x061为共用
+// 各节点以1kHz广播0x040+节点号，给出电容电流、电压、裁判系统功率和输出状态
+// updateMFLoop中将裁判系统功率按节点数平分，再按本节点与平均电容电流之差做PI修正：
+// 各板采样电阻分流不同时两个iR环会互相对抗，修正后各组电容电流相同，各节点的修正量之和为0，总功率不变
+
+#define PARALLEL_MAX_NODES          4U
+#define PARALLEL_CAN_ID_STRIDE      0x100U
+#define PARALLEL_PEER_TIMEOUT       20U     // ms，超时的节点仍按一份计入，宁可少用裁判系统功率
+#define PARALLEL_SHARE_KP           0.6f    // W/A，电容电流差的比例修正
+#define PARALLEL_SHARE_KI           0.0005f // W/A，每个62.5kHz周期的积分增益
+#define PARALLEL_SHARE_LIMIT        20.0f   // W，修正量上限
+#define PARALLEL_RESERVED_ALPHA     0.1f    // 1kHz，关闭输出的节点的裁判系统功率的滤波系数
+
+#ifndef HARDWARE_NODE_ID
+#define HARDWARE_NODE_ID            0U
+#endif
+
+#ifndef HARDWARE_PARALLEL_NUM
+#define HARDWARE_PARALLEL_NUM       1U      // 1为单板，不发送广播帧
+#endif
+
+struct TxPeerData;
+
+struct ParallelPeer
+{
+    float iCap = 0.0f;
+    float vCap = 0.0f;
+    float pReferee = 0.0f;
+    uint32_t lastTick = 0;          // 最近一次收到的vTick
+    uint8_t seq = 0;
+    bool online = false;
+    bool sharing = false;           // 输出开启，参与功率分配
+    uint16_t lostCnt = 0;           // 超时次数
+    uint16_t seqLost = 0;           // 序号不连续的累计帧数
+};
+
+struct ParallelData
+{
+    uint8_t nodeId = HARDWARE_NODE_ID;
+    uint8_t nodeNum = HARDWARE_PARALLEL_NUM;
+    uint16_t canIdOffset = HARDWARE_NODE_ID * PARALLEL_CAN_ID_STRIDE;
+
+    ParallelPeer peer[PARALLEL_MAX_NODES];
+    uint8_t txSeq = 0;
+    uint16_t conflictCnt = 0;       // 收到与本节点相同节点号的广播帧
+
+    // 1kHz任务写入（关中断），62.5kHz中断读取
+    uint8_t shareNum = HARDWARE_PARALLEL_NUM;   // 平分裁判系统功率的份数，包括本节点
+    uint8_t activeNum = 0;          // 在线且参与分配的其他节点数
+    float iCapPeerSum = 0.0f;       // 这些节点的电容电流之和
+    float pReserved = 0.0f;         // 在线但关闭输出的节点的裁判系统功率（电流仍流过其采样电阻）
+
+    // 62.5kHz中断写入
+    float shareIntegral = 0.0f;
+    float shareBias = 0.0f;         // W，叠加到本节点分得的裁判系统功率上
+};
+
+extern ParallelData parallelData;
+
+namespace Parallel
+{
+
+// 在1kHz任务中处理其他节点的广播帧
+void receive(uint8_t node, const TxPeerData &pd, uint32_t tick);
+
+// 在1kHz任务中调用，在processRx()之后，更新分配份数并发送本节点的广播帧
+void update();
+
+} // namespace Parallel
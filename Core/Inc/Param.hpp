@@ -0,0 +1,130 @@
+#pragma once
+
+#include "main.h"
+#include "stdint.h"
+#include "Config.hpp"
+
+// 运行时参数：PID增益、电容组阈值和模式切换阈值等通过CAN读写，不需要重新烧录
+// SET先写入暂存区，APPLY检查参数之间的约束后在下一个62.5kHz周期开始时一次性生效，SAVE在功率级关闭后写入Flash
+// 参数表在Param.cpp中，init()时写入表中的默认值；ParamId为协议的一部分，只能在末尾添加
+
+#define PARAM_MAGIC             0x4D524150U    // "PARM"
+#define PARAM_VERSION           1U
+#define PARAM_REPLY_QUEUE_SIZE  8U      // 需为2的幂
+#define PARAM_FRAMES_PER_TICK   2U
+
+enum ParamId
+{
+    PARAM_IR_KTP,                   // mfLoop.iRPID，裁判系统功率环
+    PARAM_IR_KMP,
+    PARAM_IR_KI,
+    PARAM_IR_KD,
+    PARAM_VACLAMP_KTP,              // mfLoop.vAClampPID，vA钳位环
+    PARAM_VACLAMP_KMP,
+    PARAM_VACLAMP_KI,
+    PARAM_VACLAMP_KD,
+    PARAM_VACLAMP_VOLTAGE,          // VA_CLAMP_VOLTAGE
+    PARAM_CURRENT_LIMIT_KI,
+    PARAM_VOLTAGE_LIMIT_KI,
+    PARAM_BURST_KI,
+    PARAM_REF_KP,                   // ctrlData.refLoop，缓冲能量环
+    PARAM_REF_KI,
+    PARAM_REF_KD,
+    PARAM_REF_ENERGY_BUFFER,        // REFEREE_ENERGY_BUFFER
+    PARAM_CAPARR_CUTOFF_VOLTAGE,    // CAPARR_*
+    PARAM_CAPARR_LOW_VOLTAGE,
+    PARAM_CAPARR_MAX_CURRENT,
+    PARAM_CAPARR_DCR,
+    PARAM_MODE_BUCK_TO_BUCKBOOST,   // psData.modeThreshold
+    PARAM_MODE_BUCKBOOST_TO_BUCK,
+    PARAM_MODE_BUCKBOOST_TO_BOOSTBUCK,
+    PARAM_MODE_BOOSTBUCK_TO_BUCK,
+    PARAM_MODE_BOOSTBUCK_TO_BUCKBOOST,
+    PARAM_MODE_BOOSTBUCK_TO_BOOST,
+    PARAM_MODE_BOOST_TO_BUCK,
+    PARAM_MODE_BOOST_TO_BOOSTBUCK,
+    PARAM_FEEDBACK_PERIOD,          // feedbackData，反馈帧的发送周期和变化触发阈值
+    PARAM_FEEDBACK_POWER_DELTA,
+    PARAM_FEEDBACK_ENERGY_DELTA,
+    PARAM_DIAG_PERIOD,              // feedbackData.diagPeriod，诊断帧0x05B
+    PARAM_NUM
+};
+
+enum ParamType
+{
+    PARAM_TYPE_FLOAT = 0,
+    PARAM_TYPE_UINT16 = 1,
+};
+
+struct ParamDesc
+{
+    uint8_t id;                     // ParamId，需与表中的位置一致
+    uint8_t type;                   // ParamType
+    float min, max, def;
+    void *ptr;
+};
+
+// Flash中每个参数按ID保存，添加参数后旧记录中缺少的参数保持默认值
+struct ParamEntry
+{
+    uint8_t id;
+    uint8_t type;
+    uint16_t resv;
+    uint32_t value;
+} __attribute__((packed));
+
+// Flash中依次为ParamHeader、count个ParamEntry和CRC-32（对前两部分计算）
+struct ParamHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+} __attribute__((packed));
+
+struct ParamCmd;
+
+struct ParamData
+{
+    // 暂存区，1kHz任务写入，APPLY后由62.5kHz中断复制到参数
+    uint32_t staged[PARAM_NUM] = {0};
+    volatile uint32_t stagedMask = 0;
+    volatile bool applyRequest = false;
+    volatile bool applied = false;
+    uint32_t appliedMask = 0;
+
+    bool flashValid = false;
+    bool dirty = false;             // 已生效的参数与Flash中不同
+    volatile bool saveRequest = false;
+    volatile bool saveDone = false;
+    bool saveOk = false;
+
+    volatile bool listing = false;
+    uint8_t listIndex = 0;
+    uint8_t listField = 0;
+
+    // 指令的回复，1kHz任务中写入和发送
+    volatile uint8_t replyHead = 0;
+    volatile uint8_t replyTail = 0;
+};
+
+extern ParamData paramData;
+
+namespace Param
+{
+
+// 写入默认值并加载Flash中保存的参数，需在开启HRTIM之前调用
+void init();
+
+// 在62.5kHz中断开始时调用，应用APPLY的暂存参数
+void applyPending();
+
+// 上位机指令，在1kHz任务中调用
+void command(const ParamCmd &cmd);
+
+// 在1kHz任务中调用，发送回复
+void update();
+
+// 在主循环中调用，功率级关闭后保存
+void process();
+
+} // namespace Param
@@ -42,11 +42,27 @@ struct SystemData
     bool buttonPressedLast = 0;
 
     uint8_t lfLoopIndex = 0;
+
+    volatile bool flashBusy = false;    // Flash擦写中，禁止开启功率级
+    uint8_t resetFlags = 0;             // 上电时的RCC_CSR复位标志 bit31:24
 };
 
 enum DCDCMode{BUCK, BUCKBOOST, BOOSTBUCK, BOOST, CALIBRATION_A, CALIBRATION_B, CALIBRATION};
 enum PCMMode{IB_VALLEY, IA_PEAK};
 
+// 模式切换阈值，按dutyByVoltage = vB / vA比较，相邻模式之间留有迟滞
+struct ModeThreshold
+{
+    float buckToBuckBoost = 0.84f;
+    float buckBoostToBuck = 0.80f;
+    float buckBoostToBoostBuck = 1.02f;
+    float boostBuckToBuck = 0.82f;
+    float boostBuckToBuckBoost = 0.98f;
+    float boostBuckToBoost = 1.25f;
+    float boostToBuck = 0.82f;
+    float boostToBoostBuck = 1.19f;
+};
+
 struct PowerStageData
 {
     bool timerEnabled = 0;
@@ -56,7 +72,6 @@ struct PowerStageData
     bool allowEnableOutput = 1;
 
     float dutyByVoltage = 0.0f;
-    float efficiency = 1.0f;
 
     float dutyE = 0.0f; //E侧占空比
     float dutyEMin = 0.0f; //E侧最小占空比
@@ -67,8 +82,10 @@ struct PowerStageData
 
     DCDCMode dcdcMode = BUCK;
     PCMMode pcmMode = IB_VALLEY;
+    ModeThreshold modeThreshold;
     float iLTarget = 0.0f;
     float IRQload = 0.0f;
+    float IRQloadMax = 0.0f;    // 诊断帧发送后清零
 };
 
 struct ADCData
@@ -102,6 +119,7 @@ enum LimitFactor
     CAPARR_VOLTAGE_NORMAL,
     IB_POSITIVE,
     IB_NEGATIVE,
+    VA_CLAMP,       // 能量回收，vA钳位
 };
 
 enum ErrorLevel
@@ -126,12 +144,14 @@ struct ControlData
     struct RefereeData
     {
         float kP = 1.0f, kI=0.04f, kD=1.5f; //积分增益
+        uint16_t energyBufferTarget = REFEREE_ENERGY_BUFFER; //缓冲能量目标，单位J
         uint16_t lastError = 0.0f; //上次误差
         float integral = 0.0f; //积分值
         int16_t error = 0U;
         uint32_t lastTimestamp = 0;
         float pRefereeBias = 0.0f;
         bool isConnected = 0;
+        uint16_t timeoutCnt = 0; //主控指令超时次数
         #ifdef DEFAULT_WITH_NEW_FORMAT
         bool useNewFeedbackMessage = 1;
         #else
@@ -158,6 +178,9 @@ struct ControlData
 struct LoopControlData
 {
     IncreasementPID iRPID {0.1f, 0.2f, 0.10f, 0.01f};
+    // vA钳位环，computeDelta(vA, VA_CLAMP_VOLTAGE)，kTP对vA上升率响应，kI对超出钳位电压的部分积分
+    IncreasementPID vAClampPID {10.0f, 0.0f, 0.5f, 0.0f};
+    float vAClampVoltage = VA_CLAMP_VOLTAGE;
     //IncreasementPID vCapPID {0.0f, 0.0f, 0.02f, 0.0f};
 
     float currentLimitKI = 0.8f;
@@ -172,6 +195,7 @@ struct LoopControlData
     //float dIL_VCap_MaxBurst;
     float dIL_IB_Positive;
     float dIL_IB_Negative;
+    float dIL_VA_Clamp;
 
     float dIL_recoverBurst;
 
@@ -191,26 +215,89 @@ struct CAPARRStatus
         uint32_t lastTick = 0;
         float dQtodV = CAPARR_DEFUALT_CAPACITY;
         float dVtodQ = (1.0f / CAPARR_DEFUALT_CAPACITY);
+        float capacity = CAPARR_DEFUALT_CAPACITY;  //最近一次有效的容量估计，单位F
         
         float maxIB = 0.0f;
         float minIB = 0.0f;
     };
+
+    struct BurstPredictData
+    {
+        uint16_t queryPower = BURST_DEFAULT_QUERY_POWER;   //预测功率，单位W
+        uint16_t queryDuration = 0;                         //可维持预测功率的时间，单位ms
+        uint16_t maxPowerDuration = 0;                      //可维持chassisPowerLimit的时间，单位ms
+        float usableEnergy = 0.0f;                          //可用能量，单位J
+    };
     
     float maxOutCurrent = 2.0f;
     float maxInCurrent = 2.0f;
+    // 以下默认值为Config.hpp中的CAPARR_*，可通过参数服务修改
+    float cutoffVoltage = CAPARR_CUTOFF_VOLTAGE;
+    float lowVoltage = CAPARR_LOW_VOLTAGE;
+    float maxCurrent = CAPARR_MAX_CURRENT;
+    float dcr = CAPARR_DCR;
     CapacityEstimateData capEstData;
+    BurstPredictData burstData;
 
     uint16_t warningCnt = 0; //警告计数
 };
 
+// 保护规则表使用的信号，每次检查开始时统一采样
+enum ProtectionSignal
+{
+    SIGNAL_VA,
+    SIGNAL_VB,
+    SIGNAL_IA_OUT,      // -iA，A侧流出电流
+    SIGNAL_IB,
+    SIGNAL_DVA,         // 相邻两次采样的变化量，只在62.5kHz检查中有效
+    SIGNAL_DIA_OUT,
+    SIGNAL_DVB,
+    SIGNAL_DIB,
+    SIGNAL_NUM
+};
+
+// 单个比较条件，带施密特迟滞：成立后需越过 threshold -/+ hysteresis 才解除
+struct ProtectionCondition
+{
+    ProtectionSignal signal;
+    float sign;             // 1.0f: signal > threshold 时成立, -1.0f: signal < threshold 时成立
+    float threshold;
+    float hysteresis;
+};
+
+// 保护规则：conditionMask中的条件全部成立并连续保持debounce次检查后触发
+// leakStep不为0时为累积计数：条件每次成立加leakStep，不成立时每次检查减1，计数达到debounce时触发
+struct ProtectionRule
+{
+    uint32_t conditionMask;
+    uint32_t debounce;
+    uint32_t leakStep;                  // 0: 条件解除即清零
+    uint16_t errorBit;
+    ErrorLevel level;                   // WARNING级别的规则在条件解除后自动清除
+    ProtectionSignal voltageSignal;     // 触发时记录到errorVoltage
+    ProtectionSignal currentSignal;     // 触发时记录到errorCurrent
+};
+
+#define PROTECTION_MAX_RULES 8U
+
+struct ProtectionState
+{
+    uint32_t conditionMask = 0;     // 当前成立的条件
+    uint32_t pendingMask = 0;       // 计数中但未触发的规则
+    uint32_t tripMask = 0;          // 已触发的规则
+    uint32_t debounceCnt[PROTECTION_MAX_RULES] = {0};
+
+    uint32_t evalCycles = 0;        // 最近一次检查耗时，CPU周期
+    uint32_t maxEvalCycles = 0;     // 最长检查耗时，CPU周期
+    uint32_t lastStart = 0;         // 上一次检查开始时的CPU周期计数
+    float lastSignal[4] = {0.0f};   // 上一次的vA、iA_OUT、vB、iB，用于计算变化率
+};
+
 struct ErrorData
 {
     uint16_t errorCode = 0;
-    uint16_t shortCircuitCnt = 0;
-    uint16_t overVoltageCnt = 0;
-    uint16_t overCurrentCnt = 0;
-    uint8_t lowBattery = 0;
-    uint16_t lowBatteryCnt = 0; //低电压计数
+    ProtectionState hfState;        // 62.5kHz规则表状态
+    ProtectionState lfState;        // 1kHz规则表状态
     ErrorLevel errorLevel     = NO_ERROR;       // 错误等级
     uint32_t powerOffCnt = 0; //关机计数
 
@@ -285,10 +372,11 @@ void checkRxDataTimeout(const uint32_t& currentTick);
 namespace Protection
 {
 
+void initErrorCheck();
 void errorCheckHF();
 void errorCheckLF();
+void raiseError(uint16_t errorBit, ErrorLevel level);
 
-void checkShortCircuit();
 void errorHandlerLF();
 void hrtimFaultHandler();
 
@@ -296,13 +384,10 @@ void configAWDG();
 
 void checkHardwareUID();
 
-void checkEfficiency();
 
 void autoClearError();
 void manualClearError();
 
-void checkLowBattery();
-
 
 } // namespace Protection
 
@@ -318,4 +403,6 @@ void updateCurrentforEstimation();
 
 uint16_t getMaxPowerFeedback();
 
+void updateBurstPrediction();
+
 } // namespace CAPARR
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "main.h"
+#include "stdint.h"
+#include "stddef.h"
+
+// 片上Flash存储区，位于128K Flash末尾20K，按4K对齐（单/双Bank模式下都是整页），链接脚本中已从FLASH区域中扣除
+// 双Bank模式下存储区在Bank2，擦写时仍可从Bank1取指（read-while-write）；单Bank模式下擦写时CPU取指会被阻塞，
+// 控制中断无法按时执行，所以只允许在功率级关闭时擦写
+
+#define STORAGE_BASE_ADDR       0x0801B000U
+#define STORAGE_SIZE            0x5000U
+#define STORAGE_END_ADDR        (STORAGE_BASE_ADDR + STORAGE_SIZE)
+#define STORAGE_ERASE_UNIT      0x1000U     // 擦除粒度，双Bank 2K页 / 单Bank 4K页的公倍数
+#define STORAGE_PROGRAM_UNIT    8U          // 双字编程
+
+// 存储区划分
+#define STORAGE_BLACKBOX_ADDR   STORAGE_BASE_ADDR
+#define STORAGE_BLACKBOX_SIZE   0x1000U
+#define STORAGE_EVENTLOG_ADDR   (STORAGE_BLACKBOX_ADDR + STORAGE_BLACKBOX_SIZE)
+#define STORAGE_EVENTLOG_SIZE   0x2000U
+#define STORAGE_HEALTH_ADDR     (STORAGE_EVENTLOG_ADDR + STORAGE_EVENTLOG_SIZE)
+#define STORAGE_HEALTH_SIZE     0x1000U
+#define STORAGE_PARAM_ADDR      (STORAGE_HEALTH_ADDR + STORAGE_HEALTH_SIZE)
+#define STORAGE_PARAM_SIZE      0x1000U
+
+namespace Storage
+{
+
+// 功率级开启，擦写会被拒绝；擦写失败时用于区分需要稍后重试还是Flash错误
+bool busy();
+
+// 擦除[address, address + size)，需按STORAGE_ERASE_UNIT对齐
+bool erase(uint32_t address, uint32_t size);
+
+// 写入已擦除的区域，address需8字节对齐，不足8字节的尾部以0xFF补齐
+bool program(uint32_t address, const void *data, uint32_t size);
+
+// 擦除后写入
+bool write(uint32_t address, const void *data, uint32_t size);
+
+// CRC-32 (与zlib.crc32一致)，crc为上一段的结果，可分段计算
+uint32_t crc32(const void *data, uint32_t size, uint32_t crc = 0);
+
+// 全为0xFF（已擦除）
+bool isBlank(const void *data, uint32_t size);
+
+// 定长记录环形存储：记录以uint32_t seq开头（全1为空记录），以uint16_t check结尾
+template <typename T> const T *slot(uint32_t base, uint32_t index)
+{
+    return reinterpret_cast<const T *>(base) + index;
+}
+
+// check为check之前部分CRC-32的低16位
+template <typename T> uint16_t recordCheck(const T &rec)
+{
+    return crc32(&rec, offsetof(T, check)) & 0xFFFF;
+}
+
+template <typename T> bool isValid(const T *rec)
+{
+    return rec->seq != 0xFFFFFFFFU && rec->check == recordCheck(*rec);
+}
+
+template <typename T> bool isBlank(const T *rec)
+{
+    return isBlank(rec, sizeof(T));
+}
+
+} // namespace Storage
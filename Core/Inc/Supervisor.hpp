@@ -0,0 +1,55 @@
+#pragma once
+
+#include "main.h"
+#include "stdint.h"
+#include "Config.hpp"
+
+// 任务监控：各周期任务完成后上报心跳，1kHz检查各任务是否在期限内上报，全部按时才喂独立看门狗(IWDG)
+// 4kHz任务本身停止运行（如被CAN中断卡住）时不会喂狗，IWDG超时后复位，关断功率级
+
+#define SUPERVISOR_IWDG_TIMEOUT     100U    // ms，需大于一页Flash擦除时间（最长约40ms）
+#define SUPERVISOR_TRACE_MAGIC      0x50414457U     // "WDAP"
+#define SUPERVISOR_STALL_FLAG       0x8000U // 看门狗复位原因：检查本身停止运行，低位为最后完成的1kHz时隙
+
+enum SupervisorTask
+{
+    SUPERVISOR_TASK_MF,             // HRTIM Master 62.5kHz中断
+    SUPERVISOR_TASK_LF0,            // 1kHz时隙0~3
+    SUPERVISOR_TASK_LF1,
+    SUPERVISOR_TASK_LF2,
+    SUPERVISOR_TASK_LF3,
+    SUPERVISOR_TASK_LED,            // LED状态更新
+    SUPERVISOR_TASK_CAN_RX,         // 主控板指令，只统计超时不影响喂狗，断开连接后不检查
+    SUPERVISOR_TASK_NUM
+};
+
+struct SupervisorData
+{
+    uint32_t lastBeat[SUPERVISOR_TASK_NUM] = {0};  // 最近一次心跳的vTick
+    uint16_t missCnt[SUPERVISOR_TASK_NUM] = {0};   // 超过期限的次数，每次超时只计一次
+    uint16_t lateMask = 0;          // 当前超时的任务
+    uint16_t resetCause = 0;        // 上次看门狗复位的原因，0为非看门狗复位
+    bool started = false;
+};
+
+extern SupervisorData supervisorData;
+
+namespace Supervisor
+{
+
+// 根据sysData.resetFlags记录上次看门狗复位的原因，需在EventLog::init之后调用
+void init();
+
+// 初始化完成后启动IWDG，启动后无法停止
+void start();
+
+// 任务完成时调用，可在任意中断中调用
+void heartbeat(SupervisorTask task);
+
+// 在1kHz任务中调用，检查期限并喂狗
+void check();
+
+// 直接喂狗，只用于功率级关闭时的长时间阻塞操作（Flash擦除）
+void refresh();
+
+} // namespace Supervisor
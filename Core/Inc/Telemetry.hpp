@@ -0,0 +1,83 @@
+#pragma once
+
+#include "main.h"
+#include "stdint.h"
+#include "Config.hpp"
+
+// 高速遥测：在62.5kHz中断中按抽取比采样所选通道，打包为64字节CAN-FD帧（数据段2Mbit/s），
+// 4kHz任务中发送，用于上位机调参和分析1kHz反馈中看不到的动态过程
+// 总线上存在只支持经典CAN的节点时不要开启，FD帧会使其产生错误帧
+
+#define TELEMETRY_FRAME_SIZE        64U
+#define TELEMETRY_HEADER_SIZE       8U
+#define TELEMETRY_PAYLOAD_SIZE      (TELEMETRY_FRAME_SIZE - TELEMETRY_HEADER_SIZE)
+#define TELEMETRY_QUEUE_SIZE        8U      // 需为2的幂
+#define TELEMETRY_MIN_DECIMATION    8U      // 62.5kHz / 8 = 7.8kHz
+#define TELEMETRY_MAX_DECIMATION    62500U  // 最低1Hz
+#define TELEMETRY_SAMPLE_FREQ       62500U
+
+enum TelemetryChannel
+{
+    TELEMETRY_CH_VA,                // 单位0.01V
+    TELEMETRY_CH_VB,                // 单位0.01V
+    TELEMETRY_CH_IA,                // 单位0.01A
+    TELEMETRY_CH_IB,                // 单位0.01A
+    TELEMETRY_CH_IR,                // 单位0.01A
+    TELEMETRY_CH_ILTARGET,          // 单位0.01A
+    TELEMETRY_CH_STATUS,            // bit7:0 dcdcMode, bit8 outputABEnabled, bit15:12 limitFactor
+    TELEMETRY_CH_NUM
+};
+
+// 每帧前8字节，后56字节为sampleNum个采样点，每个点按通道序号从小到大依次为int16
+struct TelemetryHeader
+{
+    uint16_t seq;                   // 帧序号，队列满丢弃的帧也占用序号
+    uint8_t channelMask;            // bit n为TelemetryChannel n
+    uint8_t sampleNum;              // 本帧采样点数
+    uint16_t decimation;            // 采样间隔，单位16us（62.5kHz周期）
+    uint16_t dropped;               // 队列满丢弃的累计帧数
+} __attribute__((packed));
+
+struct TelemetryFrame
+{
+    TelemetryHeader header;
+    int16_t samples[TELEMETRY_PAYLOAD_SIZE / 2];
+};
+
+struct TelemetryCmd;
+
+struct TelemetryData
+{
+    // 以下由1kHz任务写入，62.5kHz中断在下一次调用时应用，未写满的帧丢弃
+    volatile uint8_t pendingMask = 0;
+    volatile uint16_t pendingDecimation = TELEMETRY_MIN_DECIMATION;
+    volatile bool configChanged = false;
+
+    uint8_t channelMask = 0;        // 0为停止
+    uint8_t channelNum = 0;
+    uint8_t samplesPerFrame = 0;
+    uint16_t decimation = TELEMETRY_MIN_DECIMATION;
+    uint16_t decimationCnt = 0;
+    uint8_t sampleIndex = 0;        // 当前帧中已写入的采样点数
+
+    volatile uint8_t head = 0;      // 62.5kHz中断写入
+    volatile uint8_t tail = 0;      // 4kHz任务读出
+    uint16_t seq = 0;
+    uint16_t dropped = 0;
+};
+
+extern TelemetryData telemetryData;
+
+namespace Telemetry
+{
+
+// 在62.5kHz中断中调用
+void sample();
+
+// 上位机指令，在1kHz任务中调用
+void command(const TelemetryCmd &cmd);
+
+// 在4kHz任务中调用，每次最多发送一帧
+void update();
+
+} // namespace Telemetry
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "main.h"
+#include "stdint.h"
+#include "Config.hpp"
+
+// 集总热模型：A/B两个半桥和电感各用一个多级Foster RC网络，
+// 由62.5kHz中断中累加的导通和开关损耗驱动，在1kHz任务中更新温升和电流限制
+
+#define THERMAL_STAGE_NUM   2U
+#define THERMAL_DT          0.001f
+
+enum ThermalNode
+{
+    THERMAL_LEG_A,          // A侧半桥
+    THERMAL_LEG_B,          // B侧半桥
+    THERMAL_INDUCTOR,
+    THERMAL_NODE_NUM
+};
+
+struct ThermalData
+{
+    // 62.5kHz累加，1kHz取走
+    float i2Sum = 0.0f;                 // iL^2
+    float iB2Sum = 0.0f;                // iCap^2，电容组电流
+    float swASum = 0.0f;                // A侧开关时的 vA*|iL|
+    float swBSum = 0.0f;                // B侧开关时的 vB*|iL|
+    uint32_t sampleCnt = 0;
+
+    float power[THERMAL_NODE_NUM] = {0.0f};                         // 平均损耗，W
+    float stageRise[THERMAL_NODE_NUM][THERMAL_STAGE_NUM] = {{0.0f}};  // 各级温升，K
+    float temp[THERMAL_NODE_NUM] = {0.0f};                          // 估计温度，℃
+    float maxTemp = THERMAL_AMBIENT_TEMP;
+
+    float iBBurstBudget = 0.0f;         // 高于CAPARR_MAX_CURRENT的I²t预算，A²s，上电时为0
+    float iBLimit = CAPARR_MAX_CURRENT; // 电容组电流限制，有预算且温度低时高于CAPARR_MAX_CURRENT
+};
+
+extern ThermalData thermalData;
+
+namespace Thermal
+{
+
+void init();
+
+// 在62.5kHz中断中调用
+void accumulate();
+
+// 在1kHz任务中调用，更新温度和psData.iLLimit、thermalData.iBLimit
+void update();
+
+} // namespace Thermal
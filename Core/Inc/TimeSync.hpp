@@ -0,0 +1,45 @@
+#pragma once
+
+#include "main.h"
+#include "stdint.h"
+#include "Config.hpp"
+
+// 时间同步：TIM5作为1MHz的32位自由计数器，约71.6分钟溢出一次，时间差按无符号数计算
+// 主控发送0x063请求（记下发送时刻t1），本机在0x050回复收到请求的时刻t2和回复写入TX FIFO的时刻t3，
+// 主控结合收到回复的时刻t4估计两个时钟的偏差和漂移（见sdk），本机不做估计
+// 请求中开启时间戳后，每个0x052之后发送一帧0x050给出反馈数据的采样时刻，主控据此补偿测量延时
+
+#define TIMESYNC_TIMEOUT        1000U   // ms，超过该时间没有收到请求则停止发送时间戳
+#define TIMESYNC_LF_DELAY       158U    // us，MF_TO_LF_ALPHA一阶滤波的群延时 (1-α)/α × 16us
+
+struct TimeSyncCmd;
+
+struct TimeSyncData
+{
+    bool timestampEnabled = false;
+    uint8_t lastSeq = 0;
+    uint32_t lastRequestTick = 0;   // 最近一次请求的vTick
+    uint32_t requestCnt = 0;
+};
+
+extern TimeSyncData timeSyncData;
+
+namespace TimeSync
+{
+
+// 启动TIM5
+void init();
+
+// 本机us计数，任何中断中均可调用
+inline uint32_t micros()
+{
+    return TIM5->CNT;
+}
+
+// 在1kHz任务中处理主控的请求，rxTime为FDCAN中断中记录的接收时刻
+void request(const TimeSyncCmd &cmd, uint32_t rxTime);
+
+// 在1kHz任务中调用，开启时间戳且未超时时返回true
+bool timestampActive();
+
+} // namespace TimeSync
@@ -0,0 +1,195 @@
+#include "BlackBox.hpp"
+#include "PowerManager.hpp"
+#include "Communication.hpp"
+#include "Storage.hpp"
+#include "string.h"
+#include "stddef.h"
+
+BlackBoxData blackBoxData;
+
+// CCM RAM不经过总线矩阵，中断写入不与DMA竞争；NOLOAD，上电不清零
+__attribute__((section(".ccmram"))) static BlackBoxRecord bbRecord;
+
+static_assert((BLACKBOX_SAMPLE_NUM & (BLACKBOX_SAMPLE_NUM - 1)) == 0,
+              "BLACKBOX_SAMPLE_NUM must be a power of 2");
+static_assert(sizeof(BlackBoxRecord) <= STORAGE_BLACKBOX_SIZE,
+              "BlackBoxRecord does not fit in storage");
+
+namespace BlackBox {
+
+static const BlackBoxRecord *flashRecord() {
+    return reinterpret_cast<const BlackBoxRecord *>(STORAGE_BLACKBOX_ADDR);
+}
+
+static uint32_t recordCRC(const BlackBoxRecord *rec) {
+    const uint32_t crcOffset = offsetof(BlackBoxHeader, crc);
+    const uint32_t zero = 0;
+    uint32_t crc = Storage::crc32(rec, crcOffset);
+    crc = Storage::crc32(&zero, sizeof(zero), crc);
+    return Storage::crc32(reinterpret_cast<const uint8_t *>(rec) + crcOffset +
+                              sizeof(zero),
+                          sizeof(BlackBoxRecord) - crcOffset - sizeof(zero),
+                          crc);
+}
+
+static bool checkRecord() {
+    const BlackBoxRecord *rec = flashRecord();
+    return rec->header.magic == BLACKBOX_MAGIC &&
+           rec->header.version == BLACKBOX_VERSION &&
+           rec->header.crc == recordCRC(rec);
+}
+
+void init() { blackBoxData.recordValid = checkRecord(); }
+
+__attribute__((section(".code_in_ram"))) void record() {
+    if (blackBoxData.state == BLACKBOX_FROZEN) return;
+
+    BlackBoxSample &s = bbRecord.samples[blackBoxData.writeIndex];
+    s.vA = (int16_t)(adcData.vA * 100.0f);
+    s.vB = (int16_t)(adcData.vB * 100.0f);
+    s.iA = (int16_t)(adcData.iA * 100.0f);
+    s.iB = (int16_t)(adcData.iB * 100.0f);
+    s.iR = (int16_t)(adcData.iR * 100.0f);
+    s.iLTarget = (int16_t)(psData.iLTarget * 100.0f);
+    s.dcdcMode = psData.dcdcMode;
+    s.flags = psData.outputABEnabled | (ctrlData.limitFactor << 4);
+
+    blackBoxData.writeIndex =
+        (blackBoxData.writeIndex + 1) & (BLACKBOX_SAMPLE_NUM - 1);
+    if (blackBoxData.validNum < BLACKBOX_SAMPLE_NUM) blackBoxData.validNum++;
+
+    if (blackBoxData.state == BLACKBOX_TRIGGERED && --blackBoxData.postCnt == 0)
+        blackBoxData.state = BLACKBOX_FROZEN;
+}
+
+__attribute__((section(".code_in_ram"))) void trigger(uint16_t errorBit) {
+    if (blackBoxData.state != BLACKBOX_RECORDING) return;
+    blackBoxData.triggerCode = errorBit;
+    blackBoxData.triggerTick = sysData.vTick;
+    blackBoxData.postCnt = blackBoxData.postTrigger;
+    blackBoxData.state = BLACKBOX_TRIGGERED;
+}
+
+void command(const BlackBoxCmd &cmd) {
+    switch (cmd.op) {
+    case BLACKBOX_OP_READ:
+        if (blackBoxData.recordValid && !sysData.flashBusy) {
+            blackBoxData.readOffset = cmd.arg;
+            blackBoxData.reading = true;
+        }
+        break;
+    case BLACKBOX_OP_SET_POST_TRIGGER:
+        if (blackBoxData.state == BLACKBOX_RECORDING)
+            blackBoxData.postTrigger =
+                M_CLAMP(cmd.arg, 1U, BLACKBOX_SAMPLE_NUM - 1U);
+        break;
+    case BLACKBOX_OP_TRIGGER:
+        trigger(0);
+        break;
+    case BLACKBOX_OP_ERASE:
+        blackBoxData.reading = false;
+        blackBoxData.eraseRequest = true;
+        break;
+    default:
+        break;
+    }
+    blackBoxData.infoRequest = true;
+}
+
+static bool sendInfo() {
+    TxBlackBoxData td;
+    uint16_t size = sizeof(BlackBoxRecord);
+    td.offset = BLACKBOX_INFO_OFFSET;
+    td.data[0] = blackBoxData.state;
+    td.data[1] = blackBoxData.recordValid;
+    memcpy(&td.data[2], &size, sizeof(size));
+    memcpy(&td.data[4], &blackBoxData.postTrigger, sizeof(uint16_t));
+    return CANcomm::sendBlackBoxData(td);
+}
+
+void update() {
+    if (blackBoxData.infoRequest) {
+        if (!sendInfo()) return;
+        blackBoxData.infoRequest = false;
+    }
+
+    if (!blackBoxData.reading) return;
+
+    const uint8_t *src = reinterpret_cast<const uint8_t *>(flashRecord());
+    for (uint32_t i = 0; i < BLACKBOX_FRAMES_PER_TICK; i++) {
+        if (blackBoxData.readOffset >= sizeof(BlackBoxRecord) ||
+            sysData.flashBusy) {
+            blackBoxData.reading = false;
+            return;
+        }
+
+        TxBlackBoxData td;
+        td.offset = blackBoxData.readOffset;
+        memcpy(td.data, src + td.offset, sizeof(td.data));
+        if (!CANcomm::sendBlackBoxData(td)) return;
+        blackBoxData.readOffset += sizeof(td.data);
+    }
+}
+
+static void reverse(uint32_t begin, uint32_t end) {
+    while (begin + 1 < end) {
+        BlackBoxSample tmp = bbRecord.samples[begin];
+        bbRecord.samples[begin++] = bbRecord.samples[--end];
+        bbRecord.samples[end] = tmp;
+    }
+}
+
+static void prepare() {
+    // 旋转环形缓冲区，使最新的点位于末尾
+    uint32_t split = blackBoxData.writeIndex;
+    reverse(0, split);
+    reverse(split, BLACKBOX_SAMPLE_NUM);
+    reverse(0, BLACKBOX_SAMPLE_NUM);
+
+    BlackBoxHeader &h = bbRecord.header;
+    h.magic = BLACKBOX_MAGIC;
+    h.version = BLACKBOX_VERSION;
+    h.headerSize = sizeof(BlackBoxHeader);
+    h.sampleNum = BLACKBOX_SAMPLE_NUM;
+    h.validNum = blackBoxData.validNum;
+    h.postTrigger = blackBoxData.postTrigger;
+    h.triggerCode = blackBoxData.triggerCode;
+    h.errorCode = errorData.errorCode;
+    h.errorLevel = errorData.errorLevel;
+    h.reserved = 0;
+    h.triggerTick = blackBoxData.triggerTick;
+    h.errorVoltage = errorData.errorVoltage;
+    h.errorCurrent = errorData.errorCurrent;
+    h.crc = 0;
+    h.crc = recordCRC(&bbRecord);
+    blackBoxData.prepared = true;
+}
+
+static void save() {
+    if (!blackBoxData.prepared) prepare();
+
+    // 功率级开启时Storage拒绝擦写，保持冻结，下次主循环重试
+    bool ok = Storage::write(STORAGE_BLACKBOX_ADDR, &bbRecord, sizeof(bbRecord));
+    if (!ok && Storage::busy()) return;
+    blackBoxData.reading = false;
+    blackBoxData.recordValid = checkRecord();
+
+    // 旋转后最旧的点位于开头，从0继续写入即可
+    blackBoxData.prepared = false;
+    blackBoxData.writeIndex = 0;
+    blackBoxData.state = BLACKBOX_RECORDING;
+    blackBoxData.infoRequest = true;
+}
+
+void process() {
+    if (blackBoxData.eraseRequest &&
+        Storage::erase(STORAGE_BLACKBOX_ADDR, STORAGE_BLACKBOX_SIZE)) {
+        blackBoxData.eraseRequest = false;
+        blackBoxData.recordValid = false;
+        blackBoxData.infoRequest = true;
+    }
+
+    if (blackBoxData.state == BLACKBOX_FROZEN) save();
+}
+
+} // namespace BlackBox
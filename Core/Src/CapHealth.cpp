@@ -0,0 +1,275 @@
+#include "CapHealth.hpp"
+#include "PowerManager.hpp"
+#include "Communication.hpp"
+#include "EventLog.hpp"
+#include "Thermal.hpp"
+#include "Storage.hpp"
+#include "string.h"
+
+CapHealthData capHealthData;
+
+#define HEALTH_SLOT_NUM     (STORAGE_HEALTH_SIZE / HEALTH_RECORD_SIZE)
+
+static_assert(sizeof(HealthRecord) == HEALTH_RECORD_SIZE,
+              "HealthRecord size error");
+static_assert(STORAGE_HEALTH_SIZE == STORAGE_ERASE_UNIT,
+              "health log compacts a single erase unit");
+static_assert(HEALTH_KEEP_NUM < HEALTH_SLOT_NUM,
+              "HEALTH_KEEP_NUM must leave free slots after compaction");
+static_assert(THERMAL_NODE_NUM == 3, "HealthRecord.tempPeak size error");
+
+// 压缩存储区时的临时缓冲
+__attribute__((section(".ccmram"))) static HealthRecord compactBuffer[HEALTH_KEEP_NUM];
+
+namespace CapHealth {
+
+static const HealthRecord *slot(uint32_t index) {
+    return Storage::slot<HealthRecord>(STORAGE_HEALTH_ADDR, index);
+}
+
+static uint16_t toU16(float value) {
+    return (uint16_t)M_CLAMP(value + 0.5f, 0.0f, 65535.0f);
+}
+
+// 记录按写入顺序排列，最后一个非空位置之后为写入位置
+static void scan() {
+    capHealthData.headSlot = 0;
+    capHealthData.recordNum = 0;
+    for (uint32_t i = 0; i < HEALTH_SLOT_NUM; i++) {
+        const HealthRecord *rec = slot(i);
+        if (Storage::isBlank(rec)) continue;
+        capHealthData.headSlot = i + 1;
+        if (!Storage::isValid(rec)) continue;
+        capHealthData.recordNum++;
+        if (rec->seq >= capHealthData.nextSeq)
+            capHealthData.nextSeq = rec->seq + 1;
+    }
+}
+
+void init() {
+    scan();
+}
+
+void addCapacitySample(float capacity) {
+    capHealthData.capSum += capacity;
+    capHealthData.capCnt++;
+}
+
+void updateStats() {
+    if (!psData.outputABEnabled) {
+        capHealthData.lastValid = false;
+        return;
+    }
+
+    float iCap = adcData.iCaplf;
+    float vCap = adcData.vCaplf;
+    // vCap已扣除电容组内阻上的压降，还原出滤波后的vB
+    float vB = vCap + iCap * capStatus.dcr;
+
+    if (iCap > 0.0f)
+        capHealthData.chargeIn += iCap * 0.001f;
+    else
+        capHealthData.chargeOut -= iCap * 0.001f;
+
+    if (!capHealthData.vCapValid) {
+        capHealthData.vCapMax = capHealthData.vCapMin = vCap;
+        capHealthData.vCapValid = true;
+    }
+    capHealthData.vCapMax = M_MAX(capHealthData.vCapMax, vCap);
+    capHealthData.vCapMin = M_MIN(capHealthData.vCapMin, vCap);
+
+    // 电流阶跃时vB的突变主要来自ESR，扣除1ms内电容本身的电压变化后做最小二乘
+    if (capHealthData.lastValid) {
+        float dI = iCap - capHealthData.lastICap;
+        if (M_ABS(dI) > HEALTH_ESR_MIN_STEP) {
+            float dV = vB - capHealthData.lastVB -
+                       0.5f * (iCap + capHealthData.lastICap) * 0.001f /
+                           capStatus.capEstData.capacity;
+            capHealthData.esrSxy += dV * dI;
+            capHealthData.esrSxx += dI * dI;
+            capHealthData.esrCnt++;
+        }
+    }
+    capHealthData.lastVB = vB;
+    capHealthData.lastICap = iCap;
+    capHealthData.lastValid = true;
+
+    for (uint32_t n = 0; n < THERMAL_NODE_NUM; n++)
+        capHealthData.tempPeak[n] =
+            M_MAX(capHealthData.tempPeak[n], thermalData.temp[n]);
+
+    capHealthData.dirty = true;
+}
+
+static void buildRecord(HealthRecord &rec) {
+    const CapHealthData &d = capHealthData;
+
+    rec.bootCount = eventLogData.bootCount;
+    rec.capSamples = M_MIN(d.capCnt, 255U);
+    rec.esrSamples = M_MIN(d.esrCnt, 255U);
+    rec.duration = M_MIN(sysData.vTick / 1000U, 0xFFFFU);
+    rec.capacitance = d.capCnt ? toU16(d.capSum / d.capCnt * 100.0f) : 0;
+    rec.esr = (d.esrCnt >= HEALTH_ESR_MIN_SAMPLES && d.esrSxx > 0.0f)
+                  ? toU16(d.esrSxy / d.esrSxx * 10000.0f)
+                  : 0;
+    rec.vCapMax = d.vCapValid ? toU16(d.vCapMax * 100.0f) : 0;
+    rec.vCapMin = d.vCapValid ? toU16(d.vCapMin * 100.0f) : 0;
+    rec.chargeIn = (uint32_t)(d.chargeIn * 10.0f);
+    rec.chargeOut = (uint32_t)(d.chargeOut * 10.0f);
+    for (uint32_t n = 0; n < THERMAL_NODE_NUM; n++)
+        rec.tempPeak[n] = (uint8_t)M_CLAMP(d.tempPeak[n], 0.0f, 255.0f);
+    rec.resv = 0;
+}
+
+// 写满后保留最近HEALTH_KEEP_NUM次上电各自的最后一条记录，擦除后写回
+// 擦除到写回之间断电会丢失全部记录
+static bool compact() {
+    uint32_t n = 0;
+    for (uint32_t i = capHealthData.headSlot; i-- > 0 && n < HEALTH_KEEP_NUM;) {
+        const HealthRecord *rec = slot(i);
+        if (!Storage::isValid(rec)) continue;
+        bool seen = false;
+        for (uint32_t j = 0; j < n; j++)
+            if (compactBuffer[j].bootCount == rec->bootCount) seen = true;
+        if (!seen) compactBuffer[n++] = *rec;
+    }
+
+    // 恢复为写入顺序
+    for (uint32_t i = 0; i < n / 2; i++) {
+        HealthRecord tmp = compactBuffer[i];
+        compactBuffer[i] = compactBuffer[n - 1 - i];
+        compactBuffer[n - 1 - i] = tmp;
+    }
+
+    if (!Storage::erase(STORAGE_HEALTH_ADDR, STORAGE_HEALTH_SIZE)) return false;
+    capHealthData.reading = false;
+    if (n) Storage::program(STORAGE_HEALTH_ADDR, compactBuffer,
+                            n * HEALTH_RECORD_SIZE);
+    scan();
+    return capHealthData.headSlot < HEALTH_SLOT_NUM;
+}
+
+static bool append(HealthRecord &rec) {
+    if (capHealthData.headSlot >= HEALTH_SLOT_NUM && !compact()) return false;
+
+    while (capHealthData.headSlot < HEALTH_SLOT_NUM) {
+        uint32_t index = capHealthData.headSlot++;
+        if (!Storage::isBlank(slot(index))) continue;
+
+        rec.seq = capHealthData.nextSeq;
+        rec.check = Storage::recordCheck(rec);
+        if (!Storage::program(STORAGE_HEALTH_ADDR + index * HEALTH_RECORD_SIZE,
+                              &rec, sizeof(rec))) {
+            capHealthData.headSlot = index;
+            return false;
+        }
+        if (!Storage::isValid(slot(index))) continue;
+
+        capHealthData.nextSeq++;
+        capHealthData.recordNum++;
+        return true;
+    }
+    return false;
+}
+
+static void clear() {
+    if (!Storage::erase(STORAGE_HEALTH_ADDR, STORAGE_HEALTH_SIZE)) return;
+    // 保留序号
+    capHealthData.headSlot = 0;
+    capHealthData.recordNum = 0;
+    capHealthData.clearRequest = false;
+    capHealthData.infoRequest = true;
+}
+
+void process() {
+    if (capHealthData.clearRequest) clear();
+
+    // 同一次上电中按间隔覆盖更新，读取时以seq最大的记录为准
+    if (!capHealthData.dirty ||
+        sysData.vTick - capHealthData.lastSaveTick < HEALTH_SAVE_INTERVAL)
+        return;
+
+    HealthRecord rec;
+    buildRecord(rec);
+    capHealthData.dirty = false;
+    if (!append(rec)) {
+        capHealthData.dirty = true;
+        // 功率级开启时没有写入，功率级关闭后立即重试
+        if (Storage::busy()) return;
+    }
+    capHealthData.lastSaveTick = sysData.vTick;
+}
+
+void command(const HealthCmd &cmd) {
+    switch (cmd.op) {
+    case HEALTH_OP_READ:
+        capHealthData.readSlot = 0;
+        capHealthData.readPart = 0;
+        capHealthData.reading = true;
+        break;
+    case HEALTH_OP_CLEAR:
+        capHealthData.reading = false;
+        capHealthData.clearRequest = true;
+        break;
+    default:
+        break;
+    }
+    capHealthData.infoRequest = true;
+}
+
+// 依次取出Flash中的记录，最后为本次上电的实时统计
+static bool loadNext() {
+    CapHealthData &d = capHealthData;
+    while (d.readSlot < d.headSlot) {
+        const HealthRecord *rec = slot(d.readSlot++);
+        if (Storage::isValid(rec)) {
+            d.readRecord = *rec;
+            return true;
+        }
+    }
+    if (d.readSlot == d.headSlot) {
+        buildRecord(d.readRecord);
+        d.readRecord.seq = d.nextSeq;
+        d.readRecord.check = Storage::recordCheck(d.readRecord);
+        d.readSlot++;
+        return true;
+    }
+    return false;
+}
+
+void update() {
+    if (sysData.flashBusy) return;
+
+    if (capHealthData.infoRequest) {
+        TxHealthData info = {};
+        uint16_t recordNum = capHealthData.recordNum;
+        uint32_t boardId =
+            Storage::crc32(sysData.hardwareUID, sizeof(sysData.hardwareUID));
+        info.part = HEALTH_PART_INFO;
+        memcpy(&info.data[0], &recordNum, sizeof(recordNum));
+        memcpy(&info.data[2], &boardId, sizeof(boardId));
+        if (!CANcomm::sendHealthData(info)) return;
+        capHealthData.infoRequest = false;
+    }
+
+    for (uint32_t sent = 0;
+         capHealthData.reading && sent < HEALTH_FRAMES_PER_TICK; sent++) {
+        if (capHealthData.readPart == 0 && !loadNext()) {
+            capHealthData.reading = false;
+            break;
+        }
+
+        TxHealthData td = {};
+        uint32_t offset = capHealthData.readPart * sizeof(td.data);
+        td.part = capHealthData.readPart;
+        memcpy(td.data,
+               reinterpret_cast<const uint8_t *>(&capHealthData.readRecord) + offset,
+               M_MIN(sizeof(td.data), HEALTH_RECORD_SIZE - offset));
+        if (!CANcomm::sendHealthData(td)) return;
+
+        if (++capHealthData.readPart == HEALTH_PART_NUM)
+            capHealthData.readPart = 0;
+    }
+}
+
+} // namespace CapHealth
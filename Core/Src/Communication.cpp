@@ -1,5 +1,16 @@
 #include "Communication.hpp"
 #include "Interface.hpp"
+#include "LoopAnalyzer.hpp"
+#include "BlackBox.hpp"
+#include "EventLog.hpp"
+#include "CapHealth.hpp"
+#include "Supervisor.hpp"
+#include "LossMap.hpp"
+#include "Telemetry.hpp"
+#include "Param.hpp"
+#include "TimeSync.hpp"
+#include "Parallel.hpp"
+#include "string.h"
 
 
 #ifdef WPT_HARDWARE
@@ -101,6 +112,14 @@ RxData rxData;
 RxData rxData1;
 TxData txData;
 TxDataNew txDataNew;
+TxBurstData txBurstData;
+CANRxQueue canRxQueue;
+CANBusData canBusData;
+FeedbackData feedbackData;
+
+static CANRxFrame rxFrames[CAN_RX_QUEUE_SIZE];
+static_assert((CAN_RX_QUEUE_SIZE & (CAN_RX_QUEUE_SIZE - 1)) == 0 && CAN_RX_QUEUE_SIZE <= 128,
+              "CAN_RX_QUEUE_SIZE must be a power of 2 and fit in uint8_t indices");
 
 namespace CANcomm {
     
@@ -120,110 +139,584 @@ FDCAN_TxHeaderTypeDef getTxHeader(uint16_t id)
     return txHeader;
 }
 
+static FDCAN_TxHeaderTypeDef getFDTxHeader(uint16_t id)
+{
+    FDCAN_TxHeaderTypeDef txHeader = getTxHeader(id);
+    txHeader.DataLength = FDCAN_DLC_BYTES_64;
+    txHeader.BitRateSwitch = FDCAN_BRS_ON;
+    txHeader.FDFormat = FDCAN_FD_CAN;
+    return txHeader;
+}
+
 static FDCAN_TxHeaderTypeDef txHeader = getTxHeader(0x051);
 static FDCAN_TxHeaderTypeDef txHeaderNew = getTxHeader(0x052);
+static FDCAN_TxHeaderTypeDef txHeaderBurst = getTxHeader(0x053);
+static FDCAN_TxHeaderTypeDef txHeaderBode = getTxHeader(CAN_ID_BODE);
+static FDCAN_TxHeaderTypeDef txHeaderBlackBox = getTxHeader(CAN_ID_BLACKBOX);
+static FDCAN_TxHeaderTypeDef txHeaderEventLog = getTxHeader(CAN_ID_EVENTLOG);
+static FDCAN_TxHeaderTypeDef txHeaderHealth = getTxHeader(CAN_ID_HEALTH);
+static FDCAN_TxHeaderTypeDef txHeaderLossMap = getTxHeader(CAN_ID_LOSSMAP);
+static FDCAN_TxHeaderTypeDef txHeaderTelemetry = getFDTxHeader(CAN_ID_TELEMETRY);
+static FDCAN_TxHeaderTypeDef txHeaderParam = getTxHeader(CAN_ID_PARAM);
+static FDCAN_TxHeaderTypeDef txHeaderTime = getTxHeader(CAN_ID_TIME);
+static FDCAN_TxHeaderTypeDef txHeaderDiag = getTxHeader(CAN_ID_DIAG);
+static FDCAN_TxHeaderTypeDef txHeaderPeer = getTxHeader(CAN_ID_PEER + HARDWARE_NODE_ID);
+
+// 按节点号偏移的发送ID，并联广播帧除外
+static FDCAN_TxHeaderTypeDef *const nodeTxHeaders[] = {
+    &txHeader, &txHeaderNew, &txHeaderBurst, &txHeaderBode, &txHeaderBlackBox, &txHeaderEventLog,
+    &txHeaderHealth, &txHeaderLossMap, &txHeaderTelemetry, &txHeaderParam, &txHeaderTime, &txHeaderDiag};
 
 static FDCAN_RxHeaderTypeDef rxHeader = {};
 
+// 反馈帧每个ID一个位置，新值直接覆盖
+static uint8_t feedbackFrames[CAN_FEEDBACK_NUM][8];
+static volatile uint8_t feedbackPending = 0;
+static FDCAN_TxHeaderTypeDef *const feedbackHeader[CAN_FEEDBACK_NUM] = {
+    &txHeader, &txHeaderNew, &txHeaderBurst, &txHeaderTime, &txHeaderTime, &txHeaderPeer};
+
+struct CANTxFrame
+{
+    const FDCAN_TxHeaderTypeDef *header;
+    uint8_t data[8];
+};
+
+static CANTxFrame txQueue[CAN_TX_QUEUE_SIZE];
+static volatile uint8_t txHead = 0;
+static volatile uint8_t txTail = 0;
+static_assert((CAN_TX_QUEUE_SIZE & (CAN_TX_QUEUE_SIZE - 1)) == 0 && CAN_TX_QUEUE_SIZE <= 128,
+              "CAN_TX_QUEUE_SIZE must be a power of 2 and fit in uint8_t indices");
+
+static uint32_t burstTick = 0;
+
+static TelemetryFrame telemetryPendingFrame;
+static volatile bool telemetryPending = false;
+
+// 屏蔽优先级1及以下的中断（FDCAN、TIM6），62.5kHz中断不受影响
+static inline uint32_t lockTx()
+{
+    uint32_t basepri = __get_BASEPRI();
+    __set_BASEPRI_MAX(1U << (8U - __NVIC_PRIO_BITS));
+    return basepri;
+}
+
+static inline void unlockTx(uint32_t basepri)
+{
+    __set_BASEPRI(basepri);
+}
+
 void init() 
 {
     static_assert(sizeof(RxData) == 8, "RxData size error");
     static_assert(sizeof(TxData) == 8, "TxData size error");
-
+    static_assert(sizeof(TxDataNew) == 8, "TxDataNew size error");
+    static_assert(sizeof(TxBurstData) == 8, "TxBurstData size error");
+    static_assert(sizeof(BodeCmd) == 8, "BodeCmd size error");
+    static_assert(sizeof(TxBodeData) == 8, "TxBodeData size error");
+    static_assert(sizeof(BlackBoxCmd) == 8, "BlackBoxCmd size error");
+    static_assert(sizeof(TxBlackBoxData) == 8, "TxBlackBoxData size error");
+    static_assert(sizeof(EventLogCmd) == 8, "EventLogCmd size error");
+    static_assert(sizeof(TxEventLogInfo) == 8, "TxEventLogInfo size error");
+    static_assert(sizeof(HealthCmd) == 8, "HealthCmd size error");
+    static_assert(sizeof(TxHealthData) == 8, "TxHealthData size error");
+    static_assert(HEALTH_PART_NUM * sizeof(TxHealthData::data) >= HEALTH_RECORD_SIZE,
+                  "HEALTH_PART_NUM too small");
+    static_assert(sizeof(LossMapCmd) == 8, "LossMapCmd size error");
+    static_assert(sizeof(TxLossMapInfo) == 8, "TxLossMapInfo size error");
+    static_assert(sizeof(TxLossMapData) == 8, "TxLossMapData size error");
+    static_assert(sizeof(TelemetryCmd) == 8, "TelemetryCmd size error");
+    static_assert(sizeof(ParamCmd) == 8, "ParamCmd size error");
+    static_assert(sizeof(TxParamData) == 8, "TxParamData size error");
+    static_assert(sizeof(TimeSyncCmd) == 8, "TimeSyncCmd size error");
+    static_assert(sizeof(TxTimeData) == 8, "TxTimeData size error");
+    static_assert(sizeof(TxPeerData) == 8, "TxPeerData size error");
+    static_assert(sizeof(TxDiagError) == 8, "TxDiagError size error");
+    static_assert(sizeof(TxDiagLoop) == 8, "TxDiagLoop size error");
+    static_assert(sizeof(TxDiagBus) == 8, "TxDiagBus size error");
+    static_assert(sizeof(TxDiagTx) == 8, "TxDiagTx size error");
+    static_assert(HARDWARE_NODE_ID < HARDWARE_PARALLEL_NUM && HARDWARE_PARALLEL_NUM <= PARALLEL_MAX_NODES,
+                  "HARDWARE_NODE_ID or HARDWARE_PARALLEL_NUM error");
+    static_assert(HARDWARE_NODE_ID * PARALLEL_CAN_ID_STRIDE + CAN_ID_COMMAND <= 0x7FF, "CAN ID out of range");
+
+    for (FDCAN_TxHeaderTypeDef *header : nodeTxHeaders)
+        header->Identifier += parallelData.canIdOffset;
+
+    // 0: 主控指令，所有节点共用; 1: 本节点的上位机服务和时间同步; 2: 其他节点的并联广播
     FDCAN_FilterTypeDef filter;
     filter.IdType = FDCAN_STANDARD_ID;
     filter.FilterIndex = 0;
     filter.FilterType = FDCAN_FILTER_DUAL;
     filter.FilterConfig = FDCAN_FILTER_TO_RXFIFO0;
-    filter.FilterID1 = 0x061 << 5;
-    filter.FilterID2 = 0x061 << 5;
+    filter.FilterID1 = CAN_ID_COMMAND;
+    filter.FilterID2 = CAN_ID_COMMAND;
+    HAL_FDCAN_ConfigFilter(&hfdcan3, &filter);
+
+    filter.FilterIndex = 1;
+    filter.FilterType = FDCAN_FILTER_RANGE;
+    filter.FilterID1 = CAN_ID_SERVICE + parallelData.canIdOffset;
+    filter.FilterID2 = CAN_ID_TIMESYNC_REQ + parallelData.canIdOffset;
+    HAL_FDCAN_ConfigFilter(&hfdcan3, &filter);
+
+    if (parallelData.nodeNum > 1)
+    {
+        filter.FilterIndex = 2;
+        filter.FilterID1 = CAN_ID_PEER;
+        filter.FilterID2 = CAN_ID_PEER + parallelData.nodeNum - 1U;
+        HAL_FDCAN_ConfigFilter(&hfdcan3, &filter);
+    }
 
     rxData.enableDCDC = 1;
     rxData.systemRestart = 0;
     rxData.clearError = 0;
     rxData.enableActiveChargingLimit = 0;
 
-    HAL_FDCAN_ConfigFilter(&hfdcan3, &filter);
+    // 总线上其他节点的帧不进入RX FIFO，避免每一帧都进入中断
+    HAL_FDCAN_ConfigGlobalFilter(&hfdcan3, FDCAN_REJECT, FDCAN_REJECT,
+                                 FDCAN_REJECT_REMOTE, FDCAN_REJECT_REMOTE);
     HAL_FDCAN_ActivateNotification(&hfdcan3, FDCAN_IT_RX_FIFO0_NEW_MESSAGE, 0);
+    HAL_FDCAN_ActivateNotification(&hfdcan3, FDCAN_IT_TX_COMPLETE,
+                                   FDCAN_TX_BUFFER0 | FDCAN_TX_BUFFER1 | FDCAN_TX_BUFFER2);
     HAL_FDCAN_Start(&hfdcan3);
 }
 
-static void generateTxData(TxData &td) 
+static uint8_t getStatusCode()
 {
-    td = {};
     //PowerManager::status.errorCode | ((uint8_t) !PowerManager::status.outputEnabled) << 7;
-    td.statusCode = 0x00;
-    td.statusCode = (psData.outputABEnabled << 7) | (ctrlData.refLoop.useNewFeedbackMessage << 6) |
-                    (ctrlData.wptStatus << 4) |
-                    (((ctrlData.limitFactor >= 4) ? 0b11 : (ctrlData.limitFactor & 0x03)) << 2 ) |
-                    (errorData.errorLevel & 0x03);
-    td.capEnergy = (adcData.vCaplf*adcData.vCaplf * (1/(CAPARR_MAX_VOLTAGE*CAPARR_MAX_VOLTAGE))) * 250U;
+    return (psData.outputABEnabled << 7) | (ctrlData.refLoop.useNewFeedbackMessage << 6) |
+           (ctrlData.wptStatus << 4) |
+           (((ctrlData.limitFactor >= 4) ? 0b11 : (ctrlData.limitFactor & 0x03)) << 2 ) |
+           (errorData.errorLevel & 0x03);
+}
 
+static uint8_t getCapEnergy()
+{
+    // 能量回收时可以超过250，高于约29.1V时超出uint8_t，需要饱和
+    return (uint8_t)M_MIN((adcData.vCaplf*adcData.vCaplf * (1/(CAPARR_MAX_VOLTAGE*CAPARR_MAX_VOLTAGE))) * 250U, 255.0f);
+}
+
+static float getChassisPower()
+{
     #ifdef WPT_HARDWARE
         if(psData.outputEEnabled)    
-            td.chassisPower = adcData.pChassislf - adcData.pWPTlf;
-        else
-            td.chassisPower = adcData.pChassislf;
-    #else
-        td.chassisPower = adcData.pChassislf;
+            return adcData.pChassislf - adcData.pWPTlf;
     #endif    
-    
-    td.chassisPowerLimit = CAPARR::getMaxPowerFeedback() + rxData1.refereePowerLimit; //TODO
+    return adcData.pChassislf;
+}
+
+// 底盘功率限制包括裁判系统功率限制，主控发来的值没有范围限制，求和时饱和而不是回绕
+static uint16_t getChassisPowerLimit()
+{
+    return (uint16_t)M_MIN((uint32_t)CAPARR::getMaxPowerFeedback() + rxData1.refereePowerLimit, 0xFFFFU);
+}
+
+// 功率*64+16384，超出-256W~+768W时饱和；浮点数转换为uint16_t时超出范围是未定义行为，在M4上会回绕到相反的一端
+static uint16_t encodePower(float power)
+{
+    return (uint16_t)M_CLAMP(power * 64.0f + 16384.0f, 0.0f, 65535.0f);
+}
+
+static void generateTxData(TxData &td) 
+{
+    td = {};
+    td.statusCode = getStatusCode();
+    td.capEnergy = getCapEnergy();
+    td.chassisPower = getChassisPower();
+    td.chassisPowerLimit = getChassisPowerLimit();
 }
 
 static void generateTxDataNew(TxDataNew &td) 
 {
     td = {};
-    td.statusCode = 0x00;
-    td.statusCode = (psData.outputABEnabled << 7) | (ctrlData.refLoop.useNewFeedbackMessage << 6) |
-                    (ctrlData.wptStatus << 4) |
-                    (((ctrlData.limitFactor >= 4) ? 0b11 : (ctrlData.limitFactor & 0x03)) << 2 ) |
-                    (errorData.errorLevel & 0x03);
-    td.capEnergy = (adcData.vCaplf*adcData.vCaplf * (1/(CAPARR_MAX_VOLTAGE*CAPARR_MAX_VOLTAGE))) * 250U;
+    td.statusCode = getStatusCode();
+    td.capEnergy = getCapEnergy();
+    td.chassisPower = encodePower(getChassisPower());
+    td.refereePower = encodePower(adcData.pRefereelf);
+    td.chassisPowerLimit = getChassisPowerLimit();
+}
 
-    #ifdef WPT_HARDWARE
-        if(psData.outputEEnabled)    
-            td.chassisPower = (adcData.pChassislf - adcData.pWPTlf) * 64U + 16384U;
-        else
-            td.chassisPower = adcData.pChassislf * 64U + 16384U;
-    #else
-        td.chassisPower = adcData.pChassislf * 64U + 16384U;
-    #endif  
-    
-    td.refereePower = adcData.pRefereelf * 64U + 16384U;    
-    td.chassisPowerLimit = CAPARR::getMaxPowerFeedback() + rxData1.refereePowerLimit; 
+static void generateTxBurstData(TxBurstData &td)
+{
+    td.queryPower = capStatus.burstData.queryPower;
+    td.queryDuration = capStatus.burstData.queryDuration;
+    td.maxPowerDuration = capStatus.burstData.maxPowerDuration;
+    td.usableEnergy = (uint16_t)capStatus.burstData.usableEnergy;
 }
 
 
-void sendSCData() 
+// 在FDCAN中断中调用时不需要加锁，在其他位置调用前需先lockTx()
+static void fillTxFifo()
 {
-    if (hfdcan3.Instance->PSR & FDCAN_PSR_BO_Msk)
+    if (canBusData.state >= CAN_BUS_OFF)
+        return;
+
+    uint32_t freeLevel;
+    while ((freeLevel = HAL_FDCAN_GetTxFifoFreeLevel(&hfdcan3)) > 0U)
+    {
+        uint8_t pending = feedbackPending;
+        if (pending)
+        {
+            uint32_t slot = __builtin_ctz(pending);
+            if (slot == CAN_FEEDBACK_TIMESYNC)
+            {
+                TxTimeData *td = reinterpret_cast<TxTimeData *>(feedbackFrames[slot]);
+                td->delay = (uint16_t)M_MIN(TimeSync::micros() - td->time, 0xFFFFU);
+            }
+            HAL_FDCAN_AddMessageToTxFifoQ(&hfdcan3, feedbackHeader[slot], feedbackFrames[slot]);
+            feedbackPending = pending & ~(1U << slot);
+            canBusData.txCnt[CAN_TX_FEEDBACK]++;
+            continue;
+        }
+
+        // TX FIFO按顺序发送，低优先级的帧至少保留一个位置给下一个反馈帧
+        if (freeLevel < 2U)
+            break;
+
+        uint8_t tail = txTail;
+        if (tail != txHead)
+        {
+            CANTxFrame &frame = txQueue[tail];
+            HAL_FDCAN_AddMessageToTxFifoQ(&hfdcan3, frame.header, frame.data);
+            txTail = (tail + 1U) & (CAN_TX_QUEUE_SIZE - 1U);
+            canBusData.txCnt[CAN_TX_DIAG]++;
+            continue;
+        }
+
+        if (telemetryPending && canBusData.state < CAN_BUS_PASSIVE)
+        {
+            HAL_FDCAN_AddMessageToTxFifoQ(&hfdcan3, &txHeaderTelemetry,
+                                          reinterpret_cast<uint8_t *>(&telemetryPendingFrame));
+            telemetryPending = false;
+            canBusData.txCnt[CAN_TX_TELEMETRY]++;
+            continue;
+        }
+        break;
+    }
+}
+
+void pumpTx()
+{
+    uint32_t basepri = lockTx();
+    fillTxFifo();
+    unlockTx(basepri);
+}
+
+// 需在lockTx()之后调用，同一周期的几帧一起放入后再补充TX FIFO，保证0x050紧跟对应的0x052
+static void setFeedback(CANFeedbackSlot slot, const void *data)
+{
+    if (feedbackPending & (1U << slot))
+        canBusData.coalesced++;
+    memcpy(feedbackFrames[slot], data, 8);
+    feedbackPending |= (1U << slot);
+}
+
+// 多帧需连续发送时一次放入队列，剩余空间不足时全部拒绝
+static bool enqueue(const FDCAN_TxHeaderTypeDef *header, const void *data, uint32_t frameNum)
+{
+    uint32_t basepri = lockTx();
+    uint8_t head = txHead;
+    uint8_t used = (head - txTail) & (CAN_TX_QUEUE_SIZE - 1U);
+    if (used + frameNum > CAN_TX_QUEUE_SIZE - 1U)
     {
-        hfdcan3.Instance->CCCR &= ~FDCAN_CCCR_INIT;
+        canBusData.rejected++;
+        unlockTx(basepri);
+        return false;
     }
 
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    for (uint32_t i = 0; i < frameNum; i++)
+    {
+        txQueue[head].header = header;
+        memcpy(txQueue[head].data, p + i * 8U, 8);
+        head = (head + 1U) & (CAN_TX_QUEUE_SIZE - 1U);
+    }
+    txHead = head;
+    used += frameNum;
+    if (used > canBusData.queueHighWater)
+        canBusData.queueHighWater = used;
+
+    fillTxFifo();
+    unlockTx(basepri);
+    return true;
+}
+
+void updateBus()
+{
+    uint32_t psr = hfdcan3.Instance->PSR;
+    uint32_t ecr = hfdcan3.Instance->ECR;
+    canBusData.tec = (ecr & FDCAN_ECR_TEC_Msk) >> FDCAN_ECR_TEC_Pos;
+    canBusData.rec = (ecr & FDCAN_ECR_REC_Msk) >> FDCAN_ECR_REC_Pos;
+
+    uint8_t state = canBusData.state;
+    uint32_t elapsed = sysData.vTick - canBusData.stateTick;
+
+    if (psr & FDCAN_PSR_BO_Msk)
+    {
+        if (state < CAN_BUS_OFF)
+        {
+            // 总线持续异常时（如线缆断开）逐次加长等待时间，避免反复恢复占用总线
+            canBusData.busOffCnt++;
+            canBusData.state = CAN_BUS_OFF;
+            canBusData.stateTick = sysData.vTick;
+            EventLog::log(EVENT_CAN_BUS_OFF, canBusData.busOffCnt);
+        }
+        else if (state == CAN_BUS_OFF && elapsed >= (CAN_BUSOFF_MIN_DELAY << canBusData.backoffShift))
+        {
+            if (canBusData.backoffShift < CAN_BUSOFF_MAX_SHIFT)
+                canBusData.backoffShift++;
+            hfdcan3.Instance->CCCR &= ~FDCAN_CCCR_INIT;
+            canBusData.state = CAN_BUS_RECOVERING;
+            canBusData.stateTick = sysData.vTick;
+        }
+        return;
+    }
+
+    uint8_t newState = (psr & FDCAN_PSR_EP_Msk) ? CAN_BUS_PASSIVE
+                     : (psr & FDCAN_PSR_EW_Msk) ? CAN_BUS_WARNING
+                     : CAN_BUS_ACTIVE;
+    if (state >= CAN_BUS_OFF)
+        canBusData.recoverCnt++;
+    else if (newState == CAN_BUS_PASSIVE && state != CAN_BUS_PASSIVE)
+        canBusData.errorPassiveCnt++;
+
+    if (newState != state)
+    {
+        canBusData.state = newState;
+        canBusData.stateTick = sysData.vTick;
+        elapsed = 0;
+    }
+    if (newState == CAN_BUS_ACTIVE && elapsed >= CAN_BUSOFF_STABLE_TIME)
+        canBusData.backoffShift = 0;
+
+    // 恢复后TX FIFO为空，不会再有发送完成中断
+    pumpTx();
+}
+
+void sendSCData(FeedbackReason reason) 
+{
     if(!ctrlData.refLoop.useNewFeedbackMessage)
     {
         generateTxData(txData);
-        HAL_FDCAN_AddMessageToTxFifoQ(
-            &hfdcan3,
-            &txHeader,
-            reinterpret_cast<uint8_t *>(&txData)
-        );
+        uint32_t basepri = lockTx();
+        setFeedback(CAN_FEEDBACK_OLD, &txData);
+        fillTxFifo();
+        unlockTx(basepri);
     }
     else
     {
         generateTxDataNew(txDataNew);
-        HAL_FDCAN_AddMessageToTxFifoQ(
-            &hfdcan3,
-            &txHeaderNew,
-            reinterpret_cast<uint8_t *>(&txDataNew)
-        );
+
+        // 反馈数据为一阶滤波后的值，采样时刻取读取时刻减去滤波器的群延时
+        TxTimeData td = {};
+        bool timestamp = TimeSync::timestampActive();
+        if (timestamp)
+        {
+            td.type = TIME_DATA_FEEDBACK;
+            td.seq = (uint8_t)sysData.vTick;
+            td.time = TimeSync::micros() - TIMESYNC_LF_DELAY;
+        }
+
+        uint32_t basepri = lockTx();
+        setFeedback(CAN_FEEDBACK_NEW, &txDataNew);
+        if (timestamp)
+            setFeedback(CAN_FEEDBACK_TIME, &td);
+        fillTxFifo();
+        unlockTx(basepri);
     }
+    feedbackData.sentCnt[reason]++;
     ctrlData.lastTxTimestamp = sysData.vTick;
     Interface::flashLED(2, COLOR_WHITE, 2);
 }
 
+void updateFeedback()
+{
+    uint8_t status = getStatusCode();
+    uint16_t errorCode = errorData.errorCode;
+    float power = getChassisPower();
+    uint8_t energy = getCapEnergy();
+    uint32_t now = TimeSync::micros();
+
+    // 状态和错误变化立即发送；limitFactor、功率和能量变化受最小间隔限制，避免跳变和噪声使发送频率超过1kHz
+    bool intervalOk = (now - feedbackData.lastTime >= FEEDBACK_MIN_INTERVAL);
+    uint8_t statusChange = status ^ feedbackData.lastStatus;
+    uint8_t energyChange = (energy > feedbackData.lastEnergy) ? energy - feedbackData.lastEnergy
+                                                              : feedbackData.lastEnergy - energy;
+    FeedbackReason reason;
+    if (statusChange & ~FEEDBACK_LIMIT_MASK)
+        reason = FEEDBACK_STATUS;
+    else if (errorCode != feedbackData.lastErrorCode)
+        reason = FEEDBACK_ERROR;
+    else if (sysData.vTick - ctrlData.lastTxTimestamp >= feedbackData.period)
+        reason = FEEDBACK_PERIODIC;
+    else if (intervalOk && statusChange)
+        reason = FEEDBACK_LIMIT;
+    else if (intervalOk && feedbackData.powerDelta > 0.0f &&
+             fabsf(power - feedbackData.lastPower) >= feedbackData.powerDelta)
+        reason = FEEDBACK_POWER;
+    else if (intervalOk && feedbackData.energyDelta &&
+             energyChange >= feedbackData.energyDelta)
+        reason = FEEDBACK_ENERGY;
+    else
+        reason = FEEDBACK_REASON_NUM;
+
+    if (reason != FEEDBACK_REASON_NUM)
+    {
+        sendSCData(reason);
+        feedbackData.lastStatus = status;
+        feedbackData.lastErrorCode = errorCode;
+        feedbackData.lastPower = power;
+        feedbackData.lastEnergy = energy;
+        feedbackData.lastTime = now;
+    }
+
+    if (ctrlData.refLoop.useNewFeedbackMessage && sysData.vTick % BURST_PREDICT_PERIOD == 0 &&
+        sysData.vTick != burstTick)
+    {
+        burstTick = sysData.vTick;
+        generateTxBurstData(txBurstData);
+        uint32_t basepri = lockTx();
+        setFeedback(CAN_FEEDBACK_BURST, &txBurstData);
+        fillTxFifo();
+        unlockTx(basepri);
+    }
+}
+
+void updateDiag()
+{
+    if (!feedbackData.diagPeriod ||
+        sysData.vTick - feedbackData.lastDiagTick < M_MAX(feedbackData.diagPeriod, DIAG_MIN_PERIOD))
+        return;
+
+    uint8_t diag[4][8];
+    TxDiagError &de = *reinterpret_cast<TxDiagError *>(diag[0]);
+    TxDiagLoop &dl = *reinterpret_cast<TxDiagLoop *>(diag[1]);
+    TxDiagBus &db = *reinterpret_cast<TxDiagBus *>(diag[2]);
+    TxDiagTx &dt = *reinterpret_cast<TxDiagTx *>(diag[3]);
+
+    de = {};
+    de.page = DIAG_PAGE_ERROR;
+    de.limitFactor = ctrlData.limitFactor;
+    de.errorLevel = errorData.errorLevel;
+    de.errorCode = errorData.errorCode;
+    de.errorVoltage = (int16_t)M_CLAMP(errorData.errorVoltage * 100.0f, -32768.0f, 32767.0f);
+    de.errorCurrent = (int16_t)M_CLAMP(errorData.errorCurrent * 100.0f, -32768.0f, 32767.0f);
+    de.dcdcMode = psData.dcdcMode;
+
+    dl = {};
+    dl.page = DIAG_PAGE_LOOP;
+    dl.limitFactor = de.limitFactor;
+    dl.errorLevel = de.errorLevel;
+    dl.irqLoad = (uint8_t)M_MIN(psData.IRQloadMax * 200.0f, 255.0f);
+    dl.iLTarget = (int16_t)M_CLAMP(psData.iLTarget * 100.0f, -32768.0f, 32767.0f);
+    dl.capacitance = (uint16_t)M_CLAMP(capStatus.capEstData.capacity * 1000.0f, 0.0f, 65535.0f);
+    dl.rxTimeoutCnt = ctrlData.refLoop.timeoutCnt;
+
+    db = {};
+    db.page = DIAG_PAGE_BUS;
+    db.limitFactor = de.limitFactor;
+    db.errorLevel = de.errorLevel;
+    db.tec = canBusData.tec;
+    db.rec = canBusData.rec;
+    db.busOffCnt = (uint8_t)canBusData.busOffCnt;
+    db.errorPassiveCnt = (uint8_t)canBusData.errorPassiveCnt;
+    db.recoverCnt = (uint8_t)canBusData.recoverCnt;
+    db.coalesced = (uint16_t)canBusData.coalesced;
+
+    // 发送计数在入队前读取，不包括这四帧
+    dt = {};
+    dt.page = DIAG_PAGE_TX;
+    dt.limitFactor = de.limitFactor;
+    dt.errorLevel = de.errorLevel;
+    dt.txFeedback = (uint16_t)canBusData.txCnt[CAN_TX_FEEDBACK];
+    dt.txReply = (uint16_t)canBusData.txCnt[CAN_TX_DIAG];
+    dt.txTelemetry = (uint16_t)canBusData.txCnt[CAN_TX_TELEMETRY];
+    dt.rejected = (uint8_t)canBusData.rejected;
+
+    if (enqueue(&txHeaderDiag, diag, 4))
+    {
+        psData.IRQloadMax = 0.0f;
+        feedbackData.lastDiagTick = sysData.vTick;
+    }
+}
+
+// 在FDCAN中断中调用，只做过滤和复制；远程帧已由全局过滤器拒绝，这里再检查一次
+void pushRx(const FDCAN_RxHeaderTypeDef &header, const uint8_t *data, uint32_t time)
+{
+    if (header.IdType != FDCAN_STANDARD_ID || header.RxFrameType != FDCAN_DATA_FRAME ||
+        header.DataLength != FDCAN_DLC_BYTES_8)
+        return;
+
+    uint8_t head = canRxQueue.head;
+    uint8_t next = (head + 1U) & (CAN_RX_QUEUE_SIZE - 1U);
+    if (next == canRxQueue.tail)
+    {
+        canRxQueue.overflow++;
+        return;
+    }
+
+    CANRxFrame &frame = rxFrames[head];
+    frame.tick = sysData.vTick;
+    frame.time = time;
+    frame.id = header.Identifier;
+    memcpy(frame.data, data, sizeof(frame.data));
+    __DMB();
+    canRxQueue.head = next;
+
+    uint8_t used = (next - canRxQueue.tail) & (CAN_RX_QUEUE_SIZE - 1U);
+    if (used > canRxQueue.highWater)
+        canRxQueue.highWater = used;
+}
+
+void processRx()
+{
+    while (canRxQueue.tail != canRxQueue.head)
+    {
+        uint8_t tail = canRxQueue.tail;
+        const CANRxFrame &frame = rxFrames[tail];
+
+        if (frame.id == CAN_ID_COMMAND)
+        {
+            memcpy(&rxData, frame.data, sizeof(rxData));
+            ctrlData.refLoop.isConnected = 1;
+#ifdef WITHOUT_UPPER
+            // errorCode也在62.5kHz中断中修改
+            uint32_t primask = __get_PRIMASK();
+            __disable_irq();
+            errorData.errorCode &= ~WARNING_COM_TIMEOUT;
+            __set_PRIMASK(primask);
+#endif
+            rxDataHandler(rxData);
+            PowerControl::updateRefereePower(rxData1, frame.tick);
+            Supervisor::heartbeat(SUPERVISOR_TASK_CAN_RX);
+        }
+        else if (frame.id == CAN_ID_SERVICE + parallelData.canIdOffset)
+        {
+            serviceHandler(frame.data);
+        }
+        else if (frame.id == CAN_ID_TIMESYNC_REQ + parallelData.canIdOffset)
+        {
+            TimeSync::request(*reinterpret_cast<const TimeSyncCmd *>(frame.data), frame.time);
+        }
+        else if (frame.id >= CAN_ID_PEER && frame.id < CAN_ID_PEER + PARALLEL_MAX_NODES)
+        {
+            Parallel::receive(frame.id - CAN_ID_PEER, *reinterpret_cast<const TxPeerData *>(frame.data),
+                              frame.tick);
+        }
+
+        __DMB();
+        canRxQueue.tail = (tail + 1U) & (CAN_RX_QUEUE_SIZE - 1U);
+    }
+
+    uint16_t overflow = canRxQueue.overflow;
+    if (overflow != canRxQueue.overflowLogged)
+    {
+        EventLog::log(EVENT_CAN_RX_OVERFLOW, overflow - canRxQueue.overflowLogged);
+        canRxQueue.overflowLogged = overflow;
+    }
+}
+
+// 只在systemRestart从0变为1时重启：主控持续发送该位时只重启一次，上电后需先收到一帧该位为0的指令
+static bool restartArmed = false;
+
 void rxDataHandler(const RxData &rd)
 {
     rxData1 = rd;
@@ -235,13 +728,15 @@ void rxDataHandler(const RxData &rd)
     {
         HRTIM::disableOutputAB();
     }
-    if(rd.systemRestart)
+    if(rd.systemRestart && restartArmed)
     {
         HRTIM::disableOutputAB();
+        EventLog::log(EVENT_RESET_REQUEST, RESET_SOURCE_CAN);
         __disable_irq();
         while (true)
             NVIC_SystemReset();
     }
+    restartArmed = !rd.systemRestart;
     if(rd.clearError)
     {
         Protection::autoClearError();
@@ -250,43 +745,141 @@ void rxDataHandler(const RxData &rd)
     if(rd.enableActiveChargingLimit)
     {
         ctrlData.vCapArrNormal = 
-            M_CLAMP(sqrtf((rd.activeChargingLimitRatio/255.0f)) * CAPARR_MAX_VOLTAGE, CAPARR_LOW_VOLTAGE, CAPARR_MAX_VOLTAGE);    
+            M_CLAMP(sqrtf((rd.activeChargingLimitRatio/255.0f)) * CAPARR_MAX_VOLTAGE, capStatus.lowVoltage, CAPARR_MAX_VOLTAGE);    
     }
     else
     {
         ctrlData.vCapArrNormal = CAPARR_MAX_VOLTAGE;
     }
 }
+
+void serviceHandler(const uint8_t *data)
+{
+    switch (data[0])
+    {
+    case SERVICE_BODE:
+        LoopAnalyzer::start(*reinterpret_cast<const BodeCmd *>(data));
+        break;
+    case SERVICE_BLACKBOX:
+        BlackBox::command(*reinterpret_cast<const BlackBoxCmd *>(data));
+        break;
+    case SERVICE_EVENTLOG:
+        EventLog::command(*reinterpret_cast<const EventLogCmd *>(data));
+        break;
+    case SERVICE_HEALTH:
+        CapHealth::command(*reinterpret_cast<const HealthCmd *>(data));
+        break;
+    case SERVICE_LOSSMAP:
+        LossMap::command(*reinterpret_cast<const LossMapCmd *>(data));
+        break;
+    case SERVICE_TELEMETRY:
+        Telemetry::command(*reinterpret_cast<const TelemetryCmd *>(data));
+        break;
+    case SERVICE_PARAM:
+        Param::command(*reinterpret_cast<const ParamCmd *>(data));
+        break;
+    default:
+        break;
+    }
+}
+
+bool sendBodeData(const TxBodeData &td)
+{
+    return enqueue(&txHeaderBode, &td, 1);
+}
+
+bool sendBlackBoxData(const TxBlackBoxData &td)
+{
+    return enqueue(&txHeaderBlackBox, &td, 1);
+}
+
+bool sendEventLogInfo(const TxEventLogInfo &td)
+{
+    return enqueue(&txHeaderEventLog, &td, 1);
+}
+
+bool sendEventLogRecord(const EventRecord &rec)
+{
+    return enqueue(&txHeaderEventLog, &rec, 2);
+}
+
+bool sendHealthData(const TxHealthData &td)
+{
+    return enqueue(&txHeaderHealth, &td, 1);
+}
+
+bool sendLossMapInfo(const TxLossMapInfo &td)
+{
+    return enqueue(&txHeaderLossMap, &td, 1);
+}
+
+bool sendLossMapData(const TxLossMapData &td)
+{
+    return enqueue(&txHeaderLossMap, &td, 1);
+}
+
+bool sendTelemetry(const TelemetryFrame &frame)
+{
+    if (telemetryPending)
+    {
+        canBusData.rejected++;
+        return false;
+    }
+    // telemetryPending为false时FDCAN中断不会读取这一帧
+    memcpy(&telemetryPendingFrame, &frame, sizeof(TelemetryFrame));
+    uint32_t basepri = lockTx();
+    telemetryPending = true;
+    fillTxFifo();
+    unlockTx(basepri);
+    return true;
+}
+
+bool sendParamData(const TxParamData &td)
+{
+    return enqueue(&txHeaderParam, &td, 1);
+}
+
+void sendTimeSync(const TxTimeData &td)
+{
+    uint32_t basepri = lockTx();
+    setFeedback(CAN_FEEDBACK_TIMESYNC, &td);
+    fillTxFifo();
+    unlockTx(basepri);
+}
+
+void sendPeerData(const TxPeerData &td)
+{
+    uint32_t basepri = lockTx();
+    setFeedback(CAN_FEEDBACK_PEER, &td);
+    fillTxFifo();
+    unlockTx(basepri);
+}
 }
 
 extern "C" 
 {
     void FDCAN3_IT0_IRQHandler(void) 
     {
+        // 尽早记录接收时刻，作为时间同步的t2
+        uint32_t time = TimeSync::micros();
         HAL_FDCAN_IRQHandler(&hfdcan3);
         
         if ((hfdcan3.Instance->RXF0S & FDCAN_RXF0S_F0FL) == 0U)
             return;
         
-        while (HAL_FDCAN_GetRxMessage(&hfdcan3, FDCAN_RX_FIFO0, &CANcomm::rxHeader, (uint8_t *) &rxData) == HAL_OK) 
+        // FD帧最长64字节，先读到局部缓冲区
+        uint8_t data[64];
+        while (HAL_FDCAN_GetRxMessage(&hfdcan3, FDCAN_RX_FIFO0, &CANcomm::rxHeader, data) == HAL_OK) 
         {
-            if ((CANcomm::rxHeader.Identifier == 0x061) && (CANcomm::rxHeader.DataLength == 0x8) && (CANcomm::rxHeader.IdType == FDCAN_STANDARD_ID)) //
-            {
-                ctrlData.refLoop.isConnected = 1;
-#ifdef WITHOUT_UPPER
-                errorData.errorCode &= ~WARNING_COM_TIMEOUT;
-#endif
-                CANcomm::rxDataHandler(rxData);
-                PowerControl::updateRefereePower(rxData1, sysData.vTick);
-            }
+            CANcomm::pushRx(CANcomm::rxHeader, data, time);
         }
     }
-    // void CANManager::errorStatusCallback(CAN_HANDLE_T hfdcan, uint32_t errorStatusITs)
-    // {
-    //     if (hfdcan->Instance->PSR & FDCAN_PSR_BO_Msk)
-    //     {
-    //         pManager->busOffCount++;
-    //         hfdcan->Instance->CCCR &= ~FDCAN_CCCR_INIT;
-    //     }
-    // }
+
+    void HAL_FDCAN_TxBufferCompleteCallback(FDCAN_HandleTypeDef *hfdcan, uint32_t BufferIndexes)
+    {
+        (void)BufferIndexes;
+        if (hfdcan == &hfdcan3)
+            CANcomm::fillTxFifo();
+    }
+
 }
\ No newline at end of file
@@ -0,0 +1,213 @@
+#include "EventLog.hpp"
+#include "PowerManager.hpp"
+#include "Communication.hpp"
+#include "Storage.hpp"
+#include "string.h"
+
+EventLogData eventLogData;
+
+#define EVENTLOG_SLOT_NUM       (STORAGE_EVENTLOG_SIZE / EVENTLOG_RECORD_SIZE)
+#define EVENTLOG_SLOTS_PER_UNIT (STORAGE_ERASE_UNIT / EVENTLOG_RECORD_SIZE)
+
+static_assert(sizeof(EventRecord) == EVENTLOG_RECORD_SIZE,
+              "EventRecord size error");
+static_assert(STORAGE_EVENTLOG_SIZE / STORAGE_ERASE_UNIT >= 2,
+              "event log needs at least 2 erase units");
+static_assert((EVENTLOG_QUEUE_SIZE & (EVENTLOG_QUEUE_SIZE - 1)) == 0,
+              "EVENTLOG_QUEUE_SIZE must be a power of 2");
+
+// 暂存队列，放在CCM RAM中且不初始化，软件复位前写入的事件在下次上电后写入Flash
+struct EventQueue
+{
+    uint32_t magic;
+    uint32_t head;                  // 写入方在关中断时更新
+    uint32_t tail;                  // 只由主循环更新
+    EventRecord records[EVENTLOG_QUEUE_SIZE];
+};
+
+__attribute__((section(".ccmram"))) static EventQueue eventQueue;
+
+namespace EventLog {
+
+static const EventRecord *slot(uint32_t index) {
+    return Storage::slot<EventRecord>(STORAGE_EVENTLOG_ADDR, index);
+}
+
+static uint16_t countValid() {
+    uint16_t num = 0;
+    for (uint32_t i = 0; i < EVENTLOG_SLOT_NUM; i++)
+        if (Storage::isValid(slot(i))) num++;
+    return num;
+}
+
+static void scan() {
+    const EventRecord *last = nullptr;
+    uint32_t lastIndex = 0;
+
+    eventLogData.recordNum = countValid();
+    for (uint32_t i = 0; i < EVENTLOG_SLOT_NUM; i++) {
+        const EventRecord *rec = slot(i);
+        if (!Storage::isValid(rec)) continue;
+        if (!last || rec->seq > last->seq) {
+            last = rec;
+            lastIndex = i;
+        }
+    }
+
+    if (last) {
+        eventLogData.nextSeq = last->seq + 1;
+        eventLogData.bootCount = last->bootCount + 1;
+        eventLogData.headSlot = (lastIndex + 1) % EVENTLOG_SLOT_NUM;
+    } else {
+        eventLogData.nextSeq = 0;
+        eventLogData.bootCount = 0;
+        eventLogData.headSlot = 0;
+    }
+}
+
+void init() {
+    scan();
+
+    if (eventQueue.magic != EVENTLOG_QUEUE_MAGIC ||
+        eventQueue.head - eventQueue.tail > EVENTLOG_QUEUE_SIZE) {
+        eventQueue.magic = EVENTLOG_QUEUE_MAGIC;
+        eventQueue.head = 0;
+        eventQueue.tail = 0;
+    }
+
+    log(EVENT_BOOT, sysData.resetFlags);
+}
+
+__attribute__((section(".code_in_ram"))) void log(EventType type,
+                                                  uint16_t payload,
+                                                  uint8_t level) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (eventQueue.head - eventQueue.tail < EVENTLOG_QUEUE_SIZE) {
+        EventRecord &rec =
+            eventQueue.records[eventQueue.head & (EVENTLOG_QUEUE_SIZE - 1)];
+        rec.timestamp = sysData.vTick;
+        rec.bootCount = eventLogData.bootCount;
+        rec.type = type;
+        rec.level = level;
+        rec.payload = payload;
+        eventQueue.head++;
+    } else {
+        eventLogData.dropped++;
+    }
+    __set_PRIMASK(primask);
+}
+
+static bool writeRecord(EventRecord &rec) {
+    // 最多跳过一个擦除单元内的损坏记录
+    for (uint32_t retry = 0; retry <= EVENTLOG_SLOTS_PER_UNIT; retry++) {
+        uint32_t index = eventLogData.headSlot;
+        uint32_t address = STORAGE_EVENTLOG_ADDR + index * EVENTLOG_RECORD_SIZE;
+
+        if (index % EVENTLOG_SLOTS_PER_UNIT == 0) {
+            // 进入新的擦除单元，其中是最旧的记录
+            if (!Storage::erase(address, STORAGE_ERASE_UNIT)) {
+                // 功率级开启时没有擦除，下次重试
+                if (!Storage::busy()) scan();
+                return false;
+            }
+            eventLogData.recordNum = countValid();
+        }
+
+        eventLogData.headSlot = (index + 1) % EVENTLOG_SLOT_NUM;
+        if (!Storage::isBlank(slot(index))) continue;
+
+        rec.seq = eventLogData.nextSeq;
+        rec.check = Storage::recordCheck(rec);
+        if (!Storage::program(address, &rec, sizeof(rec))) {
+            // 功率级开启时没有写入，下次仍写入这个位置
+            if (Storage::busy()) eventLogData.headSlot = index;
+            return false;
+        }
+        if (!Storage::isValid(slot(index))) continue;
+
+        eventLogData.nextSeq++;
+        eventLogData.recordNum++;
+        return true;
+    }
+    return false;
+}
+
+static void clear() {
+    if (!Storage::erase(STORAGE_EVENTLOG_ADDR, STORAGE_EVENTLOG_SIZE)) return;
+    // 保留序号和上电次数
+    eventLogData.headSlot = 0;
+    eventLogData.recordNum = 0;
+    eventLogData.clearRequest = false;
+    eventLogData.infoRequest = true;
+}
+
+void process() {
+    if (eventLogData.clearRequest) clear();
+
+    while (eventQueue.tail != eventQueue.head) {
+        EventRecord rec =
+            eventQueue.records[eventQueue.tail & (EVENTLOG_QUEUE_SIZE - 1)];
+        if (!writeRecord(rec)) return;
+        eventQueue.tail++;
+    }
+
+    // 队列写空后再记录溢出，下一次调用时写入
+    if (eventLogData.dropped) {
+        uint16_t dropped = eventLogData.dropped;
+        eventLogData.dropped = 0;
+        log(EVENT_QUEUE_OVERFLOW, dropped);
+    }
+}
+
+void command(const EventLogCmd &cmd) {
+    switch (cmd.op) {
+    case EVENTLOG_OP_READ: {
+        // 从最近的arg条记录开始，0为全部
+        uint32_t back = (cmd.arg && cmd.arg < EVENTLOG_SLOT_NUM) ? cmd.arg
+                                                                 : EVENTLOG_SLOT_NUM;
+        eventLogData.readSlot =
+            (eventLogData.headSlot + EVENTLOG_SLOT_NUM - back) % EVENTLOG_SLOT_NUM;
+        eventLogData.reading = true;
+        break;
+    }
+    case EVENTLOG_OP_CLEAR:
+        eventLogData.reading = false;
+        eventLogData.clearRequest = true;
+        break;
+    default:
+        break;
+    }
+    eventLogData.infoRequest = true;
+}
+
+void update() {
+    if (eventLogData.infoRequest) {
+        TxEventLogInfo info;
+        info.marker = EVENTLOG_INFO_MARKER;
+        info.recordNum = eventLogData.recordNum;
+        info.bootCount = eventLogData.bootCount;
+        if (!CANcomm::sendEventLogInfo(info)) return;
+        eventLogData.infoRequest = false;
+    }
+
+    // 限制每周期检查的位置数，跳过空位置时不占用过多时间
+    uint32_t sent = 0;
+    for (uint32_t checked = 0; checked < EVENTLOG_SLOTS_PER_TICK &&
+                               eventLogData.reading &&
+                               sent < EVENTLOG_RECORDS_PER_TICK;
+         checked++) {
+        if (sysData.flashBusy) return;
+
+        uint32_t index = eventLogData.readSlot;
+        if (Storage::isValid(slot(index))) {
+            if (!CANcomm::sendEventLogRecord(*slot(index))) return;
+            sent++;
+        }
+        eventLogData.readSlot = (index + 1) % EVENTLOG_SLOT_NUM;
+        if (eventLogData.readSlot == eventLogData.headSlot)
+            eventLogData.reading = false;
+    }
+}
+
+} // namespace EventLog
@@ -1,5 +1,6 @@
 #include "Interface.hpp"
 #include "PowerManager.hpp"
+#include "EventLog.hpp"
 #include "string.h"
 
 // extern uint32_t vTick;
@@ -136,6 +137,7 @@ void updateButtonState() {
         sysData.buttonCnt++;
         if (sysData.buttonCnt > 3000) {
             HRTIM::disableOutputAB();
+            EventLog::log(EVENT_RESET_REQUEST, RESET_SOURCE_BUTTON);
             __disable_irq();
             while (true) NVIC_SystemReset();
         }
@@ -0,0 +1,168 @@
+#include "LoopAnalyzer.hpp"
+#include "PowerManager.hpp"
+#include "Communication.hpp"
+#include "math.h"
+
+LoopAnalyzerData analyzerData;
+
+namespace LoopAnalyzer {
+
+static float sinTable[ANALYZER_SIN_TABLE_SIZE];
+
+void init() {
+    for (uint32_t i = 0; i < ANALYZER_SIN_TABLE_SIZE; i++)
+        sinTable[i] = sinf(i * (2.0f * (float)M_PI / ANALYZER_SIN_TABLE_SIZE));
+}
+
+static void startPoint() {
+    // 频点按对数均匀分布
+    if (analyzerData.pointNum > 1)
+        analyzerData.frequency =
+            analyzerData.startFreq *
+            powf(analyzerData.stopFreq / analyzerData.startFreq,
+                 (float)analyzerData.pointIndex / (analyzerData.pointNum - 1));
+    else
+        analyzerData.frequency = analyzerData.startFreq;
+
+    analyzerData.phase = 0;
+    analyzerData.phaseInc = (uint32_t)(analyzerData.frequency *
+                                       (4294967296.0f / ANALYZER_SAMPLE_FREQ));
+    analyzerData.settleSamples = (uint32_t)(
+        ANALYZER_SETTLE_CYCLES * ANALYZER_SAMPLE_FREQ / analyzerData.frequency);
+    // 相关长度取整数个周期，减少频谱泄漏
+    analyzerData.totalSamples =
+        analyzerData.settleSamples +
+        (uint32_t)(ANALYZER_MEASURE_CYCLES * ANALYZER_SAMPLE_FREQ /
+                       analyzerData.frequency +
+                   0.5f);
+    analyzerData.sampleCnt = 0;
+    analyzerData.sumA[0] = analyzerData.sumA[1] = 0.0f;
+    analyzerData.sumB[0] = analyzerData.sumB[1] = 0.0f;
+
+    analyzerData.pointDone = false;
+    analyzerData.running = true;
+}
+
+static bool sendPoint(uint8_t status) {
+    TxBodeData td = {};
+    td.pointIndex = analyzerData.pointIndex;
+    td.status = (analyzerData.target & BODE_STATUS_TARGET_MASK) | status;
+    td.frequency = (uint16_t)(analyzerData.frequency + 0.5f);
+
+    if (!(status & BODE_STATUS_ABORTED)) {
+        // H = B / A，环路增益为 -B / A
+        float aRe = analyzerData.sumA[0], aIm = analyzerData.sumA[1];
+        float bRe = analyzerData.sumB[0], bIm = analyzerData.sumB[1];
+        float aMag2 = M_MAX(aRe * aRe + aIm * aIm, 1e-12f);
+        float hRe = (bRe * aRe + bIm * aIm) / aMag2;
+        float hIm = (bIm * aRe - bRe * aIm) / aMag2;
+        if (analyzerData.target == ANALYZER_IL_TARGET) {
+            hRe = -hRe;
+            hIm = -hIm;
+        }
+        float magDB = 10.0f * log10f(M_MAX(hRe * hRe + hIm * hIm, 1e-12f));
+        float phaseDeg = atan2f(hIm, hRe) * (180.0f / (float)M_PI);
+        td.magnitude = (int16_t)M_CLAMP(magDB * 100.0f, -32768.0f, 32767.0f);
+        td.phase = (int16_t)(phaseDeg * 100.0f);
+    }
+    return CANcomm::sendBodeData(td);
+}
+
+void start(const BodeCmd &cmd) {
+    stop();
+    if (cmd.target != ANALYZER_IL_TARGET &&
+        cmd.target != ANALYZER_REFEREE_TARGET)
+        return;
+    if (!cmd.pointNum || !cmd.amplitude) return;
+
+    analyzerData.target = (AnalyzerTarget)cmd.target;
+    analyzerData.amplitude = (analyzerData.target == ANALYZER_IL_TARGET)
+                                 ? cmd.amplitude * 0.02f
+                                 : cmd.amplitude * 0.2f;
+    analyzerData.startFreq =
+        M_CLAMP(cmd.startFreq, ANALYZER_MIN_FREQ, ANALYZER_MAX_FREQ);
+    analyzerData.stopFreq =
+        M_CLAMP(cmd.stopFreq, ANALYZER_MIN_FREQ, ANALYZER_MAX_FREQ);
+    analyzerData.pointNum = cmd.pointNum;
+    analyzerData.pointIndex = 0;
+    startPoint();
+}
+
+void stop() {
+    analyzerData.running = false;
+    analyzerData.pointDone = false;
+    analyzerData.injection = 0.0f;
+    analyzerData.pRefereeInjection = 0.0f;
+    analyzerData.target = ANALYZER_OFF;
+}
+
+__attribute__((section(".code_in_ram"))) void beginMF() {
+    // iLTarget是增量式外环的状态量，注入只作用于本周期的DAC输出
+    psData.iLTarget -= analyzerData.iLApplied;
+    analyzerData.iLApplied = 0.0f;
+
+    if (!analyzerData.running) return;
+
+    uint32_t index = analyzerData.phase >> 24;
+    analyzerData.sinValue = sinTable[index];
+    analyzerData.cosValue =
+        sinTable[(index + ANALYZER_SIN_TABLE_SIZE / 4) &
+                 (ANALYZER_SIN_TABLE_SIZE - 1)];
+    analyzerData.injection = analyzerData.amplitude * analyzerData.sinValue;
+
+    if (analyzerData.target == ANALYZER_REFEREE_TARGET)
+        analyzerData.pRefereeInjection = analyzerData.injection;
+}
+
+__attribute__((section(".code_in_ram"))) void endMF() {
+    if (!analyzerData.running) return;
+
+    float a, b;
+    if (analyzerData.target == ANALYZER_IL_TARGET) {
+        b = psData.iLTarget;
+        a = M_CLAMP(b + analyzerData.injection, -psData.iLLimit,
+                    psData.iLLimit);
+        analyzerData.iLApplied = a - b;
+        psData.iLTarget = a;
+    } else {
+        a = analyzerData.injection;
+        b = adcData.pReferee;
+    }
+
+    if (analyzerData.sampleCnt >= analyzerData.settleSamples) {
+        analyzerData.sumA[0] += a * analyzerData.cosValue;
+        analyzerData.sumA[1] += a * analyzerData.sinValue;
+        analyzerData.sumB[0] += b * analyzerData.cosValue;
+        analyzerData.sumB[1] += b * analyzerData.sinValue;
+    }
+
+    analyzerData.phase += analyzerData.phaseInc;
+    if (++analyzerData.sampleCnt >= analyzerData.totalSamples) {
+        analyzerData.running = false;
+        analyzerData.pRefereeInjection = 0.0f;
+        analyzerData.pointDone = true;
+    }
+}
+
+void update() {
+    if (analyzerData.target == ANALYZER_OFF) return;
+
+    // 发送失败时保持当前状态，下一个1kHz周期重发同一个频点
+    if (!psData.outputABEnabled) {
+        analyzerData.running = false;
+        analyzerData.pRefereeInjection = 0.0f;
+        if (sendPoint(BODE_STATUS_ABORTED | BODE_STATUS_LAST)) stop();
+        return;
+    }
+
+    if (!analyzerData.pointDone) return;
+
+    if (analyzerData.pointIndex + 1 >= analyzerData.pointNum) {
+        if (sendPoint(BODE_STATUS_LAST)) stop();
+    } else if (sendPoint(0)) {
+        analyzerData.pointIndex++;
+        startPoint();
+    }
+}
+
+} // namespace LoopAnalyzer
@@ -0,0 +1,122 @@
+#include "LossMap.hpp"
+#include "PowerManager.hpp"
+#include "Communication.hpp"
+
+LossMapData lossMapData;
+
+static LossMapBank lossMapBanks[2];
+
+static_assert(LOSSMAP_CELL_NUM <= 0xFF, "cell index must fit in TxLossMapData.cell");
+
+namespace LossMap {
+
+__attribute__((section(".code_in_ram"))) void accumulate() {
+    if (!psData.outputABEnabled || psData.dcdcMode > BOOST) return;
+
+    // iA > 0 时能量从A侧流入，iB > 0 时流入电容组
+    float pA = adcData.vA * adcData.iA;
+    float pB = adcData.vB * adcData.iB;
+    uint32_t dir = pB < 0.0f;
+    float pIn = dir ? -pB : pA;
+    float pOut = dir ? -pA : pB;
+    if (pIn < LOSSMAP_MIN_POWER) return;
+
+    uint32_t bin = (uint32_t)(pIn * (1.0f / LOSSMAP_POWER_STEP));
+    bin = M_MIN(bin, LOSSMAP_POWER_BIN_NUM - 1U);
+    uint32_t cell =
+        (psData.dcdcMode * LOSSMAP_DIR_NUM + dir) * LOSSMAP_POWER_BIN_NUM + bin;
+
+    LossMapBank &bank = lossMapBanks[lossMapData.activeBank];
+    bank.pIn[cell] += pIn;
+    bank.pOut[cell] += pOut;
+    bank.count[cell]++;
+}
+
+// 62.5kHz中断优先级更高，切换后的下一次中断即写入另一个缓冲
+static void fold() {
+    uint8_t bankIndex = lossMapData.activeBank;
+    lossMapData.activeBank = bankIndex ^ 1U;
+    __DSB();
+
+    LossMapBank &bank = lossMapBanks[bankIndex];
+    for (uint32_t i = 0; i < LOSSMAP_CELL_NUM; i++) {
+        if (!bank.count[i]) continue;
+        lossMapData.pInSum[i] += (int64_t)(bank.pIn[i] * 1000.0f);
+        lossMapData.pOutSum[i] += (int64_t)(bank.pOut[i] * 1000.0f);
+        lossMapData.count[i] += bank.count[i];
+        bank.pIn[i] = 0.0f;
+        bank.pOut[i] = 0.0f;
+        bank.count[i] = 0;
+    }
+}
+
+static void clear() {
+    for (uint32_t i = 0; i < LOSSMAP_CELL_NUM; i++) {
+        lossMapData.pInSum[i] = 0;
+        lossMapData.pOutSum[i] = 0;
+        lossMapData.count[i] = 0;
+    }
+    lossMapData.clearRequest = false;
+}
+
+static uint16_t activeCells() {
+    uint16_t num = 0;
+    for (uint32_t i = 0; i < LOSSMAP_CELL_NUM; i++)
+        if (lossMapData.count[i]) num++;
+    return num;
+}
+
+void command(const LossMapCmd &cmd) {
+    switch (cmd.op) {
+    case LOSSMAP_OP_READ:
+        lossMapData.readCell = 0;
+        lossMapData.reading = true;
+        break;
+    case LOSSMAP_OP_CLEAR:
+        lossMapData.reading = false;
+        lossMapData.clearRequest = true;
+        break;
+    default:
+        break;
+    }
+    lossMapData.infoRequest = true;
+}
+
+void update() {
+    fold();
+    if (lossMapData.clearRequest) clear();
+
+    if (lossMapData.infoRequest) {
+        TxLossMapInfo info;
+        info.marker = LOSSMAP_INFO_MARKER;
+        info.modeNum = LOSSMAP_MODE_NUM;
+        info.binNum = LOSSMAP_POWER_BIN_NUM;
+        info.powerStep = (uint16_t)LOSSMAP_POWER_STEP;
+        info.activeCells = activeCells();
+        if (!CANcomm::sendLossMapInfo(info)) return;
+        lossMapData.infoRequest = false;
+    }
+
+    uint32_t sent = 0;
+    while (lossMapData.reading && sent < LOSSMAP_FRAMES_PER_TICK) {
+        uint32_t i = lossMapData.readCell;
+        if (lossMapData.count[i]) {
+            uint32_t count = lossMapData.count[i];
+            float pIn = lossMapData.pInSum[i] * 0.001f / count;
+            float loss = (lossMapData.pInSum[i] - lossMapData.pOutSum[i]) *
+                         0.001f / count;
+
+            TxLossMapData td;
+            td.cell = i;
+            td.time = M_MIN(count / (LOSSMAP_SAMPLE_FREQ / 100U), 0xFFFFFFU);
+            td.pIn = (uint16_t)M_CLAMP(pIn * 10.0f, 0.0f, 65535.0f);
+            td.loss = (int16_t)M_CLAMP(loss * 100.0f, -32768.0f, 32767.0f);
+            if (!CANcomm::sendLossMapData(td)) return;
+            sent++;
+        }
+        if (++lossMapData.readCell >= LOSSMAP_CELL_NUM)
+            lossMapData.reading = false;
+    }
+}
+
+} // namespace LossMap
@@ -0,0 +1,85 @@
+#include "Parallel.hpp"
+#include "PowerManager.hpp"
+#include "Communication.hpp"
+#include "EventLog.hpp"
+
+ParallelData parallelData;
+
+namespace Parallel {
+
+void receive(uint8_t node, const TxPeerData &pd, uint32_t tick) {
+    if (node >= parallelData.nodeNum)
+        return;
+
+    if (node == parallelData.nodeId) {
+        // 两块板使用了同一条校准记录，或节点号写错
+        if (parallelData.conflictCnt++ == 0)
+            EventLog::log(EVENT_PARALLEL_NODE_CONFLICT, node);
+        return;
+    }
+
+    ParallelPeer &peer = parallelData.peer[node];
+    if (peer.online)
+        peer.seqLost += (uint8_t)(pd.seq - peer.seq - 1U);
+    peer.iCap = pd.iCap * 0.01f;
+    peer.vCap = pd.vCap * 0.01f;
+    peer.pReferee = pd.pReferee * 0.01f;
+    peer.seq = pd.seq;
+    peer.sharing = pd.sharing;
+    peer.lastTick = tick;
+    peer.online = true;
+}
+
+void update() {
+    if (parallelData.nodeNum <= 1)
+        return;
+
+    uint8_t shareNum = 1;
+    uint8_t activeNum = 0;
+    float iCapSum = 0.0f;
+    float pReserved = 0.0f;
+    for (uint8_t n = 0; n < parallelData.nodeNum; n++) {
+        if (n == parallelData.nodeId)
+            continue;
+
+        ParallelPeer &peer = parallelData.peer[n];
+        if (peer.online && sysData.vTick - peer.lastTick > PARALLEL_PEER_TIMEOUT) {
+            peer.online = false;
+            peer.lostCnt++;
+            EventLog::log(EVENT_PARALLEL_PEER_LOST, n);
+        }
+
+        if (!peer.online) {
+            // 不知道该节点是否仍在取用裁判系统功率，仍为其保留一份
+            shareNum++;
+        } else if (peer.sharing) {
+            shareNum++;
+            activeNum++;
+            iCapSum += peer.iCap;
+        } else {
+            // 关闭输出的节点不再调节，但A侧并联时裁判系统电流仍有一部分流过它的采样电阻
+            pReserved += peer.pReferee;
+        }
+    }
+    pReserved = parallelData.pReserved + PARALLEL_RESERVED_ALPHA * (pReserved - parallelData.pReserved);
+
+    // 62.5kHz中断中一起读取
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    parallelData.shareNum = shareNum;
+    parallelData.activeNum = activeNum;
+    parallelData.iCapPeerSum = iCapSum;
+    parallelData.pReserved = pReserved;
+    __set_PRIMASK(primask);
+
+    TxPeerData td = {};
+    td.iCap = (int16_t)M_CLAMP(adcData.iCaplf * 100.0f, -32768.0f, 32767.0f);
+    td.vCap = (uint16_t)M_CLAMP(adcData.vCaplf * 100.0f, 0.0f, 65535.0f);
+    td.pReferee = (int16_t)M_CLAMP(adcData.pRefereelf * 100.0f, -32768.0f, 32767.0f);
+    td.seq = parallelData.txSeq++;
+    td.sharing = psData.outputABEnabled;
+    td.errorLevel = errorData.errorLevel & 0x03;
+    CANcomm::sendPeerData(td);
+}
+
+} // namespace Parallel
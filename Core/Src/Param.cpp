@@ -0,0 +1,356 @@
+#include "Param.hpp"
+#include "PowerManager.hpp"
+#include "Communication.hpp"
+#include "Storage.hpp"
+#include "string.h"
+
+ParamData paramData;
+
+namespace Param {
+
+// 默认值以此表为准，init()时覆盖结构体中的初始值
+static constexpr ParamDesc paramTable[PARAM_NUM] = {
+    {PARAM_IR_KTP, PARAM_TYPE_FLOAT, 0.0f, 10.0f, 0.1f, &mfLoop.iRPID.kTP},
+    {PARAM_IR_KMP, PARAM_TYPE_FLOAT, 0.0f, 10.0f, 0.2f, &mfLoop.iRPID.kMP},
+    {PARAM_IR_KI, PARAM_TYPE_FLOAT, 0.0f, 10.0f, 0.1f, &mfLoop.iRPID.kI},
+    {PARAM_IR_KD, PARAM_TYPE_FLOAT, 0.0f, 10.0f, 0.01f, &mfLoop.iRPID.kD},
+    {PARAM_VACLAMP_KTP, PARAM_TYPE_FLOAT, 0.0f, 100.0f, 10.0f, &mfLoop.vAClampPID.kTP},
+    {PARAM_VACLAMP_KMP, PARAM_TYPE_FLOAT, 0.0f, 100.0f, 0.0f, &mfLoop.vAClampPID.kMP},
+    {PARAM_VACLAMP_KI, PARAM_TYPE_FLOAT, 0.0f, 100.0f, 0.5f, &mfLoop.vAClampPID.kI},
+    {PARAM_VACLAMP_KD, PARAM_TYPE_FLOAT, 0.0f, 100.0f, 0.0f, &mfLoop.vAClampPID.kD},
+    {PARAM_VACLAMP_VOLTAGE, PARAM_TYPE_FLOAT, 20.0f, OVP_A - 0.5f, VA_CLAMP_VOLTAGE, &mfLoop.vAClampVoltage},
+    {PARAM_CURRENT_LIMIT_KI, PARAM_TYPE_FLOAT, 0.0f, 10.0f, 0.8f, &mfLoop.currentLimitKI},
+    {PARAM_VOLTAGE_LIMIT_KI, PARAM_TYPE_FLOAT, 0.0f, 1.0f, 0.01f, &mfLoop.voltageLimitKI},
+    {PARAM_BURST_KI, PARAM_TYPE_FLOAT, 0.0f, 10.0f, 2.0f, &mfLoop.burstKI},
+    {PARAM_REF_KP, PARAM_TYPE_FLOAT, 0.0f, 10.0f, 1.0f, &ctrlData.refLoop.kP},
+    {PARAM_REF_KI, PARAM_TYPE_FLOAT, 0.0f, 10.0f, 0.04f, &ctrlData.refLoop.kI},
+    {PARAM_REF_KD, PARAM_TYPE_FLOAT, 0.0f, 10.0f, 1.5f, &ctrlData.refLoop.kD},
+    {PARAM_REF_ENERGY_BUFFER, PARAM_TYPE_UINT16, 0.0f, 60.0f, REFEREE_ENERGY_BUFFER, &ctrlData.refLoop.energyBufferTarget},
+    {PARAM_CAPARR_CUTOFF_VOLTAGE, PARAM_TYPE_FLOAT, 1.0f, 15.0f, CAPARR_CUTOFF_VOLTAGE, &capStatus.cutoffVoltage},
+    {PARAM_CAPARR_LOW_VOLTAGE, PARAM_TYPE_FLOAT, 2.0f, 20.0f, CAPARR_LOW_VOLTAGE, &capStatus.lowVoltage},
+    {PARAM_CAPARR_MAX_CURRENT, PARAM_TYPE_FLOAT, 1.0f, THERMAL_IB_BURST_CURRENT, CAPARR_MAX_CURRENT, &capStatus.maxCurrent},
+    {PARAM_CAPARR_DCR, PARAM_TYPE_FLOAT, 0.0f, 1.0f, CAPARR_DCR, &capStatus.dcr},
+    {PARAM_MODE_BUCK_TO_BUCKBOOST, PARAM_TYPE_FLOAT, 0.5f, 1.5f, 0.84f, &psData.modeThreshold.buckToBuckBoost},
+    {PARAM_MODE_BUCKBOOST_TO_BUCK, PARAM_TYPE_FLOAT, 0.5f, 1.5f, 0.80f, &psData.modeThreshold.buckBoostToBuck},
+    {PARAM_MODE_BUCKBOOST_TO_BOOSTBUCK, PARAM_TYPE_FLOAT, 0.5f, 1.5f, 1.02f, &psData.modeThreshold.buckBoostToBoostBuck},
+    {PARAM_MODE_BOOSTBUCK_TO_BUCK, PARAM_TYPE_FLOAT, 0.5f, 1.5f, 0.82f, &psData.modeThreshold.boostBuckToBuck},
+    {PARAM_MODE_BOOSTBUCK_TO_BUCKBOOST, PARAM_TYPE_FLOAT, 0.5f, 1.5f, 0.98f, &psData.modeThreshold.boostBuckToBuckBoost},
+    {PARAM_MODE_BOOSTBUCK_TO_BOOST, PARAM_TYPE_FLOAT, 0.5f, 1.5f, 1.25f, &psData.modeThreshold.boostBuckToBoost},
+    {PARAM_MODE_BOOST_TO_BUCK, PARAM_TYPE_FLOAT, 0.5f, 1.5f, 0.82f, &psData.modeThreshold.boostToBuck},
+    {PARAM_MODE_BOOST_TO_BOOSTBUCK, PARAM_TYPE_FLOAT, 0.5f, 1.5f, 1.19f, &psData.modeThreshold.boostToBoostBuck},
+    {PARAM_FEEDBACK_PERIOD, PARAM_TYPE_UINT16, 1.0f, 10.0f, 1.0f, &feedbackData.period},
+    {PARAM_FEEDBACK_POWER_DELTA, PARAM_TYPE_FLOAT, 0.0f, 100.0f, 0.0f, &feedbackData.powerDelta},
+    {PARAM_FEEDBACK_ENERGY_DELTA, PARAM_TYPE_UINT16, 0.0f, 250.0f, 0.0f, &feedbackData.energyDelta},
+    {PARAM_DIAG_PERIOD, PARAM_TYPE_UINT16, 0.0f, 1000.0f, 0.0f, &feedbackData.diagPeriod},
+};
+
+static constexpr bool tableValid() {
+    for (uint32_t i = 0; i < PARAM_NUM; i++) {
+        const ParamDesc &d = paramTable[i];
+        if (d.id != i || d.min > d.max || d.def < d.min || d.def > d.max)
+            return false;
+    }
+    return true;
+}
+
+static_assert(tableValid(), "paramTable must be ordered by ParamId with defaults in range");
+static_assert(PARAM_NUM <= 32, "stagedMask is 32 bits");
+static_assert((PARAM_REPLY_QUEUE_SIZE & (PARAM_REPLY_QUEUE_SIZE - 1)) == 0,
+              "PARAM_REPLY_QUEUE_SIZE must be a power of 2");
+static_assert(sizeof(ParamHeader) + PARAM_NUM * sizeof(ParamEntry) + 4U <= STORAGE_PARAM_SIZE,
+              "parameters do not fit in storage");
+
+// 参数之间的约束：low < high，模式切换阈值需保留迟滞，否则会在两个模式之间来回切换
+struct ParamOrder
+{
+    uint8_t low, high;
+};
+
+static constexpr ParamOrder paramOrder[] = {
+    {PARAM_CAPARR_CUTOFF_VOLTAGE, PARAM_CAPARR_LOW_VOLTAGE},
+    {PARAM_MODE_BUCKBOOST_TO_BUCK, PARAM_MODE_BUCK_TO_BUCKBOOST},
+    {PARAM_MODE_BOOSTBUCK_TO_BUCKBOOST, PARAM_MODE_BUCKBOOST_TO_BOOSTBUCK},
+    {PARAM_MODE_BOOST_TO_BOOSTBUCK, PARAM_MODE_BOOSTBUCK_TO_BOOST},
+    {PARAM_MODE_BOOSTBUCK_TO_BUCK, PARAM_MODE_BOOSTBUCK_TO_BUCKBOOST},
+    {PARAM_MODE_BOOST_TO_BUCK, PARAM_MODE_BOOST_TO_BOOSTBUCK},
+};
+
+static TxParamData replyQueue[PARAM_REPLY_QUEUE_SIZE];
+
+union ParamValue
+{
+    float f;
+    uint32_t u;
+};
+
+__attribute__((section(".code_in_ram"))) static void write(const ParamDesc &d, uint32_t value) {
+    if (d.type == PARAM_TYPE_UINT16) {
+        *static_cast<uint16_t *>(d.ptr) = (uint16_t)value;
+    } else {
+        ParamValue v;
+        v.u = value;
+        *static_cast<float *>(d.ptr) = v.f;
+    }
+}
+
+static uint32_t read(const ParamDesc &d) {
+    if (d.type == PARAM_TYPE_UINT16) return *static_cast<const uint16_t *>(d.ptr);
+    ParamValue v;
+    v.f = *static_cast<const float *>(d.ptr);
+    return v.u;
+}
+
+static uint32_t encode(const ParamDesc &d, float value) {
+    if (d.type == PARAM_TYPE_UINT16) return (uint32_t)value;
+    ParamValue v;
+    v.f = value;
+    return v.u;
+}
+
+static float toFloat(const ParamDesc &d, uint32_t value) {
+    if (d.type == PARAM_TYPE_UINT16) return (float)value;
+    ParamValue v;
+    v.u = value;
+    return v.f;
+}
+
+// NaN不满足任何比较，同样返回false
+static bool inRange(const ParamDesc &d, uint32_t value) {
+    if (d.type == PARAM_TYPE_UINT16 && value > 0xFFFFU) return false;
+    float f = toFloat(d, value);
+    return f >= d.min && f <= d.max;
+}
+
+// 返回第一个违反约束的参数，全部满足时返回PARAM_NUM
+static uint32_t checkOrder(const uint32_t *values) {
+    for (const ParamOrder &o : paramOrder) {
+        if (!(toFloat(paramTable[o.low], values[o.low]) <
+              toFloat(paramTable[o.high], values[o.high])))
+            return o.low;
+    }
+    return PARAM_NUM;
+}
+
+static void reply(uint8_t op, uint8_t id, uint8_t field, uint8_t status, uint32_t value) {
+    uint8_t head = paramData.replyHead;
+    uint8_t next = (head + 1U) & (PARAM_REPLY_QUEUE_SIZE - 1U);
+    if (next == paramData.replyTail) return;
+
+    TxParamData &td = replyQueue[head];
+    td.op = op;
+    td.id = id;
+    td.field = field;
+    td.type = id < PARAM_NUM ? paramTable[id].type : 0;
+    td.status = status;
+    td.value = value;
+    paramData.replyHead = next;
+}
+
+static void load() {
+    const uint8_t *base = reinterpret_cast<const uint8_t *>(STORAGE_PARAM_ADDR);
+    ParamHeader header;
+    memcpy(&header, base, sizeof(header));
+    if (header.magic != PARAM_MAGIC || header.version != PARAM_VERSION ||
+        sizeof(ParamHeader) + header.count * sizeof(ParamEntry) + 4U > STORAGE_PARAM_SIZE)
+        return;
+
+    uint32_t size = sizeof(ParamHeader) + header.count * sizeof(ParamEntry);
+    uint32_t crc;
+    memcpy(&crc, base + size, sizeof(crc));
+    if (crc != Storage::crc32(base, size)) return;
+
+    uint32_t values[PARAM_NUM];
+    for (uint32_t i = 0; i < PARAM_NUM; i++) values[i] = read(paramTable[i]);
+    for (uint32_t i = 0; i < header.count; i++) {
+        ParamEntry e;
+        memcpy(&e, base + sizeof(ParamHeader) + i * sizeof(ParamEntry), sizeof(e));
+        if (e.id < PARAM_NUM && e.type == paramTable[e.id].type &&
+            inRange(paramTable[e.id], e.value))
+            values[e.id] = e.value;
+    }
+    if (checkOrder(values) != PARAM_NUM) return;
+
+    for (uint32_t i = 0; i < PARAM_NUM; i++) write(paramTable[i], values[i]);
+    paramData.flashValid = true;
+}
+
+static bool save() {
+    static uint8_t buffer[sizeof(ParamHeader) + PARAM_NUM * sizeof(ParamEntry) + 4U];
+
+    ParamHeader header = {PARAM_MAGIC, PARAM_VERSION, PARAM_NUM};
+    memcpy(buffer, &header, sizeof(header));
+    for (uint32_t i = 0; i < PARAM_NUM; i++) {
+        ParamEntry e = {(uint8_t)i, paramTable[i].type, 0, read(paramTable[i])};
+        memcpy(buffer + sizeof(ParamHeader) + i * sizeof(ParamEntry), &e, sizeof(e));
+    }
+    uint32_t size = sizeof(buffer) - 4U;
+    uint32_t crc = Storage::crc32(buffer, size);
+    memcpy(buffer + size, &crc, sizeof(crc));
+    return Storage::write(STORAGE_PARAM_ADDR, buffer, sizeof(buffer));
+}
+
+void init() {
+    for (uint32_t i = 0; i < PARAM_NUM; i++)
+        write(paramTable[i], encode(paramTable[i], paramTable[i].def));
+    load();
+}
+
+__attribute__((section(".code_in_ram"))) void applyPending() {
+    if (!paramData.applyRequest) return;
+    uint32_t mask = paramData.stagedMask;
+    for (uint32_t i = 0; i < PARAM_NUM; i++)
+        if (mask & (1U << i)) write(paramTable[i], paramData.staged[i]);
+    paramData.appliedMask = mask;
+    paramData.stagedMask = 0;
+    paramData.applyRequest = false;
+    paramData.applied = true;
+}
+
+void command(const ParamCmd &cmd) {
+    uint8_t id = cmd.id;
+    switch (cmd.op) {
+    case PARAM_OP_INFO:
+        reply(cmd.op, PARAM_NUM, paramData.flashValid | (paramData.dirty << 1), PARAM_OK,
+              paramData.stagedMask);
+        break;
+    case PARAM_OP_GET:
+        if (id >= PARAM_NUM)
+            reply(cmd.op, id, PARAM_FIELD_VALUE, PARAM_ERR_ID, 0);
+        else
+            reply(cmd.op, id, PARAM_FIELD_VALUE, PARAM_OK, read(paramTable[id]));
+        break;
+    case PARAM_OP_SET:
+        if (id >= PARAM_NUM) {
+            reply(cmd.op, id, PARAM_FIELD_STAGED, PARAM_ERR_ID, cmd.value);
+        } else if (paramData.applyRequest) {
+            reply(cmd.op, id, PARAM_FIELD_STAGED, PARAM_ERR_BUSY, cmd.value);
+        } else if (!inRange(paramTable[id], cmd.value)) {
+            reply(cmd.op, id, PARAM_FIELD_STAGED, PARAM_ERR_RANGE, cmd.value);
+        } else {
+            paramData.staged[id] = cmd.value;
+            paramData.stagedMask |= 1U << id;
+            reply(cmd.op, id, PARAM_FIELD_STAGED, PARAM_OK, cmd.value);
+        }
+        break;
+    case PARAM_OP_APPLY: {
+        if (paramData.applyRequest) {
+            reply(cmd.op, PARAM_NUM, PARAM_FIELD_VALUE, PARAM_ERR_BUSY, paramData.stagedMask);
+            break;
+        }
+        uint32_t values[PARAM_NUM];
+        for (uint32_t i = 0; i < PARAM_NUM; i++)
+            values[i] = (paramData.stagedMask & (1U << i)) ? paramData.staged[i]
+                                                           : read(paramTable[i]);
+        uint32_t violated = checkOrder(values);
+        if (violated != PARAM_NUM) {
+            reply(cmd.op, violated, PARAM_FIELD_STAGED, PARAM_ERR_CONSTRAINT,
+                  paramData.stagedMask);
+            break;
+        }
+        // 回复在生效后由update()发送
+        __DMB();
+        paramData.applyRequest = true;
+        break;
+    }
+    case PARAM_OP_DISCARD:
+        if (!paramData.applyRequest) paramData.stagedMask = 0;
+        reply(cmd.op, PARAM_NUM, PARAM_FIELD_VALUE,
+              paramData.applyRequest ? PARAM_ERR_BUSY : PARAM_OK, paramData.stagedMask);
+        break;
+    case PARAM_OP_SAVE:
+        // 回复在保存后由update()发送
+        paramData.saveRequest = true;
+        break;
+    case PARAM_OP_DEFAULT:
+        if (paramData.applyRequest) {
+            reply(cmd.op, PARAM_NUM, PARAM_FIELD_VALUE, PARAM_ERR_BUSY, paramData.stagedMask);
+            break;
+        }
+        for (uint32_t i = 0; i < PARAM_NUM; i++)
+            paramData.staged[i] = encode(paramTable[i], paramTable[i].def);
+        paramData.stagedMask = 0xFFFFFFFFU >> (32U - PARAM_NUM);
+        reply(cmd.op, PARAM_NUM, PARAM_FIELD_VALUE, PARAM_OK, paramData.stagedMask);
+        break;
+    case PARAM_OP_LIST:
+        paramData.listIndex = 0;
+        paramData.listField = PARAM_FIELD_VALUE;
+        paramData.listing = true;
+        break;
+    default:
+        break;
+    }
+}
+
+static bool sendListFrame() {
+    const ParamDesc &d = paramTable[paramData.listIndex];
+    TxParamData td;
+    td.op = PARAM_OP_LIST;
+    td.id = d.id;
+    td.field = paramData.listField;
+    td.type = d.type;
+    td.status = PARAM_OK;
+    switch (paramData.listField) {
+    case PARAM_FIELD_MIN: td.value = encode(d, d.min); break;
+    case PARAM_FIELD_MAX: td.value = encode(d, d.max); break;
+    case PARAM_FIELD_DEFAULT: td.value = encode(d, d.def); break;
+    default: td.value = read(d); break;
+    }
+    return CANcomm::sendParamData(td);
+}
+
+void update() {
+    uint32_t sent = 0;
+
+    if (paramData.applied) {
+        paramData.dirty = true;
+        TxParamData td = {PARAM_OP_APPLY, PARAM_NUM, PARAM_FIELD_VALUE, 0, PARAM_OK,
+                          paramData.appliedMask};
+        if (!CANcomm::sendParamData(td)) return;
+        paramData.applied = false;
+        sent++;
+    }
+
+    if (paramData.saveDone) {
+        TxParamData td = {PARAM_OP_SAVE, PARAM_NUM, PARAM_FIELD_VALUE, 0,
+                          (uint8_t)(paramData.saveOk ? PARAM_OK : PARAM_ERR_FLASH), 0};
+        if (!CANcomm::sendParamData(td)) return;
+        paramData.saveDone = false;
+        sent++;
+    }
+
+    while (sent < PARAM_FRAMES_PER_TICK && paramData.replyTail != paramData.replyHead) {
+        uint8_t tail = paramData.replyTail;
+        if (!CANcomm::sendParamData(replyQueue[tail])) return;
+        paramData.replyTail = (tail + 1U) & (PARAM_REPLY_QUEUE_SIZE - 1U);
+        sent++;
+    }
+
+    while (paramData.listing && sent < PARAM_FRAMES_PER_TICK) {
+        if (!sendListFrame()) return;
+        sent++;
+        // 每个参数依次发送VALUE、MIN、MAX、DEFAULT
+        paramData.listField = paramData.listField == PARAM_FIELD_VALUE
+                                  ? (uint8_t)PARAM_FIELD_MIN
+                                  : paramData.listField + 1U;
+        if (paramData.listField > PARAM_FIELD_DEFAULT) {
+            paramData.listField = PARAM_FIELD_VALUE;
+            if (++paramData.listIndex >= PARAM_NUM) paramData.listing = false;
+        }
+    }
+}
+
+void process() {
+    if (!paramData.saveRequest) return;
+    bool ok = save();
+    // 功率级开启时Storage拒绝擦写，保留请求，关闭后再保存
+    if (!ok && Storage::busy()) return;
+    paramData.saveOk = ok;
+    if (ok) {
+        paramData.flashValid = true;
+        paramData.dirty = false;
+    }
+    paramData.saveRequest = false;
+    paramData.saveDone = true;
+}
+
+} // namespace Param
@@ -1,6 +1,16 @@
 
 
 #include "PowerManager.hpp"
+#include "LoopAnalyzer.hpp"
+#include "BlackBox.hpp"
+#include "EventLog.hpp"
+#include "Thermal.hpp"
+#include "CapHealth.hpp"
+#include "Supervisor.hpp"
+#include "LossMap.hpp"
+#include "Telemetry.hpp"
+#include "Param.hpp"
+#include "Parallel.hpp"
 #include "hrtim.h"
 
 SystemData sysData;
@@ -83,28 +93,29 @@ __attribute__((section(".code_in_ram"))) void modeStateMachine() {
     psData.dutyByVoltage = M_MAX(adcData.vB, 0.01f) / adcData.vA;
 
     // 根据占空比进行状态切换
+    const ModeThreshold &th = psData.modeThreshold;
     switch (psData.dcdcMode) {
         case BUCK:
-            if (psData.dutyByVoltage > 0.84f) psData.dcdcMode = BUCKBOOST;
+            if (psData.dutyByVoltage > th.buckToBuckBoost) psData.dcdcMode = BUCKBOOST;
             break;
         case BUCKBOOST:
-            if (psData.dutyByVoltage < 0.80f)
+            if (psData.dutyByVoltage < th.buckBoostToBuck)
                 psData.dcdcMode = BUCK;
-            else if (psData.dutyByVoltage > 1.02f)
+            else if (psData.dutyByVoltage > th.buckBoostToBoostBuck)
                 psData.dcdcMode = BOOSTBUCK;
             break;
         case BOOSTBUCK:
-            if (psData.dutyByVoltage < 0.82f)
+            if (psData.dutyByVoltage < th.boostBuckToBuck)
                 psData.dcdcMode = BUCK;
-            else if (psData.dutyByVoltage < 0.98f)
+            else if (psData.dutyByVoltage < th.boostBuckToBuckBoost)
                 psData.dcdcMode = BUCKBOOST;
-            else if (psData.dutyByVoltage > 1.25f)
+            else if (psData.dutyByVoltage > th.boostBuckToBoost)
                 psData.dcdcMode = BOOST;
             break;
         case BOOST:
-            if (psData.dutyByVoltage < 0.82f)
+            if (psData.dutyByVoltage < th.boostToBuck)
                 psData.dcdcMode = BUCK;
-            else if (psData.dutyByVoltage < 1.19f)
+            else if (psData.dutyByVoltage < th.boostToBoostBuck)
                 psData.dcdcMode = BOOSTBUCK;
             break;
         default:
@@ -326,7 +337,7 @@ __attribute__((section(".code_in_ram"))) void updateADCmf() {
     adcData.vWPT = 0.0f;
 #endif
 
-    adcData.vCap = adcData.vB - adcData.iCap * CAPARR_DCR;
+    adcData.vCap = adcData.vB - adcData.iCap * capStatus.dcr;
     adcData.iChassis = adcData.iR - adcData.iA;
     adcData.pReferee = adcData.vA * adcData.iR;
     adcData.pChassis = adcData.vA * adcData.iChassis;
@@ -373,7 +384,7 @@ void powerOnOffControl() {
         if (adcData.vA > REFEREE_UVLO_RECOVERY &&
             (errorData.errorLevel == NO_ERROR ||
              errorData.errorLevel == WARNING) &&
-            psData.allowEnableOutput) // TODO
+            psData.allowEnableOutput && !sysData.flashBusy) // TODO
         {
             // psData.iLLimit = 1.0f;
             HRTIM::enableOutputAB();
@@ -401,11 +412,33 @@ __attribute__((section(".code_in_ram"))) void updateMFLoop() {
         ctrlData.allowCharge = true;
     }
 
+    // 多板并联时按份数平分裁判系统功率，再按电容电流与其他节点平均值之差修正（见Parallel.hpp）
+    float pRefereeShare = ctrlData.pRefereeTarget;
+    if (parallelData.nodeNum > 1) {
+        pRefereeShare = (pRefereeShare - parallelData.pReserved) / parallelData.shareNum;
+        if (parallelData.activeNum && psData.outputABEnabled) {
+            float iCapError = adcData.iCaplf -
+                (parallelData.iCapPeerSum + adcData.iCaplf) / (parallelData.activeNum + 1);
+            parallelData.shareIntegral = M_CLAMP(
+                parallelData.shareIntegral - PARALLEL_SHARE_KI * iCapError,
+                -PARALLEL_SHARE_LIMIT, PARALLEL_SHARE_LIMIT);
+            parallelData.shareBias = M_CLAMP(
+                parallelData.shareIntegral - PARALLEL_SHARE_KP * iCapError,
+                -PARALLEL_SHARE_LIMIT, PARALLEL_SHARE_LIMIT);
+        } else {
+            parallelData.shareIntegral = 0.0f;
+            parallelData.shareBias = 0.0f;
+        }
+        pRefereeShare += parallelData.shareBias;
+    }
+
     if ((ctrlData.allowCharge || !rxData1.enableActiveChargingLimit) &&
         !psData.softStartCnt) //
     {
-        mfLoop.iRPID.computeDelta((ctrlData.pRefereeTarget / adcData.vA),
-                                  adcData.iR);
+        mfLoop.iRPID.computeDelta(
+            ((pRefereeShare + analyzerData.pRefereeInjection) /
+             adcData.vA),
+            adcData.iR);
         ctrlData.limitFactor = REFEREE_POWER;
     } else {
         mfLoop.iRPID.computeDelta(6.0f / adcData.vA, adcData.iR);
@@ -415,6 +448,15 @@ __attribute__((section(".code_in_ram"))) void updateMFLoop() {
     // 默认设为裁判系统功率PID的输出
     mfLoop.deltaIL = mfLoop.iRPID.getOutput();
 
+    // 能量回收时vA快速上升，由vA钳位环直接提高充电电流，避免触发OVP_A
+    // 每个周期都计算以保持PID状态连续，仅在超过钳位电压时生效
+    mfLoop.vAClampPID.computeDelta(adcData.vA, mfLoop.vAClampVoltage);
+    mfLoop.dIL_VA_Clamp = mfLoop.vAClampPID.getOutput();
+    if (adcData.vA > mfLoop.vAClampVoltage && mfLoop.dIL_VA_Clamp > mfLoop.deltaIL) {
+        mfLoop.deltaIL = mfLoop.dIL_VA_Clamp;
+        ctrlData.limitFactor = VA_CLAMP;
+    }
+
     mfLoop.dIL_VCap_Max =
         mfLoop.voltageLimitKI * (CAPARR_MAX_VOLTAGE - adcData.vCap);
     mfLoop.dIL_IB_Positive =
@@ -425,9 +467,15 @@ __attribute__((section(".code_in_ram"))) void updateMFLoop() {
     // mfLoop.dIL_recoverBurst = M_CLAMP((0.1f - adcData.iChassis)*
     // mfLoop.burstKI, 0.0f, 8.0f);
 
+    // vA钳位生效时电容组未满则不按电压限速，否则接近满电时充电电流升得太慢，vA会冲过OVP_A
+    // 已满时只减小充电电流，不向已高于钳位电压的母线放电
+    bool vAClamped = ctrlData.limitFactor == VA_CLAMP;
     if ((adcData.vCap > CAPARR_MAX_VOLTAGE * 0.95f) &&
+        (!vAClamped || adcData.vCap >= CAPARR_MAX_VOLTAGE) &&
         (mfLoop.dIL_VCap_Max < mfLoop.deltaIL)) {
         mfLoop.deltaIL = mfLoop.dIL_VCap_Max;
+        if (vAClamped)
+            mfLoop.deltaIL = M_MAX(mfLoop.deltaIL, -psData.iLTarget);
         ctrlData.limitFactor = CAPARR_VOLTAGE_MAX;
     } else if (adcData.iCap > capStatus.maxInCurrent &&
                mfLoop.dIL_IB_Positive < mfLoop.deltaIL) {
@@ -443,7 +491,7 @@ __attribute__((section(".code_in_ram"))) void updateMFLoop() {
 
     // [新增] 强制限制低电压时的电流，防止传感器故障导致积分器饱和
     // 即使电流传感器也读数为0，这里也会强制将目标电流压在1A以下
-    if (adcData.vCap < CAPARR_CUTOFF_VOLTAGE) {
+    if (adcData.vCap < capStatus.cutoffVoltage) {
         if (psData.iLTarget > capStatus.maxInCurrent) {
             psData.iLTarget = capStatus.maxInCurrent;
             ctrlData.limitFactor = IB_POSITIVE;
@@ -454,7 +502,7 @@ __attribute__((section(".code_in_ram"))) void updateMFLoop() {
 void updateRefereePower(const RxData &rd, const uint32_t &currentTick) {
     if (ctrlData.limitFactor == REFEREE_POWER && psData.outputABEnabled) {
         ctrlData.refLoop.error =
-            (rd.refereeEnergyBuffer - REFEREE_ENERGY_BUFFER);
+            (rd.refereeEnergyBuffer - ctrlData.refLoop.energyBufferTarget);
         ctrlData.refLoop.pRefereeBias =
             ctrlData.refLoop.kP * ctrlData.refLoop.error +
             ctrlData.refLoop.kI * ctrlData.refLoop.integral +
@@ -480,6 +528,7 @@ void checkRxDataTimeout(const uint32_t &currentTick) {
     if (ctrlData.refLoop.isConnected &&
         (currentTick - ctrlData.refLoop.lastTimestamp > RXDATA_TIMEOUT)) //
     {
+        ctrlData.refLoop.timeoutCnt++;
 #ifdef WITHOUT_UPPER
         ctrlData.pRefereeTarget = REFEREE_DEFUALT_POWER;
         ctrlData.refLoop.lastError = 0.0f;
@@ -505,147 +554,242 @@ void checkRxDataTimeout(const uint32_t &currentTick) {
 
 namespace Protection {
 
-void errorHandlerLF() {
-    if (errorData.errorLevel == WARNING) {
-        // 逐渐减小errorCnt
-        if (errorData.overCurrentCnt > 0) errorData.overCurrentCnt--;
-        if (errorData.overVoltageCnt > 0) errorData.overVoltageCnt--;
-        if (errorData.shortCircuitCnt > 0) errorData.shortCircuitCnt--;
-            // 如果Cnt都为0则解除警告状态
-#ifdef WITHOUT_UPPER
-        if (!(errorData.overCurrentCnt || errorData.overVoltageCnt ||
-              errorData.shortCircuitCnt || errorData.lowBattery))
-            errorData.errorLevel = NO_ERROR;
-#else
-        if (!(errorData.overCurrentCnt || errorData.overVoltageCnt ||
-              errorData.shortCircuitCnt || errorData.lowBattery))
-            errorData.errorLevel = NO_ERROR;
-#endif
-    }
+/*-------- 保护规则表 --------*/
+
+// 62.5kHz，在功率级开启时于ADC解码后立刻检查
+enum HFCondition {
+    HF_VA_COLLAPSE, HF_IA_SHORT, HF_VB_COLLAPSE, HF_IB_SHORT,
+    HF_VA_DROP, HF_IA_RISE, HF_VB_DROP, HF_IB_RISE
+};
+
+static constexpr ProtectionCondition hfConditions[] = {
+    {SIGNAL_VA, -1.0f, SCP_VOLTAGE, 0.0f},
+    {SIGNAL_IA_OUT, 1.0f, SCP_CURRENT, 0.0f},
+    {SIGNAL_VB, -1.0f, SCP_VOLTAGE, 0.0f},
+    {SIGNAL_IB, 1.0f, SCP_CURRENT, 0.0f},
+    {SIGNAL_DVA, -1.0f, -SCP_DV_STEP, 0.0f},
+    {SIGNAL_DIA_OUT, 1.0f, SCP_DI_STEP, 0.0f},
+    {SIGNAL_DVB, -1.0f, -SCP_DV_STEP, 0.0f},
+    {SIGNAL_DIB, 1.0f, SCP_DI_STEP, 0.0f},
+};
+
+static constexpr ProtectionRule hfRules[] = {
+    // 裁判系统端或底盘端短路
+    {(1U << HF_VA_COLLAPSE) | (1U << HF_IA_SHORT), SCP_LEAK_TRIP, SCP_A_HIT,
+     ERROR_SCP_A, ERROR_RECOVER_MANUAL, SIGNAL_VA, SIGNAL_IA_OUT},
+    // 电容端或无线充电端短路（无线充电端短路会通过buck上管短路B端）
+    {(1U << HF_VB_COLLAPSE) | (1U << HF_IB_SHORT), SCP_LEAK_TRIP, SCP_B_HIT,
+     ERROR_SCP_B, ERROR_RECOVER_MANUAL, SIGNAL_VB, SIGNAL_IB},
+    // 快速短路检测：电流已超过SCP_CURRENT，且一个采样周期内电流突增、电压突降，不去抖
+    {(1U << HF_IA_SHORT) | (1U << HF_VA_DROP) | (1U << HF_IA_RISE), 1U, 0U,
+     ERROR_SCP_A, ERROR_RECOVER_MANUAL, SIGNAL_VA, SIGNAL_IA_OUT},
+    {(1U << HF_IB_SHORT) | (1U << HF_VB_DROP) | (1U << HF_IB_RISE), 1U, 0U,
+     ERROR_SCP_B, ERROR_RECOVER_MANUAL, SIGNAL_VB, SIGNAL_IB},
+};
+
+// 1kHz
+enum LFCondition { LF_VA_LOW, LF_VA_ON };
+
+static constexpr ProtectionCondition lfConditions[] = {
+    {SIGNAL_VA, -1.0f, BATTERY_LOW_LIMIT,
+     BATTERY_LOW_RECOVERY - BATTERY_LOW_LIMIT},
+    // 低于UVLO时为裁判系统断电而不是电池低电量
+    {SIGNAL_VA, 1.0f, REFEREE_UVLO_RECOVERY,
+     REFEREE_UVLO_RECOVERY - REFEREE_UVLO_LIMIT},
+};
+
+static constexpr ProtectionRule lfRules[] = {
+    {(1U << LF_VA_LOW) | (1U << LF_VA_ON), BATTERY_LOW_DEBOUNCE, 0U,
+     WARNING_LOWBATTERY, WARNING, SIGNAL_VA, SIGNAL_IA_OUT},
+};
+
+// 错误等级的严重程度，WARNING低于所有错误
+static inline uint8_t severity(ErrorLevel level) {
+    return (level == WARNING) ? 1U : ((level == NO_ERROR) ? 0U : level + 1U);
+}
 
-    if (adcData.vA < REFEREE_UVLO_LIMIT)
-        errorData.powerOffCnt++;
-    else
-        errorData.powerOffCnt = 0;
+__attribute__((section(".code_in_ram"))) static inline void loadSignals(
+    float (&signal)[SIGNAL_NUM]) {
+    signal[SIGNAL_VA] = adcData.vA;
+    signal[SIGNAL_VB] = adcData.vB;
+    signal[SIGNAL_IA_OUT] = -adcData.iA;
+    signal[SIGNAL_IB] = adcData.iB;
+}
 
-    if (errorData.powerOffCnt > 2000 && errorData.errorLevel != NO_ERROR) {
-        Protection::autoClearError();
-        Protection::manualClearError();
+// 计算与上一次检查之间的变化量，间隔过长（输出刚开启）时置0
+__attribute__((section(".code_in_ram"))) static inline void loadRateSignals(
+    float (&signal)[SIGNAL_NUM], ProtectionState &state, uint32_t start) {
+    float valid = (start - state.lastStart < SCP_RATE_GAP_CYCLES) ? 1.0f : 0.0f;
+    state.lastStart = start;
+
+    static constexpr ProtectionSignal source[] = {SIGNAL_VA, SIGNAL_IA_OUT,
+                                                  SIGNAL_VB, SIGNAL_IB};
+    static constexpr ProtectionSignal rate[] = {SIGNAL_DVA, SIGNAL_DIA_OUT,
+                                                SIGNAL_DVB, SIGNAL_DIB};
+    for (uint32_t i = 0; i < 4; i++) {
+        signal[rate[i]] = (signal[source[i]] - state.lastSignal[i]) * valid;
+        state.lastSignal[i] = signal[source[i]];
     }
 }
 
-void checkLowBattery() {
-    // 检测低电压保护
-    if (errorData.lowBattery) {
-        if (adcData.vA > BATTERY_LOW_RECOVERY ||
-            adcData.vA < REFEREE_UVLO_LIMIT) {
-            errorData.lowBattery = 0;
-            errorData.errorCode &= ~WARNING_LOWBATTERY;
-            if (!errorData.errorCode) errorData.errorLevel = NO_ERROR;
-        }
-    } else {
-        if (adcData.vA < BATTERY_LOW_LIMIT &&
-            adcData.vA > REFEREE_UVLO_RECOVERY) {
-            errorData.lowBatteryCnt++;
-            if (errorData.lowBatteryCnt > 1000) // 低电压持续1
-            {
-                if (errorData.errorLevel == NO_ERROR) {
-                    errorData.errorLevel = WARNING;
-                }
-                errorData.lowBattery = 1;
-                errorData.errorCode |= WARNING_LOWBATTERY;
-                errorData.lowBatteryCnt = 0;
+// 规则状态发生变化时调用，不在常规路径上
+__attribute__((section(".code_in_ram"))) static void applyRules(
+    const ProtectionRule *rules, uint32_t ruleNum, uint32_t newTrips,
+    uint32_t cleared, uint32_t newPending, const float *signal) {
+    for (uint32_t i = 0; i < ruleNum; i++) {
+        uint32_t bit = 1U << i;
+        if (newTrips & bit) {
+            if (rules[i].level != WARNING) {
+                errorData.errorVoltage = signal[rules[i].voltageSignal];
+                errorData.errorCurrent = signal[rules[i].currentSignal];
             }
+            raiseError(rules[i].errorBit, rules[i].level);
+        } else if ((cleared & bit) && rules[i].level == WARNING) {
+            EventLog::log(EVENT_ERROR_CLEAR, rules[i].errorBit, WARNING);
+            errorData.errorCode &= ~rules[i].errorBit;
+            if (!errorData.errorCode) errorData.errorLevel = NO_ERROR;
+        } else if ((newPending & bit) && rules[i].level != WARNING &&
+                   errorData.errorLevel == NO_ERROR) {
+            errorData.errorLevel = WARNING;
         }
     }
 }
 
-__attribute__((section(".code_in_ram"))) void checkShortCircuit() {
-    // 检测短路保护，在ADC解码后立刻调用
-    if (adcData.vA <= SCP_VOLTAGE && -adcData.iA >= SCP_CURRENT) {
-        // 裁判系统端或底盘端短路
-        errorData.errorLevel = WARNING;
-        errorData.shortCircuitCnt += 600;
-        if (errorData.shortCircuitCnt > 1700) {
-            HRTIM::disableOutputAB();
-            errorData.errorCode |= ERROR_SCP_A;
-            errorData.errorLevel = ERROR_RECOVER_MANUAL;
-            errorData.errorVoltage = adcData.vA;
-            errorData.errorCurrent = -adcData.iA;
-        }
+// 条件和计数全部以位运算更新，只有规则状态变化时才进入applyRules
+template <uint32_t C, uint32_t R>
+__attribute__((always_inline)) static inline void evaluate(
+    const ProtectionCondition (&conditions)[C],
+    const ProtectionRule (&rules)[R], const float (&signal)[SIGNAL_NUM],
+    ProtectionState &state) {
+    static_assert(C <= 32U, "too many protection conditions");
+    static_assert(R <= PROTECTION_MAX_RULES, "too many protection rules");
+
+    uint32_t conditionMask = 0;
+    for (uint32_t i = 0; i < C; i++) {
+        uint32_t last = (state.conditionMask >> i) & 1U;
+        uint32_t active =
+            (conditions[i].sign * signal[conditions[i].signal]) >
+            (conditions[i].sign * conditions[i].threshold -
+             conditions[i].hysteresis * last);
+        conditionMask |= active << i;
     }
-    if (adcData.vB <= SCP_VOLTAGE && adcData.iB >= SCP_CURRENT) {
-        // 电容端或无线充电端短路（无线充电端短路会通过buck上管短路B端）
-        errorData.errorLevel = WARNING;
-        errorData.shortCircuitCnt += 300;
-        // if(adcData.vB <= 0.08f)
-        //     errorData.shortCircuitCnt -= 600;
-        // else if(adcData.vB <= 0.2f)
-        //     errorData.shortCircuitCnt -= 550;
-
-        if (errorData.shortCircuitCnt > 1700) { //
-            HRTIM::disableOutputAB();
-            errorData.errorCode |= ERROR_SCP_B;
-            errorData.errorLevel = ERROR_RECOVER_MANUAL;
-            errorData.errorVoltage = psData.softStartCnt; // adcData.vB;
-            errorData.errorCurrent = adcData.iB;
-        }
+    state.conditionMask = conditionMask;
+
+    uint32_t pendingMask = 0, tripMask = 0;
+    for (uint32_t i = 0; i < R; i++) {
+        uint32_t active = (conditionMask & rules[i].conditionMask) ==
+                          rules[i].conditionMask;
+        // 规则表为常量，展开后leakStep的分支在编译时确定
+        uint32_t cnt = state.debounceCnt[i];
+        uint32_t step = rules[i].leakStep ? rules[i].leakStep : 1U;
+        uint32_t hit = M_MIN(cnt + step, rules[i].debounce);
+        uint32_t miss = rules[i].leakStep ? cnt - (cnt != 0U) : 0U;
+        cnt = active ? hit : miss;
+        uint32_t trip = cnt >= rules[i].debounce;
+        state.debounceCnt[i] = cnt;
+        tripMask |= trip << i;
+        pendingMask |= ((cnt != 0U) & (trip ^ 1U)) << i;
     }
 
-    // // [新增] 传感器故障保护：如果目标电流很大但电压极低，说明可能发生了传感器断路或严重短路
-    // if (psData.outputABEnabled && psData.iLTarget > 2.0f && adcData.vB < 1.0f) {
-    //     errorData.shortCircuitCnt += 100;
-    //     if (errorData.shortCircuitCnt > 2000) {
-    //         HRTIM::disableOutputAB();
-    //         errorData.errorCode |= ERROR_SCP_B; // 视为B端短路
-    //         errorData.errorLevel = ERROR_RECOVER_MANUAL;
-    //         errorData.errorVoltage = adcData.vB;
-    //         errorData.errorCurrent = psData.iLTarget;
-    //     }
-    // }
+    uint32_t newTrips = tripMask & ~state.tripMask;
+    uint32_t cleared = state.tripMask & ~tripMask;
+    uint32_t newPending = pendingMask & ~state.pendingMask;
+    state.tripMask = tripMask;
+    state.pendingMask = pendingMask;
+
+    // 累积计数的规则在一次成立后会计数较长时间，只在开始计数时进入applyRules设置警告
+    if (newTrips | cleared | newPending)
+        applyRules(rules, R, newTrips, cleared, newPending, signal);
+}
+
+static void resetState(ProtectionState &state) {
+    state.conditionMask = 0;
+    state.pendingMask = 0;
+    state.tripMask = 0;
+    for (uint32_t i = 0; i < PROTECTION_MAX_RULES; i++)
+        state.debounceCnt[i] = 0;
+}
+
+void initErrorCheck() {
+    // 使用DWT周期计数器统计规则表检查耗时
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
 }
 
-__attribute__((section(".code_in_ram"))) void checkEfficiency() {
-    if (adcData.iA > 0.5f)
-        psData.efficiency =
-            (adcData.vB * adcData.iB) / (adcData.vA * adcData.iA);
-    else if (adcData.iA < -0.5f)
-        psData.efficiency =
-            (adcData.vA * adcData.iA) / (adcData.vB * adcData.iB);
+__attribute__((section(".code_in_ram"))) void errorCheckHF() {
+    uint32_t start = DWT->CYCCNT;
+    float signal[SIGNAL_NUM];
+    loadSignals(signal);
+    loadRateSignals(signal, errorData.hfState, start);
+    evaluate(hfConditions, hfRules, signal, errorData.hfState);
+
+    errorData.hfState.evalCycles = DWT->CYCCNT - start;
+    errorData.hfState.maxEvalCycles =
+        M_MAX(errorData.hfState.maxEvalCycles, errorData.hfState.evalCycles);
+}
+
+void errorCheckLF() {
+    // 可能被62.5kHz中断抢占，maxEvalCycles包含被抢占的时间
+    uint32_t start = DWT->CYCCNT;
+    float signal[SIGNAL_NUM];
+    loadSignals(signal);
+    evaluate(lfConditions, lfRules, signal, errorData.lfState);
+
+    errorData.lfState.evalCycles = DWT->CYCCNT - start;
+    errorData.lfState.maxEvalCycles =
+        M_MAX(errorData.lfState.maxEvalCycles, errorData.lfState.evalCycles);
+}
+
+__attribute__((section(".code_in_ram"))) void raiseError(uint16_t errorBit,
+                                                         ErrorLevel level) {
+    EventLog::log(EVENT_ERROR, errorBit, level);
+    errorData.errorCode |= errorBit;
+    if (severity(level) > severity(errorData.errorLevel))
+        errorData.errorLevel = level;
+    if (level != WARNING) {
+        HRTIM::disableOutputAB();
+        BlackBox::trigger(errorBit);
+    }
+}
+
+void errorHandlerLF() {
+    // 没有计数中的规则且没有警告位时解除警告状态
+    if (errorData.errorLevel == WARNING &&
+        !(errorData.hfState.pendingMask || errorData.lfState.pendingMask ||
+          errorData.errorCode))
+        errorData.errorLevel = NO_ERROR;
+
+    if (adcData.vA < REFEREE_UVLO_LIMIT) {
+        if (++errorData.powerOffCnt == REFEREE_POWER_OFF_TIME)
+            EventLog::log(EVENT_REFEREE_POWER_OFF,
+                          (uint16_t)(M_MAX(adcData.vA, 0.0f) * 100.0f));
+    } else {
+        if (errorData.powerOffCnt >= REFEREE_POWER_OFF_TIME)
+            EventLog::log(EVENT_REFEREE_POWER_ON,
+                          M_MIN(errorData.powerOffCnt / 100U, 0xFFFFU));
+        errorData.powerOffCnt = 0;
+    }
+
+    if (errorData.powerOffCnt > REFEREE_POWER_OFF_TIME &&
+        errorData.errorLevel != NO_ERROR) {
+        Protection::autoClearError();
+        Protection::manualClearError();
+    }
 }
 
 void hrtimFaultHandler() // 过压/过流保护触发
 {
     if (HRTIM1->sCommonRegs.ISR & HRTIM_FLAG_FLT1) // vA过压保护触发
-    {
-        errorData.errorCode |= ERROR_OVP_A;
-        errorData.errorLevel = ERROR_RECOVER_AUTO;
-        HRTIM::disableOutputAB();
-    }
+        raiseError(ERROR_OVP_A, ERROR_RECOVER_AUTO);
     if (HRTIM1->sCommonRegs.ISR & HRTIM_FLAG_FLT2) // iA过流保护触发
-    {
-        errorData.errorCode |= ERROR_OCP_A;
-        errorData.errorLevel = ERROR_RECOVER_AUTO;
-        HRTIM::disableOutputAB();
-    }
+        raiseError(ERROR_OCP_A, ERROR_RECOVER_AUTO);
     if (HRTIM1->sCommonRegs.ISR & HRTIM_FLAG_FLT3) // iR过流保护触发
-    {
-        errorData.errorCode |= ERROR_OCP_R;
-        errorData.errorLevel = ERROR_RECOVER_AUTO;
-        HRTIM::disableOutputAB();
-    }
+        raiseError(ERROR_OCP_R, ERROR_RECOVER_AUTO);
     if (HRTIM1->sCommonRegs.ISR & HRTIM_FLAG_FLT4) // vB过压保护触发
-    {
-        errorData.errorCode |= ERROR_OVP_B;
-        errorData.errorLevel = ERROR_RECOVER_AUTO;
-        HRTIM::disableOutputAB();
-    }
+        raiseError(ERROR_OVP_B, ERROR_RECOVER_AUTO);
     if (HRTIM1->sCommonRegs.ISR & HRTIM_FLAG_FLT5) // iB过流保护触发
-    {
-        errorData.errorCode |= ERROR_OCP_B;
-        errorData.errorLevel = ERROR_RECOVER_AUTO;
-        HRTIM::disableOutputAB();
-    }
+        raiseError(ERROR_OCP_B, ERROR_RECOVER_AUTO);
 }
 
 void configAWDG() {
@@ -679,9 +823,9 @@ void checkHardwareUID() {
 
 void autoClearError() {
     if (errorData.errorLevel == ERROR_RECOVER_AUTO) {
+        EventLog::log(EVENT_ERROR_CLEAR, errorData.errorCode, ERROR_RECOVER_AUTO);
         errorData.errorCode = 0;
-        errorData.overCurrentCnt = 0;
-        errorData.overVoltageCnt = 0;
+        resetState(errorData.lfState);
         errorData.errorLevel = NO_ERROR;
         HRTIM::enableOutputAB();
     }
@@ -689,8 +833,11 @@ void autoClearError() {
 
 void manualClearError() {
     if (errorData.errorLevel == ERROR_RECOVER_MANUAL) {
+        EventLog::log(EVENT_ERROR_CLEAR, errorData.errorCode,
+                      ERROR_RECOVER_MANUAL);
         errorData.errorCode = 0;
-        errorData.shortCircuitCnt = 0;
+        resetState(errorData.hfState);
+        resetState(errorData.lfState);
 
         errorData.errorLevel = NO_ERROR;
         HRTIM::enableOutputAB();
@@ -702,14 +849,14 @@ void manualClearError() {
 namespace CAPARR {
 
 __attribute__((section(".code_in_ram"))) void updateMaxCurrent() {
-    if (adcData.vCap > CAPARR_LOW_VOLTAGE) {
-        capStatus.maxOutCurrent = CAPARR_MAX_CURRENT;
-        capStatus.maxInCurrent = CAPARR_MAX_CURRENT;
-    } else if (adcData.vCap > CAPARR_CUTOFF_VOLTAGE) {
+    if (adcData.vCap > capStatus.lowVoltage) {
+        capStatus.maxOutCurrent = thermalData.iBLimit;
+        capStatus.maxInCurrent = thermalData.iBLimit;
+    } else if (adcData.vCap > capStatus.cutoffVoltage) {
         capStatus.maxOutCurrent =
-            (CAPARR_MAX_CURRENT - 1.0f) /
-                (CAPARR_LOW_VOLTAGE - CAPARR_CUTOFF_VOLTAGE) *
-                (adcData.vCap - CAPARR_CUTOFF_VOLTAGE) +
+            (thermalData.iBLimit - 1.0f) /
+                (capStatus.lowVoltage - capStatus.cutoffVoltage) *
+                (adcData.vCap - capStatus.cutoffVoltage) +
             1.0f;
         capStatus.maxInCurrent = capStatus.maxOutCurrent;
     } else {
@@ -725,12 +872,14 @@ updateCurrentforEstimation() {
 }
 
 uint16_t getMaxPowerFeedback() {
-    if (adcData.vCap > CAPARR_LOW_VOLTAGE)
-        return (uint16_t)(CM01_CURRENT_LIMIT * adcData.vCaplf);
-    else if (adcData.vCap > CAPARR_CUTOFF_VOLTAGE)
-        return (uint16_t)((CM01_CURRENT_LIMIT - 1.0f) /
-                              (CAPARR_LOW_VOLTAGE - CAPARR_CUTOFF_VOLTAGE) *
-                              (adcData.vCaplf - CAPARR_CUTOFF_VOLTAGE) +
+    // 热降额后不再按CM01_CURRENT_LIMIT反馈
+    float iLimit = M_MIN(CM01_CURRENT_LIMIT, thermalData.iBLimit);
+    if (adcData.vCap > capStatus.lowVoltage)
+        return (uint16_t)(iLimit * adcData.vCaplf);
+    else if (adcData.vCap > capStatus.cutoffVoltage)
+        return (uint16_t)((iLimit - 1.0f) /
+                              (capStatus.lowVoltage - capStatus.cutoffVoltage) *
+                              (adcData.vCaplf - capStatus.cutoffVoltage) +
                           1.0f) *
                adcData.vCaplf;
     else
@@ -738,6 +887,49 @@ uint16_t getMaxPowerFeedback() {
                adcData.vCaplf;
 }
 
+// 估算电容组以pDemand功率(底盘侧)放电可以维持的时间，单位ms
+// 裁判系统提供pRefereeTarget，剩余部分由电容组经DCDC提供
+// 放电截止电压取capStatus.lowVoltage和电流限制对应电压中的较大值，ESR损耗按平均电压下的电流计算
+static uint16_t predictBurstDuration(float pDemand, float usableEnergyScale) {
+    float pCap = (pDemand - ctrlData.pRefereeTarget) *
+                 (1.0f / CAPARR_DISCHARGE_EFFICIENCY);
+    if (pCap <= 0.0f) return BURST_DURATION_UNLIMITED;
+
+    float vMin = M_MAX(pCap / capStatus.maxCurrent, capStatus.lowVoltage);
+    if (adcData.vCaplf <= vMin) return 0;
+
+    float vAvg = 0.5f * (adcData.vCaplf + vMin);
+    float iAvg = pCap / vAvg;
+    float energy =
+        usableEnergyScale * (adcData.vCaplf * adcData.vCaplf - vMin * vMin);
+    float duration = energy / (pCap + iAvg * iAvg * capStatus.dcr) * 1000.0f;
+
+    return (uint16_t)M_MIN(duration, (float)(BURST_DURATION_UNLIMITED - 1));
+}
+
+void updateBurstPrediction() {
+    // 0.5 * C，C为最近一次有效的容量估计
+    float usableEnergyScale = 0.5f * M_CLAMP(capStatus.capEstData.capacity,
+                                             CAPARR_CAPACITY_LT,
+                                             CAPARR_CAPACITY_HT);
+
+    capStatus.burstData.queryPower = rxData1.burstQueryPower
+                                         ? rxData1.burstQueryPower
+                                         : BURST_DEFAULT_QUERY_POWER;
+    capStatus.burstData.queryDuration =
+        predictBurstDuration(capStatus.burstData.queryPower, usableEnergyScale);
+    capStatus.burstData.maxPowerDuration = predictBurstDuration(
+        getMaxPowerFeedback() + rxData1.refereePowerLimit, usableEnergyScale);
+
+    if (adcData.vCaplf > capStatus.lowVoltage)
+        capStatus.burstData.usableEnergy =
+            usableEnergyScale *
+            (adcData.vCaplf * adcData.vCaplf -
+             capStatus.lowVoltage * capStatus.lowVoltage);
+    else
+        capStatus.burstData.usableEnergy = 0.0f;
+}
+
 void restartEstimation(const uint32_t &_currentTick) {
     capStatus.capEstData.dQ = 0.0f;
     capStatus.capEstData.lastVCap = adcData.vCaplf;
@@ -761,8 +953,11 @@ void estimateCapacity(const uint32_t &_currentTick) {
             if (capStatus.capEstData.dQtodV > CAPARR_CAPACITY_HT ||
                 capStatus.capEstData.dQtodV < CAPARR_CAPACITY_LT)
                 capStatus.warningCnt += 9;
-            else if (capStatus.warningCnt > 0)
-                capStatus.warningCnt--;
+            else {
+                capStatus.capEstData.capacity = capStatus.capEstData.dQtodV;
+                CapHealth::addCapacitySample(capStatus.capEstData.capacity);
+                if (capStatus.warningCnt > 0) capStatus.warningCnt--;
+            }
         }
         restartEstimation(_currentTick);
     } else if (M_ABS(capStatus.capEstData.dQ) > 600.0f) // 累计电荷变化超过阈值
@@ -776,8 +971,12 @@ void estimateCapacity(const uint32_t &_currentTick) {
             if (capStatus.capEstData.dVtodQ < (1.0f / CAPARR_CAPACITY_HT) ||
                 capStatus.capEstData.dVtodQ > (1.0f / CAPARR_CAPACITY_LT))
                 capStatus.warningCnt += 4;
-            else if (capStatus.warningCnt > 0)
-                capStatus.warningCnt--;
+            else {
+                capStatus.capEstData.capacity =
+                    1.0f / capStatus.capEstData.dVtodQ;
+                CapHealth::addCapacitySample(capStatus.capEstData.capacity);
+                if (capStatus.warningCnt > 0) capStatus.warningCnt--;
+            }
         }
         restartEstimation(_currentTick);
     } else if (
@@ -806,6 +1005,9 @@ HRTIM1_Master_IRQHandler(void) // 136kHz/8 sample
     // 清零中断负载检测Timer
     __HAL_TIM_SET_COUNTER(&htim16, 0);
 
+    // 在控制周期开始时一次性应用参数更新
+    Param::applyPending();
+
     // 计算ADC采样值
     ADC::updateADCmf();
 
@@ -814,9 +1016,9 @@ HRTIM1_Master_IRQHandler(void) // 136kHz/8 sample
 
         if (psData.outputABEnabled) {
 
-            Protection::checkShortCircuit();
+            Protection::errorCheckHF();
 
-    
+            LoopAnalyzer::beginMF();
 
     #ifdef CALIBRATION_MODE
 
@@ -836,11 +1038,11 @@ HRTIM1_Master_IRQHandler(void) // 136kHz/8 sample
 
     #endif
 
-    
+            LoopAnalyzer::endMF();
 
             PowerControl::setInductorCurrent();
 
-        Protection::checkEfficiency();
+        LossMap::accumulate();
 
         CAPARR::updateCurrentforEstimation();
 
@@ -854,6 +1056,11 @@ HRTIM1_Master_IRQHandler(void) // 136kHz/8 sample
 
         mfLoop.deltaIL = 0.0f;
         mfLoop.iRPID.resetError();
+        // 以当前vA作为上次输入，避免启动后第一个周期kTP项产生阶跃
+        mfLoop.vAClampPID.resetError();
+        mfLoop.vAClampPID.t1 = adcData.vA;
+        mfLoop.vAClampPID.m1 = mfLoop.vAClampVoltage;
+        analyzerData.iLApplied = 0.0f;
     }
 
 #ifdef WPT_HARDWARE
@@ -902,7 +1109,17 @@ HRTIM1_Master_IRQHandler(void) // 136kHz/8 sample
     }
 #endif
 
+    Thermal::accumulate();
+
+    BlackBox::record();
+
+    Telemetry::sample();
+
+    Supervisor::heartbeat(SUPERVISOR_TASK_MF);
+
     psData.IRQload = __HAL_TIM_GET_COUNTER(&htim16) * (1.0f / 2720.0f);
+    if (psData.IRQload > psData.IRQloadMax)
+        psData.IRQloadMax = psData.IRQload;
 
     // GPIOB->BRR = (uint32_t)GPIO_PIN_5;
 }
@@ -0,0 +1,128 @@
+#include "Storage.hpp"
+#include "PowerManager.hpp"
+#include "Supervisor.hpp"
+#include "string.h"
+
+namespace Storage {
+
+static uint32_t pageSize() {
+    return (FLASH->OPTR & FLASH_OPTR_DBANK) ? 0x800U : 0x1000U;
+}
+
+static bool inRange(uint32_t address, uint32_t size) {
+    return address >= STORAGE_BASE_ADDR && size <= STORAGE_SIZE &&
+           address - STORAGE_BASE_ADDR <= STORAGE_SIZE - size;
+}
+
+bool busy() { return psData.outputABEnabled || psData.outputEEnabled; }
+
+// 先置位flashBusy再检查输出，避免检查之后4kHz任务开启功率级
+// 功率级开启时不置位flashBusy，主循环反复重试不会打断1kHz任务中的下载
+static bool lock() {
+    if (busy()) return false;
+    sysData.flashBusy = true;
+    __DSB();
+    if (busy()) {
+        sysData.flashBusy = false;
+        return false;
+    }
+    HAL_FLASH_Unlock();
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+    return true;
+}
+
+static void unlock() {
+    HAL_FLASH_Lock();
+    sysData.flashBusy = false;
+}
+
+static bool eraseUnlocked(uint32_t address, uint32_t size) {
+    FLASH_EraseInitTypeDef eraseInit = {};
+    uint32_t pageError = 0;
+
+    eraseInit.TypeErase = FLASH_TYPEERASE_PAGES;
+    eraseInit.NbPages = 1;
+    // 逐页擦除，每页之间喂狗，擦除期间4kHz任务无法运行
+    for (uint32_t offset = 0; offset < size; offset += pageSize()) {
+        uint32_t flashOffset = address + offset - FLASH_BASE;
+        // 双Bank模式下页号从各Bank起始处计
+        if ((FLASH->OPTR & FLASH_OPTR_DBANK) && flashOffset >= FLASH_BANK_SIZE) {
+            eraseInit.Banks = FLASH_BANK_2;
+            flashOffset -= FLASH_BANK_SIZE;
+        } else {
+            eraseInit.Banks = FLASH_BANK_1;
+        }
+        eraseInit.Page = flashOffset / pageSize();
+        if (HAL_FLASHEx_Erase(&eraseInit, &pageError) != HAL_OK) return false;
+        Supervisor::refresh();
+    }
+    return true;
+}
+
+static bool programUnlocked(uint32_t address, const void *data, uint32_t size) {
+    const uint8_t *src = static_cast<const uint8_t *>(data);
+    for (uint32_t offset = 0; offset < size; offset += STORAGE_PROGRAM_UNIT) {
+        uint64_t word = 0xFFFFFFFFFFFFFFFFULL;
+        memcpy(&word, src + offset, M_MIN(size - offset, STORAGE_PROGRAM_UNIT));
+        if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, address + offset,
+                              word) != HAL_OK)
+            return false;
+    }
+    return true;
+}
+
+bool erase(uint32_t address, uint32_t size) {
+    if (!inRange(address, size) || ((address | size) & (STORAGE_ERASE_UNIT - 1)))
+        return false;
+    if (!lock()) return false;
+    bool ok = eraseUnlocked(address, size);
+    unlock();
+    return ok;
+}
+
+bool program(uint32_t address, const void *data, uint32_t size) {
+    if (!inRange(address, size) || (address & (STORAGE_PROGRAM_UNIT - 1)))
+        return false;
+    if (!lock()) return false;
+    bool ok = programUnlocked(address, data, size);
+    unlock();
+    return ok;
+}
+
+bool write(uint32_t address, const void *data, uint32_t size) {
+    uint32_t eraseSize =
+        (size + STORAGE_ERASE_UNIT - 1) & ~(STORAGE_ERASE_UNIT - 1);
+    if (!inRange(address, eraseSize) || (address & (STORAGE_ERASE_UNIT - 1)))
+        return false;
+    if (!lock()) return false;
+    bool ok = eraseUnlocked(address, eraseSize) &&
+              programUnlocked(address, data, size);
+    unlock();
+    return ok;
+}
+
+uint32_t crc32(const void *data, uint32_t size, uint32_t crc) {
+    // 4位查表，只占64字节
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4,
+        0x4DB26158, 0x5005713C, 0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+        0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+
+    crc = ~crc;
+    for (uint32_t i = 0; i < size; i++) {
+        crc ^= p[i];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+bool isBlank(const void *data, uint32_t size) {
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    for (uint32_t i = 0; i < size; i++)
+        if (p[i] != 0xFF) return false;
+    return true;
+}
+
+} // namespace Storage
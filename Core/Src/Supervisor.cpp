@@ -0,0 +1,98 @@
+#include "Supervisor.hpp"
+#include "PowerManager.hpp"
+#include "EventLog.hpp"
+
+SupervisorData supervisorData;
+
+// 放在CCM RAM中且不初始化，看门狗复位后用于判断原因
+struct SupervisorTrace
+{
+    uint32_t magic;
+    uint16_t lateMask;              // 最近一次检查时超时的任务
+    uint8_t lastSlot;               // 最近完成的1kHz时隙
+    uint8_t resv;
+};
+
+__attribute__((section(".ccmram"))) static SupervisorTrace supervisorTrace;
+
+namespace Supervisor {
+
+// 期限，单位ms（vTick），vTick只在时隙0中递增
+static constexpr uint16_t deadline[SUPERVISOR_TASK_NUM] = {
+    2U,                     // SUPERVISOR_TASK_MF
+    2U, 2U, 2U, 2U,         // SUPERVISOR_TASK_LF0 ~ LF3
+    2U,                     // SUPERVISOR_TASK_LED
+    50U,                    // SUPERVISOR_TASK_CAN_RX
+};
+
+// 超时后停止喂狗的任务
+static constexpr uint16_t criticalMask = (1U << SUPERVISOR_TASK_CAN_RX) - 1U;
+
+void init() {
+    if ((sysData.resetFlags & (RCC_CSR_IWDGRSTF >> 24)) &&
+        supervisorTrace.magic == SUPERVISOR_TRACE_MAGIC) {
+        supervisorData.resetCause =
+            supervisorTrace.lateMask
+                ? supervisorTrace.lateMask
+                : (SUPERVISOR_STALL_FLAG | supervisorTrace.lastSlot);
+        EventLog::log(EVENT_WATCHDOG_RESET, supervisorData.resetCause);
+    }
+    supervisorTrace.magic = SUPERVISOR_TRACE_MAGIC;
+    supervisorTrace.lateMask = 0;
+    supervisorTrace.lastSlot = 0;
+}
+
+void start() {
+    for (uint32_t i = 0; i < SUPERVISOR_TASK_NUM; i++)
+        supervisorData.lastBeat[i] = sysData.vTick;
+
+    // 调试器暂停内核时冻结IWDG
+    DBGMCU->APB1FZR1 |= DBGMCU_APB1FZR1_DBG_IWDG_STOP;
+
+    // LSI 32kHz / 32 = 1kHz
+    IWDG->KR = 0xCCCCU;
+    IWDG->KR = 0x5555U;
+    IWDG->PR = IWDG_PR_PR_0 | IWDG_PR_PR_1;
+    IWDG->RLR = SUPERVISOR_IWDG_TIMEOUT - 1U;
+    while (IWDG->SR) {
+    }
+    IWDG->KR = 0xAAAAU;
+    supervisorData.started = true;
+}
+
+__attribute__((section(".code_in_ram"))) void heartbeat(SupervisorTask task) {
+    supervisorData.lastBeat[task] = sysData.vTick;
+    if (task >= SUPERVISOR_TASK_LF0 && task <= SUPERVISOR_TASK_LF3)
+        supervisorTrace.lastSlot = task - SUPERVISOR_TASK_LF0;
+}
+
+void check() {
+    if (!supervisorData.started) return;
+
+    uint32_t now = sysData.vTick;
+    uint16_t lateMask = 0;
+    for (uint32_t i = 0; i < SUPERVISOR_TASK_NUM; i++) {
+        if (now - supervisorData.lastBeat[i] > deadline[i])
+            lateMask |= 1U << i;
+    }
+    // 主控板断开后不再检查CAN接收
+    if (!ctrlData.refLoop.isConnected)
+        lateMask &= ~(1U << SUPERVISOR_TASK_CAN_RX);
+
+    uint16_t newLate = lateMask & ~supervisorData.lateMask;
+    for (uint32_t i = 0; i < SUPERVISOR_TASK_NUM; i++)
+        if (newLate & (1U << i)) supervisorData.missCnt[i]++;
+    if (newLate & criticalMask)
+        EventLog::log(EVENT_DEADLINE_MISS, newLate & criticalMask);
+
+    supervisorData.lateMask = lateMask;
+    supervisorTrace.lateMask = lateMask & criticalMask;
+
+    if (!(lateMask & criticalMask)) refresh();
+}
+
+void refresh() {
+    if (supervisorData.started) IWDG->KR = 0xAAAAU;
+}
+
+} // namespace Supervisor
@@ -0,0 +1,88 @@
+#include "Telemetry.hpp"
+#include "PowerManager.hpp"
+#include "Communication.hpp"
+
+TelemetryData telemetryData;
+
+// 与黑匣子相同放在CCM RAM中，中断写入不与DMA竞争
+__attribute__((section(".ccmram"))) static TelemetryFrame telemetryFrames[TELEMETRY_QUEUE_SIZE];
+
+static_assert(sizeof(TelemetryHeader) == TELEMETRY_HEADER_SIZE, "TelemetryHeader size error");
+static_assert(sizeof(TelemetryFrame) == TELEMETRY_FRAME_SIZE, "TelemetryFrame size error");
+static_assert((TELEMETRY_QUEUE_SIZE & (TELEMETRY_QUEUE_SIZE - 1)) == 0,
+              "TELEMETRY_QUEUE_SIZE must be a power of 2");
+static_assert(TELEMETRY_CH_NUM <= 8, "channelMask is 8 bits");
+
+namespace Telemetry {
+
+// 配置在帧边界之外改变时丢弃未写满的帧
+__attribute__((section(".code_in_ram"))) static void applyConfig() {
+    telemetryData.configChanged = false;
+    telemetryData.channelMask = telemetryData.pendingMask;
+    telemetryData.decimation = telemetryData.pendingDecimation;
+    uint8_t num = 0;
+    for (uint32_t i = 0; i < TELEMETRY_CH_NUM; i++)
+        if (telemetryData.channelMask & (1U << i)) num++;
+    telemetryData.channelNum = num;
+    telemetryData.samplesPerFrame = num ? (TELEMETRY_PAYLOAD_SIZE / 2U) / num : 0;
+    telemetryData.decimationCnt = 0;
+    telemetryData.sampleIndex = 0;
+}
+
+__attribute__((section(".code_in_ram"))) void sample() {
+    if (telemetryData.configChanged) applyConfig();
+    if (!telemetryData.channelMask) return;
+    if (++telemetryData.decimationCnt < telemetryData.decimation) return;
+    telemetryData.decimationCnt = 0;
+
+    TelemetryFrame &frame = telemetryFrames[telemetryData.head];
+    int16_t *p = &frame.samples[telemetryData.sampleIndex * telemetryData.channelNum];
+    uint32_t mask = telemetryData.channelMask;
+    if (mask & (1U << TELEMETRY_CH_VA)) *p++ = (int16_t)(adcData.vA * 100.0f);
+    if (mask & (1U << TELEMETRY_CH_VB)) *p++ = (int16_t)(adcData.vB * 100.0f);
+    if (mask & (1U << TELEMETRY_CH_IA)) *p++ = (int16_t)(adcData.iA * 100.0f);
+    if (mask & (1U << TELEMETRY_CH_IB)) *p++ = (int16_t)(adcData.iB * 100.0f);
+    if (mask & (1U << TELEMETRY_CH_IR)) *p++ = (int16_t)(adcData.iR * 100.0f);
+    if (mask & (1U << TELEMETRY_CH_ILTARGET)) *p++ = (int16_t)(psData.iLTarget * 100.0f);
+    if (mask & (1U << TELEMETRY_CH_STATUS))
+        *p = (int16_t)(psData.dcdcMode | (psData.outputABEnabled << 8) |
+                       (ctrlData.limitFactor << 12));
+
+    if (++telemetryData.sampleIndex < telemetryData.samplesPerFrame) return;
+    telemetryData.sampleIndex = 0;
+
+    frame.header.seq = telemetryData.seq++;
+    frame.header.channelMask = telemetryData.channelMask;
+    frame.header.sampleNum = telemetryData.samplesPerFrame;
+    frame.header.decimation = telemetryData.decimation;
+    frame.header.dropped = telemetryData.dropped;
+
+    // 队列满时丢弃本帧，下一帧覆盖同一位置，上位机由seq的间隔得知
+    uint8_t next = (telemetryData.head + 1U) & (TELEMETRY_QUEUE_SIZE - 1U);
+    if (next == telemetryData.tail) {
+        telemetryData.dropped++;
+        return;
+    }
+    __DMB();
+    telemetryData.head = next;
+}
+
+void command(const TelemetryCmd &cmd) {
+    // 先清除标志，避免62.5kHz中断读到写了一半的配置
+    telemetryData.configChanged = false;
+    __DMB();
+    telemetryData.pendingMask = cmd.channelMask & ((1U << TELEMETRY_CH_NUM) - 1U);
+    telemetryData.pendingDecimation =
+        M_CLAMP(cmd.decimation, TELEMETRY_MIN_DECIMATION, TELEMETRY_MAX_DECIMATION);
+    __DMB();
+    telemetryData.configChanged = true;
+}
+
+void update() {
+    uint8_t tail = telemetryData.tail;
+    if (tail == telemetryData.head) return;
+    if (!CANcomm::sendTelemetry(telemetryFrames[tail])) return;
+    telemetryData.tail = (tail + 1U) & (TELEMETRY_QUEUE_SIZE - 1U);
+}
+
+} // namespace Telemetry
@@ -0,0 +1,137 @@
+#include "Thermal.hpp"
+#include "PowerManager.hpp"
+#include "math.h"
+
+ThermalData thermalData;
+
+namespace Thermal {
+
+struct ThermalStage
+{
+    float resistance;       // K/W
+    float tau;              // s
+};
+
+// 第一级为结到壳/绕组到磁芯，第二级为经PCB到环境，按实际散热条件标定
+static constexpr ThermalStage stages[THERMAL_NODE_NUM][THERMAL_STAGE_NUM] = {
+    {{1.0f, 0.05f}, {20.0f, 20.0f}},    // THERMAL_LEG_A
+    {{1.0f, 0.05f}, {20.0f, 20.0f}},    // THERMAL_LEG_B
+    {{2.0f, 2.0f}, {25.0f, 60.0f}},     // THERMAL_INDUCTOR
+};
+
+static float stageAlpha[THERMAL_NODE_NUM][THERMAL_STAGE_NUM];
+
+void init() {
+    for (uint32_t n = 0; n < THERMAL_NODE_NUM; n++) {
+        for (uint32_t s = 0; s < THERMAL_STAGE_NUM; s++)
+            stageAlpha[n][s] = 1.0f - expf(-THERMAL_DT / stages[n][s].tau);
+        thermalData.temp[n] = THERMAL_AMBIENT_TEMP;
+    }
+    psData.iLLimit = MAX_INDUCTOR_CURRENT;
+    // 上电前电容组的电流未知，从持续电流开始，预算在电流低于持续电流时积累
+    thermalData.iBBurstBudget = 0.0f;
+    thermalData.iBLimit = capStatus.maxCurrent;
+}
+
+__attribute__((section(".code_in_ram"))) void accumulate() {
+    thermalData.sampleCnt++;
+    if (!psData.outputABEnabled) return;
+
+    // BUCK时电感电流等于iB，BOOST时等于iA，中间模式取较大值
+    float iAAbs = M_ABS(adcData.iA), iBAbs = M_ABS(adcData.iB);
+    float iL;
+    switch (psData.dcdcMode) {
+    case BUCK:
+        iL = iBAbs;
+        thermalData.swASum += adcData.vA * iL;
+        break;
+    case BOOST:
+        iL = iAAbs;
+        thermalData.swBSum += adcData.vB * iL;
+        break;
+    default:
+        iL = M_MAX(iAAbs, iBAbs);
+        thermalData.swASum += adcData.vA * iL;
+        thermalData.swBSum += adcData.vB * iL;
+        break;
+    }
+    thermalData.i2Sum += iL * iL;
+    thermalData.iB2Sum += adcData.iCap * adcData.iCap;
+}
+
+// 在[t0, t1]内从v0线性过渡到v1
+static float ramp(float temp, float t0, float t1, float v0, float v1) {
+    float k = M_CLAMP((temp - t0) / (t1 - t0), 0.0f, 1.0f);
+    return v0 + (v1 - v0) * k;
+}
+
+static float derate(float temp, float burst, float continuous, float minimum) {
+    if (temp < THERMAL_DERATE_TEMP)
+        return ramp(temp, THERMAL_BURST_TEMP, THERMAL_DERATE_TEMP, burst,
+                    continuous);
+    return ramp(temp, THERMAL_DERATE_TEMP, THERMAL_MAX_TEMP, continuous,
+                minimum);
+}
+
+void update() {
+    // 与62.5kHz中断交换累加值
+    __disable_irq();
+    float i2Sum = thermalData.i2Sum, swASum = thermalData.swASum,
+          swBSum = thermalData.swBSum, iB2Sum = thermalData.iB2Sum;
+    uint32_t cnt = thermalData.sampleCnt;
+    thermalData.i2Sum = thermalData.swASum = thermalData.swBSum = 0.0f;
+    thermalData.iB2Sum = 0.0f;
+    thermalData.sampleCnt = 0;
+    __enable_irq();
+
+    float iB2 = 0.0f;
+    if (cnt) {
+        float inv = 1.0f / cnt;
+        iB2 = iB2Sum * inv;
+        float conduction = i2Sum * inv * THERMAL_MOS_RDSON;
+        thermalData.power[THERMAL_LEG_A] =
+            conduction + swASum * inv * THERMAL_SW_LOSS_COEF;
+        thermalData.power[THERMAL_LEG_B] =
+            conduction + swBSum * inv * THERMAL_SW_LOSS_COEF;
+        thermalData.power[THERMAL_INDUCTOR] =
+            i2Sum * inv * THERMAL_INDUCTOR_DCR;
+    }
+
+    thermalData.maxTemp = THERMAL_AMBIENT_TEMP;
+    for (uint32_t n = 0; n < THERMAL_NODE_NUM; n++) {
+        float temp = THERMAL_AMBIENT_TEMP;
+        for (uint32_t s = 0; s < THERMAL_STAGE_NUM; s++) {
+            float &rise = thermalData.stageRise[n][s];
+            rise += stageAlpha[n][s] *
+                    (thermalData.power[n] * stages[n][s].resistance - rise);
+            temp += rise;
+        }
+        thermalData.temp[n] = temp;
+        thermalData.maxTemp = M_MAX(thermalData.maxTemp, temp);
+    }
+
+    // MAX_INDUCTOR_CURRENT已是电感和MOS允许的最大值，没有短时余量，只在高温时降额
+    psData.iLLimit = ramp(thermalData.maxTemp, THERMAL_DERATE_TEMP,
+                          THERMAL_MAX_TEMP, MAX_INDUCTOR_CURRENT,
+                          THERMAL_IL_MIN_CURRENT);
+
+    // 电容组高于持续电流的部分消耗预算，低于时恢复
+    float continuous = capStatus.maxCurrent;
+    float budgetMax =
+        (THERMAL_IB_BURST_CURRENT * THERMAL_IB_BURST_CURRENT -
+         continuous * continuous) *
+        THERMAL_IB_BURST_TIME;
+    thermalData.iBBurstBudget =
+        M_CLAMP(thermalData.iBBurstBudget -
+                    (iB2 - continuous * continuous) * THERMAL_DT,
+                0.0f, budgetMax);
+    // PARAM_CAPARR_MAX_CURRENT最大可设为THERMAL_IB_BURST_CURRENT，此时没有冲刺余量
+    float burst = (budgetMax > 0.0f)
+                      ? ramp(thermalData.iBBurstBudget, 0.0f, 0.2f * budgetMax,
+                             continuous, THERMAL_IB_BURST_CURRENT)
+                      : continuous;
+    thermalData.iBLimit = derate(thermalData.maxTemp, burst, continuous,
+                                 THERMAL_IB_MIN_CURRENT);
+}
+
+} // namespace Thermal
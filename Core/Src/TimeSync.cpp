@@ -0,0 +1,35 @@
+#include "TimeSync.hpp"
+#include "Communication.hpp"
+#include "tim.h"
+
+TimeSyncData timeSyncData;
+
+namespace TimeSync {
+
+void init() {
+    HAL_TIM_Base_Start(&htim5);
+}
+
+void request(const TimeSyncCmd &cmd, uint32_t rxTime) {
+    timeSyncData.lastSeq = cmd.seq;
+    timeSyncData.lastRequestTick = sysData.vTick;
+    timeSyncData.timestampEnabled = cmd.enableTimestamp;
+    timeSyncData.requestCnt++;
+
+    TxTimeData td = {};
+    td.type = TIME_DATA_SYNC;
+    td.seq = cmd.seq;
+    td.time = rxTime;
+    CANcomm::sendTimeSync(td);
+}
+
+bool timestampActive() {
+    if (!timeSyncData.timestampEnabled) return false;
+    if (sysData.vTick - timeSyncData.lastRequestTick > TIMESYNC_TIMEOUT) {
+        timeSyncData.timestampEnabled = false;
+        return false;
+    }
+    return true;
+}
+
+} // namespace TimeSync
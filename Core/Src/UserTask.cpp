@@ -14,6 +14,17 @@
 #include "Communication.hpp"
 #include "Config.hpp"
 #include "Interface.hpp"
+#include "LoopAnalyzer.hpp"
+#include "BlackBox.hpp"
+#include "EventLog.hpp"
+#include "Thermal.hpp"
+#include "CapHealth.hpp"
+#include "Supervisor.hpp"
+#include "LossMap.hpp"
+#include "Telemetry.hpp"
+#include "Param.hpp"
+#include "TimeSync.hpp"
+#include "Parallel.hpp"
 
 
 // uint16_t deadTime = 50;
@@ -41,19 +52,31 @@ void tickCallback(TIM_HandleTypeDef *htim)
         {
         case 0:
             sysData.vTick++;
+            Supervisor::check();
             Buzzer::update();
             Interface::updateLEDs();
+            Supervisor::heartbeat(SUPERVISOR_TASK_LED);
             //WS2812::update();
             Protection::errorHandlerLF();
+            Supervisor::heartbeat(SUPERVISOR_TASK_LF0);
             sysData.lfLoopIndex++;
             break;
         case 1:
             if(sysData.systemInited)
             {
-                CANcomm::sendSCData();
+                CANcomm::updateBus();
+                CANcomm::processRx();
+                Parallel::update();
+                BlackBox::update();
+                EventLog::update();
+                CapHealth::update();
+                LossMap::update();
+                Param::update();
+                CANcomm::updateDiag();
                 PowerControl::checkRxDataTimeout(sysData.vTick);
                 Interface::updateButtonState();
             }
+            Supervisor::heartbeat(SUPERVISOR_TASK_LF1);
             sysData.lfLoopIndex++;
             break;
         case 2:
@@ -61,12 +84,20 @@ void tickCallback(TIM_HandleTypeDef *htim)
             {
                 CAPARR::estimateCapacity(sysData.vTick);
             }
+            if (sysData.vTick % BURST_PREDICT_PERIOD == 0)
+            {
+                CAPARR::updateBurstPrediction();
+            }
             ADC::updateADClf();
+            Thermal::update();
+            CapHealth::updateStats();
+            Supervisor::heartbeat(SUPERVISOR_TASK_LF2);
             sysData.lfLoopIndex++;
             break;
         case 3:
-            Protection::checkLowBattery();
+            Protection::errorCheckLF();
             Interface::updateBuzzerSequence();
+            LoopAnalyzer::update();
 
             #ifdef WPT_HARDWARE
             
@@ -82,12 +113,13 @@ void tickCallback(TIM_HandleTypeDef *htim)
             {
                 askData.enableASK = 0;
                 askData.lowPowerCnt = 0;
-                if(adcData.vWPT < adcData.vB + 0.5f && adcData.vCaplf > CAPARR_CUTOFF_VOLTAGE)
+                if(adcData.vWPT < adcData.vB + 0.5f && adcData.vCaplf > capStatus.cutoffVoltage)
                     askData.allowRestart = 1U; // 允许重新启动WPT
             }
             
             #endif // WPT_HARDWARE
 
+            Supervisor::heartbeat(SUPERVISOR_TASK_LF3);
             sysData.lfLoopIndex = 0;
             break;
         default:
@@ -101,6 +133,8 @@ void tickCallback(TIM_HandleTypeDef *htim)
         if(sysData.systemInited)
         {
             PowerControl::powerOnOffControl();
+            CANcomm::updateFeedback();
+            Telemetry::update();
             
             #ifdef WPT_HARDWARE
 
@@ -164,12 +198,24 @@ void tickCallback(TIM_HandleTypeDef *htim)
 
 void init()
 {
+    sysData.resetFlags = RCC->CSR >> 24;
+    __HAL_RCC_CLEAR_RESET_FLAGS();
+    EventLog::init();
+    Supervisor::init();
+    CapHealth::init();
+    Param::init();
+
     Protection::configAWDG();
+    Protection::initErrorCheck();
 
     ADC::initAnalog();
     ADC::initADC();
 
+    TimeSync::init();
     CANcomm::init();
+    LoopAnalyzer::init();
+    BlackBox::init();
+    Thermal::init();
     WS2812::init();
     Buzzer::init();
     
@@ -202,6 +248,7 @@ void init()
 
     HAL_Delay(400);
     sysData.systemInited = true;
+    Supervisor::start();
 }
 
 
@@ -210,6 +257,10 @@ static void loop()
     while (true)
     {
         HAL_Delay(1);
+        BlackBox::process();
+        EventLog::process();
+        CapHealth::process();
+        Param::process();
         //WS2812::blink(0, COLOR_BLANK);
         //WS2812::blink(1, COLOR_BLANK);
         //WS2812::blink(2, COLOR_BLANK);
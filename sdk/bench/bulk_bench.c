@@ -0,0 +1,165 @@
+// 批量解包与逐帧SuperCap_ParseRxData的对比：1000万帧合成的0x052（约2.8小时的1kHz记录），检查各列逐位相同并计时
+// 在仓库根目录执行，分别编译三种实现：
+//   gcc -O2 -std=c99 -Isdk/include sdk/bench/bulk_bench.c sdk/src/supercap_sdk.c sdk/src/supercap_bulk.c -o /tmp/bulk_sse2
+//   gcc -O2 -std=c99 -mavx2 -Isdk/include sdk/bench/bulk_bench.c sdk/src/supercap_sdk.c sdk/src/supercap_bulk.c -o /tmp/bulk_avx2
+//   gcc -O2 -std=c99 -DSUPERCAP_BULK_NO_SIMD -Isdk/include sdk/bench/bulk_bench.c sdk/src/supercap_sdk.c sdk/src/supercap_bulk.c -o /tmp/bulk_scalar
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "supercap_sdk.h"
+#include "supercap_bulk.h"
+
+#define FRAME_NUM 10000000U
+#define ROUNDS 3                        // 取最快的一次
+#define CHUNK_FRAMES 4096U              // 在缓存中的测量：反复解包同一段，排除内存带宽的影响
+
+typedef struct {
+    uint8_t *status;
+    float *chassis, *referee, *energy;
+    uint16_t *limit;
+} Columns;
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int columns_alloc(Columns *c) {
+    c->status = malloc(FRAME_NUM);
+    c->chassis = malloc(FRAME_NUM * sizeof(float));
+    c->referee = malloc(FRAME_NUM * sizeof(float));
+    c->energy = malloc(FRAME_NUM * sizeof(float));
+    c->limit = malloc(FRAME_NUM * sizeof(uint16_t));
+    return c->status && c->chassis && c->referee && c->energy && c->limit;
+}
+
+// 比赛过程的合成记录：功率随机游走，偶尔阶跃，状态字节按限制因素变化
+static void synthesize(uint8_t *frames) {
+    uint32_t seed = 1;
+    int32_t chassis = 40 * 64, referee = 60 * 64;
+    uint32_t energy = 200;
+    for (uint32_t i = 0; i < FRAME_NUM; i++) {
+        seed = seed * 1664525U + 1013904223U;
+        chassis += (int32_t)(seed >> 27) - 16;
+        if ((seed & 0xFFF) == 0) chassis = (int32_t)((seed >> 12) % 500) * 64;
+        if (chassis < -256 * 64) chassis = -256 * 64;
+        if (chassis > 767 * 64) chassis = 767 * 64;
+        referee += ((seed >> 20) & 7) - 3;
+        if ((seed & 0x3FF) == 1) energy = (seed >> 10) % 256;
+
+        uint16_t pc = (uint16_t)(chassis + 16384), pr = (uint16_t)(referee + 16384);
+        uint16_t limit = (uint16_t)(60 + energy);
+        uint8_t *d = frames + (size_t)i * 8;
+        d[0] = (uint8_t)(0xC0 | (chassis > 200 * 64 ? 0 : 2 << 2) | ((seed >> 30) == 3 ? 1 : 0));
+        d[1] = (uint8_t)pc;
+        d[2] = (uint8_t)(pc >> 8);
+        d[3] = (uint8_t)pr;
+        d[4] = (uint8_t)(pr >> 8);
+        d[5] = (uint8_t)limit;
+        d[6] = (uint8_t)(limit >> 8);
+        d[7] = (uint8_t)energy;
+    }
+}
+
+static void decode_per_frame(const uint8_t *frames, Columns *c) {
+    SuperCap_Feedback_t fb;
+    for (uint32_t i = 0; i < FRAME_NUM; i++) {
+        const uint8_t *d = frames + (size_t)i * 8;
+        SuperCap_ParseRxData(d, &fb);
+        c->status[i] = d[0];
+        c->chassis[i] = fb.chassis_power_w;
+        c->referee[i] = fb.referee_power_w;
+        c->limit[i] = fb.chassis_power_limit_w;
+        c->energy[i] = fb.cap_energy_percent;
+    }
+}
+
+static void decode_bulk(const uint8_t *frames, Columns *c) {
+    SuperCap_FeedbackColumns_t cols = {c->status, c->chassis, c->referee, c->limit, c->energy};
+    SuperCap_DecodeFeedbackBulk(frames, FRAME_NUM, &cols);
+}
+
+// 整段记录都在内存中，输入加输出每帧23字节，大块连续解包时受内存带宽限制
+static void decode_per_frame_chunk(const uint8_t *frames, Columns *c) {
+    SuperCap_Feedback_t fb;
+    for (uint32_t n = 0; n < FRAME_NUM; n += CHUNK_FRAMES) {
+        for (uint32_t i = 0; i < CHUNK_FRAMES; i++) {
+            const uint8_t *d = frames + (size_t)i * 8;
+            SuperCap_ParseRxData(d, &fb);
+            c->status[i] = d[0];
+            c->chassis[i] = fb.chassis_power_w;
+            c->referee[i] = fb.referee_power_w;
+            c->limit[i] = fb.chassis_power_limit_w;
+            c->energy[i] = fb.cap_energy_percent;
+        }
+        __asm__ volatile("" ::: "memory");
+    }
+}
+
+static void decode_bulk_chunk(const uint8_t *frames, Columns *c) {
+    SuperCap_FeedbackColumns_t cols = {c->status, c->chassis, c->referee, c->limit, c->energy};
+    for (uint32_t n = 0; n < FRAME_NUM; n += CHUNK_FRAMES) {
+        SuperCap_DecodeFeedbackBulk(frames, CHUNK_FRAMES, &cols);
+        __asm__ volatile("" ::: "memory");
+    }
+}
+
+static double best_of(void (*decode)(const uint8_t *, Columns *), const uint8_t *frames, Columns *c) {
+    double best = 1e9;
+    for (int r = 0; r < ROUNDS; r++) {
+        double start = now_s();
+        decode(frames, c);
+        double t = now_s() - start;
+        if (t < best) best = t;
+    }
+    return best;
+}
+
+int main(void) {
+    uint8_t *frames = malloc((size_t)FRAME_NUM * 8);
+    Columns ref, bulk;
+    if (!frames || !columns_alloc(&ref) || !columns_alloc(&bulk)) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    synthesize(frames);
+
+    double tRef = best_of(decode_per_frame, frames, &ref);
+    double tBulk = best_of(decode_bulk, frames, &bulk);
+    double tRefChunk = best_of(decode_per_frame_chunk, frames, &ref);
+    double tBulkChunk = best_of(decode_bulk_chunk, frames, &bulk);
+
+    decode_per_frame(frames, &ref);
+    decode_bulk(frames, &bulk);
+    int same = !memcmp(ref.status, bulk.status, FRAME_NUM) &&
+               !memcmp(ref.chassis, bulk.chassis, FRAME_NUM * sizeof(float)) &&
+               !memcmp(ref.referee, bulk.referee, FRAME_NUM * sizeof(float)) &&
+               !memcmp(ref.limit, bulk.limit, FRAME_NUM * sizeof(uint16_t)) &&
+               !memcmp(ref.energy, bulk.energy, FRAME_NUM * sizeof(float));
+
+    // 尾部不足一组的帧走逐帧实现，单独检查
+    SuperCap_FeedbackColumns_t tail = {bulk.status, bulk.chassis, bulk.referee, bulk.limit, bulk.energy};
+    SuperCap_DecodeFeedbackBulk(frames + 8, 13, &tail);
+    same = same && !memcmp(bulk.chassis, ref.chassis + 1, 13 * sizeof(float)) &&
+           !memcmp(bulk.limit, ref.limit + 1, 13 * sizeof(uint16_t));
+
+    printf("%u frames, bulk backend %s: %s\n", FRAME_NUM, SuperCap_DecodeBulkBackend(),
+           same ? "bit-exact with SuperCap_ParseRxData" : "MISMATCH");
+    printf("whole trace in memory:\n");
+    printf("  per frame SuperCap_ParseRxData  %7.1f ms  %6.2f ns/frame  %7.1f Mframe/s\n", tRef * 1e3,
+           tRef * 1e9 / FRAME_NUM, FRAME_NUM / tRef * 1e-6);
+    printf("  SuperCap_DecodeFeedbackBulk     %7.1f ms  %6.2f ns/frame  %7.1f Mframe/s  (x%.1f)\n", tBulk * 1e3,
+           tBulk * 1e9 / FRAME_NUM, FRAME_NUM / tBulk * 1e-6, tRef / tBulk);
+    printf("in cache, %u-frame chunks:\n", CHUNK_FRAMES);
+    printf("  per frame SuperCap_ParseRxData  %6.2f ns/frame  %7.1f Mframe/s\n", tRefChunk * 1e9 / FRAME_NUM,
+           FRAME_NUM / tRefChunk * 1e-6);
+    printf("  SuperCap_DecodeFeedbackBulk     %6.2f ns/frame  %7.1f Mframe/s  (x%.1f)\n", tBulkChunk * 1e9 / FRAME_NUM,
+           FRAME_NUM / tBulkChunk * 1e-6, tRefChunk / tBulkChunk);
+    return same ? 0 : 1;
+}
@@ -0,0 +1,205 @@
+// supercap_sdk.hpp与C版本的运行时对比：所有定点值逐个解包比较浮点结果的位，再测量每帧的解包时间
+// 在仓库根目录执行：
+//   gcc -O2 -std=c99 -Isdk/include -c sdk/src/supercap_sdk.c -o /tmp/supercap_sdk.o
+//   g++ -O2 -std=c++17 -Isdk/include sdk/bench/codec_bench.cpp /tmp/supercap_sdk.o -o /tmp/codec_bench && /tmp/codec_bench
+// 交叉编译到单片机上时把now_ns()换成DWT->CYCCNT即可
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "supercap_sdk.h"
+#include "supercap_sdk.hpp"
+
+namespace sc = supercap;
+
+static int failures = 0;
+
+static bool sameBits(float a, float b)
+{
+    return std::memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+static void expect(bool ok, const char *what, unsigned value)
+{
+    if (!ok && failures++ < 10) std::printf("mismatch: %s at 0x%04X\n", what, value);
+}
+
+static void checkFeedback()
+{
+    uint8_t buf[sc::frame_size] = {};
+    SuperCap_Feedback_t fb;
+    for (unsigned status = 0; status < 256; status++)
+    {
+        buf[0] = uint8_t(status);
+        SuperCap_ParseRxData(buf, &fb);
+        sc::FeedbackView v(buf);
+        expect(fb.dcdc_enabled == v.dcdc_enabled(), "dcdc_enabled", status);
+        expect(fb.wpt_status == SuperCapWPTStatus_t(v.wpt_status()), "wpt_status", status);
+        expect(fb.limit_factor == SuperCapLimitFactor_t(v.limit_factor()), "limit_factor", status);
+        expect(fb.error_flag == SuperCapErrorLevel_t(v.error_level()), "error_level", status);
+    }
+    for (unsigned raw = 0; raw < 0x10000; raw++)
+    {
+        buf[1] = buf[3] = buf[5] = uint8_t(raw);
+        buf[2] = buf[4] = buf[6] = uint8_t(raw >> 8);
+        buf[7] = uint8_t(raw);
+        SuperCap_ParseRxData(buf, &fb);
+        sc::FeedbackView v(buf);
+        expect(sameBits(fb.chassis_power_w, v.chassis_power_w()), "chassis_power_w", raw);
+        expect(sameBits(fb.referee_power_w, v.referee_power_w()), "referee_power_w", raw);
+        expect(sameBits(fb.chassis_power_w, v.chassis_power_q6() / 64.0f), "chassis_power_q6", raw);
+        expect(fb.chassis_power_limit_w == v.chassis_power_limit_w(), "chassis_power_limit_w", raw);
+        expect(sameBits(fb.cap_energy_percent, v.cap_energy_percent()), "cap_energy_percent", raw & 0xFF);
+        expect(sc::encode(v.decode()).data[3] == buf[3] && sc::encode(v.decode()).data[6] == buf[6], "encode", raw);
+    }
+}
+
+static void checkBurstAndDiag()
+{
+    uint8_t buf[sc::frame_size] = {};
+    SuperCap_BurstFeedback_t burst;
+    SuperCap_Diag_t diag = {};
+    for (unsigned raw = 0; raw < 0x10000; raw++)
+    {
+        for (size_t i = 0; i < sc::frame_size; i += 2)
+        {
+            buf[i] = uint8_t(raw);
+            buf[i + 1] = uint8_t(raw >> 8);
+        }
+        SuperCap_ParseBurstData(buf, &burst);
+        sc::BurstView b(buf);
+        expect(burst.query_power_w == b.query_power_w() && burst.query_duration_ms == b.query_duration_ms() &&
+               burst.max_power_duration_ms == b.max_power_duration_ms() && burst.usable_energy_j == b.usable_energy_j(),
+               "burst", raw);
+
+        // byte0同时是page，两页都覆盖
+        for (uint8_t page = 0; page < 2; page++)
+        {
+            buf[0] = uint8_t((raw & 0xFC) | page);
+            SuperCap_ParseDiagData(buf, &diag);
+            sc::DiagView d(buf);
+            expect(diag.limit_factor == SuperCapDiagLimitFactor_t(d.limit_factor()), "diag limit_factor", raw);
+            expect(diag.error_level == uint8_t(d.error_level()), "diag error_level", raw);
+            if (page == 0)
+            {
+                expect(diag.error_code == d.error_code() && diag.dcdc_mode == d.dcdc_mode(), "diag error_code", raw);
+                expect(sameBits(diag.error_voltage_v, d.error_voltage_v()), "diag error_voltage", raw);
+                expect(sameBits(diag.error_current_a, d.error_current_a()), "diag error_current", raw);
+            }
+            else
+            {
+                expect(sameBits(diag.irq_load, d.irq_load()), "diag irq_load", raw);
+                expect(sameBits(diag.il_target_a, d.il_target_a()), "diag il_target", raw);
+                expect(sameBits(diag.capacitance_f, d.capacitance_f()), "diag capacitance", raw);
+                expect(diag.rx_timeout_count == d.rx_timeout_count(), "diag rx_timeout", raw);
+            }
+        }
+    }
+}
+
+static void checkControl()
+{
+    SuperCap_Control_t c;
+    SuperCap_InitDefaultControl(&c);
+    uint8_t cBuf[sc::frame_size];
+    for (unsigned flags = 0; flags < 16; flags++)
+    {
+        for (unsigned raw = 0; raw < 0x10000; raw += 0x0101)
+        {
+            c.enable_dcdc = flags & 1;
+            c.system_restart = flags & 2;
+            c.clear_error = flags & 4;
+            c.enable_active_charging_limit = flags & 8;
+            c.referee_power_limit = uint16_t(raw);
+            c.referee_energy_buffer = uint16_t(~raw);
+            c.active_charging_limit_ratio = (raw & 0xFF) / 255.0f;
+            c.burst_query_power_w = uint16_t(raw * 7);
+            SuperCap_PackTxData(&c, cBuf);
+
+            sc::Control cc;
+            cc.enable_dcdc = c.enable_dcdc;
+            cc.system_restart = c.system_restart;
+            cc.clear_error = c.clear_error;
+            cc.enable_active_charging_limit = c.enable_active_charging_limit;
+            cc.referee_power_limit = c.referee_power_limit;
+            cc.referee_energy_buffer = c.referee_energy_buffer;
+            cc.active_charging_limit_ratio = sc::ratio_raw(c.active_charging_limit_ratio);
+            cc.burst_query_power_w = c.burst_query_power_w;
+            expect(std::memcmp(sc::encode(cc).data, cBuf, sc::frame_size) == 0, "control encode", (flags << 12) ^ raw);
+        }
+    }
+}
+
+// 基准测试
+
+static constexpr size_t BENCH_FRAMES = 4096;
+static constexpr int BENCH_ROUNDS = 2000;
+
+static uint8_t frames[BENCH_FRAMES][sc::frame_size];
+
+static uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template <typename F>
+static void bench(const char *name, F &&parse)
+{
+    float sink = 0.0f;
+    uint64_t start = now_ns();
+    for (int r = 0; r < BENCH_ROUNDS; r++)
+    {
+        for (size_t i = 0; i < BENCH_FRAMES; i++) sink += parse(frames[i]);
+        asm volatile("" : "+m"(frames));    // 每轮重新从内存读帧，防止整轮被提到循环外
+    }
+    double ns = double(now_ns() - start) / (double(BENCH_FRAMES) * BENCH_ROUNDS);
+    std::printf("  %-40s %6.2f ns/frame  (%g)\n", name, ns, double(sink));
+}
+
+static void runBench()
+{
+    uint32_t seed = 1;
+    for (auto &f : frames)
+    {
+        for (auto &b : f)
+        {
+            seed = seed * 1664525U + 1013904223U;
+            b = uint8_t(seed >> 24);
+        }
+    }
+
+    std::printf("0x052 decode, %zu frames x %d rounds:\n", BENCH_FRAMES, BENCH_ROUNDS);
+    bench("C SuperCap_ParseRxData", [](const uint8_t *d) {
+        SuperCap_Feedback_t fb;
+        SuperCap_ParseRxData(d, &fb);
+        return fb.chassis_power_w + fb.referee_power_w + fb.cap_energy_percent + float(fb.chassis_power_limit_w);
+    });
+    bench("C++ FeedbackView float", [](const uint8_t *d) {
+        sc::FeedbackView v(d);
+        return v.chassis_power_w() + v.referee_power_w() + v.cap_energy_percent() + float(v.chassis_power_limit_w());
+    });
+    bench("C++ FeedbackView raw (q6, no float)", [](const uint8_t *d) {
+        sc::FeedbackView v(d);
+        return float(v.chassis_power_q6() + v.referee_power_q6() + v.raw_cap_energy() + v.chassis_power_limit_w());
+    });
+    bench("C++ FeedbackView status only", [](const uint8_t *d) {
+        sc::FeedbackView v(d);
+        return float(uint8_t(v.limit_factor()) + uint8_t(v.error_level()) + v.dcdc_enabled());
+    });
+}
+
+int main()
+{
+    checkFeedback();
+    checkBurstAndDiag();
+    checkControl();
+    if (failures)
+    {
+        std::printf("%d mismatches against the C SDK\n", failures);
+        return 1;
+    }
+    std::printf("bit-exact with the C SDK: 0x052, 0x053, 0x05B decode and 0x061 encode\n");
+    runBench();
+    return 0;
+}
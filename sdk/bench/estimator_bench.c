@@ -0,0 +1,249 @@
+// supercap_estimator在不同反馈帧率下的估计误差：仿真一段比赛过程，底盘控制周期1ms，0x052按不同周期发送
+// 在仓库根目录执行：
+//   gcc -O2 -std=c99 -Isdk/include sdk/bench/estimator_bench.c sdk/src/supercap_sdk.c sdk/src/supercap_estimator.c -lm -o /tmp/estimator_bench
+//   /tmp/estimator_bench
+// 真实的底盘功率与指令功率有比例和固定的偏差（电机模型不准）并带噪声，DCDC效率、电容组容量也与SDK的默认值不同
+// 每个控制周期比较三种能量值与真实值：直接用最近一次0x052的cap_energy_percent、估计值、估计值的误差界
+// 最后几行的0x052在采样后1~5ms才到达，0x050在其后200us到达，比较使用和不使用采样时刻，
+// 默认配置的区间较宽，测量延时的影响在界内；收紧测量区间和功率误差的界后才能看出差别
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "supercap_sdk.h"
+#include "supercap_estimator.h"
+
+#define CYCLE_US 1000U                  // 底盘控制周期
+#define SUBSTEP_US 100U                 // 电容组仿真步长
+#define SIM_SECONDS 300
+#define SIM_CAPACITY 4.6f               // 与默认的4.4F不同
+#define SIM_EFFICIENCY 0.94f            // 与SUPERCAP_DISCHARGE_EFFICIENCY不同
+#define SIM_POWER_GAIN 1.06f            // 真实底盘功率 = 指令功率 × SIM_POWER_GAIN + SIM_POWER_OFFSET + 噪声
+#define SIM_POWER_OFFSET 3.0f
+#define SIM_POWER_NOISE 4.0f            // 每个仿真步长均匀分布噪声的幅值 (W)
+#define SIM_REFEREE_LIMIT 60.0f
+#define SIM_DELAY_PERIOD_US 10000U      // 延迟到达的几行使用的0x052周期
+#define SIM_MAX_DELAY_US 5000U
+#define SIM_TIME_FRAME_US 200U          // 0x050在0x052之后的时间
+#define SIM_CLOCK_OFFSET_US 123456789U  // 超级电容时钟与主控时钟的差
+
+static const uint32_t feedbackPeriodsUs[] = {1000, 2000, 5000, 10000, 20000, 50000, 100000};
+#define PERIOD_NUM (sizeof(feedbackPeriodsUs) / sizeof(feedbackPeriodsUs[0]))
+
+typedef struct {
+    unsigned samples;
+    double staleSq, estSq, boundSum;
+    float staleMax, estMax;
+    unsigned violations;                // 真实值超出误差界的控制周期数
+    uint32_t resets;
+} Stats;
+
+typedef enum {
+    DELAY_NONE,                         // 采样后立即到达
+    DELAY_NO_SAMPLE_TIME,               // 延迟到达，不使用采样时刻
+    DELAY_SAMPLE_TIME,                  // 延迟到达，0x050后调用UpdateSampleTime
+} DelayMode;
+
+static uint32_t seed = 1;
+static uint32_t delaySeed = 1;          // 与比赛过程分开，各行的比赛过程相同
+
+static float uniform(void) {
+    seed = seed * 1664525U + 1013904223U;
+    return (float)(seed >> 8) * (1.0f / 16777216.0f);
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+}
+
+// 比赛中的指令功率：怠速、巡航、冲刺、刹车回收分段随机切换，能量不足时不冲刺
+static float next_command(float energyPercent, uint32_t *segmentLeftMs, float *target) {
+    if (*segmentLeftMs == 0) {
+        float r = uniform();
+        *segmentLeftMs = 200 + (uint32_t)(uniform() * 1800.0f);
+        if (r < 0.2f)
+            *target = 15.0f;
+        else if (r < 0.6f)
+            *target = 50.0f + 30.0f * uniform();
+        else if (r < 0.85f && energyPercent > 0.4f)
+            *target = 150.0f + 100.0f * uniform();
+        else {
+            *target = -40.0f;
+            *segmentLeftMs = 100 + (uint32_t)(uniform() * 300.0f);
+        }
+    }
+    (*segmentLeftMs)--;
+    return *target + 4.0f * (uniform() - 0.5f);
+}
+
+static void encode_feedback(uint8_t *d, float chassis, float referee, float energyPercent) {
+    uint16_t pc = (uint16_t)(chassis * 64.0f + 16384.0f), pr = (uint16_t)(referee * 64.0f + 16384.0f);
+    float energy = energyPercent * 250.0f;
+    uint16_t limit = 300;
+    d[0] = 0xC0;                        // DCDC开启，新反馈格式，无错误
+    d[1] = (uint8_t)pc;
+    d[2] = (uint8_t)(pc >> 8);
+    d[3] = (uint8_t)pr;
+    d[4] = (uint8_t)(pr >> 8);
+    d[5] = (uint8_t)limit;
+    d[6] = (uint8_t)(limit >> 8);
+    d[7] = (uint8_t)(energy > 255.0f ? 255.0f : energy);   // 与固件getCapEnergy相同，截断取整
+}
+
+static void pack_time(uint8_t *d, uint8_t type, uint8_t seq, uint16_t delay, uint32_t time) {
+    d[0] = type;
+    d[1] = seq;
+    d[2] = (uint8_t)delay;
+    d[3] = (uint8_t)(delay >> 8);
+    for (int i = 0; i < 4; i++) d[4 + i] = (uint8_t)(time >> (8 * i));
+}
+
+// 时间同步在请求时刻完成，往返300us，超级电容内部处理50us
+static void sim_sync(SuperCap_TimeSync_t *sync, uint32_t t) {
+    uint8_t req[8], rsp[8];
+    SuperCap_PackTimeSyncRequest(sync, t, true, req);
+    pack_time(rsp, 0, req[0], 50U, t + 125U + SIM_CLOCK_OFFSET_US);
+    SuperCap_ParseTimeData(sync, rsp, t + 300U, NULL);
+}
+
+static void run(uint32_t periodUs, DelayMode mode, const SuperCap_EstimatorConfig_t *cfg, Stats *s) {
+    memset(s, 0, sizeof(*s));
+    seed = 1;                           // 各帧率使用相同的比赛过程
+    delaySeed = 1;
+
+    SuperCap_Estimator_t est;
+    SuperCap_Estimator_Init(&est, cfg);
+    SuperCap_TimeSync_t sync;
+    SuperCap_TimeSync_Init(&sync);
+    SuperCap_Feedback_t fb;
+    uint8_t rxFrame[8], timeFrame[8];
+    uint32_t rxAt = 0, timeAt = 0;
+    bool rxPending = false, timePending = false;
+
+    const float fullEnergy = 0.5f * SIM_CAPACITY * SUPERCAP_CAPARR_MAX_VOLTAGE * SUPERCAP_CAPARR_MAX_VOLTAGE;
+    float energyPercent = 0.9f;
+    float chassis = 0.0f, referee = 0.0f, command = 0.0f, target = 0.0f;
+    uint32_t segmentLeftMs = 0;
+    float staleEnergy = 0.0f;
+    bool haveFeedback = false;
+
+    for (uint32_t t = 0; t < SIM_SECONDS * 1000000U; t += SUBSTEP_US) {
+        // 电容组：裁判系统功率保持在限制上，电容承担差值，充满后不再充电
+        chassis = command * SIM_POWER_GAIN + SIM_POWER_OFFSET + SIM_POWER_NOISE * 2.0f * (uniform() - 0.5f);
+        referee = (energyPercent >= 1.0f && chassis < SIM_REFEREE_LIMIT) ? chassis : SIM_REFEREE_LIMIT;
+        float pCap = chassis - referee;
+        float drain = pCap > 0.0f ? pCap / SIM_EFFICIENCY : pCap * SIM_EFFICIENCY;
+        energyPercent -= drain * (SUBSTEP_US * 1e-6f) / fullEnergy;
+
+        if (t % (SUPERCAP_TIMESYNC_PERIOD_MS * 1000U) == 0) sim_sync(&sync, t);
+        if (t % periodUs == 0) {
+            encode_feedback(rxFrame, chassis, referee, energyPercent);
+            pack_time(timeFrame, 1, (uint8_t)(t / 1000U), 0, t + SIM_CLOCK_OFFSET_US);
+            rxAt = t;
+            if (mode != DELAY_NONE) {
+                delaySeed = delaySeed * 1664525U + 1013904223U;
+                rxAt += (1000U + (delaySeed >> 8) % (SIM_MAX_DELAY_US - 1000U + SUBSTEP_US)) / SUBSTEP_US * SUBSTEP_US;
+            }
+            rxPending = true;
+        }
+        if (rxPending && t == rxAt) {
+            SuperCap_ParseRxData(rxFrame, &fb);
+            SuperCap_Estimator_UpdateFeedback(&est, &fb, t);
+            staleEnergy = fb.cap_energy_percent;
+            haveFeedback = true;
+            rxPending = false;
+            timePending = mode == DELAY_SAMPLE_TIME;
+            timeAt = t + SIM_TIME_FRAME_US;
+        }
+        if (timePending && t == timeAt) {
+            SuperCap_ParseTimeData(&sync, timeFrame, t, &fb);
+            SuperCap_Estimator_UpdateSampleTime(&est, &fb);
+            timePending = false;
+        }
+
+        if (t % CYCLE_US == 0) {
+            // 收到第一帧0x052之前底盘静止
+            if (!haveFeedback) {
+                SuperCap_Estimator_Predict(&est, 0.0f, t);
+                continue;
+            }
+            command = next_command(energyPercent, &segmentLeftMs, &target);
+            SuperCap_Estimator_Predict(&est, command, t);
+
+            // 控制周期开始时各方法手中的能量值
+            float staleErr = fabsf(staleEnergy - energyPercent);
+            float estErr = fabsf(est.energy_percent - energyPercent);
+            float bound = SuperCap_Estimator_ErrorBound(&est);
+            s->samples++;
+            s->staleSq += (double)staleErr * staleErr;
+            s->estSq += (double)estErr * estErr;
+            s->boundSum += bound;
+            if (staleErr > s->staleMax) s->staleMax = staleErr;
+            if (estErr > s->estMax) s->estMax = estErr;
+            if (energyPercent < est.lower_percent || energyPercent > est.upper_percent) s->violations++;
+        }
+    }
+    s->resets = est.reset_count;
+}
+
+// 单次调用太短，连续调用后取平均
+static double time_predict(void) {
+    SuperCap_Estimator_t est;
+    SuperCap_Feedback_t fb;
+    uint8_t frame[8];
+    SuperCap_Estimator_Init(&est, NULL);
+    encode_feedback(frame, 100.0f, SIM_REFEREE_LIMIT, 0.8f);
+    SuperCap_ParseRxData(frame, &fb);
+    SuperCap_Estimator_UpdateFeedback(&est, &fb, 0);
+
+    const uint32_t calls = 10000000U;
+    uint64_t start = now_ns();
+    for (uint32_t i = 1; i <= calls; i++)
+        SuperCap_Estimator_Predict(&est, (float)(i & 255), i * 10U);
+    uint64_t elapsed = now_ns() - start;
+    __asm__ volatile("" : : "g"(&est) : "memory");
+    return (double)elapsed / calls;
+}
+
+static void print_row(const char *label, const Stats *s) {
+    const float lsb = 1.0f / 250.0f;
+    printf("  %-9s | %6.3f  %6.3f  | %6.3f  %6.3f  | %6.3f | %6.3f%% | %6u\n", label,
+           sqrt(s->staleSq / s->samples) / lsb, s->staleMax / lsb, sqrt(s->estSq / s->samples) / lsb,
+           s->estMax / lsb, s->boundSum / s->samples / lsb, 100.0 * s->violations / s->samples, s->resets);
+}
+
+int main(void) {
+    printf("%d s match, control cycle %u us, errors in units of 1/250 (one cap_energy_percent LSB)\n",
+           SIM_SECONDS, CYCLE_US);
+    printf("  feedback  | last 0x052      | estimator       | mean   | outside | resets\n");
+    printf("  period    | rms     max     | rms     max     | bound  | bound   |\n");
+    Stats s;
+    char label[16];
+    for (unsigned i = 0; i < PERIOD_NUM; i++) {
+        run(feedbackPeriodsUs[i], DELAY_NONE, NULL, &s);
+        snprintf(label, sizeof(label), "%6.1f ms", feedbackPeriodsUs[i] * 1e-3);
+        print_row(label, &s);
+    }
+
+    SuperCap_EstimatorConfig_t tight;
+    SuperCap_Estimator_InitDefaultConfig(&tight);
+    tight.measurement_margin_percent = 0.0f;
+    tight.power_error_w = 2.0f;
+    const SuperCap_EstimatorConfig_t *configs[] = {NULL, &tight};
+    for (unsigned i = 0; i < 2; i++) {
+        printf("  %.1f ms, 0x052 delayed 1-%u ms, %s:\n", SIM_DELAY_PERIOD_US * 1e-3, SIM_MAX_DELAY_US / 1000U,
+               i ? "measurement margin 0, power_error_w 2 W" : "default config");
+        run(SIM_DELAY_PERIOD_US, DELAY_NO_SAMPLE_TIME, configs[i], &s);
+        print_row("no 0x050", &s);
+        run(SIM_DELAY_PERIOD_US, DELAY_SAMPLE_TIME, configs[i], &s);
+        print_row("0x050", &s);
+    }
+    printf("SuperCap_Estimator_Predict: %.1f ns/call\n", time_predict());
+    return 0;
+}
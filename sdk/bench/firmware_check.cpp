@@ -0,0 +1,146 @@
+// 编译期检查supercap_sdk.hpp与C版本sdk、固件packed结构体的帧格式逐位一致，只需编译，不生成程序
+// 需要固件的头文件（在仓库根目录执行）：
+//   g++ -std=gnu++17 -fsyntax-only -fpermissive -w -DUSE_HAL_DRIVER -DSTM32G474xx -D__ARM_ARCH_7EM__=1 \
+//       -Isdk/include -ICore/Inc -IDrivers/STM32G4xx_HAL_Driver/Inc -IDrivers/STM32G4xx_HAL_Driver/Inc/Legacy \
+//       -IDrivers/CMSIS/Device/ST/STM32G4xx/Include -IDrivers/CMSIS/Include sdk/bench/firmware_check.cpp
+// 在主机上编译HAL会有指针宽度的警告，-fpermissive -w忽略即可，静态断言失败仍会报错
+// 固件的枚举（LimitFactor、ErrorLevel等）是全局的，sdk的类型都带上命名空间
+
+#include <cstddef>
+
+#include "supercap_sdk.h"
+#include "supercap_sdk.hpp"
+#include "Communication.hpp"
+#include "Parallel.hpp"
+
+namespace sc = supercap;
+
+// 固件结构体在内存中的字节
+template <typename T>
+constexpr sc::Frame toFrame(const T &t)
+{
+    static_assert(sizeof(T) == sc::frame_size, "frame size");
+    return __builtin_bit_cast(sc::Frame, t);
+}
+
+constexpr bool sameFrame(const sc::Frame &a, const sc::Frame &b)
+{
+    for (size_t i = 0; i < sc::frame_size; i++)
+    {
+        if (a.data[i] != b.data[i]) return false;
+    }
+    return true;
+}
+
+// C版本的常量
+static_assert(sc::receive_can_id == SUPERCAP_RECEIVE_CAN_ID && sc::burst_can_id == SUPERCAP_BURST_CAN_ID &&
+              sc::send_can_id == SUPERCAP_SEND_CAN_ID && sc::timesync_req_can_id == SUPERCAP_TIMESYNC_REQ_CAN_ID &&
+              sc::time_can_id == SUPERCAP_TIME_CAN_ID && sc::diag_can_id == SUPERCAP_DIAG_CAN_ID, "C SDK CAN ID");
+static_assert(sc::node_can_id(sc::receive_can_id, 2) == SUPERCAP_NODE_CAN_ID(SUPERCAP_RECEIVE_CAN_ID, 2), "C SDK node ID");
+static_assert(sc::burst_duration_unlimited == SUPERCAP_BURST_DURATION_UNLIMITED, "C SDK burst");
+static_assert(uint8_t(sc::ErrorLevel::unrecoverable) == SUPERCAP_ERROR_UNRECOVERABLE &&
+              uint8_t(sc::ErrorLevel::warning) == SUPERCAP_ERROR_WARNING, "C SDK error level");
+static_assert(uint8_t(sc::LimitFactor::ib_positive_or_ib_negative) == SUPERCAP_IB_POSITIVE_OR_IB_NEGATIVE,
+              "C SDK limit factor");
+static_assert(uint8_t(sc::WptStatus::finished) == SUPERCAP_WPT_FINISHED, "C SDK wpt status");
+static_assert(uint8_t(sc::DiagLimitFactor::va_clamp) == SUPERCAP_DIAG_VA_CLAMP, "C SDK diag limit factor");
+
+// 固件的常量，0x052和0x053在Communication.cpp中直接写在txHeader里，没有宏
+static_assert(sc::send_can_id == CAN_ID_COMMAND && sc::timesync_req_can_id == CAN_ID_TIMESYNC_REQ &&
+              sc::time_can_id == CAN_ID_TIME && sc::diag_can_id == CAN_ID_DIAG, "firmware CAN ID");
+static_assert(sc::node_can_id(0, 1) == PARALLEL_CAN_ID_STRIDE, "firmware node stride");
+static_assert(uint8_t(sc::WptStatus::charging) == WPT_CHARGING && uint8_t(sc::WptStatus::error) == WPT_ERROR,
+              "firmware wpt status");
+static_assert(uint8_t(sc::ErrorLevel::warning) == WARNING && uint8_t(sc::DiagLimitFactor::va_clamp) == VA_CLAMP,
+              "firmware enums");
+static_assert(uint8_t(sc::DiagPage::loop) == DIAG_PAGE_LOOP && uint8_t(sc::DiagPage::bus) == DIAG_PAGE_BUS &&
+              uint8_t(sc::DiagPage::tx) == DIAG_PAGE_TX && uint8_t(sc::TimeDataType::feedback) == TIME_DATA_FEEDBACK,
+              "firmware page");
+
+// 字节偏移
+static_assert(offsetof(RxData, refereePowerLimit) == sc::layout::control::referee_power_limit &&
+              offsetof(RxData, refereeEnergyBuffer) == sc::layout::control::referee_energy_buffer &&
+              offsetof(RxData, activeChargingLimitRatio) == sc::layout::control::active_charging_limit_ratio &&
+              offsetof(RxData, burstQueryPower) == sc::layout::control::burst_query_power, "RxData layout");
+static_assert(offsetof(TxDataNew, chassisPower) == sc::layout::feedback::chassis_power &&
+              offsetof(TxDataNew, refereePower) == sc::layout::feedback::referee_power &&
+              offsetof(TxDataNew, chassisPowerLimit) == sc::layout::feedback::chassis_power_limit &&
+              offsetof(TxDataNew, capEnergy) == sc::layout::feedback::cap_energy, "TxDataNew layout");
+static_assert(offsetof(TxBurstData, queryDuration) == sc::layout::burst::query_duration &&
+              offsetof(TxBurstData, usableEnergy) == sc::layout::burst::usable_energy, "TxBurstData layout");
+static_assert(offsetof(TxTimeData, delay) == sc::layout::time::delay && offsetof(TxTimeData, time) == sc::layout::time::time,
+              "TxTimeData layout");
+
+// 位域和小端：固件结构体的字节与编码结果逐字节比较
+constexpr RxData rxSample = {1, 0, 0, 1, 1, 1, 0x1234, 0xBEEF, 0xA5, 0x5AC3};
+constexpr sc::Control controlSample = {true, false, true, true, 0x1234, 0xBEEF, 0xA5, 0x5AC3};
+static_assert(sameFrame(toFrame(rxSample), sc::encode(controlSample)), "RxData encode");
+static_assert(sc::ControlView(toFrame(rxSample).data).referee_energy_buffer() == rxSample.refereeEnergyBuffer &&
+              sc::ControlView(toFrame(rxSample).data).burst_query_power() == rxSample.burstQueryPower &&
+              sc::ControlView(toFrame(rxSample).data).enable_active_charging_limit(), "RxData decode");
+
+constexpr RxData rxRestart = {0, 1, 0, 0, 0, 1, 37, 57, 0, 0};
+static_assert(sameFrame(toFrame(rxRestart), sc::encode(sc::Control{false, true, false, false, 37, 57, 0, 0})),
+              "RxData restart");
+
+// 状态字节按getStatusCode()的方式拼出，功率按generateTxDataNew()换算
+constexpr uint8_t statusCode = (1 << 7) | (1 << 6) | (WPT_FINISHED << 4) | (CAPARR_VOLTAGE_NORMAL << 2) | ERROR_UNRECOVERABLE;
+constexpr TxDataNew txSample = {statusCode, uint16_t(-12.5f * 64U + 16384U), uint16_t(58.25f * 64U + 16384U), 412, 251};
+static_assert(sc::FeedbackView(toFrame(txSample).data).wpt_status() == sc::WptStatus::finished &&
+              sc::FeedbackView(toFrame(txSample).data).limit_factor() == sc::LimitFactor::caparr_voltage_normal &&
+              sc::FeedbackView(toFrame(txSample).data).error_level() == sc::ErrorLevel::unrecoverable, "TxDataNew status");
+static_assert(sc::FeedbackView(toFrame(txSample).data).chassis_power_w() == -12.5f &&
+              sc::FeedbackView(toFrame(txSample).data).referee_power_q6() == 58 * 64 + 16 &&
+              sc::FeedbackView(toFrame(txSample).data).chassis_power_limit_w() == 412 &&
+              sc::FeedbackView(toFrame(txSample).data).raw_cap_energy() == 251, "TxDataNew decode");
+static_assert(sameFrame(toFrame(txSample),
+                        sc::encode(sc::FeedbackRaw{statusCode, sc::power_raw(-12.5f), sc::power_raw(58.25f), 412, 251})),
+              "TxDataNew encode");
+
+constexpr TxBurstData burstSample = {200, sc::burst_duration_unlimited, 3150, 1234};
+static_assert(sc::BurstView(toFrame(burstSample).data).query_unlimited() &&
+              sc::BurstView(toFrame(burstSample).data).max_power_duration_ms() == 3150 &&
+              sc::BurstView(toFrame(burstSample).data).usable_energy_j() == 1234, "TxBurstData");
+
+constexpr TxTimeData timeSample = {TIME_DATA_SYNC, 0x7E, 321, 0xDEADBEEF};
+static_assert(sc::TimeView(toFrame(timeSample).data).type() == sc::TimeDataType::sync &&
+              sc::TimeView(toFrame(timeSample).data).seq() == 0x7E &&
+              sc::TimeView(toFrame(timeSample).data).delay_us() == 321 &&
+              sc::TimeView(toFrame(timeSample).data).time_us() == 0xDEADBEEF, "TxTimeData");
+
+constexpr TimeSyncCmd syncSample = {0x42, 1, 0, {}};
+static_assert(sameFrame(toFrame(syncSample), sc::encode_timesync_request(0x42, true)), "TimeSyncCmd");
+
+constexpr TxDiagError diagErrorSample = {DIAG_PAGE_ERROR, IB_NEGATIVE, WARNING, 0x0804, -1234, 2345, 3};
+static_assert(sc::DiagView(toFrame(diagErrorSample).data).page() == sc::DiagPage::error &&
+              sc::DiagView(toFrame(diagErrorSample).data).limit_factor() == sc::DiagLimitFactor::ib_negative &&
+              sc::DiagView(toFrame(diagErrorSample).data).error_level() == sc::ErrorLevel::warning &&
+              sc::DiagView(toFrame(diagErrorSample).data).error_code() == 0x0804 &&
+              sc::DiagView(toFrame(diagErrorSample).data).raw_error_voltage() == -1234 &&
+              sc::DiagView(toFrame(diagErrorSample).data).raw_error_current() == 2345 &&
+              sc::DiagView(toFrame(diagErrorSample).data).dcdc_mode() == 3, "TxDiagError");
+
+constexpr TxDiagLoop diagLoopSample = {DIAG_PAGE_LOOP, VA_CLAMP, NO_ERROR, 37, -820, 4400, 17};
+static_assert(sc::DiagView(toFrame(diagLoopSample).data).page() == sc::DiagPage::loop &&
+              sc::DiagView(toFrame(diagLoopSample).data).limit_factor() == sc::DiagLimitFactor::va_clamp &&
+              sc::DiagView(toFrame(diagLoopSample).data).raw_irq_load() == 37 &&
+              sc::DiagView(toFrame(diagLoopSample).data).raw_il_target() == -820 &&
+              sc::DiagView(toFrame(diagLoopSample).data).raw_capacitance() == 4400 &&
+              sc::DiagView(toFrame(diagLoopSample).data).rx_timeout_count() == 17, "TxDiagLoop");
+
+constexpr TxDiagBus diagBusSample = {DIAG_PAGE_BUS, CAPARR_VOLTAGE_MAX, NO_ERROR, 136, 5, 3, 1, 2, 40000};
+static_assert(sc::DiagView(toFrame(diagBusSample).data).page() == sc::DiagPage::bus &&
+              sc::DiagView(toFrame(diagBusSample).data).tec() == 136 &&
+              sc::DiagView(toFrame(diagBusSample).data).rec() == 5 &&
+              sc::DiagView(toFrame(diagBusSample).data).bus_off_count() == 3 &&
+              sc::DiagView(toFrame(diagBusSample).data).error_passive_count() == 1 &&
+              sc::DiagView(toFrame(diagBusSample).data).recover_count() == 2 &&
+              sc::DiagView(toFrame(diagBusSample).data).coalesced_count() == 40000, "TxDiagBus");
+
+constexpr TxDiagTx diagTxSample = {DIAG_PAGE_TX, REFEREE_POWER, WARNING, 51234, 812, 7, 4};
+static_assert(sc::DiagView(toFrame(diagTxSample).data).page() == sc::DiagPage::tx &&
+              sc::DiagView(toFrame(diagTxSample).data).error_level() == sc::ErrorLevel::warning &&
+              sc::DiagView(toFrame(diagTxSample).data).tx_feedback_count() == 51234 &&
+              sc::DiagView(toFrame(diagTxSample).data).tx_reply_count() == 812 &&
+              sc::DiagView(toFrame(diagTxSample).data).tx_telemetry_count() == 7 &&
+              sc::DiagView(toFrame(diagTxSample).data).rejected_count() == 4, "TxDiagTx");
@@ -0,0 +1,358 @@
+// 用记录的CAN日志或仿真的比赛过程回放supercap_governor，检查功率预算和能量预测
+// 在仓库根目录执行：
+//   gcc -O2 -std=c99 -Isdk/include sdk/bench/governor_replay.c sdk/src/supercap_sdk.c sdk/src/supercap_governor.c -lm -o /tmp/governor_replay
+//   /tmp/governor_replay                      仿真：底盘按预算限幅，电容组为6F（与默认的4.4F不同，检验0x053修正）
+//   /tmp/governor_replay candump.log -l 80    回放candump格式的日志（candump -l），按日志中的0x061取裁判系统功率限制
+//   /tmp/governor_replay candump.log -n 1     并联时回放1号节点
+// 回放日志时底盘功率已经记录下来，不受预算影响，只能比较预测能量和实测能量、统计底盘功率超过预算的时间
+// 日志中有0x063和0x050时按记录的时间同步调用UpdateSampleTime
+// 仿真时检查：平时能量不低于保留值，冲刺时不低于floor_percent，Step的耗时与调用次数无关
+// 仿真的0x052延迟1~5ms到达，0x050在下一个控制周期到达，分别在使用和不使用采样时刻时比较预测能量与真实能量
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "supercap_sdk.h"
+#include "supercap_governor.h"
+
+#define CYCLE_US 1000U                  // 底盘控制周期
+#define FEEDBACK_PERIOD_US 10000U       // 0x052和0x053的周期（固件默认feedback_period为10ms）
+#define SIM_SECONDS 180
+#define SIM_CAPACITY 6.0f
+#define SIM_MAX_CURRENT 15.0f           // CAPARR_MAX_CURRENT
+#define SIM_CUTOFF_VOLTAGE 5.0f
+#define TOLERANCE_PERCENT 0.01f         // 能量量化为1/250，再留一点预测误差
+#define SIM_MAX_DELAY_CYCLES 5          // 0x052从采样到主控处理的延时，1~5个控制周期
+#define SIM_CLOCK_OFFSET_US 123456789U  // 超级电容时钟与主控时钟的差
+#define SIM_CLOCK_DRIFT 30e-6           // 超级电容时钟快30ppm
+#define SIM_SYNC_RTT_US 300U
+
+typedef struct {
+    unsigned cycles;
+    unsigned over_budget;               // 回放：底盘功率超过预算的周期数
+    unsigned below_reserve;             // 仿真：没有冲刺时能量低于保留值且仍在下降的周期数
+    unsigned below_floor;               // 仿真：能量低于floor_percent的周期数
+    unsigned predictions;
+    double prediction_error_sum;        // 新的0x052到达前的预测值与测量值之差
+    float prediction_error_max;
+    double budget_sum;
+    float budget_min, budget_max;
+    double step_ns;
+    unsigned true_samples;              // 仿真：每个周期Step之后的预测值与真实能量之差，扣除所用测量值的量化误差
+    double true_error_sum;
+    float true_error_max;
+} Stats;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+}
+
+static void stats_init(Stats *s) {
+    memset(s, 0, sizeof(*s));
+    s->budget_min = 1e9f;
+    s->budget_max = -1e9f;
+}
+
+static float timed_step(SuperCap_Governor_t *gov, uint16_t limit, bool burst, uint32_t t, Stats *s) {
+    uint64_t start = now_ns();
+    float budget = SuperCap_Governor_Step(gov, limit, burst, t);
+    s->step_ns += (double)(now_ns() - start);
+    s->cycles++;
+    s->budget_sum += budget;
+    if (budget < s->budget_min) s->budget_min = budget;
+    if (budget > s->budget_max) s->budget_max = budget;
+    return budget;
+}
+
+static void feed(SuperCap_Governor_t *gov, const SuperCap_Feedback_t *fb, uint32_t t, Stats *s) {
+    if (gov->valid) {
+        float err = fabsf(gov->predicted_percent - fb->cap_energy_percent);
+        s->prediction_error_sum += err;
+        s->predictions++;
+        if (err > s->prediction_error_max) s->prediction_error_max = err;
+    }
+    SuperCap_Governor_UpdateFeedback(gov, fb, t);
+}
+
+static void print_stats(const Stats *s, const SuperCap_Governor_t *gov) {
+    if (!s->cycles) {
+        printf("no 0x052 frames\n");
+        return;
+    }
+    printf("%u cycles, budget %.1f W mean, %.1f-%.1f W\n", s->cycles, s->budget_sum / s->cycles,
+           s->budget_min, s->budget_max);
+    if (s->predictions)
+        printf("energy prediction before each 0x052: mean error %.4f, max %.4f (1/250 = 0.004)\n",
+               s->prediction_error_sum / s->predictions, s->prediction_error_max);
+    printf("full energy estimate %.0f J (%.2f F)\n", gov->full_energy_j,
+           gov->full_energy_j / (0.5f * SUPERCAP_CAPARR_MAX_VOLTAGE * SUPERCAP_CAPARR_MAX_VOLTAGE));
+    printf("Step: %.1f ns/call\n", s->step_ns / s->cycles);
+}
+
+static int hex_to_bytes(const char *hex, uint8_t *out, int max) {
+    int n = 0;
+    while (n < max && hex[0] && hex[1]) {
+        unsigned v;
+        if (sscanf(hex, "%2x", &v) != 1) break;
+        out[n++] = (uint8_t)v;
+        hex += 2;
+    }
+    return n;
+}
+
+static int replay(const char *filename, uint16_t limit, unsigned node) {
+    FILE *f = fopen(filename, "r");
+    if (!f) {
+        perror(filename);
+        return 1;
+    }
+
+    SuperCap_Governor_t gov;
+    SuperCap_Governor_Init(&gov, NULL);
+    SuperCap_Feedback_t fb = {0};
+    SuperCap_BurstFeedback_t burst;
+    SuperCap_TimeSync_t sync;
+    SuperCap_TimeSync_Init(&sync);
+    Stats s;
+    stats_init(&s);
+
+    char line[256], iface[32], hex[64];
+    double ts, t0 = -1.0;
+    unsigned id;
+    uint32_t nextStep = 0;
+    float budget = 0.0f;
+    bool started = false;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, " (%lf) %31s %x#%63s", &ts, iface, &id, hex) != 4) continue;
+        uint8_t data[8];
+        if (hex_to_bytes(hex, data, 8) != 8) continue;
+        if (t0 < 0) t0 = ts;
+        uint32_t t = (uint32_t)((ts - t0) * 1e6);
+
+        // 两帧之间按控制周期运行
+        while (started && (int32_t)(t - nextStep) >= 0) {
+            budget = timed_step(&gov, limit, false, nextStep, &s);
+            if (fb.chassis_power_w > budget + 1.0f) s.over_budget++;
+            nextStep += CYCLE_US;
+        }
+
+        if (id == SUPERCAP_SEND_CAN_ID) {
+            limit = (uint16_t)(data[1] | (data[2] << 8));
+        } else if (id == SUPERCAP_NODE_CAN_ID(SUPERCAP_RECEIVE_CAN_ID, node)) {
+            SuperCap_ParseRxData(data, &fb);
+            feed(&gov, &fb, t, &s);
+            if (!started) nextStep = t;
+            started = true;
+        } else if (id == SUPERCAP_NODE_CAN_ID(SUPERCAP_TIMESYNC_REQ_CAN_ID, node)) {
+            // 按记录的序号重新打包，使SuperCap_ParseTimeData能匹配回复
+            uint8_t req[8];
+            sync.seq = data[0];
+            SuperCap_PackTimeSyncRequest(&sync, t, data[1] != 0, req);
+        } else if (id == SUPERCAP_NODE_CAN_ID(SUPERCAP_TIME_CAN_ID, node)) {
+            SuperCap_ParseTimeData(&sync, data, t, &fb);
+            SuperCap_Governor_UpdateSampleTime(&gov, &fb);
+        } else if (id == SUPERCAP_NODE_CAN_ID(SUPERCAP_BURST_CAN_ID, node)) {
+            SuperCap_ParseBurstData(data, &burst);
+            SuperCap_Governor_UpdateBurst(&gov, &burst);
+        }
+    }
+    fclose(f);
+
+    printf("%s: referee power limit %u W (last)\n", filename, limit);
+    print_stats(&s, &gov);
+    if (s.cycles) printf("chassis power above budget: %.1f%% of cycles\n", 100.0 * s.over_budget / s.cycles);
+    return 0;
+}
+
+// 仿真的比赛过程：需求功率分段随机，需求大时有一部分请求冲刺
+typedef struct {
+    uint32_t seed;
+    float demand;
+    bool burst;
+    uint32_t hold_us;
+} Profile;
+
+static float rnd(Profile *p) {
+    p->seed = p->seed * 1664525U + 1013904223U;
+    return (float)(p->seed >> 8) / 16777216.0f;
+}
+
+static void profile_step(Profile *p) {
+    static const float levels[] = {0.0f, 40.0f, 80.0f, 150.0f, 250.0f, 350.0f, -30.0f};
+    if (p->hold_us >= CYCLE_US) {
+        p->hold_us -= CYCLE_US;
+        return;
+    }
+    p->demand = levels[(int)(rnd(p) * 7.0f) % 7];
+    p->burst = p->demand >= 250.0f && rnd(p) < 0.3f;
+    p->hold_us = (uint32_t)((0.2f + 1.8f * rnd(p)) * 1e6f);
+}
+
+static void pack_feedback(uint8_t *d, float chassis, float referee, uint16_t powerLimit, float vCap) {
+    uint16_t pc = (uint16_t)(chassis * 64.0f + 16384.0f);
+    uint16_t pr = (uint16_t)(referee * 64.0f + 16384.0f);
+    d[0] = (1 << 7) | (1 << 6) | (SUPERCAP_WPT_ERROR << 4);
+    d[1] = (uint8_t)pc;
+    d[2] = (uint8_t)(pc >> 8);
+    d[3] = (uint8_t)pr;
+    d[4] = (uint8_t)(pr >> 8);
+    d[5] = (uint8_t)powerLimit;
+    d[6] = (uint8_t)(powerLimit >> 8);
+    d[7] = (uint8_t)(vCap * vCap / (SUPERCAP_CAPARR_MAX_VOLTAGE * SUPERCAP_CAPARR_MAX_VOLTAGE) * 250.0f);
+}
+
+// 超级电容的us计数：偏差加漂移
+static uint32_t device_time(uint32_t t) {
+    return (uint32_t)(t + SIM_CLOCK_OFFSET_US + (uint32_t)(t * SIM_CLOCK_DRIFT));
+}
+
+static void pack_time(uint8_t *d, uint8_t type, uint8_t seq, uint16_t delay, uint32_t time) {
+    d[0] = type;
+    d[1] = seq;
+    d[2] = (uint8_t)delay;
+    d[3] = (uint8_t)(delay >> 8);
+    for (int i = 0; i < 4; i++) d[4 + i] = (uint8_t)(time >> (8 * i));
+}
+
+// 时间同步请求和回复直接在请求时刻完成，往返SIM_SYNC_RTT_US，超级电容内部处理50us
+static void sim_sync(SuperCap_TimeSync_t *sync, uint32_t t) {
+    uint8_t req[8], rsp[8];
+    SuperCap_PackTimeSyncRequest(sync, t, true, req);
+    uint32_t t2 = device_time(t + (SIM_SYNC_RTT_US - 50U) / 2U);
+    pack_time(rsp, 0, req[0], 50U, t2);
+    SuperCap_ParseTimeData(sync, rsp, t + SIM_SYNC_RTT_US, NULL);
+}
+
+// sampleTime为false时不调用UpdateSampleTime，只打印预测误差用于比较
+static int simulate(uint16_t limit, bool sampleTime) {
+    SuperCap_Governor_t gov;
+    SuperCap_Governor_Init(&gov, NULL);
+    SuperCap_Feedback_t fb;
+    SuperCap_BurstFeedback_t burst;
+    SuperCap_TimeSync_t sync;
+    SuperCap_TimeSync_Init(&sync);
+    Stats s;
+    stats_init(&s);
+    Profile prof = {12345U, 0.0f, false, 0};
+    Profile delay = {777U, 0.0f, false, 0};
+
+    // 采样后延迟到达的0x052、紧随其后的0x050和0x053
+    uint8_t rxFrame[8], timeFrame[8];
+    uint16_t rxEnergy = 0;
+    uint32_t rxAt = 0;
+    float rxQuantError = 0.0f, quantError = 0.0f;
+    bool rxPending = false, timePending = false;
+
+    const float eff = SUPERCAP_DISCHARGE_EFFICIENCY;
+    float energy = 0.5f * SIM_CAPACITY * 26.0f * 26.0f;
+    float chassis = 0.0f, referee = 0.0f, minNormal = 1.0f, minBurst = 1.0f, lastPercent = 1.0f;
+    double burstEnergy = 0.0;
+    for (uint32_t t = 0; t < SIM_SECONDS * 1000000U; t += CYCLE_US) {
+        float vCap = sqrtf(2.0f * energy / SIM_CAPACITY);
+        float capMax = SIM_MAX_CURRENT * vCap * eff;
+        if (t % (SUPERCAP_TIMESYNC_PERIOD_MS * 1000U) == 0) sim_sync(&sync, t);
+        if (timePending) {
+            SuperCap_ParseTimeData(&sync, timeFrame, t, &fb);
+            if (sampleTime) SuperCap_Governor_UpdateSampleTime(&gov, &fb);
+            timePending = false;
+        }
+        if (rxPending && t == rxAt) {
+            SuperCap_ParseRxData(rxFrame, &fb);
+            SuperCap_Governor_UpdateFeedback(&gov, &fb, t);
+            burst.usable_energy_j = rxEnergy;
+            SuperCap_Governor_UpdateBurst(&gov, &burst);
+            quantError = rxQuantError;
+            rxPending = false;
+            timePending = true;
+        }
+        if (t % FEEDBACK_PERIOD_US == 0) {
+            pack_feedback(rxFrame, chassis, referee, (uint16_t)(capMax + limit), vCap);
+            pack_time(timeFrame, 1, (uint8_t)(t / 1000U), 0, device_time(t));
+            rxEnergy = (uint16_t)(0.5f * SIM_CAPACITY * (vCap * vCap - SUPERCAP_CAPARR_LOW_VOLTAGE *
+                                                                       SUPERCAP_CAPARR_LOW_VOLTAGE));
+            rxQuantError = rxFrame[7] / 250.0f - vCap * vCap / (SUPERCAP_CAPARR_MAX_VOLTAGE * SUPERCAP_CAPARR_MAX_VOLTAGE);
+            rxAt = t + CYCLE_US * (1U + (uint32_t)(rnd(&delay) * SIM_MAX_DELAY_CYCLES));
+            rxPending = true;
+        }
+
+        profile_step(&prof);
+        float budget = timed_step(&gov, limit, prof.burst, t, &s);
+        chassis = prof.demand < budget ? prof.demand : budget;
+
+        // Step预测的是本周期开始时的能量，量化误差1/250远大于测量延时的影响，扣除后再比较
+        float truePercent = vCap * vCap / (SUPERCAP_CAPARR_MAX_VOLTAGE * SUPERCAP_CAPARR_MAX_VOLTAGE);
+        if (gov.valid) {
+            float err = fabsf(gov.predicted_percent - truePercent - quantError);
+            s.true_error_sum += err;
+            s.true_samples++;
+            if (err > s.true_error_max) s.true_error_max = err;
+        }
+
+        // 裁判系统功率保持在限制附近，差值由电容组充放电，充满后只供底盘
+        bool full = vCap >= SUPERCAP_CAPARR_MAX_VOLTAGE;
+        referee = full && chassis < limit ? chassis : (float)limit;
+        float pCap = chassis - referee;
+        if (pCap > capMax) {
+            pCap = capMax;
+            chassis = referee + capMax;
+        }
+        energy -= (pCap > 0.0f ? pCap / eff : pCap * eff) * CYCLE_US * 1e-6f;
+        float cutoff = 0.5f * SIM_CAPACITY * SIM_CUTOFF_VOLTAGE * SIM_CUTOFF_VOLTAGE;
+        if (energy < cutoff) energy = cutoff;
+
+        // 按本周期结束时的能量检查
+        float percent = 2.0f * energy / SIM_CAPACITY / (SUPERCAP_CAPARR_MAX_VOLTAGE * SUPERCAP_CAPARR_MAX_VOLTAGE);
+        if (prof.burst) {
+            if (percent < minBurst) minBurst = percent;
+            if (pCap > 0.0f) burstEnergy += pCap * CYCLE_US * 1e-6;
+        } else {
+            if (percent < minNormal) minNormal = percent;
+            if (percent < gov.cfg.burst_reserve_percent - TOLERANCE_PERCENT && percent < lastPercent) s.below_reserve++;
+        }
+        if (percent < gov.cfg.floor_percent - TOLERANCE_PERCENT) s.below_floor++;
+        lastPercent = percent;
+    }
+
+    if (!sampleTime) {
+        printf("without sample time: prediction error excluding quantization: mean %.5f, max %.4f\n",
+               s.true_error_sum / s.true_samples, s.true_error_max);
+        return 0;
+    }
+    printf("simulated %d s at %u W referee limit, %.1f F bank, 0x052 delayed 1-%d ms\n", SIM_SECONDS, limit,
+           SIM_CAPACITY, SIM_MAX_DELAY_CYCLES);
+    print_stats(&s, &gov);
+    printf("time sync: %u samples, %u rejected, drift %.1f ppm\n", sync.sample_count, sync.reject_count,
+           sync.drift * 1e6f);
+    printf("with sample time: prediction error excluding quantization: mean %.5f, max %.4f\n",
+           s.true_error_sum / s.true_samples, s.true_error_max);
+    printf("min energy: %.3f without burst (reserve %.2f), %.3f in burst (floor %.2f)\n", minNormal,
+           gov.cfg.burst_reserve_percent, minBurst, gov.cfg.floor_percent);
+    printf("capacitor energy used in bursts: %.0f J\n", burstEnergy);
+    printf("cycles discharging below reserve without burst: %u, below floor: %u\n", s.below_reserve, s.below_floor);
+    return s.below_reserve || s.below_floor ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+    const char *filename = NULL;
+    uint16_t limit = 60;
+    unsigned node = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-l") && i + 1 < argc)
+            limit = (uint16_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            node = (unsigned)atoi(argv[++i]);
+        else
+            filename = argv[i];
+    }
+    if (filename) return replay(filename, limit, node);
+    int ret = simulate(limit, true);
+    simulate(limit, false);
+    return ret;
+}
@@ -0,0 +1,349 @@
+// 固件CAN接收路径的模糊测试：把Core/Src/Communication.cpp与HAL、其他模块的桩一起编译到主机上，
+// 任意帧经pushRx -> processRx -> rxDataHandler/serviceHandler处理，检查：
+//   - pushRx只接受8字节标准数据帧，扩展帧、远程帧、其他DLC直接丢弃，队列满时计入overflow
+//   - activeChargingLimitRatio换算的vCapArrNormal在[capStatus.lowVoltage, CAPARR_MAX_VOLTAGE]内，不启用时为最大值
+//   - systemRestart只在该位从0变为1时触发重启（上电后的第一帧不算），按帧顺序与模型逐一比较
+//   - 固件的RxData与supercap_sdk.hpp的ControlView解出相同的字段
+//   - 反馈帧功率的16384偏移编码与supercap_sdk.hpp一致：所有编码值往返不变，映射范围内误差小于1/64W，超出时饱和
+// 在仓库根目录执行（FLAGS为固件头文件需要的宏和路径）：
+//   FLAGS="-DUSE_HAL_DRIVER -DSTM32G474xx -D__ARM_ARCH_7EM__=1 -Isdk/include -ICore/Inc \
+//          -IDrivers/STM32G4xx_HAL_Driver/Inc -IDrivers/STM32G4xx_HAL_Driver/Inc/Legacy \
+//          -IDrivers/CMSIS/Device/ST/STM32G4xx/Include -IDrivers/CMSIS/Include"
+//   clang++ -m32 -g -O1 -std=gnu++17 -fsanitize=fuzzer,address,undefined -DPROTOCOL_FUZZ_LIBFUZZER $FLAGS \
+//       sdk/bench/protocol_fuzz.cpp -o /tmp/protocol_fuzz && /tmp/protocol_fuzz -max_total_time=60
+//   g++ -O2 -std=gnu++17 -fpermissive -w $FLAGS sdk/bench/protocol_fuzz.cpp -o /tmp/protocol_fuzz && /tmp/protocol_fuzz [帧数]
+// HAL头文件把指针转换为uint32_t，clang在64位下直接报错，用-m32与M4的指针宽度相同；gcc用-fpermissive -w忽略
+// 不用libFuzzer时main()用固定种子的随机帧运行，最后给出每秒处理的帧数；加-fsanitize=address,undefined同样可用
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+
+#include "Communication.hpp"
+#include "Interface.hpp"
+#include "LoopAnalyzer.hpp"
+#include "BlackBox.hpp"
+#include "EventLog.hpp"
+#include "CapHealth.hpp"
+#include "Supervisor.hpp"
+#include "LossMap.hpp"
+#include "Telemetry.hpp"
+#include "Param.hpp"
+#include "TimeSync.hpp"
+#include "Parallel.hpp"
+
+#include "supercap_sdk.hpp"
+
+// CMSIS的内联汇编只能在M4上运行，头文件已经包含，之后Communication.cpp中的调用改为主机上的实现
+struct SystemReset {};
+[[noreturn]] static void fuzzSystemReset() { throw SystemReset(); }
+
+#undef NVIC_SystemReset
+#define NVIC_SystemReset() fuzzSystemReset()
+#define __DMB() ((void)0)
+#define __disable_irq() ((void)0)
+#define __get_PRIMASK() 0U
+#define __set_PRIMASK(x) ((void)(x))
+#define __get_BASEPRI() 0U
+#define __set_BASEPRI(x) ((void)(x))
+#define __set_BASEPRI_MAX(x) ((void)(x))
+
+#include "../../Core/Src/Communication.cpp"
+
+namespace sc = supercap;
+
+// 其他模块的全局变量和函数，接收路径只用到其中一部分
+FDCAN_HandleTypeDef hfdcan3;
+SystemData sysData;
+PowerStageData psData;
+ControlData ctrlData;
+ErrorData errorData;
+ADCData adcData;
+CAPARRStatus capStatus;
+ParallelData parallelData;
+
+static unsigned serviceCalls, timeSyncCalls, peerCalls, restarts;
+
+// 发送不在测试范围内：TX FIFO始终没有空位，帧留在Communication.cpp自己的队列中
+extern "C"
+{
+HAL_StatusTypeDef HAL_FDCAN_ConfigFilter(FDCAN_HandleTypeDef *, const FDCAN_FilterTypeDef *) { return HAL_OK; }
+HAL_StatusTypeDef HAL_FDCAN_ConfigGlobalFilter(FDCAN_HandleTypeDef *, uint32_t, uint32_t, uint32_t, uint32_t)
+{
+    return HAL_OK;
+}
+HAL_StatusTypeDef HAL_FDCAN_ActivateNotification(FDCAN_HandleTypeDef *, uint32_t, uint32_t) { return HAL_OK; }
+HAL_StatusTypeDef HAL_FDCAN_Start(FDCAN_HandleTypeDef *) { return HAL_OK; }
+HAL_StatusTypeDef HAL_FDCAN_AddMessageToTxFifoQ(FDCAN_HandleTypeDef *, const FDCAN_TxHeaderTypeDef *, const uint8_t *)
+{
+    return HAL_ERROR;
+}
+uint32_t HAL_FDCAN_GetTxFifoFreeLevel(const FDCAN_HandleTypeDef *) { return 0; }
+HAL_StatusTypeDef HAL_FDCAN_GetRxMessage(FDCAN_HandleTypeDef *, uint32_t, FDCAN_RxHeaderTypeDef *, uint8_t *)
+{
+    return HAL_ERROR;
+}
+void HAL_FDCAN_IRQHandler(FDCAN_HandleTypeDef *) {}
+}
+
+namespace HRTIM { void disableOutputAB() { psData.outputABEnabled = 0; } }
+namespace CAPARR { uint16_t getMaxPowerFeedback() { return 0; } }
+namespace Protection { void autoClearError() {} void manualClearError() {} }
+namespace PowerControl { void updateRefereePower(const RxData &, const uint32_t &) {} }
+namespace Supervisor { void heartbeat(SupervisorTask) {} }
+namespace EventLog
+{
+void log(EventType, uint16_t, uint8_t) {}
+void command(const EventLogCmd &) { serviceCalls++; }
+}
+namespace Interface { void flashLED(uint8_t, uint32_t, uint32_t) {} }
+namespace LoopAnalyzer { void start(const BodeCmd &) { serviceCalls++; } }
+namespace BlackBox { void command(const BlackBoxCmd &) { serviceCalls++; } }
+namespace CapHealth { void command(const HealthCmd &) { serviceCalls++; } }
+namespace LossMap { void command(const LossMapCmd &) { serviceCalls++; } }
+namespace Telemetry { void command(const TelemetryCmd &) { serviceCalls++; } }
+namespace Param { void command(const ParamCmd &) { serviceCalls++; } }
+namespace TimeSync
+{
+bool timestampActive() { return false; }
+void request(const TimeSyncCmd &, uint32_t) { timeSyncCalls++; }
+}
+namespace Parallel
+{
+void receive(uint8_t node, const TxPeerData &, uint32_t)
+{
+    if (node >= PARALLEL_MAX_NODES) std::abort();
+    peerCalls++;
+}
+}
+
+#define FUZZ_RECORD_SIZE 11U    // byte0：bit1-0 ID类型（3为扩展帧），bit2 远程帧，bit3 使用常见ID，bit7-4 DLC
+                                // byte1-2：ID，byte2的bit7-5都为1时之后调用processRx，byte3-10：数据
+
+static const uint16_t commonIds[8] = {CAN_ID_COMMAND, CAN_ID_SERVICE, CAN_ID_TIMESYNC_REQ, CAN_ID_PEER,
+                                      CAN_ID_PEER + PARALLEL_MAX_NODES - 1, CAN_ID_PEER + PARALLEL_MAX_NODES,
+                                      CAN_ID_COMMAND + PARALLEL_CAN_ID_STRIDE, 0x052};
+
+struct Frame
+{
+    uint16_t id;
+    uint8_t data[8];
+};
+
+// 模型：队列中尚未处理的帧和重启是否已准备好，与固件独立计算
+static std::deque<Frame> pending;
+static bool modelArmed;
+static uint32_t accepted, dropped, overflowed;
+
+static void check(bool ok, const char *what)
+{
+    if (ok) return;
+    std::fprintf(stderr, "protocol_fuzz: %s\n", what);
+    std::abort();
+}
+
+// 上电：清空接收队列，重启需重新准备
+static void boot(float lowVoltage)
+{
+    canRxQueue.head = canRxQueue.tail = 0;
+    canRxQueue.overflow = canRxQueue.overflowLogged = 0;
+    CANcomm::restartArmed = false;
+    ctrlData.vCapArrNormal = CAPARR_MAX_VOLTAGE;
+    capStatus.lowVoltage = lowVoltage;
+    parallelData.canIdOffset = 0;
+    pending.clear();
+    modelArmed = false;
+}
+
+static void checkControl(const Frame &f)
+{
+    RxData rd;
+    std::memcpy(&rd, f.data, sizeof(rd));
+    sc::Control c = sc::ControlView(f.data).decode();
+    check(c.enable_dcdc == bool(rd.enableDCDC) && c.system_restart == bool(rd.systemRestart) &&
+          c.clear_error == bool(rd.clearError) &&
+          c.enable_active_charging_limit == bool(rd.enableActiveChargingLimit) &&
+          c.referee_power_limit == rd.refereePowerLimit && c.referee_energy_buffer == rd.refereeEnergyBuffer &&
+          c.active_charging_limit_ratio == rd.activeChargingLimitRatio &&
+          c.burst_query_power_w == rd.burstQueryPower, "RxData differs from ControlView");
+}
+
+// processRx之后比较最后一帧0x061的结果，期间应当重启时SystemReset从processRx中抛出
+static void process()
+{
+    bool restartExpected = false;
+    const Frame *last = nullptr;
+    for (const Frame &f : pending)
+    {
+        if (f.id != CAN_ID_COMMAND) continue;
+        checkControl(f);
+        bool request = f.data[0] & sc::layout::control::system_restart;
+        last = &f;
+        if (request && modelArmed)
+        {
+            restartExpected = true;
+            break;
+        }
+        modelArmed = !request;
+    }
+
+    try
+    {
+        CANcomm::processRx();
+    }
+    catch (const SystemReset &)
+    {
+        check(restartExpected, "systemRestart fired without a 0 -> 1 edge");
+        restarts++;
+        boot(capStatus.lowVoltage);
+        return;
+    }
+    check(!restartExpected, "systemRestart request ignored");
+    check(canRxQueue.tail == canRxQueue.head, "processRx left frames in the queue");
+    pending.clear();
+
+    if (last)
+    {
+        float v = ctrlData.vCapArrNormal;
+        check(v >= capStatus.lowVoltage && v <= CAPARR_MAX_VOLTAGE, "vCapArrNormal out of range");
+        if (!(last->data[0] & sc::layout::control::enable_active_charging_limit))
+            check(v == CAPARR_MAX_VOLTAGE, "vCapArrNormal limited without enableActiveChargingLimit");
+    }
+}
+
+static void push(const uint8_t *rec)
+{
+    FDCAN_RxHeaderTypeDef header = {};
+    bool extended = (rec[0] & 0x03) == 0x03;
+    bool remote = rec[0] & 0x04;
+    uint32_t id = rec[1] | (uint32_t(rec[2]) << 8);
+    header.IdType = extended ? FDCAN_EXTENDED_ID : FDCAN_STANDARD_ID;
+    header.RxFrameType = remote ? FDCAN_REMOTE_FRAME : FDCAN_DATA_FRAME;
+    header.DataLength = rec[0] >> 4;
+    header.Identifier = extended ? id << 13 : (rec[0] & 0x08) ? commonIds[id & 7U] : id & 0x7FFU;
+
+    Frame f;
+    f.id = uint16_t(header.Identifier);
+    std::memcpy(f.data, rec + 3, 8);
+
+    uint8_t head = canRxQueue.head;
+    uint16_t overflow = canRxQueue.overflow;
+    CANcomm::pushRx(header, f.data, sysData.vTick);
+
+    if (extended || remote || header.DataLength != FDCAN_DLC_BYTES_8)
+    {
+        check(canRxQueue.head == head && canRxQueue.overflow == overflow, "bad frame queued");
+        dropped++;
+    }
+    else if (pending.size() == CAN_RX_QUEUE_SIZE - 1U)
+    {
+        check(canRxQueue.head == head && canRxQueue.overflow == uint16_t(overflow + 1U), "overflow not counted");
+        overflowed++;
+    }
+    else
+    {
+        check(canRxQueue.head != head, "frame not queued");
+        pending.push_back(f);
+        accepted++;
+    }
+}
+
+// 固件的encodePower与supercap_sdk.hpp的power_raw/power_w
+static void checkPower(float w)
+{
+    uint16_t raw = CANcomm::encodePower(w);
+    float decoded = sc::power_w(raw);
+    if (w >= -256.0f && w < 768.0f)
+    {
+        check(raw == sc::power_raw(w), "encodePower differs from power_raw");
+        check(decoded <= w && w - decoded < 1.0f / 64.0f, "power round trip error");
+    }
+    else
+        check(raw == (w < 0.0f ? 0U : 0xFFFFU), "encodePower not saturated");
+}
+
+static void checkPowerCodes()
+{
+    for (uint32_t raw = 0; raw <= 0xFFFFU; raw++)
+        check(CANcomm::encodePower(sc::power_w(uint16_t(raw))) == raw, "power code round trip");
+}
+
+// 一次输入：byte0决定capStatus.lowVoltage，之后每FUZZ_RECORD_SIZE字节一帧，
+// 数据的前3字节同时作为功率（有符号，1/256W）检查编码；两次processRx之间超过15帧时队列溢出
+static void runInput(const uint8_t *data, size_t size)
+{
+    if (size < 1) return;
+    boot(CAPARR_LOW_VOLTAGE + (CAPARR_MAX_VOLTAGE - CAPARR_LOW_VOLTAGE) * data[0] / 255.0f);
+    data++;
+    size--;
+
+    for (; size >= FUZZ_RECORD_SIZE; data += FUZZ_RECORD_SIZE, size -= FUZZ_RECORD_SIZE)
+    {
+        int32_t q = int32_t(uint32_t(data[3]) << 24 | uint32_t(data[4]) << 16 | uint32_t(data[5]) << 8) >> 8;
+        checkPower(q / 256.0f);
+
+        push(data);
+        if ((data[2] & 0xE0) == 0xE0)
+            process();
+        sysData.vTick++;
+    }
+    process();
+}
+
+#ifdef PROTOCOL_FUZZ_LIBFUZZER
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    static bool codesChecked = false;
+    if (!codesChecked)
+    {
+        checkPowerCodes();
+        codesChecked = true;
+    }
+    runInput(data, size);
+    return 0;
+}
+
+#else
+
+static uint32_t seed = 1;
+
+static uint8_t randomByte()
+{
+    seed = seed * 1664525U + 1013904223U;
+    return uint8_t(seed >> 24);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t frames = argc > 1 ? uint32_t(std::strtoul(argv[1], nullptr, 0)) : 10000000U;
+    checkPowerCodes();
+
+    // 每个输入64帧，0x061的标志位偏向重启和充电限制，使边沿和钳位经常出现
+    const uint32_t framesPerInput = 64;
+    uint8_t input[1 + framesPerInput * FUZZ_RECORD_SIZE];
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t done = 0; done < frames; done += framesPerInput)
+    {
+        for (uint8_t &b : input) b = randomByte();
+        for (uint32_t i = 0; i < framesPerInput; i++)
+        {
+            uint8_t *rec = input + 1 + i * FUZZ_RECORD_SIZE;
+            if (rec[0] & 0x08) rec[0] = (rec[0] & 0x0F) | 0x80;         // 常见ID多用8字节，否则都被丢弃
+        }
+        runInput(input, sizeof(input));
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint32_t total = accepted + dropped + overflowed;
+    std::printf("%u frames: %u queued, %u dropped (bad id type / rtr / dlc), %u queue overflow\n",
+                total, accepted, dropped, overflowed);
+    std::printf("service %u, timesync %u, peer %u, restarts %u\n", serviceCalls, timeSyncCalls, peerCalls, restarts);
+    std::printf("%.2f M frames/s\n", total / seconds * 1e-6);
+    return 0;
+}
+
+#endif
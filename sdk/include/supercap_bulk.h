@@ -0,0 +1,35 @@
+#ifndef SUPERCAP_BULK_H
+#define SUPERCAP_BULK_H
+
+#include <stddef.h>
+#include "supercap_sdk.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 批量解包：赛后分析记录的CAN数据时使用，一次解包连续存放的多帧，结果按列（每个字段一个数组）输出
+// 结果与逐帧调用SuperCap_ParseRxData逐位相同
+// 编译时按目标指令集选择实现：定义了__AVX2__时每次8帧，__SSE2__时每次4帧（x86-64默认），其余为逐帧
+// 主机上用-mavx2或-march=native编译即可使用AVX2；定义SUPERCAP_BULK_NO_SIMD强制使用逐帧实现
+
+// 0x052的各列，不需要的列设为NULL
+typedef struct {
+    uint8_t* status;                    // 原始状态字节，位定义见SuperCap_ParseRxData
+    float* chassis_power_w;
+    float* referee_power_w;
+    uint16_t* chassis_power_limit_w;
+    float* cap_energy_percent;
+} SuperCap_FeedbackColumns_t;
+
+// frames为count帧0x052的数据，每帧8字节连续存放，输出的每列至少count个元素
+void SuperCap_DecodeFeedbackBulk(const uint8_t* frames, size_t count, const SuperCap_FeedbackColumns_t* columns);
+
+// 当前使用的实现："avx2"、"sse2"或"scalar"
+const char* SuperCap_DecodeBulkBackend(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SUPERCAP_BULK_H
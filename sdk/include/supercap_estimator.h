@@ -0,0 +1,92 @@
+#ifndef SUPERCAP_ESTIMATOR_H
+#define SUPERCAP_ESTIMATOR_H
+
+#include "supercap_sdk.h"
+#include "supercap_governor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 反馈帧之间的电容能量估计：底盘控制周期比0x052快，cap_energy_percent又只有1/250的分辨率
+// 每个控制周期用底盘自己的指令功率（电机功率模型的输出）向前积分，收到0x052时修正：
+// - 固件的capEnergy为截断取整，一帧0x052说明真实值在[n/250, (n+1)/250)内
+// - 估计值带一个区间，预测时按功率误差的界放宽，收到0x052时与测量区间取交集，分辨率可以远高于1/250
+// - 修正只把估计值移入新区间再向区间中点靠近，不会整步跳到测量值，估计值是连续变化的
+// - 指令功率与0x052中底盘功率之差滤波后作为偏差补偿到预测中
+// 所有函数都是O(1)，不分配内存，可以在控制中断里调用
+
+typedef struct {
+    float capacity_f;                   // 电容组容量的初值 (F)，收到0x053后按usable_energy_j修正
+    float power_error_w;                // 补偿偏差后底盘功率与指令功率之差的界 (W)，
+    float power_error_ratio;            // 加上|电容功率|的这个比例（DCDC效率和容量的误差）
+    float bias_tau_s;                   // 功率偏差一阶滤波的时间常数 (s)
+    float measurement_margin_percent;   // 测量区间两边放宽的量，覆盖采样噪声
+    float correction_gain;              // 修正时估计值向区间中点靠近的比例 (0-1)
+} SuperCap_EstimatorConfig_t;
+
+// 估计值和区间的快照
+typedef struct {
+    float energy_percent;
+    float lower_percent;
+    float upper_percent;
+} SuperCap_EstimatorState_t;
+
+typedef struct {
+    SuperCap_EstimatorConfig_t cfg;
+
+    bool valid;                         // 收到过0x052
+    bool dcdc_enabled;                  // DCDC关闭时电容不充放电
+    uint32_t time_us;                   // 估计值对应的时刻
+    uint32_t feedback_us;               // 最近一次0x052的时刻
+    float full_energy_j;                // cap_energy_percent为1时的能量
+    float command_power_w;              // 最近一次Predict的指令功率
+    float referee_power_w;              // 最近一次0x052的裁判系统功率
+    float power_bias_w;                 // 0x052中底盘功率减去指令功率，滤波后
+
+    float energy_percent;               // 估计的cap_energy_percent
+    float lower_percent;                // 真实值所在的区间
+    float upper_percent;
+    uint32_t reset_count;               // 测量与预测区间不相交、重置为测量值的次数
+
+    // 最近一次0x052在feedback_us时刻修正前后的状态，UpdateSampleTime按采样时刻重新修正
+    bool sample_pending;                // 还没有收到这帧0x052的采样时刻
+    bool prior_valid;                   // 修正前已有估计值
+    int measured_raw;                   // cap_energy_percent × 250
+    uint32_t prior_reset_count;
+    SuperCap_EstimatorState_t prior;
+    SuperCap_EstimatorState_t corrected;
+} SuperCap_Estimator_t;
+
+void SuperCap_Estimator_InitDefaultConfig(SuperCap_EstimatorConfig_t* config);
+
+// config为NULL时使用默认值
+void SuperCap_Estimator_Init(SuperCap_Estimator_t* est, const SuperCap_EstimatorConfig_t* config);
+
+// 每个控制周期调用一次，command_power_w为这个周期底盘电机的指令功率 (W)，now_us与时间同步使用同一个us时钟
+void SuperCap_Estimator_Predict(SuperCap_Estimator_t* est, float command_power_w, uint32_t now_us);
+
+// 每次SuperCap_ParseRxData之后调用，now_us为接收时刻，先按测量值就是接收时刻的能量修正
+void SuperCap_Estimator_UpdateFeedback(SuperCap_Estimator_t* est, const SuperCap_Feedback_t* feedback, uint32_t now_us);
+
+// 可选，开启时间戳时在0x050的SuperCap_ParseTimeData之后调用，与SuperCap_Governor_UpdateSampleTime相同
+// 把测量区间从采样时刻推到接收时刻后重新修正，此后Predict的积分保留
+void SuperCap_Estimator_UpdateSampleTime(SuperCap_Estimator_t* est, const SuperCap_Feedback_t* feedback);
+
+// 可选，每次SuperCap_ParseBurstData之后调用，用usable_energy_j修正电容组的总能量
+void SuperCap_Estimator_UpdateBurst(SuperCap_Estimator_t* est, const SuperCap_BurstFeedback_t* burst);
+
+// 估计误差的界（cap_energy_percent），估计值到区间两端的较大距离
+float SuperCap_Estimator_ErrorBound(const SuperCap_Estimator_t* est);
+
+// 放电到SUPERCAP_CAPARR_LOW_VOLTAGE可用的能量 (J)，error_j不为NULL时写入误差的界
+float SuperCap_Estimator_UsableEnergy(const SuperCap_Estimator_t* est, float* error_j);
+
+// 当前底盘功率的估计 (W)，指令功率加偏差
+float SuperCap_Estimator_ChassisPower(const SuperCap_Estimator_t* est);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SUPERCAP_ESTIMATOR_H
@@ -0,0 +1,80 @@
+#ifndef SUPERCAP_GOVERNOR_H
+#define SUPERCAP_GOVERNOR_H
+
+#include "supercap_sdk.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 底盘功率分配：由0x052/0x053反馈算出每个控制周期底盘电机可用的功率
+// 反馈帧之间按滤波后的底盘功率和裁判系统功率向前预测电容能量，按冲刺保留策略给出功率预算：
+// - 平时保留burst_reserve_percent的能量，高于保留值的部分在horizon_s内用完
+// - 冲刺（burst为true）时可以用到floor_percent
+// - 低于保留值时预算低于裁判系统功率限制，让出最多recharge_power_w给电容充电
+// - 反馈超时、DCDC关闭或有错误时，预算为裁判系统功率限制 × fallback_ratio
+// 所有函数都是O(1)，不分配内存，可以在控制中断里调用
+
+// 与固件Config.hpp相同：cap_energy_percent = (vCap/CAPARR_MAX_VOLTAGE)^2，usable_energy_j放电到CAPARR_LOW_VOLTAGE
+#define SUPERCAP_CAPARR_MAX_VOLTAGE 28.8f
+#define SUPERCAP_CAPARR_LOW_VOLTAGE 10.0f
+#define SUPERCAP_CAPARR_DEFAULT_CAPACITY 4.4f
+#define SUPERCAP_DISCHARGE_EFFICIENCY 0.92f
+
+typedef struct {
+    float power_filter_tau_s;           // 功率一阶滤波的时间常数 (s)
+    float horizon_s;                    // 高于保留值的能量在这段时间内用完 (s)
+    float burst_reserve_percent;        // 平时保留给冲刺的能量（cap_energy_percent）
+    float floor_percent;                // 冲刺时也不使用的能量，需高于(CAPARR_LOW_VOLTAGE/CAPARR_MAX_VOLTAGE)^2
+    float recharge_power_w;             // 低于保留值时最多让出的充电功率 (W)
+    float capacity_f;                   // 电容组容量的初值 (F)，收到0x053后按usable_energy_j修正
+    float fallback_ratio;               // 电容不可用时使用的裁判系统功率限制比例
+    uint32_t feedback_timeout_us;       // 超过这么久没有0x052认为电容不可用
+} SuperCap_GovernorConfig_t;
+
+typedef struct {
+    SuperCap_GovernorConfig_t cfg;
+
+    // 反馈，UpdateFeedback写入
+    bool valid;                         // 收到过0x052
+    bool available;                     // DCDC开启且没有错误
+    uint32_t feedback_us;               // 最近一次0x052的时刻
+    float chassis_power_w;              // 滤波后的底盘功率
+    float referee_power_w;              // 滤波后的裁判系统功率
+    uint16_t chassis_power_limit_w;
+    float energy_percent;               // 最近一次0x052的cap_energy_percent
+    float full_energy_j;                // cap_energy_percent为1时的能量，0.5 * C * CAPARR_MAX_VOLTAGE^2
+
+    // Step写入
+    uint32_t predict_us;                // predicted_percent对应的时刻
+    float predicted_percent;            // 向前预测的cap_energy_percent，收到0x052后重置为测量值
+    float budget_w;                     // 最近一次给出的预算
+} SuperCap_Governor_t;
+
+void SuperCap_Governor_InitDefaultConfig(SuperCap_GovernorConfig_t* config);
+
+// config为NULL时使用默认值
+void SuperCap_Governor_Init(SuperCap_Governor_t* gov, const SuperCap_GovernorConfig_t* config);
+
+// 每次SuperCap_ParseRxData之后调用，now_us为接收时刻（与时间同步使用同一个us时钟）
+void SuperCap_Governor_UpdateFeedback(SuperCap_Governor_t* gov, const SuperCap_Feedback_t* feedback, uint32_t now_us);
+
+// 可选，开启时间戳时在0x050的SuperCap_ParseTimeData之后调用
+// 0x050在0x052之后到达，此前的Step按接收时刻预测；这里改为从采样时刻重新预测，补上测量延时内的能量变化
+void SuperCap_Governor_UpdateSampleTime(SuperCap_Governor_t* gov, const SuperCap_Feedback_t* feedback);
+
+// 可选，每次SuperCap_ParseBurstData之后调用，用usable_energy_j修正电容组的总能量
+void SuperCap_Governor_UpdateBurst(SuperCap_Governor_t* gov, const SuperCap_BurstFeedback_t* burst);
+
+// 每个控制周期调用一次，返回底盘电机的功率预算 (W)
+// referee_power_limit与0x061中发送的相同，burst为true时允许使用保留的能量
+float SuperCap_Governor_Step(SuperCap_Governor_t* gov, uint16_t referee_power_limit, bool burst, uint32_t now_us);
+
+// 预测的可用能量 (J)，不计floor_percent以下的能量，burst为false时也不计保留的能量
+float SuperCap_Governor_AvailableEnergy(const SuperCap_Governor_t* gov, bool burst);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SUPERCAP_GOVERNOR_H
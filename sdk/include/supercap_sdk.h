@@ -4,10 +4,23 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 // 发送给超级电容的控制数据 (Chassis -> Supercap)
 
 #define SUPERCAP_RECEIVE_CAN_ID 0x052
+#define SUPERCAP_BURST_CAN_ID 0x053
 #define SUPERCAP_SEND_CAN_ID 0x061
+#define SUPERCAP_TIMESYNC_REQ_CAN_ID 0x063
+#define SUPERCAP_TIME_CAN_ID 0x050
+#define SUPERCAP_DIAG_CAN_ID 0x05B
+
+// 多板并联时，除SUPERCAP_SEND_CAN_ID外各ID按节点号偏移，0号节点不变
+#define SUPERCAP_NODE_CAN_ID(id, node) ((id) + (node) * 0x100)
+
+#define SUPERCAP_BURST_DURATION_UNLIMITED 0xFFFF
 
 typedef struct {
     // 开关控制
@@ -22,6 +35,7 @@ typedef struct {
     
     // 策略参数
     float active_charging_limit_ratio; // 主动充电限制比例 (0-1.0)
+    uint16_t burst_query_power_w;      // 放电时间预测的目标底盘功率 (W)，0为使用默认值200W
 } SuperCap_Control_t;
 
 typedef enum {
@@ -36,14 +50,21 @@ typedef enum {
     SUPERCAP_REFEREE_POWER = 0,
     SUPERCAP_CAPARR_VOLTAGE_MAX = 1,
     SUPERCAP_CAPARR_VOLTAGE_NORMAL = 2,
-    SUPERCAP_IB_POSITIVE_OR_IB_NEGATIVE = 3,
+    SUPERCAP_IB_POSITIVE_OR_IB_NEGATIVE = 3,    // 也包括能量回收时的vA钳位
 } SuperCapLimitFactor_t;
 
+typedef enum {
+    SUPERCAP_WPT_ERROR = 0,              // 非无线充电硬件，或发生错误
+    SUPERCAP_WPT_OFF = 1,                // 无线充电关闭
+    SUPERCAP_WPT_CHARGING = 2,           // 无线充电中
+    SUPERCAP_WPT_FINISHED = 3,           // 无线充电完成
+} SuperCapWPTStatus_t;
+
 // 从超级电容接收的反馈数据 (Supercap -> Chassis)
 typedef struct {
     // 状态标志
     bool dcdc_enabled;               // 当前DCDC是否开启
-    bool wpt_status; // TODO
+    SuperCapWPTStatus_t wpt_status;
     SuperCapLimitFactor_t limit_factor;
     SuperCapErrorLevel_t error_flag;
 
@@ -52,8 +73,89 @@ typedef struct {
     float referee_power_w;              // 裁判系统功率 (W)
     uint16_t chassis_power_limit_w;     // 当前底盘最大可用功率 (W)，这主要是基于裁判系统电流限制算出来的，如果不放心可以再加个缩放系数0.9什么的
     float cap_energy_percent;           // 电容剩余能量百分比，注意这个是可以超过1的（以电容冲到28.8V为1计算，最后一点为保护和能量回收预留）
+
+    // 采样时刻，由紧跟0x052的0x050帧填入（需开启时间戳且时间同步有效），为主控自己的us时钟
+    bool sample_time_valid;
+    uint32_t sample_time_us;
 } SuperCap_Feedback_t;
 
+// 放电时间预测 (Supercap -> Chassis)，100Hz
+typedef struct {
+    uint16_t query_power_w;             // 预测使用的底盘功率 (W)
+    uint16_t query_duration_ms;         // 可以维持query_power_w的时间 (ms)，SUPERCAP_BURST_DURATION_UNLIMITED表示裁判系统功率即可满足
+    uint16_t max_power_duration_ms;     // 可以维持chassis_power_limit_w的时间 (ms)
+    uint16_t usable_energy_j;           // 电容组放电到10V前可用的能量 (J)
+} SuperCap_BurstFeedback_t;
+
+
+// 诊断数据 (Supercap -> Chassis)，默认不发送，用运行时参数diag_period开启（20ms~1s）
+// 每次发送四帧，分别填入下面不同的字段
+#define SUPERCAP_ERROR_WARNING 4         // diag_error_level中的WARNING
+
+// 完整的限制因素，0x052中IB_POSITIVE和IB_NEGATIVE合并为3
+typedef enum {
+    SUPERCAP_DIAG_REFEREE_POWER = 0,
+    SUPERCAP_DIAG_CAPARR_VOLTAGE_MAX = 1,
+    SUPERCAP_DIAG_CAPARR_VOLTAGE_NORMAL = 2,
+    SUPERCAP_DIAG_IB_POSITIVE = 3,
+    SUPERCAP_DIAG_IB_NEGATIVE = 4,
+    SUPERCAP_DIAG_VA_CLAMP = 5,          // 能量回收时的vA钳位
+} SuperCapDiagLimitFactor_t;
+
+typedef struct {
+    SuperCapDiagLimitFactor_t limit_factor;
+    uint8_t error_level;                // SuperCapErrorLevel_t或SUPERCAP_ERROR_WARNING
+
+    // 错误帧
+    bool error_valid;
+    uint16_t error_code;                // 错误位，见固件Config.hpp中的ERROR_*/WARNING_*
+    float error_voltage_v;              // 最近一次保护触发时的电压 (V)
+    float error_current_a;              // 最近一次保护触发时的电流 (A)
+    uint8_t dcdc_mode;                  // 0: BUCK 1: BUCKBOOST 2: BOOSTBUCK 3: BOOST
+
+    // 环路帧
+    bool loop_valid;
+    float irq_load;                     // 上一帧之后62.5kHz中断占用率的最大值 (0-1)
+    float il_target_a;                  // 电感电流目标 (A)
+    float capacitance_f;                // 电容组容量估计 (F)
+    uint16_t rx_timeout_count;          // 超级电容收不到0x061的次数
+
+    // 总线帧和发送帧，计数器只有低8/16位，溢出后回绕，用相邻两次的差值统计
+    bool bus_valid;
+    uint8_t tec;                        // 发送错误计数器
+    uint8_t rec;                        // 接收错误计数器
+    uint8_t bus_off_count;
+    uint8_t error_passive_count;
+    uint8_t recover_count;              // bus-off后恢复的次数
+    uint16_t coalesced_count;           // 发送前被新值覆盖的反馈帧数
+
+    bool tx_valid;
+    uint16_t tx_feedback_count;         // 发出的反馈帧数（0x050-0x053等）
+    uint16_t tx_reply_count;            // 发出的上位机回复帧数，包括0x05B
+    uint16_t tx_telemetry_count;        // 发出的CAN-FD遥测帧数
+    uint8_t rejected_count;             // 发送队列满时被拒绝的回复和遥测帧数
+} SuperCap_Diag_t;
+
+// 时间同步状态 (主控侧)
+// 主控需提供一个us时钟（32位自由计数，溢出后回绕即可），推荐使用1MHz的32位定时器
+// 模型: 超级电容时钟 = 主控时钟 + offset + drift * (主控时钟 - ref)
+typedef struct {
+    uint8_t seq;                        // 下一次请求的序号
+    uint8_t pending_seq;                // 等待回复的请求序号
+    bool pending;
+    uint32_t t1_us;                     // 请求发送时刻（主控时钟）
+
+    bool valid;                         // 至少完成一次同步
+    uint32_t offset_us;                 // ref时刻两个时钟的差，按无符号数回绕
+    uint32_t ref_us;                    // 主控时钟
+    float drift;                        // 超级电容时钟相对主控时钟的频率偏差，如50e-6为快50ppm
+    uint32_t rtt_us;                    // 最近一次的往返时间（已扣除超级电容内部的处理时间）
+    uint32_t min_rtt_us;                // 往返时间的下限估计，用于剔除排队延时大的样本
+    uint32_t sample_count;
+    uint32_t reject_count;
+} SuperCap_TimeSync_t;
+
+#define SUPERCAP_TIMESYNC_PERIOD_MS 100    // 推荐的请求周期；超级电容1s内没有收到请求会停止发送时间戳
 
 
 void SuperCap_InitDefaultControl(SuperCap_Control_t* control);
@@ -62,4 +164,26 @@ void SuperCap_PackTxData(const SuperCap_Control_t* control, uint8_t* tx_buffer);
 
 void SuperCap_ParseRxData(const uint8_t* rx_buffer, SuperCap_Feedback_t* feedback);
 
+void SuperCap_ParseBurstData(const uint8_t* rx_buffer, SuperCap_BurstFeedback_t* feedback);
+
+// 解包0x05B，四帧分别更新diag中对应的字段
+void SuperCap_ParseDiagData(const uint8_t* rx_buffer, SuperCap_Diag_t* diag);
+
+void SuperCap_TimeSync_Init(SuperCap_TimeSync_t* sync);
+
+// 打包时间同步请求（CAN ID 0x063），now_us为发送时刻，尽量在写入发送邮箱时取
+// enable_timestamp为true时超级电容在每个0x052之后发送采样时刻
+void SuperCap_PackTimeSyncRequest(SuperCap_TimeSync_t* sync, uint32_t now_us, bool enable_timestamp, uint8_t* tx_buffer);
+
+// 解包0x050，now_us为接收时刻（尽量在接收中断中取）
+// 同步回复更新offset和drift；采样时刻写入feedback（可为NULL），需在对应的0x052解包之后调用
+void SuperCap_ParseTimeData(SuperCap_TimeSync_t* sync, const uint8_t* rx_buffer, uint32_t now_us, SuperCap_Feedback_t* feedback);
+
+// 把超级电容时钟换算为主控时钟，sync->valid为false时结果无意义
+uint32_t SuperCap_DeviceToLocalTime(const SuperCap_TimeSync_t* sync, uint32_t device_us);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif // SUPERCAP_SDK_H
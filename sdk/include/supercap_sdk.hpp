@@ -0,0 +1,457 @@
+#ifndef SUPERCAP_SDK_HPP
+#define SUPERCAP_SDK_HPP
+
+// supercap_sdk.h的C++17版本，只有头文件，可以和C版本同时使用
+// 视图类直接在8字节的CAN数据上读写，不复制、不分配内存，全部为constexpr
+// raw_*()返回帧中的定点数，底盘控制环可以直接用定点数计算，跳过浮点换算
+// 浮点换算的表达式与supercap_sdk.c相同，结果逐位一致；
+// 与C版本和固件结构体的一致性检查及性能对比见sdk/bench
+
+#include <cstddef>
+#include <cstdint>
+
+namespace supercap
+{
+
+inline constexpr uint16_t receive_can_id = 0x052;
+inline constexpr uint16_t burst_can_id = 0x053;
+inline constexpr uint16_t send_can_id = 0x061;
+inline constexpr uint16_t timesync_req_can_id = 0x063;
+inline constexpr uint16_t time_can_id = 0x050;
+inline constexpr uint16_t diag_can_id = 0x05B;
+inline constexpr uint16_t burst_duration_unlimited = 0xFFFF;
+
+// 多板并联时，除send_can_id外各ID按节点号偏移，0号节点不变
+constexpr uint16_t node_can_id(uint16_t id, uint8_t node) { return id + node * 0x100; }
+
+inline constexpr size_t frame_size = 8;
+
+struct Frame
+{
+    uint8_t data[frame_size] = {};
+};
+
+enum class ErrorLevel : uint8_t
+{
+    no_error = 0,
+    recover_auto = 1,
+    recover_manual = 2,
+    unrecoverable = 3,
+    warning = 4,                    // 只出现在诊断帧中
+};
+
+enum class LimitFactor : uint8_t
+{
+    referee_power = 0,
+    caparr_voltage_max = 1,
+    caparr_voltage_normal = 2,
+    ib_positive_or_ib_negative = 3, // 也包括能量回收时的vA钳位
+};
+
+enum class WptStatus : uint8_t
+{
+    error = 0,                      // 非无线充电硬件，或发生错误
+    off = 1,
+    charging = 2,
+    finished = 3,
+};
+
+enum class DiagLimitFactor : uint8_t
+{
+    referee_power = 0,
+    caparr_voltage_max = 1,
+    caparr_voltage_normal = 2,
+    ib_positive = 3,
+    ib_negative = 4,
+    va_clamp = 5,
+};
+
+enum class DiagPage : uint8_t
+{
+    error = 0,
+    loop = 1,
+    bus = 2,
+    tx = 3,
+};
+
+enum class TimeDataType : uint8_t
+{
+    sync = 0,
+    feedback = 1,
+};
+
+namespace detail
+{
+
+constexpr uint16_t load_u16(const uint8_t *p) { return uint16_t(p[0] | (p[1] << 8)); }
+constexpr int16_t load_i16(const uint8_t *p) { return int16_t(load_u16(p)); }
+constexpr uint32_t load_u32(const uint8_t *p)
+{
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+constexpr void store_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = uint8_t(v & 0xFF);
+    p[1] = uint8_t(v >> 8);
+}
+
+} // namespace detail
+
+// 各字段在帧中的字节偏移，与固件的packed结构体一致
+namespace layout
+{
+
+namespace control           // 0x061, RxData
+{
+inline constexpr size_t flags = 0;
+inline constexpr size_t referee_power_limit = 1;
+inline constexpr size_t referee_energy_buffer = 3;
+inline constexpr size_t active_charging_limit_ratio = 5;
+inline constexpr size_t burst_query_power = 6;
+inline constexpr uint8_t enable_dcdc = 1 << 0;
+inline constexpr uint8_t system_restart = 1 << 1;
+inline constexpr uint8_t clear_error = 1 << 5;
+inline constexpr uint8_t enable_active_charging_limit = 1 << 6;
+inline constexpr uint8_t use_new_feedback = 1 << 7;
+} // namespace control
+
+namespace feedback          // 0x052, TxDataNew
+{
+inline constexpr size_t status = 0;
+inline constexpr size_t chassis_power = 1;
+inline constexpr size_t referee_power = 3;
+inline constexpr size_t chassis_power_limit = 5;
+inline constexpr size_t cap_energy = 7;
+inline constexpr uint8_t dcdc_enabled = 1 << 7;
+inline constexpr uint8_t new_msg = 1 << 6;
+inline constexpr unsigned wpt_shift = 4;
+inline constexpr unsigned limit_shift = 2;
+inline constexpr unsigned error_shift = 0;
+} // namespace feedback
+
+namespace burst             // 0x053, TxBurstData
+{
+inline constexpr size_t query_power = 0;
+inline constexpr size_t query_duration = 2;
+inline constexpr size_t max_power_duration = 4;
+inline constexpr size_t usable_energy = 6;
+} // namespace burst
+
+namespace time              // 0x050, TxTimeData
+{
+inline constexpr size_t type = 0;
+inline constexpr size_t seq = 1;
+inline constexpr size_t delay = 2;
+inline constexpr size_t time = 4;
+} // namespace time
+
+} // namespace layout
+
+// 功率映射：功率*64+16384，-256W~+768W，精度1/64W
+inline constexpr int32_t power_offset = 16384;
+
+constexpr int32_t power_q6(uint16_t raw) { return int32_t(raw) - power_offset; }
+constexpr float power_w(uint16_t raw) { return (float(raw) - power_offset) / 64.0f; }
+// 与固件generateTxDataNew相同，向下截断，w需在映射范围内
+constexpr uint16_t power_raw(float w) { return uint16_t(w * 64.0f + 16384.0f); }
+
+// 0x061，主控发送
+struct Control
+{
+    bool enable_dcdc = true;
+    bool system_restart = false;    // 只要发一个包就会重启，不要重复发
+    bool clear_error = false;
+    bool enable_active_charging_limit = false;
+    uint16_t referee_power_limit = 37;
+    uint16_t referee_energy_buffer = 57;
+    uint8_t active_charging_limit_ratio = 0;    // 0-255对应0-1.0
+    uint16_t burst_query_power_w = 0;           // 0为默认值200W
+};
+
+// 与SuperCap_PackTxData的换算相同
+constexpr uint8_t ratio_raw(float ratio) { return uint8_t(ratio * 255.0f); }
+
+class ControlWriter
+{
+public:
+    explicit constexpr ControlWriter(uint8_t *data) : d(data) {}
+
+    constexpr void flags(bool enableDCDC, bool systemRestart, bool clearError, bool enableLimit)
+    {
+        d[layout::control::flags] = uint8_t((enableDCDC ? layout::control::enable_dcdc : 0) |
+                                            (systemRestart ? layout::control::system_restart : 0) |
+                                            (clearError ? layout::control::clear_error : 0) |
+                                            (enableLimit ? layout::control::enable_active_charging_limit : 0) |
+                                            layout::control::use_new_feedback);
+    }
+    constexpr void referee_power_limit(uint16_t w) { detail::store_u16(d + layout::control::referee_power_limit, w); }
+    constexpr void referee_energy_buffer(uint16_t j) { detail::store_u16(d + layout::control::referee_energy_buffer, j); }
+    constexpr void active_charging_limit_ratio(uint8_t raw) { d[layout::control::active_charging_limit_ratio] = raw; }
+    constexpr void burst_query_power(uint16_t w) { detail::store_u16(d + layout::control::burst_query_power, w); }
+
+    constexpr void write(const Control &c)
+    {
+        flags(c.enable_dcdc, c.system_restart, c.clear_error, c.enable_active_charging_limit);
+        referee_power_limit(c.referee_power_limit);
+        referee_energy_buffer(c.referee_energy_buffer);
+        active_charging_limit_ratio(c.active_charging_limit_ratio);
+        burst_query_power(c.burst_query_power_w);
+    }
+
+private:
+    uint8_t *d;
+};
+
+class ControlView
+{
+public:
+    explicit constexpr ControlView(const uint8_t *data) : d(data) {}
+
+    constexpr bool enable_dcdc() const { return d[layout::control::flags] & layout::control::enable_dcdc; }
+    constexpr bool system_restart() const { return d[layout::control::flags] & layout::control::system_restart; }
+    constexpr bool clear_error() const { return d[layout::control::flags] & layout::control::clear_error; }
+    constexpr bool enable_active_charging_limit() const
+    {
+        return d[layout::control::flags] & layout::control::enable_active_charging_limit;
+    }
+    constexpr bool use_new_feedback() const { return d[layout::control::flags] & layout::control::use_new_feedback; }
+    constexpr uint16_t referee_power_limit() const { return detail::load_u16(d + layout::control::referee_power_limit); }
+    constexpr uint16_t referee_energy_buffer() const { return detail::load_u16(d + layout::control::referee_energy_buffer); }
+    constexpr uint8_t raw_active_charging_limit_ratio() const { return d[layout::control::active_charging_limit_ratio]; }
+    constexpr uint16_t burst_query_power() const { return detail::load_u16(d + layout::control::burst_query_power); }
+
+    constexpr Control decode() const
+    {
+        Control c;
+        c.enable_dcdc = enable_dcdc();
+        c.system_restart = system_restart();
+        c.clear_error = clear_error();
+        c.enable_active_charging_limit = enable_active_charging_limit();
+        c.referee_power_limit = referee_power_limit();
+        c.referee_energy_buffer = referee_energy_buffer();
+        c.active_charging_limit_ratio = raw_active_charging_limit_ratio();
+        c.burst_query_power_w = burst_query_power();
+        return c;
+    }
+
+private:
+    const uint8_t *d;
+};
+
+constexpr Frame encode(const Control &c)
+{
+    Frame f;
+    ControlWriter(f.data).write(c);
+    return f;
+}
+
+// 0x052的定点数据，与帧中的字段一一对应
+struct FeedbackRaw
+{
+    uint8_t status = 0;
+    uint16_t chassis_power = power_offset;
+    uint16_t referee_power = power_offset;
+    uint16_t chassis_power_limit = 0;
+    uint8_t cap_energy = 0;
+};
+
+class FeedbackView
+{
+public:
+    explicit constexpr FeedbackView(const uint8_t *data) : d(data) {}
+
+    constexpr uint8_t raw_status() const { return d[layout::feedback::status]; }
+    constexpr bool dcdc_enabled() const { return raw_status() & layout::feedback::dcdc_enabled; }
+    constexpr bool new_msg() const { return raw_status() & layout::feedback::new_msg; }
+    constexpr WptStatus wpt_status() const { return WptStatus((raw_status() >> layout::feedback::wpt_shift) & 0x3); }
+    constexpr LimitFactor limit_factor() const { return LimitFactor((raw_status() >> layout::feedback::limit_shift) & 0x3); }
+    constexpr ErrorLevel error_level() const { return ErrorLevel((raw_status() >> layout::feedback::error_shift) & 0x3); }
+
+    constexpr uint16_t raw_chassis_power() const { return detail::load_u16(d + layout::feedback::chassis_power); }
+    constexpr uint16_t raw_referee_power() const { return detail::load_u16(d + layout::feedback::referee_power); }
+    constexpr uint8_t raw_cap_energy() const { return d[layout::feedback::cap_energy]; }  // (vCap/CAPARR_MAX_VOLTAGE)^2 * 250
+
+    // 单位1/64W
+    constexpr int32_t chassis_power_q6() const { return power_q6(raw_chassis_power()); }
+    constexpr int32_t referee_power_q6() const { return power_q6(raw_referee_power()); }
+    constexpr uint16_t chassis_power_limit_w() const { return detail::load_u16(d + layout::feedback::chassis_power_limit); }
+
+    constexpr float chassis_power_w() const { return power_w(raw_chassis_power()); }
+    constexpr float referee_power_w() const { return power_w(raw_referee_power()); }
+    constexpr float cap_energy_percent() const { return float(raw_cap_energy()) / 250.0f; }
+
+    constexpr FeedbackRaw decode() const
+    {
+        FeedbackRaw r;
+        r.status = raw_status();
+        r.chassis_power = raw_chassis_power();
+        r.referee_power = raw_referee_power();
+        r.chassis_power_limit = chassis_power_limit_w();
+        r.cap_energy = raw_cap_energy();
+        return r;
+    }
+
+private:
+    const uint8_t *d;
+};
+
+// 生成0x052，用于仿真和联调
+class FeedbackWriter
+{
+public:
+    explicit constexpr FeedbackWriter(uint8_t *data) : d(data) {}
+
+    constexpr void status(bool dcdcEnabled, WptStatus wpt, LimitFactor limit, ErrorLevel error)
+    {
+        d[layout::feedback::status] = uint8_t((dcdcEnabled ? layout::feedback::dcdc_enabled : 0) | layout::feedback::new_msg |
+                                              ((uint8_t(wpt) & 0x3) << layout::feedback::wpt_shift) |
+                                              ((uint8_t(limit) & 0x3) << layout::feedback::limit_shift) |
+                                              ((uint8_t(error) & 0x3) << layout::feedback::error_shift));
+    }
+    constexpr void write(const FeedbackRaw &r)
+    {
+        d[layout::feedback::status] = r.status;
+        detail::store_u16(d + layout::feedback::chassis_power, r.chassis_power);
+        detail::store_u16(d + layout::feedback::referee_power, r.referee_power);
+        detail::store_u16(d + layout::feedback::chassis_power_limit, r.chassis_power_limit);
+        d[layout::feedback::cap_energy] = r.cap_energy;
+    }
+
+private:
+    uint8_t *d;
+};
+
+constexpr Frame encode(const FeedbackRaw &r)
+{
+    Frame f;
+    FeedbackWriter(f.data).write(r);
+    return f;
+}
+
+// 0x053
+class BurstView
+{
+public:
+    explicit constexpr BurstView(const uint8_t *data) : d(data) {}
+
+    constexpr uint16_t query_power_w() const { return detail::load_u16(d + layout::burst::query_power); }
+    constexpr uint16_t query_duration_ms() const { return detail::load_u16(d + layout::burst::query_duration); }
+    constexpr uint16_t max_power_duration_ms() const { return detail::load_u16(d + layout::burst::max_power_duration); }
+    constexpr uint16_t usable_energy_j() const { return detail::load_u16(d + layout::burst::usable_energy); }
+    constexpr bool query_unlimited() const { return query_duration_ms() == burst_duration_unlimited; }
+
+private:
+    const uint8_t *d;
+};
+
+// 0x050
+class TimeView
+{
+public:
+    explicit constexpr TimeView(const uint8_t *data) : d(data) {}
+
+    constexpr TimeDataType type() const { return TimeDataType(d[layout::time::type]); }
+    constexpr uint8_t seq() const { return d[layout::time::seq]; }
+    constexpr uint16_t delay_us() const { return detail::load_u16(d + layout::time::delay); }
+    constexpr uint32_t time_us() const { return detail::load_u32(d + layout::time::time); }
+
+private:
+    const uint8_t *d;
+};
+
+// 0x063，只负责打包，同步计算仍用SuperCap_TimeSync_t
+constexpr Frame encode_timesync_request(uint8_t seq, bool enableTimestamp)
+{
+    Frame f;
+    f.data[0] = seq;
+    f.data[1] = enableTimestamp ? 1 : 0;
+    return f;
+}
+
+// 0x05B，四页共用byte0
+class DiagView
+{
+public:
+    explicit constexpr DiagView(const uint8_t *data) : d(data) {}
+
+    constexpr DiagPage page() const { return DiagPage(d[0] & 0x03); }
+    constexpr DiagLimitFactor limit_factor() const { return DiagLimitFactor((d[0] >> 2) & 0x07); }
+    constexpr ErrorLevel error_level() const { return ErrorLevel(d[0] >> 5); }
+
+    // 错误帧
+    constexpr uint16_t error_code() const { return detail::load_u16(d + 1); }
+    constexpr int16_t raw_error_voltage() const { return detail::load_i16(d + 3); }  // 0.01V
+    constexpr int16_t raw_error_current() const { return detail::load_i16(d + 5); }  // 0.01A
+    constexpr uint8_t dcdc_mode() const { return d[7]; }
+    constexpr float error_voltage_v() const { return raw_error_voltage() * 0.01f; }
+    constexpr float error_current_a() const { return raw_error_current() * 0.01f; }
+
+    // 环路帧
+    constexpr uint8_t raw_irq_load() const { return d[1]; }                         // 0.5%
+    constexpr int16_t raw_il_target() const { return detail::load_i16(d + 2); }      // 0.01A
+    constexpr uint16_t raw_capacitance() const { return detail::load_u16(d + 4); }   // 0.001F
+    constexpr uint16_t rx_timeout_count() const { return detail::load_u16(d + 6); }
+    constexpr float irq_load() const { return raw_irq_load() * 0.005f; }
+    constexpr float il_target_a() const { return raw_il_target() * 0.01f; }
+    constexpr float capacitance_f() const { return raw_capacitance() * 0.001f; }
+
+    // 总线帧，计数器只有低位，溢出后回绕
+    constexpr uint8_t tec() const { return d[1]; }
+    constexpr uint8_t rec() const { return d[2]; }
+    constexpr uint8_t bus_off_count() const { return d[3]; }
+    constexpr uint8_t error_passive_count() const { return d[4]; }
+    constexpr uint8_t recover_count() const { return d[5]; }
+    constexpr uint16_t coalesced_count() const { return detail::load_u16(d + 6); }
+
+    // 发送帧
+    constexpr uint16_t tx_feedback_count() const { return detail::load_u16(d + 1); }
+    constexpr uint16_t tx_reply_count() const { return detail::load_u16(d + 3); }
+    constexpr uint16_t tx_telemetry_count() const { return detail::load_u16(d + 5); }
+    constexpr uint8_t rejected_count() const { return d[7]; }
+
+private:
+    const uint8_t *d;
+};
+
+namespace selftest
+{
+
+inline constexpr Control sample_control = {true, false, true, true, 120, 60, 204, 250};
+inline constexpr Frame sample_control_frame = encode(sample_control);
+static_assert(sample_control_frame.data[0] == 0xE1 && sample_control_frame.data[1] == 120 &&
+              sample_control_frame.data[3] == 60 && sample_control_frame.data[5] == 204 &&
+              sample_control_frame.data[6] == 250 && sample_control_frame.data[7] == 0, "0x061 layout");
+static_assert(ControlView(sample_control_frame.data).decode().referee_power_limit == 120 &&
+              ControlView(sample_control_frame.data).decode().burst_query_power_w == 250 &&
+              ControlView(sample_control_frame.data).use_new_feedback(), "0x061 round trip");
+
+inline constexpr uint8_t sample_feedback[frame_size] = {0xEA, 0x40, 0x50, 0x00, 0x41, 0x2C, 0x01, 0xFA};
+static_assert(FeedbackView(sample_feedback).dcdc_enabled() && FeedbackView(sample_feedback).new_msg() &&
+              FeedbackView(sample_feedback).wpt_status() == WptStatus::charging &&
+              FeedbackView(sample_feedback).limit_factor() == LimitFactor::caparr_voltage_normal &&
+              FeedbackView(sample_feedback).error_level() == ErrorLevel::recover_manual, "0x052 status");
+static_assert(FeedbackView(sample_feedback).chassis_power_q6() == 65 * 64 &&
+              FeedbackView(sample_feedback).chassis_power_w() == 65.0f &&
+              FeedbackView(sample_feedback).referee_power_w() == 4.0f &&
+              FeedbackView(sample_feedback).chassis_power_limit_w() == 300 &&
+              FeedbackView(sample_feedback).cap_energy_percent() == 1.0f, "0x052 values");
+static_assert(encode(FeedbackView(sample_feedback).decode()).data[2] == 0x50 &&
+              encode(FeedbackView(sample_feedback).decode()).data[7] == 0xFA, "0x052 round trip");
+static_assert(power_raw(-256.0f) == 0 && power_raw(65.0f) == 0x5040 && power_raw(-0.5f) == 16352, "power mapping");
+
+inline constexpr uint8_t sample_diag[frame_size] = {0x91, 200, 0x18, 0xFC, 0x10, 0x27, 3, 0};
+static_assert(DiagView(sample_diag).page() == DiagPage::loop && DiagView(sample_diag).error_level() == ErrorLevel::warning &&
+              DiagView(sample_diag).limit_factor() == DiagLimitFactor::ib_negative &&
+              DiagView(sample_diag).raw_il_target() == -1000 && DiagView(sample_diag).raw_capacitance() == 10000, "0x05B");
+
+inline constexpr uint8_t sample_diag_tx[frame_size] = {0x03, 0x34, 0x12, 9, 0, 0xFF, 0xFF, 2};
+static_assert(DiagView(sample_diag_tx).page() == DiagPage::tx && DiagView(sample_diag_tx).tx_feedback_count() == 0x1234 &&
+              DiagView(sample_diag_tx).tx_reply_count() == 9 && DiagView(sample_diag_tx).tx_telemetry_count() == 0xFFFF &&
+              DiagView(sample_diag_tx).rejected_count() == 2, "0x05B tx page");
+
+} // namespace selftest
+
+} // namespace supercap
+
+#endif // SUPERCAP_SDK_HPP
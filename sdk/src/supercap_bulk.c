@@ -0,0 +1,154 @@
+#include "supercap_bulk.h"
+
+#include <string.h>
+
+#if !defined(SUPERCAP_BULK_NO_SIMD) && defined(__AVX2__)
+#include <immintrin.h>
+#define BULK_AVX2
+#elif !defined(SUPERCAP_BULK_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+#define BULK_SSE2
+#endif
+
+// 各字段在帧（按小端读成uint64）中的位置
+#define BULK_SHIFT_CHASSIS 8
+#define BULK_SHIFT_REFEREE 24
+#define BULK_SHIFT_LIMIT 40
+#define BULK_SHIFT_ENERGY 56
+
+static void decode_scalar(const uint8_t *frames, size_t begin, size_t count,
+                          const SuperCap_FeedbackColumns_t *c) {
+    for (size_t i = begin; i < count; i++) {
+        const uint8_t *d = frames + i * 8;
+        uint16_t chassis = (uint16_t)d[1] | ((uint16_t)d[2] << 8);
+        uint16_t referee = (uint16_t)d[3] | ((uint16_t)d[4] << 8);
+        // 表达式与SuperCap_ParseRxData相同
+        if (c->status) c->status[i] = d[0];
+        if (c->chassis_power_w) c->chassis_power_w[i] = ((float)chassis - 16384) / 64.0f;
+        if (c->referee_power_w) c->referee_power_w[i] = ((float)referee - 16384) / 64.0f;
+        if (c->chassis_power_limit_w) c->chassis_power_limit_w[i] = (uint16_t)d[5] | ((uint16_t)d[6] << 8);
+        if (c->cap_energy_percent) c->cap_energy_percent[i] = (float)d[7] / 250.0f;
+    }
+}
+
+#if defined(BULK_AVX2)
+
+// 一次8帧：两个寄存器各4帧，每帧一个64位通道
+// 取出的字段在各通道的低32位，把第二个寄存器的左移32位合并后，dword顺序为f0 f4 f1 f5 f2 f6 f3 f7，再重排
+static inline __m256i avx2_field(__m256i a, __m256i b, int shift, __m256i mask, __m256i order) {
+    __m256i fa = _mm256_and_si256(_mm256_srli_epi64(a, shift), mask);
+    __m256i fb = _mm256_and_si256(_mm256_srli_epi64(b, shift), mask);
+    return _mm256_permutevar8x32_epi32(_mm256_or_si256(fa, _mm256_slli_epi64(fb, 32)), order);
+}
+
+static inline __m256 avx2_power(__m256i raw, __m256 offset, __m256 scale) {
+    // 偏移和除以64都是精确的，结果与标量相同
+    return _mm256_mul_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(raw), offset), scale);
+}
+
+static size_t decode_simd(const uint8_t *frames, size_t count, const SuperCap_FeedbackColumns_t *c) {
+    const __m256i mask16 = _mm256_set1_epi64x(0xFFFF);
+    const __m256i mask8 = _mm256_set1_epi64x(0xFF);
+    const __m256i order = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    const __m256 offset = _mm256_set1_ps(16384.0f);
+    const __m256 scale = _mm256_set1_ps(1.0f / 64.0f);
+    const __m256 energyFull = _mm256_set1_ps(250.0f);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(frames + i * 8));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(frames + i * 8 + 32));
+        if (c->status) {
+            __m256i s = avx2_field(a, b, 0, mask8, order);
+            __m128i s16 = _mm_packus_epi32(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+            _mm_storel_epi64((__m128i *)(c->status + i), _mm_packus_epi16(s16, s16));
+        }
+        if (c->chassis_power_w)
+            _mm256_storeu_ps(c->chassis_power_w + i, avx2_power(avx2_field(a, b, BULK_SHIFT_CHASSIS, mask16, order), offset, scale));
+        if (c->referee_power_w)
+            _mm256_storeu_ps(c->referee_power_w + i, avx2_power(avx2_field(a, b, BULK_SHIFT_REFEREE, mask16, order), offset, scale));
+        if (c->chassis_power_limit_w) {
+            __m256i l = avx2_field(a, b, BULK_SHIFT_LIMIT, mask16, order);
+            _mm_storeu_si128((__m128i *)(c->chassis_power_limit_w + i),
+                             _mm_packus_epi32(_mm256_castsi256_si128(l), _mm256_extracti128_si256(l, 1)));
+        }
+        if (c->cap_energy_percent) {
+            __m256i e = avx2_field(a, b, BULK_SHIFT_ENERGY, mask8, order);
+            _mm256_storeu_ps(c->cap_energy_percent + i, _mm256_div_ps(_mm256_cvtepi32_ps(e), energyFull));
+        }
+    }
+    return i;
+}
+
+#elif defined(BULK_SSE2)
+
+// 一次4帧：两个寄存器各2帧，合并方式同AVX2，SSE2没有跨通道的dword重排，用shuffle_epi32
+static inline __m128i sse2_field(__m128i a, __m128i b, int shift, __m128i mask) {
+    __m128i fa = _mm_and_si128(_mm_srli_epi64(a, shift), mask);
+    __m128i fb = _mm_and_si128(_mm_srli_epi64(b, shift), mask);
+    // fa的dword为f0 - f1 -，fb为f2 - f3 -
+    return _mm_unpacklo_epi64(_mm_shuffle_epi32(fa, _MM_SHUFFLE(3, 1, 2, 0)),
+                              _mm_shuffle_epi32(fb, _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+static inline __m128 sse2_power(__m128i raw, __m128 offset, __m128 scale) {
+    return _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(raw), offset), scale);
+}
+
+static size_t decode_simd(const uint8_t *frames, size_t count, const SuperCap_FeedbackColumns_t *c) {
+    const __m128i mask16 = _mm_set1_epi64x(0xFFFF);
+    const __m128i mask8 = _mm_set1_epi64x(0xFF);
+    const __m128i bias16 = _mm_set1_epi32(0x8000);
+    const __m128 offset = _mm_set1_ps(16384.0f);
+    const __m128 scale = _mm_set1_ps(1.0f / 64.0f);
+    const __m128 energyFull = _mm_set1_ps(250.0f);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(frames + i * 8));
+        __m128i b = _mm_loadu_si128((const __m128i *)(frames + i * 8 + 16));
+        if (c->status) {
+            __m128i s = sse2_field(a, b, 0, mask8);
+            s = _mm_packs_epi32(s, s);
+            uint32_t packed = (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(s, s));
+            memcpy(c->status + i, &packed, sizeof(packed));
+        }
+        if (c->chassis_power_w)
+            _mm_storeu_ps(c->chassis_power_w + i, sse2_power(sse2_field(a, b, BULK_SHIFT_CHASSIS, mask16), offset, scale));
+        if (c->referee_power_w)
+            _mm_storeu_ps(c->referee_power_w + i, sse2_power(sse2_field(a, b, BULK_SHIFT_REFEREE, mask16), offset, scale));
+        if (c->chassis_power_limit_w) {
+            // SSE2只有有符号饱和的packs，先减去0x8000，打包后再异或回来
+            __m128i l = _mm_sub_epi32(sse2_field(a, b, BULK_SHIFT_LIMIT, mask16), bias16);
+            l = _mm_xor_si128(_mm_packs_epi32(l, l), _mm_set1_epi16((short)0x8000));
+            _mm_storel_epi64((__m128i *)(c->chassis_power_limit_w + i), l);
+        }
+        if (c->cap_energy_percent) {
+            __m128i e = sse2_field(a, b, BULK_SHIFT_ENERGY, mask8);
+            _mm_storeu_ps(c->cap_energy_percent + i, _mm_div_ps(_mm_cvtepi32_ps(e), energyFull));
+        }
+    }
+    return i;
+}
+
+#endif
+
+void SuperCap_DecodeFeedbackBulk(const uint8_t *frames, size_t count,
+                                 const SuperCap_FeedbackColumns_t *columns) {
+    if (!frames || !columns) return;
+    size_t done = 0;
+#if defined(BULK_AVX2) || defined(BULK_SSE2)
+    done = decode_simd(frames, count, columns);
+#endif
+    decode_scalar(frames, done, count, columns);
+}
+
+const char *SuperCap_DecodeBulkBackend(void) {
+#if defined(BULK_AVX2)
+    return "avx2";
+#elif defined(BULK_SSE2)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
@@ -0,0 +1,35 @@
+#ifndef SUPERCAP_ENERGY_H
+#define SUPERCAP_ENERGY_H
+
+// supercap_governor.c和supercap_estimator.c共用的能量换算，只在sdk/src中包含，不属于公开接口
+
+#include "supercap_governor.h"
+
+#define ENERGY_ALPHA 0.1f                   // 总能量估计的滤波系数
+#define ENERGY_MIN_SPAN 0.1f                // cap_energy_percent高于截止电压对应值这么多时才修正总能量
+#define ENERGY_CAPACITY_LT 0.2f             // 与固件CAPARR_CAPACITY_LT/HT相同
+#define ENERGY_CAPACITY_HT 10.0f
+#define ENERGY_LOW_PERCENT ((SUPERCAP_CAPARR_LOW_VOLTAGE * SUPERCAP_CAPARR_LOW_VOLTAGE) / \
+                            (SUPERCAP_CAPARR_MAX_VOLTAGE * SUPERCAP_CAPARR_MAX_VOLTAGE))    // 截止电压对应的cap_energy_percent
+
+static inline float clampf(float x, float lo, float hi) {
+    return x < lo ? lo : (x > hi ? hi : x);
+}
+
+// cap_energy_percent为1时的能量
+static inline float full_energy(float capacity) {
+    return 0.5f * capacity * SUPERCAP_CAPARR_MAX_VOLTAGE * SUPERCAP_CAPARR_MAX_VOLTAGE;
+}
+
+// 用0x053的usable_energy_j修正总能量，energy_percent为同一时刻的cap_energy_percent
+// usable_energy_j = 0.5 * C * (vCap^2 - CAPARR_LOW_VOLTAGE^2) = full_energy * (percent - low_percent)
+static inline void correct_full_energy(float *full_energy_j, float energy_percent, uint16_t usable_energy_j) {
+    float span = energy_percent - ENERGY_LOW_PERCENT;
+    if (span < ENERGY_MIN_SPAN) return;
+
+    float energy = clampf((float)usable_energy_j / span, full_energy(ENERGY_CAPACITY_LT),
+                          full_energy(ENERGY_CAPACITY_HT));
+    *full_energy_j += ENERGY_ALPHA * (energy - *full_energy_j);
+}
+
+#endif // SUPERCAP_ENERGY_H
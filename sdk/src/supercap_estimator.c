@@ -0,0 +1,177 @@
+#include "supercap_estimator.h"
+#include "supercap_energy.h"
+
+#include <math.h>
+
+#define ESTIMATOR_ENERGY_LSB (1.0f / 250.0f)    // cap_energy_percent的分辨率
+#define ESTIMATOR_ENERGY_RAW_MAX 255            // 固件饱和时只说明真实值不低于255/250
+
+// dt内cap_energy_percent的变化和误差界的增长
+static void model_step(const SuperCap_Estimator_t *est, float dt, float *delta, float *widen) {
+    float pCap = est->dcdc_enabled ? est->command_power_w + est->power_bias_w - est->referee_power_w : 0.0f;
+    float drain = pCap > 0.0f ? pCap / SUPERCAP_DISCHARGE_EFFICIENCY : pCap * SUPERCAP_DISCHARGE_EFFICIENCY;
+    float error = est->cfg.power_error_w + est->cfg.power_error_ratio * fabsf(pCap);
+    *delta = -drain * dt / est->full_energy_j;
+    *widen = error / SUPERCAP_DISCHARGE_EFFICIENCY * dt / est->full_energy_j;
+}
+
+static void advance(SuperCap_Estimator_t *est, uint32_t now_us) {
+    int32_t elapsed = (int32_t)(now_us - est->time_us);
+    if (!est->valid) {
+        est->time_us = now_us;
+        return;
+    }
+    if (elapsed <= 0) return;
+    est->time_us = now_us;
+
+    float delta, widen;
+    model_step(est, (float)elapsed * 1e-6f, &delta, &widen);
+    est->energy_percent += delta;
+    est->lower_percent += delta - widen;
+    est->upper_percent += delta + widen;
+    if (est->lower_percent < 0.0f) est->lower_percent = 0.0f;
+    if (est->energy_percent < est->lower_percent) est->energy_percent = est->lower_percent;
+}
+
+void SuperCap_Estimator_InitDefaultConfig(SuperCap_EstimatorConfig_t *config) {
+    if (!config) return;
+    config->capacity_f = SUPERCAP_CAPARR_DEFAULT_CAPACITY;
+    config->power_error_w = 5.0f;
+    config->power_error_ratio = 0.1f;
+    config->bias_tau_s = 0.5f;
+    config->measurement_margin_percent = 0.0005f;
+    config->correction_gain = 0.2f;
+}
+
+void SuperCap_Estimator_Init(SuperCap_Estimator_t *est, const SuperCap_EstimatorConfig_t *config) {
+    if (!est) return;
+    *est = (SuperCap_Estimator_t){0};
+    if (config)
+        est->cfg = *config;
+    else
+        SuperCap_Estimator_InitDefaultConfig(&est->cfg);
+    est->full_energy_j = full_energy(est->cfg.capacity_f);
+}
+
+void SuperCap_Estimator_Predict(SuperCap_Estimator_t *est, float command_power_w, uint32_t now_us) {
+    if (!est) return;
+    // 上一个周期的指令功率作用到now_us为止，新的指令功率从now_us开始
+    advance(est, now_us);
+    est->command_power_w = command_power_w;
+}
+
+static SuperCap_EstimatorState_t get_state(const SuperCap_Estimator_t *est) {
+    return (SuperCap_EstimatorState_t){est->energy_percent, est->lower_percent, est->upper_percent};
+}
+
+static void set_state(SuperCap_Estimator_t *est, SuperCap_EstimatorState_t state) {
+    est->energy_percent = state.energy_percent;
+    est->lower_percent = state.lower_percent;
+    est->upper_percent = state.upper_percent;
+}
+
+// 用measured_raw修正est中的预测区间，lag_s为采样时刻到feedback_us的时间
+static void correct(SuperCap_Estimator_t *est, float lag_s) {
+    int raw = est->measured_raw;
+    float lower = raw * ESTIMATOR_ENERGY_LSB - est->cfg.measurement_margin_percent;
+    float upper = (raw + 1) * ESTIMATOR_ENERGY_LSB + est->cfg.measurement_margin_percent;
+    if (lag_s > 0.0f) {
+        float delta, widen;
+        model_step(est, lag_s, &delta, &widen);
+        lower += delta - widen;
+        upper += delta + widen;
+    }
+
+    if (!est->prior_valid) {
+        est->lower_percent = lower;
+        est->upper_percent = upper;
+        est->energy_percent = 0.5f * (lower + upper);
+        return;
+    }
+
+    // 饱和时测量只给出下界，上界沿用预测值
+    if (raw >= ESTIMATOR_ENERGY_RAW_MAX && est->upper_percent > upper) upper = est->upper_percent;
+    float newLower = est->lower_percent > lower ? est->lower_percent : lower;
+    float newUpper = est->upper_percent < upper ? est->upper_percent : upper;
+    if (newLower > newUpper) {
+        // 功率误差超过了假设的界，预测不可信，重新从测量开始
+        est->reset_count++;
+        est->lower_percent = lower;
+        est->upper_percent = upper;
+        est->energy_percent = 0.5f * (lower + upper);
+        return;
+    }
+    est->lower_percent = newLower;
+    est->upper_percent = newUpper;
+    est->energy_percent = clampf(est->energy_percent, newLower, newUpper);
+    est->energy_percent += est->cfg.correction_gain * (0.5f * (newLower + newUpper) - est->energy_percent);
+}
+
+void SuperCap_Estimator_UpdateFeedback(SuperCap_Estimator_t *est, const SuperCap_Feedback_t *feedback,
+                                       uint32_t now_us) {
+    if (!est || !feedback) return;
+    advance(est, now_us);
+
+    // 反馈间隔不固定（按变化发送），偏差的滤波系数按实际间隔计算
+    float residual = feedback->chassis_power_w - est->command_power_w;
+    float alpha = 1.0f;
+    if (est->valid) {
+        float dt = (float)(now_us - est->feedback_us) * 1e-6f;
+        alpha = dt / (est->cfg.bias_tau_s + dt);
+    }
+    est->power_bias_w += alpha * (residual - est->power_bias_w);
+    est->feedback_us = now_us;
+    est->referee_power_w = feedback->referee_power_w;
+    est->dcdc_enabled = feedback->dcdc_enabled;
+
+    est->measured_raw = (int)lroundf(feedback->cap_energy_percent * 250.0f);
+    est->prior_valid = est->valid;
+    est->prior_reset_count = est->reset_count;
+    est->prior = get_state(est);
+    est->valid = true;
+    correct(est, 0.0f);
+    est->corrected = get_state(est);
+    est->sample_pending = true;
+}
+
+void SuperCap_Estimator_UpdateSampleTime(SuperCap_Estimator_t *est, const SuperCap_Feedback_t *feedback) {
+    if (!est || !feedback || !est->sample_pending || !feedback->sample_time_valid) return;
+    int32_t lag = (int32_t)(est->feedback_us - feedback->sample_time_us);
+    if (lag <= 0) return;
+    est->sample_pending = false;
+
+    // feedback_us之后Predict只在区间上叠加变化量，重新修正后把这部分变化加回去
+    SuperCap_EstimatorState_t now = get_state(est);
+    set_state(est, est->prior);
+    est->reset_count = est->prior_reset_count;
+    correct(est, (float)lag * 1e-6f);
+    est->energy_percent += now.energy_percent - est->corrected.energy_percent;
+    est->lower_percent += now.lower_percent - est->corrected.lower_percent;
+    est->upper_percent += now.upper_percent - est->corrected.upper_percent;
+    if (est->lower_percent < 0.0f) est->lower_percent = 0.0f;
+    est->energy_percent = clampf(est->energy_percent, est->lower_percent, est->upper_percent);
+}
+
+void SuperCap_Estimator_UpdateBurst(SuperCap_Estimator_t *est, const SuperCap_BurstFeedback_t *burst) {
+    if (!est || !burst || !est->valid) return;
+    correct_full_energy(&est->full_energy_j, est->energy_percent, burst->usable_energy_j);
+}
+
+float SuperCap_Estimator_ErrorBound(const SuperCap_Estimator_t *est) {
+    if (!est || !est->valid) return 0.0f;
+    float below = est->energy_percent - est->lower_percent;
+    float above = est->upper_percent - est->energy_percent;
+    return below > above ? below : above;
+}
+
+float SuperCap_Estimator_UsableEnergy(const SuperCap_Estimator_t *est, float *error_j) {
+    if (error_j) *error_j = est ? SuperCap_Estimator_ErrorBound(est) * est->full_energy_j : 0.0f;
+    if (!est || !est->valid) return 0.0f;
+    float energy = (est->energy_percent - ENERGY_LOW_PERCENT) * est->full_energy_j;
+    return energy > 0.0f ? energy : 0.0f;
+}
+
+float SuperCap_Estimator_ChassisPower(const SuperCap_Estimator_t *est) {
+    if (!est) return 0.0f;
+    return est->command_power_w + est->power_bias_w;
+}
@@ -0,0 +1,105 @@
+#include "supercap_governor.h"
+#include "supercap_energy.h"
+
+#define GOVERNOR_MAX_STEP_S 0.1f            // 两次Step间隔过长时按这么多预测，避免暂停调用后预测值跳变
+
+void SuperCap_Governor_InitDefaultConfig(SuperCap_GovernorConfig_t *config) {
+    if (!config) return;
+    config->power_filter_tau_s = 0.05f;
+    config->horizon_s = 2.0f;
+    config->burst_reserve_percent = 0.5f;
+    config->floor_percent = 0.2f;           // 约12.9V
+    config->recharge_power_w = 15.0f;
+    config->capacity_f = SUPERCAP_CAPARR_DEFAULT_CAPACITY;
+    config->fallback_ratio = 0.9f;
+    config->feedback_timeout_us = 100000;
+}
+
+void SuperCap_Governor_Init(SuperCap_Governor_t *gov,
+                            const SuperCap_GovernorConfig_t *config) {
+    if (!gov) return;
+    *gov = (SuperCap_Governor_t){0};
+    if (config)
+        gov->cfg = *config;
+    else
+        SuperCap_Governor_InitDefaultConfig(&gov->cfg);
+    gov->full_energy_j = full_energy(gov->cfg.capacity_f);
+}
+
+void SuperCap_Governor_UpdateFeedback(SuperCap_Governor_t *gov,
+                                      const SuperCap_Feedback_t *feedback,
+                                      uint32_t now_us) {
+    if (!gov || !feedback) return;
+
+    // 反馈间隔不固定（按变化发送），滤波系数按实际间隔计算
+    float alpha = 1.0f;
+    if (gov->valid) {
+        float dt = (float)(now_us - gov->feedback_us) * 1e-6f;
+        alpha = dt / (gov->cfg.power_filter_tau_s + dt);
+    }
+    gov->chassis_power_w += alpha * (feedback->chassis_power_w - gov->chassis_power_w);
+    gov->referee_power_w += alpha * (feedback->referee_power_w - gov->referee_power_w);
+
+    gov->valid = true;
+    gov->available = feedback->dcdc_enabled && feedback->error_flag == SUPERCAP_NO_ERROR;
+    gov->feedback_us = now_us;
+    gov->chassis_power_limit_w = feedback->chassis_power_limit_w;
+    gov->energy_percent = feedback->cap_energy_percent;
+    gov->predicted_percent = feedback->cap_energy_percent;
+    gov->predict_us = now_us;
+}
+
+void SuperCap_Governor_UpdateSampleTime(SuperCap_Governor_t *gov,
+                                        const SuperCap_Feedback_t *feedback) {
+    if (!gov || !feedback || !gov->valid || !feedback->sample_time_valid) return;
+
+    // 采样时刻应早于0x052的接收时刻，否则时间同步还没有收敛，保持按接收时刻预测
+    if ((int32_t)(gov->feedback_us - feedback->sample_time_us) <= 0) return;
+
+    // 丢弃接收之后的预测，下次Step从采样时刻开始积分
+    gov->predicted_percent = gov->energy_percent;
+    gov->predict_us = feedback->sample_time_us;
+}
+
+void SuperCap_Governor_UpdateBurst(SuperCap_Governor_t *gov,
+                                   const SuperCap_BurstFeedback_t *burst) {
+    if (!gov || !burst || !gov->valid) return;
+    correct_full_energy(&gov->full_energy_j, gov->energy_percent, burst->usable_energy_j);
+}
+
+float SuperCap_Governor_Step(SuperCap_Governor_t *gov, uint16_t referee_power_limit,
+                             bool burst, uint32_t now_us) {
+    if (!gov) return 0.0f;
+
+    // 从上次Step或最近一次反馈的采样时刻开始预测
+    float dt = clampf((float)(int32_t)(now_us - gov->predict_us) * 1e-6f, 0.0f, GOVERNOR_MAX_STEP_S);
+    gov->predict_us = now_us;
+
+    if (!gov->valid || !gov->available ||
+        now_us - gov->feedback_us > gov->cfg.feedback_timeout_us) {
+        gov->budget_w = referee_power_limit * gov->cfg.fallback_ratio;
+        return gov->budget_w;
+    }
+
+    // 电容承担底盘功率与裁判系统功率之差，放电和充电都经过DCDC
+    float pCap = gov->chassis_power_w - gov->referee_power_w;
+    float drain = pCap > 0.0f ? pCap / SUPERCAP_DISCHARGE_EFFICIENCY : pCap * SUPERCAP_DISCHARGE_EFFICIENCY;
+    gov->predicted_percent -= drain * dt / gov->full_energy_j;
+    if (gov->predicted_percent < 0.0f) gov->predicted_percent = 0.0f;
+
+    // 高于保留值的能量在horizon_s内用完，按指数逼近保留值，不会越过
+    float reserve = burst ? gov->cfg.floor_percent : gov->cfg.burst_reserve_percent;
+    float spare = (gov->predicted_percent - reserve) * gov->full_energy_j;
+    float capBudget = spare * SUPERCAP_DISCHARGE_EFFICIENCY / gov->cfg.horizon_s;
+    if (capBudget < -gov->cfg.recharge_power_w) capBudget = -gov->cfg.recharge_power_w;
+
+    gov->budget_w = clampf(referee_power_limit + capBudget, 0.0f, gov->chassis_power_limit_w);
+    return gov->budget_w;
+}
+
+float SuperCap_Governor_AvailableEnergy(const SuperCap_Governor_t *gov, bool burst) {
+    if (!gov || !gov->valid) return 0.0f;
+    float reserve = burst ? gov->cfg.floor_percent : gov->cfg.burst_reserve_percent;
+    float spare = (gov->predicted_percent - reserve) * gov->full_energy_j;
+    return spare > 0.0f ? spare : 0.0f;
+}
@@ -8,6 +8,7 @@ void SuperCap_InitDefaultControl(SuperCap_Control_t *control) {
     control->referee_power_limit = 37;
     control->referee_energy_buffer = 57;
     control->active_charging_limit_ratio = 0;
+    control->burst_query_power_w = 0;
 }
 
 #define TX_FLAH_ENABLE_DCDC (1 << 0)
@@ -44,9 +45,9 @@ void SuperCap_PackTxData(const SuperCap_Control_t *control,
     // Byte 5: 主动充电限制比例
     tx_buffer[5] = (uint8_t)(control->active_charging_limit_ratio * 255.0f);
 
-    // Byte 6-7: Reserved
-    tx_buffer[6] = 0;
-    tx_buffer[7] = 0;
+    // Byte 6-7: 放电时间预测的目标功率
+    tx_buffer[6] = (uint8_t)(control->burst_query_power_w & 0xFF);
+    tx_buffer[7] = (uint8_t)((control->burst_query_power_w >> 8) & 0xFF);
 }
 
 
@@ -68,7 +69,7 @@ void SuperCap_ParseRxData(const uint8_t *rx_buffer,
     // Byte 0 flag
     uint8_t status = rx_buffer[0];
     feedback->dcdc_enabled = (status & RX_FLAG_DCDC_ENABLED) != 0;
-    feedback->wpt_status = (status & RX_FLAG_WPT_STATUS) >> 4;
+    feedback->wpt_status = (SuperCapWPTStatus_t)((status & RX_FLAG_WPT_STATUS) >> 4);
     feedback->limit_factor = (status & RX_FLAG_LIMIT_FACTOR) >> 2;
     feedback->error_flag = (status & RX_FLAG_ERROR_LEVEL);
 
@@ -89,4 +90,168 @@ void SuperCap_ParseRxData(const uint8_t *rx_buffer,
     // Byte 7: 电容能量
     uint8_t raw_energy = rx_buffer[7];
     feedback->cap_energy_percent = (float)raw_energy / 250.0f;
+
+    // 采样时刻由之后的0x050帧填入
+    feedback->sample_time_valid = false;
+}
+
+void SuperCap_ParseBurstData(const uint8_t *rx_buffer,
+                             SuperCap_BurstFeedback_t *feedback) {
+    if (!rx_buffer || !feedback) return;
+
+    feedback->query_power_w =
+        (uint16_t)rx_buffer[0] | ((uint16_t)rx_buffer[1] << 8);
+    feedback->query_duration_ms =
+        (uint16_t)rx_buffer[2] | ((uint16_t)rx_buffer[3] << 8);
+    feedback->max_power_duration_ms =
+        (uint16_t)rx_buffer[4] | ((uint16_t)rx_buffer[5] << 8);
+    feedback->usable_energy_j =
+        (uint16_t)rx_buffer[6] | ((uint16_t)rx_buffer[7] << 8);
+}
+
+
+#define DIAG_PAGE_ERROR 0
+#define DIAG_PAGE_LOOP 1
+#define DIAG_PAGE_BUS 2
+#define DIAG_PAGE_TX 3
+
+void SuperCap_ParseDiagData(const uint8_t *rx_buffer, SuperCap_Diag_t *diag) {
+    if (!rx_buffer || !diag) return;
+
+    uint8_t page = rx_buffer[0] & 0x03;
+    diag->limit_factor = (SuperCapDiagLimitFactor_t)((rx_buffer[0] >> 2) & 0x07);
+    diag->error_level = rx_buffer[0] >> 5;
+
+    if (page == DIAG_PAGE_ERROR) {
+        diag->error_code = (uint16_t)rx_buffer[1] | ((uint16_t)rx_buffer[2] << 8);
+        diag->error_voltage_v =
+            (int16_t)((uint16_t)rx_buffer[3] | ((uint16_t)rx_buffer[4] << 8)) * 0.01f;
+        diag->error_current_a =
+            (int16_t)((uint16_t)rx_buffer[5] | ((uint16_t)rx_buffer[6] << 8)) * 0.01f;
+        diag->dcdc_mode = rx_buffer[7];
+        diag->error_valid = true;
+    } else if (page == DIAG_PAGE_LOOP) {
+        diag->irq_load = rx_buffer[1] * 0.005f;
+        diag->il_target_a =
+            (int16_t)((uint16_t)rx_buffer[2] | ((uint16_t)rx_buffer[3] << 8)) * 0.01f;
+        diag->capacitance_f =
+            ((uint16_t)rx_buffer[4] | ((uint16_t)rx_buffer[5] << 8)) * 0.001f;
+        diag->rx_timeout_count = (uint16_t)rx_buffer[6] | ((uint16_t)rx_buffer[7] << 8);
+        diag->loop_valid = true;
+    } else if (page == DIAG_PAGE_BUS) {
+        diag->tec = rx_buffer[1];
+        diag->rec = rx_buffer[2];
+        diag->bus_off_count = rx_buffer[3];
+        diag->error_passive_count = rx_buffer[4];
+        diag->recover_count = rx_buffer[5];
+        diag->coalesced_count = (uint16_t)rx_buffer[6] | ((uint16_t)rx_buffer[7] << 8);
+        diag->bus_valid = true;
+    } else {
+        diag->tx_feedback_count = (uint16_t)rx_buffer[1] | ((uint16_t)rx_buffer[2] << 8);
+        diag->tx_reply_count = (uint16_t)rx_buffer[3] | ((uint16_t)rx_buffer[4] << 8);
+        diag->tx_telemetry_count = (uint16_t)rx_buffer[5] | ((uint16_t)rx_buffer[6] << 8);
+        diag->rejected_count = rx_buffer[7];
+        diag->tx_valid = true;
+    }
+}
+
+
+#define TIME_DATA_SYNC 0
+#define TIME_DATA_FEEDBACK 1
+
+#define TIMESYNC_OFFSET_GAIN 0.25f
+#define TIMESYNC_DRIFT_GAIN 0.02f
+#define TIMESYNC_MAX_DRIFT 1e-3f
+#define TIMESYNC_RTT_MARGIN_US 50U      // 往返时间超过下限估计这么多的样本认为有排队延时，丢弃
+#define TIMESYNC_RESYNC_US 10000        // 偏差超过10ms认为超级电容重启过，重新同步
+
+void SuperCap_TimeSync_Init(SuperCap_TimeSync_t *sync) {
+    if (!sync) return;
+    *sync = (SuperCap_TimeSync_t){0};
+}
+
+void SuperCap_PackTimeSyncRequest(SuperCap_TimeSync_t *sync, uint32_t now_us,
+                                  bool enable_timestamp, uint8_t *tx_buffer) {
+    if (!sync || !tx_buffer) return;
+
+    sync->pending_seq = sync->seq++;
+    sync->pending = true;
+    sync->t1_us = now_us;
+
+    tx_buffer[0] = sync->pending_seq;
+    tx_buffer[1] = enable_timestamp ? 1 : 0;
+    for (int i = 2; i < 8; i++) tx_buffer[i] = 0;
+}
+
+static void timesync_update(SuperCap_TimeSync_t *sync, uint32_t t2,
+                            uint16_t delay, uint32_t t4) {
+    uint32_t elapsed = t4 - sync->t1_us;
+    if (elapsed < delay) return;
+    uint32_t rtt = elapsed - delay;
+    sync->rtt_us = rtt;
+
+    // 下限估计缓慢上升，总线负载长期变化后仍能接受新的样本
+    if (!sync->valid || rtt < sync->min_rtt_us)
+        sync->min_rtt_us = rtt;
+    else
+        sync->min_rtt_us++;
+    if (sync->valid && rtt > sync->min_rtt_us + TIMESYNC_RTT_MARGIN_US) {
+        sync->reject_count++;
+        return;
+    }
+
+    // 假设往返两个方向的延时相等，主控的t1、t4中点对应超级电容的t2、t3中点
+    uint32_t local_mid = sync->t1_us + elapsed / 2;
+    uint32_t offset = (t2 + delay / 2) - local_mid;
+    sync->sample_count++;
+
+    if (sync->valid) {
+        int32_t dt = (int32_t)(local_mid - sync->ref_us);
+        if (dt <= 0) return;
+        uint32_t predicted = sync->offset_us + (int32_t)(sync->drift * (float)dt);
+        int32_t err = (int32_t)(offset - predicted);
+        if (err < TIMESYNC_RESYNC_US && err > -TIMESYNC_RESYNC_US) {
+            float drift = sync->drift + TIMESYNC_DRIFT_GAIN * (float)err / (float)dt;
+            if (drift > TIMESYNC_MAX_DRIFT) drift = TIMESYNC_MAX_DRIFT;
+            if (drift < -TIMESYNC_MAX_DRIFT) drift = -TIMESYNC_MAX_DRIFT;
+            sync->drift = drift;
+            sync->offset_us = predicted + (int32_t)(TIMESYNC_OFFSET_GAIN * (float)err);
+            sync->ref_us = local_mid;
+            return;
+        }
+    }
+
+    sync->offset_us = offset;
+    sync->ref_us = local_mid;
+    sync->drift = 0.0f;
+    sync->valid = true;
+}
+
+void SuperCap_ParseTimeData(SuperCap_TimeSync_t *sync, const uint8_t *rx_buffer,
+                            uint32_t now_us, SuperCap_Feedback_t *feedback) {
+    if (!sync || !rx_buffer) return;
+
+    uint8_t type = rx_buffer[0];
+    uint8_t seq = rx_buffer[1];
+    uint16_t delay = (uint16_t)rx_buffer[2] | ((uint16_t)rx_buffer[3] << 8);
+    uint32_t time = (uint32_t)rx_buffer[4] | ((uint32_t)rx_buffer[5] << 8) |
+                    ((uint32_t)rx_buffer[6] << 16) | ((uint32_t)rx_buffer[7] << 24);
+
+    if (type == TIME_DATA_SYNC) {
+        if (!sync->pending || seq != sync->pending_seq) return;
+        sync->pending = false;
+        timesync_update(sync, time, delay, now_us);
+    } else if (type == TIME_DATA_FEEDBACK) {
+        if (!feedback || !sync->valid) return;
+        feedback->sample_time_us = SuperCap_DeviceToLocalTime(sync, time);
+        feedback->sample_time_valid = true;
+    }
+}
+
+uint32_t SuperCap_DeviceToLocalTime(const SuperCap_TimeSync_t *sync,
+                                    uint32_t device_us) {
+    // 用device_us - offset近似代替待求的主控时刻计算漂移项，误差为drift的二阶小量
+    uint32_t local = device_us - sync->offset_us;
+    int32_t dt = (int32_t)(local - sync->ref_us);
+    return local - (int32_t)(sync->drift * (float)dt);
 }
@@ -0,0 +1,248 @@
+"""Braking transient replay for the vA clamp of updateMFLoop.
+
+Runs the 62.5kHz part of updateMFLoop that decides deltaIL: the iR incremental PID, the vA clamp PID
+(VA_CLAMP), the CAPARR_VOLTAGE_MAX / IB_POSITIVE / IB_NEGATIVE limits and the iLLimit clamp, with
+updateMaxCurrent in front. Gains and thresholds are the firmware defaults, read from the parameter
+table in Param.cpp and from Config.hpp, so the replay follows changes to them. Values changed at run
+time with `param set` are not seen.
+
+Plant: the referee supply is a source behind a series resistance and a diode (it cannot sink current)
+into the A side bus capacitance, the chassis draws or regenerates power on the same bus, and the
+converter moves iL between the bus and the capacitor bank. iL follows iLTarget with a first order lag
+for the peak current loop. vA, iR and iCap go through the ADC filters of updateADC.
+
+Each scenario brakes from a cruise load: the chassis power ramps to --regen W (negative load) and back.
+The report gives the peak vA against OVP_A and the peak vCap against CAPARR_MAX_VOLTAGE. --no-clamp
+also runs each scenario with the clamp disabled, which is the deltaIL logic before VA_CLAMP.
+
+    python braking_sim.py
+    python braking_sim.py --regen 400 --brake 0.5
+    python braking_sim.py --vcap 28.4 --no-clamp
+    python braking_sim.py --bus-cap 470e-6 --trace brake.csv
+"""
+import argparse
+import os
+import re
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'Core')
+CONFIG = os.path.join(ROOT, 'Inc', 'Config.hpp')
+PARAM = os.path.join(ROOT, 'Src', 'Param.cpp')
+MF_PERIOD = 16e-6
+CAPACITY = 4.4                      # F, SUPERCAP_CAPARR_DEFAULT_CAPACITY
+EFFICIENCY = 0.95                   # converter, each direction
+REFEREE_VOLTAGE = 24.0
+REFEREE_RESISTANCE = 0.08           # supply, cable and iR shunt
+IL_TAU = 40e-6                      # peak current loop, iL to iLTarget
+CRUISE_POWER = 80.0                 # W before and after the brake
+RAMP = 0.005                        # s, cruise to regen
+
+
+def read_config(path=CONFIG):
+    values = {}
+    with open(path, encoding='utf-8') as f:
+        for line in f:
+            m = re.match(r'#define\s+(\w+)\s+(-?[\d.]+)[fU]?\b', line)
+            if m:
+                values[m.group(1)] = float(m.group(2))
+    return values
+
+
+def read_gains(config, path=PARAM):
+    """Defaults of the paramTable entries; a default may be a Config.hpp macro."""
+    with open(path, encoding='utf-8') as f:
+        text = f.read()
+    defaults = {}
+    for name, value in re.findall(r'\{PARAM_(\w+),\s*PARAM_TYPE_\w+,\s*[^,]+,\s*[^,]+,\s*([^,]+),', text):
+        value = value.strip()
+        defaults[name] = config[value] if value in config else float(value.rstrip('f'))
+
+    def pid(prefix):
+        return tuple(defaults[f'{prefix}_{k}'] for k in ('KTP', 'KMP', 'KI', 'KD'))
+
+    return {
+        'ir': pid('IR'),
+        'vaclamp': pid('VACLAMP'),
+        'vaclamp_voltage': defaults['VACLAMP_VOLTAGE'],
+        'current_limit_ki': defaults['CURRENT_LIMIT_KI'],
+        'voltage_limit_ki': defaults['VOLTAGE_LIMIT_KI'],
+        'caparr_low_voltage': defaults['CAPARR_LOW_VOLTAGE'],
+        'caparr_cutoff_voltage': defaults['CAPARR_CUTOFF_VOLTAGE'],
+        'caparr_max_current': defaults['CAPARR_MAX_CURRENT'],
+    }
+
+
+class IncreasementPID:
+    def __init__(self, ktp, kmp, ki, kd):
+        self.ktp, self.kmp, self.ki, self.kd = ktp, kmp, ki, kd
+        self.t1 = self.m1 = self.e2 = 0.0
+
+    def compute_delta(self, target, current):
+        delta = (self.ktp * (target - self.t1) + self.kmp * (current - self.m1) + self.ki * (target - current)
+                 + self.kd * ((target - current) - 2 * (self.t1 - self.m1) + self.e2))
+        self.e2 = self.t1 - self.m1
+        self.t1, self.m1 = target, current
+        return delta
+
+
+class MFLoop:
+    """The deltaIL part of updateMFLoop and updateMaxCurrent, enableActiveChargingLimit off."""
+
+    def __init__(self, cfg, gains, clamp=True):
+        self.cfg, self.clamp = cfg, clamp
+        self.ir_pid = IncreasementPID(*gains['ir'])
+        self.va_pid = IncreasementPID(*gains['vaclamp'])
+        self.va_clamp = gains['vaclamp_voltage']
+        self.current_ki = gains['current_limit_ki']
+        self.voltage_ki = gains['voltage_limit_ki']
+        self.low_voltage = gains['caparr_low_voltage']
+        self.cutoff_voltage = gains['caparr_cutoff_voltage']
+        self.ib_limit = gains['caparr_max_current']     # continuous bank current limit
+        self.il_limit = cfg['MAX_INDUCTOR_CURRENT']
+        self.il_target = 0.0
+        self.limit_factor = 'REFEREE_POWER'
+
+    def max_current(self, vcap):
+        if vcap > self.low_voltage:
+            return self.ib_limit, self.ib_limit
+        if vcap > self.cutoff_voltage:
+            i = (self.ib_limit - 1.0) / (self.low_voltage - self.cutoff_voltage) * (vcap - self.cutoff_voltage) + 1.0
+            return i, i
+        return 1.0, 0.2 + 0.8 / 5.0 * vcap
+
+    def step(self, p_referee, va, ir, vcap, icap):
+        cap_max = self.cfg['CAPARR_MAX_VOLTAGE']
+        max_in, max_out = self.max_current(vcap)
+        delta = self.ir_pid.compute_delta(p_referee / va, ir)
+        self.limit_factor = 'REFEREE_POWER'
+        d_clamp = self.va_pid.compute_delta(va, self.va_clamp)
+        if self.clamp and va > self.va_clamp and d_clamp > delta:
+            delta = d_clamp
+            self.limit_factor = 'VA_CLAMP'
+        d_vcap = self.voltage_ki * (cap_max - vcap)
+        d_ib_pos = self.current_ki * (max_in - icap)
+        d_ib_neg = self.current_ki * (-icap - max_out)
+        clamped = self.limit_factor == 'VA_CLAMP'
+        if vcap > cap_max * 0.95 and (not clamped or vcap >= cap_max) and d_vcap < delta:
+            delta = max(d_vcap, -self.il_target) if clamped else d_vcap
+            self.limit_factor = 'CAPARR_VOLTAGE_MAX'
+        elif icap > max_in and d_ib_pos < delta:
+            delta = d_ib_pos
+            self.limit_factor = 'IB_POSITIVE'
+        elif icap < -max_out and d_ib_neg > delta:
+            delta = d_ib_neg
+            self.limit_factor = 'IB_NEGATIVE'
+        self.il_target = min(self.il_limit, max(-self.il_limit, self.il_target + delta))
+        if vcap < self.cutoff_voltage and self.il_target > max_in:
+            self.il_target = max_in
+        return self.il_target
+
+
+def chassis_power(t, args):
+    """Cruise, ramp to -regen, hold for --brake seconds, ramp back to cruise."""
+    start, end = args.start, args.start + RAMP + args.brake
+    if t < start or t >= end + RAMP:
+        return CRUISE_POWER
+    if t < start + RAMP:
+        x = (t - start) / RAMP
+    elif t < end:
+        x = 1.0
+    else:
+        x = 1.0 - (t - end) / RAMP
+    return CRUISE_POWER + x * (-args.regen - CRUISE_POWER)
+
+
+def simulate(args, cfg, gains, vcap0, clamp):
+    loop = MFLoop(cfg, gains, clamp)
+    alpha_i, alpha_v = cfg['ADC_ISENSE_ALPHA'], cfg['ADC_VSENSE_ALPHA']
+    va, vcap, il = REFEREE_VOLTAGE, vcap0, 0.0
+    va_adc, ir_adc, icap_adc = va, 0.0, 0.0
+    result = {'va_max': va, 'va_max_t': 0.0, 'vcap_max': vcap, 'ovp_t': None, 'vcap_max_t': None,
+              'factors': {}}
+    trace = []
+    for step in range(int(args.time / MF_PERIOD)):
+        t = step * MF_PERIOD
+        # plant over one MF period, a few substeps for the bus capacitance
+        sub = 4
+        dt = MF_PERIOD / sub
+        for _ in range(sub):
+            ir = max(0.0, (REFEREE_VOLTAGE - va) / REFEREE_RESISTANCE)
+            i_chassis = chassis_power(t, args) / va
+            p_cap = il * vcap
+            i_conv = (p_cap / EFFICIENCY if p_cap > 0 else p_cap * EFFICIENCY) / va
+            va += (ir - i_chassis - i_conv) * dt / args.bus_cap
+            il += (loop.il_target - il) * dt / IL_TAU
+            vcap += il * dt / CAPACITY
+        ir_adc = (1 - alpha_i) * ir_adc + alpha_i * ir
+        va_adc = (1 - alpha_v) * va_adc + alpha_v * va
+        icap_adc = (1 - alpha_i) * icap_adc + alpha_i * il
+
+        loop.step(args.limit, va_adc, ir_adc, vcap, icap_adc)
+        result['factors'][loop.limit_factor] = result['factors'].get(loop.limit_factor, 0) + 1
+
+        if va > result['va_max']:
+            result['va_max'], result['va_max_t'] = va, t
+        if vcap > result['vcap_max']:
+            result['vcap_max'] = vcap
+        if result['vcap_max_t'] is None and vcap >= cfg['CAPARR_MAX_VOLTAGE'] - 0.01:
+            result['vcap_max_t'] = t
+        if va > cfg['OVP_A']:
+            # the ADC watchdog raises ERROR_OVP_A and the output turns off, the replay stops here
+            result['ovp_t'] = t
+            break
+        if args.trace_file and step % 8 == 0:
+            trace.append(f"{t:.6f},{chassis_power(t, args):.1f},{va:.3f},{ir:.3f},{loop.il_target:.3f},{il:.3f},"
+                         f"{vcap:.3f},{loop.limit_factor}")
+    if args.trace_file:
+        args.trace_file.write('t,p_chassis,va,ir,il_target,il,vcap,limit_factor\n' + '\n'.join(trace) + '\n')
+    return result
+
+
+def report(name, result, cfg, vcap0):
+    ovp, cap_max = cfg['OVP_A'], cfg['CAPARR_MAX_VOLTAGE']
+    va = f"vA max {result['va_max']:6.3f} V at {result['va_max_t'] * 1000:6.1f} ms ({ovp - result['va_max']:+.3f} V to OVP_A)"
+    if result['ovp_t'] is not None:
+        va = f"OVP_A at {result['ovp_t'] * 1000:6.1f} ms"
+        if result['vcap_max_t'] is not None and result['vcap_max_t'] < result['ovp_t']:
+            va += " (bank full, the regen has no sink)"
+    cap = f"vCap {vcap0:5.2f} -> max {result['vcap_max']:6.3f} V"
+    if result['vcap_max_t'] is not None:
+        cap += f" (reached {cap_max:.1f} V at {result['vcap_max_t'] * 1000:.1f} ms)"
+    total = sum(result['factors'].values())
+    factors = ', '.join(f"{k} {100.0 * v / total:.1f}%" for k, v in
+                        sorted(result['factors'].items(), key=lambda kv: -kv[1]) if v * 1000 >= total)
+    print(f"{name:<28} {va} | {cap}\n{'':<28} limit factors: {factors}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--time', type=float, default=1.0, help='simulated seconds')
+    parser.add_argument('--limit', type=float, default=60.0, help='referee power target in W')
+    parser.add_argument('--regen', type=float, default=250.0, help='regenerated power while braking in W')
+    parser.add_argument('--start', type=float, default=0.1, help='brake start in s')
+    parser.add_argument('--brake', type=float, default=0.3, help='brake duration in s, without the ramps')
+    parser.add_argument('--bus-cap', type=float, default=1000e-6, help='A side bus capacitance in F')
+    parser.add_argument('--vcap', type=float, action='append',
+                        help='initial capacitor voltage, repeat for several scenarios (default 20, 27.5, 28.2, 28.5)')
+    parser.add_argument('--no-clamp', action='store_true', help='also run without the vA clamp loop')
+    parser.add_argument('--trace', type=argparse.FileType('w'), dest='trace_file',
+                        help='CSV trace of the first scenario, every 8 MF cycles')
+    args = parser.parse_args()
+
+    cfg = read_config()
+    gains = read_gains(cfg)
+    print(f"OVP_A {cfg['OVP_A']} V, vA clamp {gains['vaclamp_voltage']} V "
+          f"(kTP {gains['vaclamp'][0]}, kI {gains['vaclamp'][2]}), "
+          f"CAPARR_MAX_VOLTAGE {cfg['CAPARR_MAX_VOLTAGE']} V, iB limit {gains['caparr_max_current']} A, "
+          f"bus {args.bus_cap * 1e6:.0f} uF, regen {args.regen:.0f} W for {args.brake * 1000:.0f} ms")
+    trace_file = args.trace_file
+    for vcap0 in args.vcap or [20.0, 27.5, 28.2, 28.5]:
+        for clamp in (True, False) if args.no_clamp else (True,):
+            result = simulate(args, cfg, gains, vcap0, clamp)
+            args.trace_file = None
+            report(f"vCap {vcap0:.1f} V{'' if clamp else ', no clamp'}", result, cfg, vcap0)
+    if trace_file:
+        trace_file.close()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,981 @@
+// Native CAN logger: owns the bus, timestamps every frame, writes a binary log and feeds live consumers.
+//
+// Build (Linux):
+//   g++ -O2 -std=c++17 -Wall tools/canlog/canlog.cpp -o canlog
+// Usage:
+//   canlog can:vcan0 -o match.sclog --stats            SocketCAN, kernel timestamps, recvmmsg batches
+//   canlog slcan:/dev/ttyACM0 --bitrate 1000000 -o match.sclog
+//   canlog can:can0 --live /tmp/canlog.sock            slcan_monitor.py --interface canlog /tmp/canlog.sock
+//
+// Log file: 16-byte header (magic "SCCANLOG", u16 version, u16 header size, u32 reserved) followed by
+// records, all little-endian: u64 timestamp_ns (CLOCK_REALTIME), u32 can_id (SocketCAN flags kept),
+// u8 len, u8 flags, u16 reserved, then len data bytes. tools/canlog/canlog.py reads and converts it.
+//
+// Live socket: a unix datagram socket. An empty datagram subscribes (send one every second as keepalive),
+// a datagram of records is transmitted on the bus. Received frames go to every subscriber in batches of
+// the same records; a subscriber that cannot keep up loses batches, the logger never waits for it.
+
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <net/if.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <linux/can.h>
+#include <linux/can/raw.h>
+
+#ifndef SO_RXQ_OVFL
+#define SO_RXQ_OVFL 40
+#endif
+
+namespace canlog
+{
+
+constexpr char LOG_MAGIC[8] = {'S', 'C', 'C', 'A', 'N', 'L', 'O', 'G'};
+constexpr uint16_t LOG_VERSION = 1;
+
+constexpr uint8_t FLAG_FD = 0x01;
+constexpr uint8_t FLAG_BRS = 0x02;
+constexpr uint8_t FLAG_ESI = 0x04;
+constexpr uint8_t FLAG_TX = 0x08;       // sent by this logger on behalf of a live client
+constexpr uint8_t FLAG_EVENT = 0x80;    // not a bus frame, can_id holds the event type
+constexpr uint32_t EVENT_KERNEL_DROP = 1;   // data: u32 frames dropped by the socket queue since the last event
+
+constexpr size_t RECV_BATCH = 64;       // frames per recvmmsg
+constexpr size_t FILE_BUFFER = 1 << 20;
+constexpr size_t FILE_FLUSH = 256 << 10;
+constexpr int FLUSH_INTERVAL_MS = 200;
+constexpr size_t LIVE_DATAGRAM = 60000;
+constexpr size_t LIVE_CLIENT_MAX = 8;
+constexpr int LIVE_CLIENT_TIMEOUT_S = 5;
+constexpr int SOCKET_RCVBUF = 4 << 20;
+
+#pragma pack(push, 1)
+struct FileHeader
+{
+    char magic[8];
+    uint16_t version;
+    uint16_t headerSize;
+    uint32_t reserved;
+};
+
+struct RecordHeader
+{
+    uint64_t timestampNs;
+    uint32_t canId;
+    uint8_t len;
+    uint8_t flags;
+    uint16_t reserved;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(FileHeader) == 16 && sizeof(RecordHeader) == 16, "log layout is fixed");
+
+struct Frame
+{
+    uint64_t timestampNs;
+    uint32_t canId;
+    uint8_t len;
+    uint8_t flags;
+    uint8_t data[CANFD_MAX_DLEN];
+};
+
+struct Options
+{
+    std::string source;
+    std::string output;
+    std::string live;
+    uint32_t bitrate = 1000000;
+    uint32_t fdBitrate = 0;             // slcan only, 0 keeps the adapter default
+    uint32_t ttyBaud = 115200;
+    bool slcanInit = true;
+    bool stats = false;
+};
+
+struct Stats
+{
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+    uint64_t kernelDrops = 0;
+    uint64_t liveDrops = 0;
+    uint64_t txFrames = 0;
+    uint64_t batches = 0;
+};
+
+static volatile sig_atomic_t running = 1;
+
+static void onSignal(int)
+{
+    running = 0;
+}
+
+static uint64_t realtimeNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t monotonicMs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ull + (uint64_t)ts.tv_nsec / 1000000ull;
+}
+
+static size_t appendRecord(uint8_t *out, const Frame &f)
+{
+    RecordHeader h = {f.timestampNs, f.canId, f.len, f.flags, 0};
+    memcpy(out, &h, sizeof(h));
+    memcpy(out + sizeof(h), f.data, f.len);
+    return sizeof(h) + f.len;
+}
+
+// Buffered log writer, one write(2) per FILE_FLUSH bytes or FLUSH_INTERVAL_MS
+class LogFile
+{
+  public:
+    bool open(const std::string &path)
+    {
+        fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd_ < 0)
+            return false;
+        buffer_.resize(FILE_BUFFER);
+        FileHeader h = {};
+        memcpy(h.magic, LOG_MAGIC, sizeof(h.magic));
+        h.version = LOG_VERSION;
+        h.headerSize = sizeof(FileHeader);
+        memcpy(buffer_.data(), &h, sizeof(h));
+        used_ = sizeof(h);
+        return true;
+    }
+
+    bool active() const { return fd_ >= 0; }
+
+    void append(const Frame &f)
+    {
+        if (fd_ < 0)
+            return;
+        if (used_ + sizeof(RecordHeader) + CANFD_MAX_DLEN > buffer_.size())
+            flush();
+        used_ += appendRecord(buffer_.data() + used_, f);
+        if (used_ >= FILE_FLUSH)
+            flush();
+    }
+
+    void flush()
+    {
+        size_t done = 0;
+        while (fd_ >= 0 && done < used_)
+        {
+            ssize_t n = ::write(fd_, buffer_.data() + done, used_ - done);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+            {
+                perror("canlog: write");
+                ::close(fd_);
+                fd_ = -1;
+                break;
+            }
+            done += (size_t)n;
+            written_ += (uint64_t)n;
+        }
+        used_ = 0;
+    }
+
+    void close()
+    {
+        flush();
+        if (fd_ >= 0)
+            ::close(fd_);
+        fd_ = -1;
+    }
+
+    uint64_t written() const { return written_ + used_; }
+
+  private:
+    int fd_ = -1;
+    std::vector<uint8_t> buffer_;
+    size_t used_ = 0;
+    uint64_t written_ = 0;
+};
+
+// Live consumers on a unix datagram socket
+class LiveServer
+{
+  public:
+    bool open(const std::string &path)
+    {
+        fd_ = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd_ < 0)
+            return false;
+        sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path))
+            return false;
+        memcpy(addr.sun_path, path.c_str(), path.size());
+        unlink(path.c_str());
+        if (bind(fd_, (sockaddr *)&addr, sizeof(addr)) < 0)
+            return false;
+        int sndbuf = SOCKET_RCVBUF;
+        setsockopt(fd_, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+        path_ = path;
+        batch_.resize(LIVE_DATAGRAM);
+        return true;
+    }
+
+    int fd() const { return fd_; }
+    bool active() const { return fd_ >= 0; }
+
+    void append(const Frame &f, Stats &stats)
+    {
+        if (fd_ < 0 || clients_.empty())
+            return;
+        if (used_ + sizeof(RecordHeader) + CANFD_MAX_DLEN > batch_.size())
+            publish(stats);
+        used_ += appendRecord(batch_.data() + used_, f);
+    }
+
+    void publish(Stats &stats)
+    {
+        if (used_ == 0)
+            return;
+        for (size_t i = 0; i < clients_.size();)
+        {
+            Client &c = clients_[i];
+            ssize_t n = sendto(fd_, batch_.data(), used_, MSG_DONTWAIT, (sockaddr *)&c.addr, c.addrLen);
+            if (n < 0 && (errno == EAGAIN || errno == ENOBUFS))
+                stats.liveDrops++;
+            else if (n < 0)
+            {
+                // ECONNREFUSED / ENOENT: the client is gone
+                clients_.erase(clients_.begin() + (long)i);
+                continue;
+            }
+            i++;
+        }
+        used_ = 0;
+    }
+
+    // Drain client datagrams, subscriptions are recorded, frames are returned for transmission
+    template <typename Transmit> void receive(Transmit transmit)
+    {
+        uint8_t buf[LIVE_DATAGRAM];
+        for (;;)
+        {
+            Client from = {};
+            from.addrLen = sizeof(from.addr);
+            ssize_t n = recvfrom(fd_, buf, sizeof(buf), MSG_DONTWAIT, (sockaddr *)&from.addr, &from.addrLen);
+            if (n < 0)
+                break;
+            subscribe(from);
+            for (size_t off = 0; off + sizeof(RecordHeader) <= (size_t)n;)
+            {
+                RecordHeader h;
+                memcpy(&h, buf + off, sizeof(h));
+                if (h.len > CANFD_MAX_DLEN || off + sizeof(h) + h.len > (size_t)n)
+                    break;
+                Frame f = {};
+                f.canId = h.canId;
+                f.len = h.len;
+                f.flags = (uint8_t)(h.flags & (FLAG_FD | FLAG_BRS));
+                memcpy(f.data, buf + off + sizeof(h), h.len);
+                transmit(f);
+                off += sizeof(h) + h.len;
+            }
+        }
+    }
+
+    void expire(uint64_t nowMs)
+    {
+        for (size_t i = 0; i < clients_.size();)
+        {
+            if (nowMs - clients_[i].seenMs > LIVE_CLIENT_TIMEOUT_S * 1000ull)
+                clients_.erase(clients_.begin() + (long)i);
+            else
+                i++;
+        }
+    }
+
+    size_t clients() const { return clients_.size(); }
+
+    void close()
+    {
+        if (fd_ < 0)
+            return;
+        ::close(fd_);
+        unlink(path_.c_str());
+        fd_ = -1;
+    }
+
+  private:
+    struct Client
+    {
+        sockaddr_un addr;
+        socklen_t addrLen;
+        uint64_t seenMs;
+    };
+
+    void subscribe(Client &from)
+    {
+        from.seenMs = monotonicMs();
+        for (Client &c : clients_)
+        {
+            if (c.addrLen == from.addrLen && !memcmp(&c.addr, &from.addr, from.addrLen))
+            {
+                c.seenMs = from.seenMs;
+                return;
+            }
+        }
+        if (clients_.size() < LIVE_CLIENT_MAX && from.addrLen > sizeof(sa_family_t))
+            clients_.push_back(from);
+    }
+
+    int fd_ = -1;
+    std::string path_;
+    std::vector<Client> clients_;
+    std::vector<uint8_t> batch_;
+    size_t used_ = 0;
+};
+
+// Bus backends: readBatch() returns up to max timestamped frames without blocking, write() transmits one
+class Source
+{
+  public:
+    virtual ~Source() = default;
+    virtual int fd() const = 0;
+    virtual size_t readBatch(Frame *frames, size_t max, Stats &stats) = 0;
+    virtual bool write(const Frame &f) = 0;
+};
+
+class SocketCanSource : public Source
+{
+  public:
+    bool open(const std::string &ifname)
+    {
+        fd_ = socket(PF_CAN, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, CAN_RAW);
+        if (fd_ < 0)
+        {
+            perror("canlog: socket(PF_CAN)");
+            return false;
+        }
+        int on = 1;
+        // FD frames are optional: classic-only interfaces reject the option but still work
+        setsockopt(fd_, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &on, sizeof(on));
+        // Own transmissions come back flagged MSG_CONFIRM, so TX frames get a kernel timestamp too
+        setsockopt(fd_, SOL_CAN_RAW, CAN_RAW_RECV_OWN_MSGS, &on, sizeof(on));
+        setsockopt(fd_, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+        setsockopt(fd_, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on));
+        int rcvbuf = SOCKET_RCVBUF;
+        if (setsockopt(fd_, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf, sizeof(rcvbuf)) < 0)
+            setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+        ifreq ifr = {};
+        if (ifname.size() >= sizeof(ifr.ifr_name))
+            return false;
+        memcpy(ifr.ifr_name, ifname.c_str(), ifname.size());
+        if (ioctl(fd_, SIOCGIFINDEX, &ifr) < 0)
+        {
+            perror("canlog: SIOCGIFINDEX");
+            return false;
+        }
+        sockaddr_can addr = {};
+        addr.can_family = AF_CAN;
+        addr.can_ifindex = ifr.ifr_ifindex;
+        if (bind(fd_, (sockaddr *)&addr, sizeof(addr)) < 0)
+        {
+            perror("canlog: bind");
+            return false;
+        }
+
+        for (size_t i = 0; i < RECV_BATCH; i++)
+        {
+            iov_[i] = {&frames_[i], sizeof(frames_[i])};
+            msgs_[i].msg_hdr.msg_iov = &iov_[i];
+            msgs_[i].msg_hdr.msg_iovlen = 1;
+        }
+        return true;
+    }
+
+    ~SocketCanSource() override
+    {
+        if (fd_ >= 0)
+            close(fd_);
+    }
+
+    int fd() const override { return fd_; }
+
+    size_t readBatch(Frame *out, size_t max, Stats &stats) override
+    {
+        if (max > RECV_BATCH)
+            max = RECV_BATCH;
+        for (size_t i = 0; i < max; i++)
+        {
+            msgs_[i].msg_hdr.msg_control = control_[i];
+            msgs_[i].msg_hdr.msg_controllen = sizeof(control_[i]);
+            msgs_[i].msg_hdr.msg_flags = 0;
+        }
+        int n = recvmmsg(fd_, msgs_, (unsigned)max, MSG_DONTWAIT, nullptr);
+        if (n <= 0)
+            return 0;
+
+        uint64_t fallbackNs = 0;
+        for (int i = 0; i < n; i++)
+        {
+            Frame &f = out[i];
+            f = {};
+            uint32_t dropCount = dropCount_;
+            for (cmsghdr *c = CMSG_FIRSTHDR(&msgs_[i].msg_hdr); c; c = CMSG_NXTHDR(&msgs_[i].msg_hdr, c))
+            {
+                if (c->cmsg_level != SOL_SOCKET)
+                    continue;
+                if (c->cmsg_type == SO_TIMESTAMPNS)
+                {
+                    timespec ts;
+                    memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+                    f.timestampNs = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+                }
+                else if (c->cmsg_type == SO_RXQ_OVFL)
+                    memcpy(&dropCount, CMSG_DATA(c), sizeof(dropCount));
+            }
+            if (!f.timestampNs)
+                f.timestampNs = fallbackNs ? fallbackNs : (fallbackNs = realtimeNs());
+            if (dropCount != dropCount_)
+            {
+                stats.kernelDrops += (uint32_t)(dropCount - dropCount_);
+                pendingDrops_ += (uint32_t)(dropCount - dropCount_);
+                dropCount_ = dropCount;
+            }
+
+            const canfd_frame &cf = frames_[i];
+            f.canId = cf.can_id;
+            if (msgs_[i].msg_len == CANFD_MTU)
+            {
+                f.flags = FLAG_FD;
+                if (cf.flags & CANFD_BRS)
+                    f.flags |= FLAG_BRS;
+                if (cf.flags & CANFD_ESI)
+                    f.flags |= FLAG_ESI;
+                f.len = cf.len > CANFD_MAX_DLEN ? CANFD_MAX_DLEN : cf.len;
+            }
+            else
+                f.len = cf.len > CAN_MAX_DLEN ? CAN_MAX_DLEN : cf.len;
+            if (msgs_[i].msg_hdr.msg_flags & MSG_CONFIRM)
+                f.flags |= FLAG_TX;
+            memcpy(f.data, cf.data, f.len);
+        }
+        return (size_t)n;
+    }
+
+    // Kernel queue overflows since the last call, logged as an event record
+    uint32_t takeDrops()
+    {
+        uint32_t d = pendingDrops_;
+        pendingDrops_ = 0;
+        return d;
+    }
+
+    bool write(const Frame &f) override
+    {
+        canfd_frame cf = {};
+        cf.can_id = f.canId;
+        cf.len = f.len;
+        memcpy(cf.data, f.data, f.len);
+        size_t size = CAN_MTU;
+        if (f.flags & FLAG_FD)
+        {
+            size = CANFD_MTU;
+            cf.flags = (f.flags & FLAG_BRS) ? CANFD_BRS : 0;
+        }
+        else if (f.len > CAN_MAX_DLEN)
+            return false;
+        return ::write(fd_, &cf, size) == (ssize_t)size;
+    }
+
+  private:
+    int fd_ = -1;
+    canfd_frame frames_[RECV_BATCH];
+    iovec iov_[RECV_BATCH];
+    mmsghdr msgs_[RECV_BATCH] = {};
+    alignas(cmsghdr) uint8_t control_[RECV_BATCH][CMSG_SPACE(sizeof(timespec)) + CMSG_SPACE(sizeof(uint32_t))];
+    uint32_t dropCount_ = 0;
+    uint32_t pendingDrops_ = 0;
+};
+
+// slcan (Lawicel ASCII, with the d/D/b/B CAN-FD extension) on a serial port or pty.
+// Every frame from one read() gets the same host timestamp.
+class SlcanSource : public Source
+{
+  public:
+    bool open(const Options &opt, const std::string &path)
+    {
+        fd_ = ::open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+        if (fd_ < 0)
+        {
+            perror("canlog: open tty");
+            return false;
+        }
+        termios tio;
+        if (tcgetattr(fd_, &tio) == 0)
+        {
+            cfmakeraw(&tio);
+            speed_t speed = ttySpeed(opt.ttyBaud);
+            cfsetispeed(&tio, speed);
+            cfsetospeed(&tio, speed);
+            tcsetattr(fd_, TCSANOW, &tio);
+        }
+        init_ = opt.slcanInit;
+        if (init_)
+        {
+            command("C");
+            command(std::string("S") + bitrateCode(opt.bitrate));
+            if (opt.fdBitrate)
+                command(std::string("Y") + std::to_string(opt.fdBitrate / 1000000));
+            command("O");
+        }
+        return true;
+    }
+
+    ~SlcanSource() override
+    {
+        if (fd_ < 0)
+            return;
+        // Close the channel again, the adapter may already be gone
+        if (init_)
+        {
+            ssize_t ignored = ::write(fd_, "C\r", 2);
+            (void)ignored;
+        }
+        close(fd_);
+    }
+
+    int fd() const override { return fd_; }
+
+    size_t readBatch(Frame *out, size_t max, Stats &) override
+    {
+        size_t count = 0;
+        while (count < max)
+        {
+            // Parse complete lines already buffered before reading more
+            size_t end = 0;
+            while (end < lineLen_ && line_[end] != '\r' && line_[end] != '\a')
+                end++;
+            if (end < lineLen_)
+            {
+                if (parse(line_, end, out[count]))
+                    out[count++].timestampNs = readNs_;
+                memmove(line_, line_ + end + 1, lineLen_ - end - 1);
+                lineLen_ -= end + 1;
+                continue;
+            }
+            if (lineLen_ == sizeof(line_))
+                lineLen_ = 0;           // garbage without a terminator
+            ssize_t n = ::read(fd_, line_ + lineLen_, sizeof(line_) - lineLen_);
+            if (n <= 0)
+                break;
+            readNs_ = realtimeNs();
+            lineLen_ += (size_t)n;
+        }
+        return count;
+    }
+
+    bool write(const Frame &f) override
+    {
+        static const char hex[] = "0123456789ABCDEF";
+        char buf[8 + 1 + 1 + 2 * CANFD_MAX_DLEN + 1];
+        size_t n = 0;
+        bool ext = f.canId & CAN_EFF_FLAG;
+        uint8_t dlc = lenToDlc(f.len);
+        if (f.flags & FLAG_FD)
+            buf[n++] = (f.flags & FLAG_BRS) ? (ext ? 'B' : 'b') : (ext ? 'D' : 'd');
+        else if (f.len > CAN_MAX_DLEN)
+            return false;
+        else
+            buf[n++] = (f.canId & CAN_RTR_FLAG) ? (ext ? 'R' : 'r') : (ext ? 'T' : 't');
+        uint32_t id = f.canId & (ext ? CAN_EFF_MASK : CAN_SFF_MASK);
+        for (int shift = ext ? 28 : 8; shift >= 0; shift -= 4)
+            buf[n++] = hex[(id >> shift) & 0xF];
+        buf[n++] = hex[dlc];
+        if (!(f.canId & CAN_RTR_FLAG))
+        {
+            for (uint8_t i = 0; i < f.len; i++)
+            {
+                buf[n++] = hex[f.data[i] >> 4];
+                buf[n++] = hex[f.data[i] & 0xF];
+            }
+        }
+        buf[n++] = '\r';
+        return ::write(fd_, buf, n) == (ssize_t)n;
+    }
+
+  private:
+    static speed_t ttySpeed(uint32_t baud)
+    {
+        switch (baud)
+        {
+        case 9600: return B9600;
+        case 57600: return B57600;
+        case 230400: return B230400;
+        case 460800: return B460800;
+        case 921600: return B921600;
+        case 1000000: return B1000000;
+        case 2000000: return B2000000;
+        case 3000000: return B3000000;
+        default: return B115200;
+        }
+    }
+
+    static const char *bitrateCode(uint32_t bitrate)
+    {
+        switch (bitrate)
+        {
+        case 10000: return "0";
+        case 20000: return "1";
+        case 50000: return "2";
+        case 100000: return "3";
+        case 125000: return "4";
+        case 250000: return "5";
+        case 500000: return "6";
+        case 800000: return "7";
+        default: return "8";
+        }
+    }
+
+    static uint8_t lenToDlc(uint8_t len)
+    {
+        static const uint8_t fdLen[] = {12, 16, 20, 24, 32, 48, 64};
+        if (len <= 8)
+            return len;
+        for (uint8_t i = 0; i < sizeof(fdLen); i++)
+            if (len <= fdLen[i])
+                return (uint8_t)(9 + i);
+        return 15;
+    }
+
+    static int hexValue(char c)
+    {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        return -1;
+    }
+
+    static bool parseHex(const char *s, size_t digits, uint32_t &value)
+    {
+        value = 0;
+        for (size_t i = 0; i < digits; i++)
+        {
+            int v = hexValue(s[i]);
+            if (v < 0)
+                return false;
+            value = value << 4 | (uint32_t)v;
+        }
+        return true;
+    }
+
+    static bool parse(const char *s, size_t len, Frame &f)
+    {
+        static const uint8_t dlcLen[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64};
+        if (len == 0)
+            return false;
+        f = {};
+        bool ext, rtr = false;
+        switch (s[0])
+        {
+        case 't': ext = false; break;
+        case 'T': ext = true; break;
+        case 'r': ext = false; rtr = true; break;
+        case 'R': ext = true; rtr = true; break;
+        case 'd': ext = false; f.flags = FLAG_FD; break;
+        case 'D': ext = true; f.flags = FLAG_FD; break;
+        case 'b': ext = false; f.flags = FLAG_FD | FLAG_BRS; break;
+        case 'B': ext = true; f.flags = FLAG_FD | FLAG_BRS; break;
+        default: return false;          // command replies ("z", "Z", version strings)
+        }
+        size_t idDigits = ext ? 8 : 3;
+        uint32_t id, dlc;
+        if (len < 1 + idDigits + 1 || !parseHex(s + 1, idDigits, id) || !parseHex(s + 1 + idDigits, 1, dlc))
+            return false;
+        if (!(f.flags & FLAG_FD) && dlc > CAN_MAX_DLEN)
+            return false;
+        f.len = dlcLen[dlc];
+        f.canId = id | (ext ? CAN_EFF_FLAG : 0) | (rtr ? CAN_RTR_FLAG : 0);
+        if (rtr)
+            return true;
+        const char *data = s + 2 + idDigits;
+        // A trailing 4-digit timestamp (Z1) is allowed and ignored
+        if (len < 2 + idDigits + 2 * (size_t)f.len)
+            return false;
+        for (uint8_t i = 0; i < f.len; i++)
+        {
+            uint32_t b;
+            if (!parseHex(data + 2 * i, 2, b))
+                return false;
+            f.data[i] = (uint8_t)b;
+        }
+        return true;
+    }
+
+    void command(const std::string &cmd)
+    {
+        std::string line = cmd + "\r";
+        if (::write(fd_, line.data(), line.size()) < 0)
+            perror("canlog: slcan command");
+    }
+
+    int fd_ = -1;
+    bool init_ = false;
+    char line_[4096];
+    size_t lineLen_ = 0;
+    uint64_t readNs_ = 0;
+};
+
+static void usage()
+{
+    fprintf(stderr,
+            "usage: canlog <can:IFNAME | slcan:TTY> [options]\n"
+            "  -o FILE            write the binary log\n"
+            "  --live PATH        serve live consumers on a unix datagram socket\n"
+            "  --stats            print frame rate, drops and CPU use every second\n"
+            "  --bitrate N        slcan nominal bitrate (default 1000000)\n"
+            "  --fd-bitrate N     slcan CAN-FD data bitrate, sent as Y<Mbit/s>\n"
+            "  --tty-baud N       serial baud rate for slcan (default 115200, ignored by USB CDC)\n"
+            "  --no-init          do not send C/S/O to the slcan adapter (ptys, already open adapters)\n");
+}
+
+static bool parseArgs(int argc, char **argv, Options &opt)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string a = argv[i];
+        auto value = [&](const char *name) -> const char * {
+            if (i + 1 >= argc)
+            {
+                fprintf(stderr, "canlog: %s needs a value\n", name);
+                return nullptr;
+            }
+            return argv[++i];
+        };
+        const char *v;
+        if (a == "-o")
+        {
+            if (!(v = value("-o"))) return false;
+            opt.output = v;
+        }
+        else if (a == "--live")
+        {
+            if (!(v = value("--live"))) return false;
+            opt.live = v;
+        }
+        else if (a == "--bitrate")
+        {
+            if (!(v = value("--bitrate"))) return false;
+            opt.bitrate = (uint32_t)strtoul(v, nullptr, 0);
+        }
+        else if (a == "--fd-bitrate")
+        {
+            if (!(v = value("--fd-bitrate"))) return false;
+            opt.fdBitrate = (uint32_t)strtoul(v, nullptr, 0);
+        }
+        else if (a == "--tty-baud")
+        {
+            if (!(v = value("--tty-baud"))) return false;
+            opt.ttyBaud = (uint32_t)strtoul(v, nullptr, 0);
+        }
+        else if (a == "--no-init")
+            opt.slcanInit = false;
+        else if (a == "--stats")
+            opt.stats = true;
+        else if (a == "-h" || a == "--help")
+            return false;
+        else if (opt.source.empty() && a[0] != '-')
+            opt.source = a;
+        else
+        {
+            fprintf(stderr, "canlog: unknown argument %s\n", a.c_str());
+            return false;
+        }
+    }
+    return !opt.source.empty();
+}
+
+static double cpuSeconds()
+{
+    rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return (double)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1e-6;
+}
+
+} // namespace canlog
+
+int main(int argc, char **argv)
+{
+    using namespace canlog;
+
+    Options opt;
+    if (!parseArgs(argc, argv, opt))
+    {
+        usage();
+        return 2;
+    }
+
+    SocketCanSource *socketCan = nullptr;
+    Source *source = nullptr;
+    if (opt.source.rfind("can:", 0) == 0)
+    {
+        socketCan = new SocketCanSource();
+        if (!socketCan->open(opt.source.substr(4)))
+            return 1;
+        source = socketCan;
+    }
+    else if (opt.source.rfind("slcan:", 0) == 0)
+    {
+        SlcanSource *slcan = new SlcanSource();
+        if (!slcan->open(opt, opt.source.substr(6)))
+            return 1;
+        source = slcan;
+    }
+    else
+    {
+        usage();
+        return 2;
+    }
+
+    LogFile log;
+    if (!opt.output.empty() && !log.open(opt.output))
+    {
+        perror("canlog: open log");
+        return 1;
+    }
+    LiveServer live;
+    if (!opt.live.empty() && !live.open(opt.live))
+    {
+        perror("canlog: live socket");
+        return 1;
+    }
+
+    struct sigaction sa = {};
+    sa.sa_handler = onSignal;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    Stats stats, lastStats;
+    Frame frames[RECV_BATCH];
+    uint64_t lastFlushMs = monotonicMs(), lastStatsMs = lastFlushMs;
+    double lastCpu = cpuSeconds();
+
+    auto record = [&](const Frame &f) {
+        log.append(f);
+        live.append(f, stats);
+    };
+
+    while (running)
+    {
+        pollfd fds[2] = {{source->fd(), POLLIN, 0}, {live.fd(), POLLIN, 0}};
+        int ready = poll(fds, live.active() ? 2 : 1, FLUSH_INTERVAL_MS);
+        if (ready < 0 && errno != EINTR)
+        {
+            perror("canlog: poll");
+            break;
+        }
+        if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL))
+        {
+            fprintf(stderr, "canlog: bus closed\n");
+            break;
+        }
+
+        if (fds[0].revents & POLLIN)
+        {
+            size_t n;
+            while ((n = source->readBatch(frames, RECV_BATCH, stats)) > 0)
+            {
+                stats.batches++;
+                for (size_t i = 0; i < n; i++)
+                {
+                    record(frames[i]);
+                    stats.frames++;
+                    stats.bytes += frames[i].len;
+                }
+                if (socketCan)
+                {
+                    if (uint32_t drops = socketCan->takeDrops())
+                    {
+                        Frame ev = {};
+                        ev.timestampNs = frames[n - 1].timestampNs;
+                        ev.canId = EVENT_KERNEL_DROP;
+                        ev.flags = FLAG_EVENT;
+                        ev.len = sizeof(drops);
+                        memcpy(ev.data, &drops, sizeof(drops));
+                        record(ev);
+                    }
+                }
+                if (n < RECV_BATCH)
+                    break;
+            }
+            live.publish(stats);
+        }
+
+        if (live.active() && (fds[1].revents & POLLIN))
+        {
+            live.receive([&](Frame &f) {
+                if (!source->write(f))
+                    return;
+                stats.txFrames++;
+                // SocketCAN echoes the frame back with a kernel timestamp, slcan does not
+                if (!socketCan)
+                {
+                    f.timestampNs = realtimeNs();
+                    f.flags |= FLAG_TX;
+                    record(f);
+                }
+            });
+            live.publish(stats);
+        }
+
+        uint64_t nowMs = monotonicMs();
+        if (nowMs - lastFlushMs >= FLUSH_INTERVAL_MS)
+        {
+            log.flush();
+            live.expire(nowMs);
+            lastFlushMs = nowMs;
+        }
+        if (opt.stats && nowMs - lastStatsMs >= 1000)
+        {
+            double dt = (nowMs - lastStatsMs) * 1e-3;
+            double cpu = cpuSeconds();
+            uint64_t batches = stats.batches - lastStats.batches;
+            fprintf(stderr, "%8.0f frames/s  %6.2f frames/batch  %8.1f kB logged  drops kernel %llu live %llu  "
+                            "tx %llu  clients %zu  cpu %.2f%%\n",
+                    (stats.frames - lastStats.frames) / dt,
+                    batches ? (double)(stats.frames - lastStats.frames) / batches : 0.0, log.written() / 1024.0,
+                    (unsigned long long)stats.kernelDrops, (unsigned long long)stats.liveDrops,
+                    (unsigned long long)stats.txFrames, live.clients(), 100.0 * (cpu - lastCpu) / dt);
+            lastStats = stats;
+            lastStatsMs = nowMs;
+            lastCpu = cpu;
+        }
+    }
+
+    log.close();
+    live.close();
+    delete source;
+    fprintf(stderr, "canlog: %llu frames, %llu kernel drops, %llu live drops\n", (unsigned long long)stats.frames,
+            (unsigned long long)stats.kernelDrops, (unsigned long long)stats.liveDrops);
+    return 0;
+}
@@ -0,0 +1,224 @@
+"""Reader and live client for the native CAN logger (canlog.cpp).
+
+    python canlog.py dump match.sclog > match.log       candump -l text, e.g. for sdk/bench/governor_replay.c
+    python canlog.py stats match.sclog                  frame counts and rates per CAN ID
+    python canlog.py slcan-sim --rate 5000              slcan pty that sends synthetic 0x052 frames, for testing
+
+CanlogBus is a minimal python-can style bus (recv / send / shutdown) on top of the logger's live socket, so
+slcan_monitor.py can run as an optional consumer while canlog keeps the bus and the recording.
+"""
+import argparse
+import os
+import select
+import signal
+import socket
+import struct
+import sys
+import time
+from collections import Counter, deque
+
+LOG_MAGIC = b'SCCANLOG'
+FILE_HEADER = struct.Struct('<8sHHI')
+RECORD_HEADER = struct.Struct('<QIBBH')
+
+FLAG_FD = 0x01
+FLAG_BRS = 0x02
+FLAG_ESI = 0x04
+FLAG_TX = 0x08
+FLAG_EVENT = 0x80
+EVENT_KERNEL_DROP = 1
+
+CAN_EFF_FLAG = 0x80000000
+CAN_RTR_FLAG = 0x40000000
+CAN_ERR_FLAG = 0x20000000
+CAN_EFF_MASK = 0x1FFFFFFF
+
+KEEPALIVE_S = 1.0
+
+
+def iter_records(buf, offset=0):
+    """Yield (timestamp_ns, can_id, flags, data) for every record in buf starting at offset."""
+    end = len(buf)
+    while offset + RECORD_HEADER.size <= end:
+        ts, can_id, length, flags, _ = RECORD_HEADER.unpack_from(buf, offset)
+        offset += RECORD_HEADER.size
+        if offset + length > end:
+            break
+        yield ts, can_id, flags, bytes(buf[offset:offset + length])
+        offset += length
+
+
+def read_log(path):
+    """Yield the records of a log file, see iter_records."""
+    with open(path, 'rb') as f:
+        buf = f.read()
+    magic, version, header_size, _ = FILE_HEADER.unpack_from(buf, 0)
+    if magic != LOG_MAGIC:
+        raise ValueError(f"{path}: not a canlog file")
+    if version != 1:
+        raise ValueError(f"{path}: unsupported version {version}")
+    yield from iter_records(memoryview(buf), header_size)
+
+
+def pack_record(can_id, data, flags=0, timestamp_ns=0):
+    return RECORD_HEADER.pack(timestamp_ns, can_id, len(data), flags, 0) + bytes(data)
+
+
+def format_candump(ts, can_id, flags, data, channel):
+    """One candump -l line: (sec.usec) channel ID#DATA, ID##<flags>DATA for CAN-FD."""
+    ident = f"{can_id & CAN_EFF_MASK:08X}" if can_id & CAN_EFF_FLAG else f"{can_id & 0x7FF:03X}"
+    if flags & FLAG_FD:
+        fd_flags = (1 if flags & FLAG_BRS else 0) | (2 if flags & FLAG_ESI else 0)
+        body = f"#{fd_flags:X}{data.hex().upper()}"
+    elif can_id & CAN_RTR_FLAG:
+        body = "R"
+    else:
+        body = data.hex().upper()
+    return f"({ts // 1000000000}.{ts // 1000 % 1000000:06d}) {channel} {ident}#{body}"
+
+
+class CanlogBus:
+    """python-can style bus backed by a canlog --live socket. Messages are python-can Message objects."""
+
+    def __init__(self, path):
+        import can
+        self._can = can
+        self.server = path
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+        # Autobind to an abstract address so the logger can reply
+        self.sock.bind('')
+        self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4 << 20)
+        self.pending = deque()
+        self.last_keepalive = 0.0
+        self._keepalive()
+
+    def _keepalive(self):
+        now = time.monotonic()
+        if now - self.last_keepalive >= KEEPALIVE_S:
+            try:
+                self.sock.sendto(b'', self.server)
+            except OSError as e:
+                raise self._can.CanError(f"canlog live socket {self.server}: {e}")
+            self.last_keepalive = now
+
+    def recv(self, timeout=None):
+        deadline = None if timeout is None else time.monotonic() + timeout
+        while not self.pending:
+            self._keepalive()
+            wait = KEEPALIVE_S if deadline is None else min(KEEPALIVE_S, deadline - time.monotonic())
+            if wait <= 0:
+                return None
+            self.sock.settimeout(wait)
+            try:
+                batch = self.sock.recv(65536)
+            except socket.timeout:
+                continue
+            for ts, can_id, flags, data in iter_records(batch):
+                if flags & FLAG_EVENT:
+                    continue
+                self.pending.append(self._can.Message(
+                    timestamp=ts * 1e-9, arbitration_id=can_id & CAN_EFF_MASK,
+                    is_extended_id=bool(can_id & CAN_EFF_FLAG), is_remote_frame=bool(can_id & CAN_RTR_FLAG),
+                    is_error_frame=bool(can_id & CAN_ERR_FLAG), is_fd=bool(flags & FLAG_FD),
+                    bitrate_switch=bool(flags & FLAG_BRS), error_state_indicator=bool(flags & FLAG_ESI),
+                    is_rx=not flags & FLAG_TX, dlc=len(data), data=data))
+        return self.pending.popleft()
+
+    def send(self, msg, timeout=None):
+        can_id = msg.arbitration_id | (CAN_EFF_FLAG if msg.is_extended_id else 0)
+        flags = (FLAG_FD if msg.is_fd else 0) | (FLAG_BRS if msg.bitrate_switch else 0)
+        try:
+            self.sock.sendto(pack_record(can_id, msg.data, flags), self.server)
+        except OSError as e:
+            raise self._can.CanError(f"canlog live socket {self.server}: {e}")
+
+    def shutdown(self):
+        self.sock.close()
+
+
+def cmd_dump(args):
+    for ts, can_id, flags, data in read_log(args.file):
+        if flags & FLAG_EVENT:
+            if can_id == EVENT_KERNEL_DROP:
+                print(f"# ({ts // 1000000000}.{ts // 1000 % 1000000:06d}) "
+                      f"kernel dropped {struct.unpack('<I', data)[0]} frames", file=sys.stderr)
+            continue
+        print(format_candump(ts, can_id, flags, data, args.channel))
+
+
+def cmd_stats(args):
+    counts = Counter()
+    first = last = None
+    drops = 0
+    for ts, can_id, flags, data in read_log(args.file):
+        if flags & FLAG_EVENT:
+            drops += struct.unpack('<I', data)[0] if can_id == EVENT_KERNEL_DROP else 0
+            continue
+        counts[(can_id & CAN_EFF_MASK, bool(flags & FLAG_TX))] += 1
+        first = ts if first is None else first
+        last = ts
+    span = (last - first) * 1e-9 if first is not None and last > first else 0.0
+    print(f"{sum(counts.values())} frames in {span:.3f} s, {drops} dropped by the kernel")
+    for (can_id, tx), n in sorted(counts.items()):
+        rate = f"{n / span:10.1f} /s" if span else ""
+        print(f"  {can_id:#05x} {'tx' if tx else 'rx'} {n:10d} {rate}")
+
+
+def cmd_slcan_sim(args):
+    """Open a pty, write slcan lines for 0x052 (classic) and optionally 0x059 (CAN-FD, 64 bytes), print what
+    the host sends back."""
+    import pty
+    import tty
+    master, slave = pty.openpty()
+    tty.setraw(slave)
+    print(os.ttyname(slave), flush=True)
+    period = 1.0 / args.rate
+    sent = 0
+    start = time.monotonic()
+    try:
+        while args.count == 0 or sent < args.count:
+            lines = []
+            target = int((time.monotonic() - start) / period) + 1
+            while sent < target and (args.count == 0 or sent < args.count):
+                energy = sent % 250
+                data = struct.pack('<BHHHB', 0xC0, (40 * 64 + 16384 + sent % 64) & 0xFFFF, 60 * 64 + 16384, 120,
+                                   energy)
+                lines.append(f"t0528{data.hex().upper()}\r")
+                if args.fd and sent % 8 == 0:
+                    lines.append(f"b059F{bytes((sent + i) & 0xFF for i in range(64)).hex().upper()}\r")
+                sent += 1
+            if lines:
+                os.write(master, ''.join(lines).encode())
+            # Commands and frames from the host side (slcan init, canlog live clients)
+            while select.select([master], [], [], 0)[0]:
+                for line in os.read(master, 65536).split(b'\r'):
+                    if line:
+                        print(f"host -> {line.decode(errors='replace')}", file=sys.stderr)
+            time.sleep(0.001)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        print(f"sent {sent} frames", file=sys.stderr)
+        time.sleep(0.5)
+        os.close(master)
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='canlog binary log reader and slcan test source.')
+    sub = parser.add_subparsers(dest='cmd', required=True)
+    p = sub.add_parser('dump', help='print a log as candump -l text')
+    p.add_argument('file')
+    p.add_argument('--channel', default='can0')
+    p.set_defaults(func=cmd_dump)
+    p = sub.add_parser('stats', help='frame counts and rates per CAN ID')
+    p.add_argument('file')
+    p.set_defaults(func=cmd_stats)
+    p = sub.add_parser('slcan-sim', help='pty that sends synthetic slcan frames, prints its path')
+    p.add_argument('--rate', type=float, default=1000, help='0x052 frames per second')
+    p.add_argument('--count', type=int, default=0, help='stop after this many 0x052 frames, 0 runs until ^C')
+    p.add_argument('--fd', action='store_true', help='also send a 64-byte CAN-FD 0x059 every 8 frames')
+    p.set_defaults(func=cmd_slcan_sim)
+    args = parser.parse_args()
+    if hasattr(signal, 'SIGPIPE'):
+        signal.signal(signal.SIGPIPE, signal.SIG_DFL)     # dump | head
+    args.func(args)
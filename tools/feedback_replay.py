@@ -0,0 +1,180 @@
+"""Replay a trace through the feedback scheduler to estimate CAN bus load and state-change latency.
+
+Mirrors CANcomm::updateFeedback: evaluated at 4kHz, sends immediately when a statusCode bit other
+than the limit factor changes, on the configured period, and on limit-factor/power/energy changes (no
+closer than FEEDBACK_MIN_INTERVAL). The result is compared with the old fixed 1kHz feedback.
+
+Traces are telemetry CSVs from `tele va,vb,ia,ir,status` in slcan_monitor.py. Without a trace a
+synthetic match profile is generated (driving bursts, idle, limit-factor changes, the output switched
+off now and then). --chatter adds noise to the limit-factor decision so it toggles near its thresholds.
+
+    python feedback_replay.py telemetry_*.csv --period 10 --power 2 --energy 2
+    python feedback_replay.py --synthetic 180 --period 10 --power 2 --energy 2
+    python feedback_replay.py --synthetic 180 --chatter 20 --period 10 --power 2 --energy 2
+"""
+import argparse
+import csv
+import os
+import random
+import re
+
+CONFIG = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'Core', 'Inc', 'Config.hpp')
+MF_PERIOD_US = 16
+TICK_US = 250                       # 4kHz task
+MIN_INTERVAL_US = 1000              # FEEDBACK_MIN_INTERVAL
+BITRATE = 1_000_000
+FRAME_BITS = 135                    # 8-byte standard frame with worst-case stuffing and interframe space
+BURST_FRAMES_PER_S = 100            # 0x053 is unchanged
+SYNTHETIC_STEP_US = 80              # finer than the 4kHz tick so state changes fall between evaluations
+
+
+def read_config(path=CONFIG):
+    """Read the constants the firmware feedback depends on."""
+    values = {}
+    with open(path, encoding='utf-8') as f:
+        for line in f:
+            m = re.match(r'#define\s+(MF_TO_LF_ALPHA|CAPARR_MAX_VOLTAGE)\s+([\d.]+)f?', line)
+            if m:
+                values[m.group(1)] = float(m.group(2))
+    return values
+
+
+def load_trace(filename):
+    """Yield (t_us, power, vcap, status) from a telemetry CSV, status being (outputAB, limitFactor)."""
+    with open(filename, newline='') as f:
+        for row in csv.DictReader(f):
+            va = float(row['va'])
+            power = va * (float(row['ir']) - float(row['ia']))
+            status = (int(row.get('outputAB', 1)), int(row.get('limitFactor', 0)))
+            yield float(row['t_us']), power, float(row['vb']), status
+
+
+def synthetic_trace(seconds, chatter=0.0, seed=1):
+    """Match-like profile: bursts up to 300W, idle, regen, limit factor following the load, output off
+    for 0.5 s about every 30 s. chatter is the noise in W on the power the limit factor is decided from."""
+    rng = random.Random(seed)
+    t, vcap, target, hold = 0.0, 24.0, 40.0, 0.0
+    power = target
+    off_start = rng.uniform(25e6, 29e6)
+    while t < seconds * 1e6:
+        if t >= off_start + 0.5e6:
+            off_start += rng.uniform(28e6, 32e6)
+        if hold <= 0:
+            target = rng.choice([0.0, 30.0, 60.0, 120.0, 250.0, 300.0, -40.0])
+            hold = rng.uniform(0.1, 2.0) * 1e6
+        hold -= SYNTHETIC_STEP_US
+        power += (target - power) * 0.0064 + rng.gauss(0, 0.85)
+        vcap = min(28.8, max(8.0, vcap - (power - 60.0) * SYNTHETIC_STEP_US * 1e-6 / (vcap * 6.0)))
+        decided = power + rng.gauss(0, chatter) if chatter else power
+        limit = 0 if decided < 150 else (3 if decided > 250 else 2)
+        output = 0 if t >= off_start else 1
+        yield t, power, vcap, (output, limit)
+        t += SYNTHETIC_STEP_US
+
+
+def encode(status):
+    """Split a trace status into the statusCode bits sent at once and its 2-bit limit factor field."""
+    output, limit = status
+    return output, 3 if limit >= 4 else limit & 3
+
+
+def replay(samples, cfg, period_ms, power_delta, energy_delta):
+    alpha = cfg['MF_TO_LF_ALPHA']
+    vmax2 = cfg['CAPARR_MAX_VOLTAGE'] ** 2
+    counts = {'periodic': 0, 'status': 0, 'limit': 0, 'power': 0, 'energy': 0}
+    last = None
+    last_tx_tick = last_tx_time = -10 ** 9
+    power_lf = None
+    latency = {'status': 0.0, 'limit': 0.0}
+    next_tick = prev_t = None
+    status_t = limit_t = None       # first time the value differed from the last sent one
+    duration = 0.0
+    for t, power, vcap, status in samples:
+        # the firmware filters at 62.5kHz, the trace may be decimated
+        if power_lf is None:
+            power_lf = power
+        else:
+            steps = max(1, round((t - prev_t) / MF_PERIOD_US))
+            power_lf += (power - power_lf) * (1 - (1 - alpha) ** steps)
+            duration += t - prev_t
+        prev_t = t
+        fields = encode(status)
+        if last is not None:
+            # a value that went back to the sent one before the next frame needs no frame
+            if fields[0] == last[0][0]:
+                status_t = None
+            elif status_t is None:
+                status_t = t
+            if fields[1] == last[0][1]:
+                limit_t = None
+            elif limit_t is None:
+                limit_t = t
+        if next_tick is None:
+            next_tick = t
+        if t < next_tick:
+            continue
+        while next_tick <= t:
+            next_tick += TICK_US
+
+        energy = int(vcap * vcap / vmax2 * 250)
+        tick = int(t // 1000)
+        interval_ok = t - last_tx_time >= MIN_INTERVAL_US
+        reason = None
+        if last is None or fields[0] != last[0][0]:
+            reason = 'status'
+        elif tick - last_tx_tick >= period_ms:
+            reason = 'periodic'
+        elif interval_ok and fields[1] != last[0][1]:
+            reason = 'limit'
+        elif interval_ok and power_delta > 0 and abs(power_lf - last[1]) >= power_delta:
+            reason = 'power'
+        elif interval_ok and energy_delta > 0 and abs(energy - last[2]) >= energy_delta:
+            reason = 'energy'
+        if reason:
+            # a frame sent for any reason carries the current status and limit factor
+            if status_t is not None and fields[0] != last[0][0]:
+                latency['status'] = max(latency['status'], t - status_t)
+            if limit_t is not None and fields[1] != last[0][1]:
+                latency['limit'] = max(latency['limit'], t - limit_t)
+            status_t = limit_t = None
+            counts[reason] += 1
+            last = (fields, power_lf, energy)
+            last_tx_tick, last_tx_time = tick, t
+    return counts, duration / 1e6, latency
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('files', nargs='*', help='telemetry CSV files (va, vb, ia, ir, status)')
+    parser.add_argument('--synthetic', type=float, metavar='SECONDS', help='use a generated profile of this length')
+    parser.add_argument('--chatter', type=float, default=0.0, metavar='W',
+                        help='noise on the limit-factor decision of --synthetic, in W')
+    parser.add_argument('--period', type=int, default=10, help='feedback_period in ms (1-10)')
+    parser.add_argument('--power', type=float, default=2.0, help='feedback_power_delta in W, 0 disables')
+    parser.add_argument('--energy', type=int, default=2, help='feedback_energy_delta, 0 disables')
+    args = parser.parse_args()
+
+    cfg = read_config()
+    traces = [(f, load_trace(f)) for f in args.files]
+    if args.synthetic or not traces:
+        name = f"synthetic {args.synthetic or 60:.0f} s" + (f", chatter {args.chatter:g} W" if args.chatter else "")
+        traces.append((name, synthetic_trace(args.synthetic or 60, args.chatter)))
+
+    for name, samples in traces:
+        counts, seconds, latency = replay(list(samples), cfg, args.period, args.power, args.energy)
+        if seconds <= 0:
+            print(f"{name}: empty trace")
+            continue
+        sent = sum(counts.values())
+        rate = sent / seconds
+        baseline = 1000.0
+        load = (rate + BURST_FRAMES_PER_S) * FRAME_BITS / BITRATE * 100
+        load_base = (baseline + BURST_FRAMES_PER_S) * FRAME_BITS / BITRATE * 100
+        detail = ", ".join(f"{k} {v / seconds:.0f}/s" for k, v in counts.items())
+        print(f"{name}: {seconds:.1f} s, feedback {rate:.0f} frames/s ({detail})")
+        print(f"  bus load {load:.2f}% vs {load_base:.2f}% at fixed 1kHz ({(load / load_base - 1) * 100:+.0f}%), "
+              f"latency <= {latency['status']:.0f} us for status, <= {latency['limit']:.0f} us for limit factor")
+
+
+if __name__ == '__main__':
+    main()
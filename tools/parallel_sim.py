@@ -0,0 +1,232 @@
+"""Two boards in parallel on a virtual CAN bus, to check the current sharing loop of Parallel.hpp.
+
+Each instance runs the parts of the firmware that matter for sharing: the iR incremental PID and the
+sharing correction of updateMFLoop at 62.5kHz, and the 1kHz peer broadcast (0x040 + node) and
+Parallel::update. Peer frames are packed as TxPeerData and go through a virtual bus, so they are
+only seen by the other board at its next 1kHz tick, as with processRx.
+
+Plant: the referee supply feeds both boards through their own iR shunts with the A sides tied to the
+chassis, so the referee current splits by shunt and wiring resistance (--split), not by control.
+Without sharing the two iR loops disagree on the same current and wind up against each other.
+
+    python parallel_sim.py
+    python parallel_sim.py --split 0.6 --no-share
+    python parallel_sim.py --drop 1.5
+    python parallel_sim.py --lost 1.5
+"""
+import argparse
+import os
+import re
+import struct
+
+HEADER = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'Core', 'Inc', 'Parallel.hpp')
+MF_PERIOD = 16e-6
+MF_PER_TICK = 62                    # 62.5 MF cycles per 1kHz tick
+MF_TO_LF_ALPHA = 0.092
+IR_PID = (0.1, 0.2, 0.10, 0.01)     # mfLoop.iRPID defaults (kTP, kMP, kI, kD)
+CAP_MAX_CURRENT = 15.0
+CAPACITY = 4.4                      # F per bank
+VA = 24.0
+PEER_FORMAT = '<hHhBB'              # TxPeerData
+CAN_ID_PEER = 0x040
+
+
+def read_config(path=HEADER):
+    values = {}
+    with open(path, encoding='utf-8') as f:
+        for line in f:
+            m = re.match(r'#define\s+(PARALLEL_\w+)\s+(0x[0-9A-Fa-f]+|[\d.]+)[fU]?', line)
+            if m:
+                values[m.group(1)] = float(int(m.group(2), 16)) if m.group(2).startswith('0x') else float(m.group(2))
+    return values
+
+
+class IncreasementPID:
+    def __init__(self, ktp, kmp, ki, kd):
+        self.ktp, self.kmp, self.ki, self.kd = ktp, kmp, ki, kd
+        self.t1 = self.m1 = self.e2 = 0.0
+
+    def compute_delta(self, target, current):
+        delta = (self.ktp * (target - self.t1) + self.kmp * (current - self.m1) + self.ki * (target - current)
+                 + self.kd * ((target - current) - 2 * (self.t1 - self.m1) + self.e2))
+        self.e2 = self.t1 - self.m1
+        self.t1, self.m1 = target, current
+        return delta
+
+
+class VirtualBus:
+    """Frames written in one tick are received by every other node at its next tick."""
+
+    def __init__(self):
+        self.frames = []
+
+    def send(self, can_id, data):
+        self.frames.append((can_id, data))
+
+    def take(self):
+        frames, self.frames = self.frames, []
+        return frames
+
+
+class Board:
+    def __init__(self, node, nodes, cfg, vcap, share=True):
+        self.node, self.nodes, self.cfg, self.share = node, nodes, cfg, share
+        self.pid = IncreasementPID(*IR_PID)
+        self.il = 0.0
+        self.vcap = vcap
+        self.icap_lf = 0.0
+        self.ir = 0.0
+        self.output = True
+        self.online = True                  # sends peer frames
+        self.peers = {}                     # node -> (iCap, pReferee, sharing, last tick)
+        self.seq = 0
+        self.share_num = nodes
+        self.peer_active = 0
+        self.icap_peer_sum = 0.0
+        self.reserved = 0.0
+        self.integral = 0.0
+        self.bias = 0.0
+
+    # Parallel::update, 1kHz
+    def update(self, tick, bus_frames, bus):
+        for can_id, data in bus_frames:
+            node = can_id - CAN_ID_PEER
+            if node == self.node or not 0 <= node < self.nodes:
+                continue
+            icap, _vcap, pref, _seq, flags = struct.unpack(PEER_FORMAT, data)
+            self.peers[node] = (icap / 100.0, pref / 100.0, bool(flags & 1), tick)
+        share_num, active, icap_sum, reserved = 1, 0, 0.0, 0.0
+        for node in range(self.nodes):
+            if node == self.node:
+                continue
+            peer = self.peers.get(node)
+            if peer is None or tick - peer[3] > self.cfg['PARALLEL_PEER_TIMEOUT']:
+                share_num += 1              # offline: keep its share unused
+            elif peer[2]:
+                share_num += 1
+                active += 1
+                icap_sum += peer[0]
+            else:
+                reserved += peer[1]         # output off, referee current still passes through it
+        self.share_num, self.peer_active, self.icap_peer_sum = share_num, active, icap_sum
+        self.reserved += self.cfg['PARALLEL_RESERVED_ALPHA'] * (reserved - self.reserved)
+        if self.online:
+            flags = 1 if self.output else 0
+            data = struct.pack(PEER_FORMAT, round(self.icap_lf * 100), round(self.vcap * 100),
+                               round(self.ir * VA * 100), self.seq & 0xFF, flags)
+            bus.send(CAN_ID_PEER + self.node, data)
+            self.seq += 1
+
+    # updateMFLoop, 62.5kHz
+    def mf_loop(self, p_total):
+        if not self.output:
+            self.il = 0.0
+            self.integral = self.bias = 0.0
+            return
+        p_target = (p_total - self.reserved) / self.share_num
+        if self.share and self.peer_active:
+            avg = (self.icap_peer_sum + self.icap_lf) / (self.peer_active + 1)
+            err = self.icap_lf - avg
+            limit = self.cfg['PARALLEL_SHARE_LIMIT']
+            self.integral = min(limit, max(-limit, self.integral - self.cfg['PARALLEL_SHARE_KI'] * err))
+            self.bias = min(limit, max(-limit, self.integral - self.cfg['PARALLEL_SHARE_KP'] * err))
+        else:
+            self.integral = self.bias = 0.0
+        p_target += self.bias
+        self.il += self.pid.compute_delta(p_target / VA, self.ir)
+        self.il = min(CAP_MAX_CURRENT, max(-CAP_MAX_CURRENT, self.il))
+
+
+LOAD_STEPS = [(0.0, 30.0), (0.3, 180.0), (1.0, 80.0), (1.8, -60.0), (2.2, 50.0)]
+SETTLED_DIFF = 0.2                  # A
+SETTLED_POWER = 1.0                 # W
+
+
+def load_power(t):
+    """Chassis load: idle, acceleration burst, cruise, regen, cruise."""
+    power = LOAD_STEPS[0][1]
+    for start, p in LOAD_STEPS:
+        if t >= start:
+            power = p
+    return power
+
+
+def simulate(args, cfg):
+    bus = VirtualBus()
+    boards = [Board(0, 2, cfg, 22.0, not args.no_share), Board(1, 2, cfg, 20.0, not args.no_share)]
+    split = (args.split, 1.0 - args.split)
+    delivered = []
+    tick = 0
+    overdraw = 0.0
+    trace = []                          # (t, iCap difference, referee power) every 1kHz tick
+    for step in range(int(args.time / MF_PERIOD)):
+        t = step * MF_PERIOD
+        if step % MF_PER_TICK == 0:
+            tick += 1
+            if args.drop is not None and t >= args.drop:
+                boards[1].output = False
+            if args.lost is not None and t >= args.lost:
+                boards[1].online = False
+                boards[1].output = False
+            frames = delivered
+            delivered = bus.take()
+            for b in boards:
+                b.update(tick, frames, bus)
+
+        # plant: converter current is iLTarget, power balance on the A side
+        i_ref = load_power(t) / VA + sum(b.il * b.vcap / VA for b in boards)
+        for b, w in zip(boards, split):
+            b.ir = w * i_ref
+            b.icap_lf += MF_TO_LF_ALPHA * (b.il - b.icap_lf)
+            b.vcap = min(28.8, max(5.0, b.vcap + b.il * MF_PERIOD / CAPACITY))
+        for b in boards:
+            b.mf_loop(args.limit)
+
+        # energy taken from the referee buffer
+        overdraw += max(0.0, i_ref * VA - args.limit) * MF_PERIOD
+        if step % MF_PER_TICK == 0:
+            trace.append((t, abs(boards[0].il - boards[1].il) if boards[1].output else 0.0, i_ref * VA))
+        if step % int(0.1 / MF_PERIOD) == 0:
+            print(f"t={t:4.2f}s load {load_power(t):6.1f}W referee {i_ref * VA:6.1f}W | "
+                  + " | ".join(f"node{b.node} iCap {b.il:6.2f}A vCap {b.vcap:5.2f}V bias {b.bias:+6.2f}W"
+                               f"{'' if b.output else ' off'}" for b in boards))
+    return trace, overdraw
+
+
+def settling(trace, start, end, limit):
+    """Time from start until iCap difference and referee power stay within the settled band."""
+    settled_at = None
+    for t, diff, power in trace:
+        if t < start or t >= end:
+            continue
+        if diff <= SETTLED_DIFF and abs(power - limit) <= SETTLED_POWER:
+            if settled_at is None:
+                settled_at = t
+        else:
+            settled_at = None
+    return None if settled_at is None else settled_at - start
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--time', type=float, default=3.0, help='simulated seconds')
+    parser.add_argument('--limit', type=float, default=60.0, help='referee power limit in W')
+    parser.add_argument('--split', type=float, default=0.56, help='share of the referee current through node 0')
+    parser.add_argument('--no-share', action='store_true', help='equal split only, no iCap correction')
+    parser.add_argument('--drop', type=float, metavar='SECONDS', help='node 1 turns its output off at this time')
+    parser.add_argument('--lost', type=float, metavar='SECONDS', help='node 1 stops sending peer frames and turns off')
+    args = parser.parse_args()
+
+    trace, overdraw = simulate(args, read_config())
+    events = sorted({s for s, _ in LOAD_STEPS} | {e for e in (args.drop, args.lost) if e is not None})
+    events = [e for e in events if e < args.time] + [args.time]
+    for start, end in zip(events, events[1:]):
+        t = settling(trace, start, end, args.limit)
+        result = f"settled in {t * 1000:.0f} ms" if t is not None else "not settled"
+        tail = [p for s, _, p in trace if end - 0.05 <= s < end]
+        print(f"{start:4.2f}-{end:4.2f}s load {load_power(start):6.1f}W: referee {sum(tail) / len(tail):5.1f}W, {result}")
+    print(f"energy drawn above the limit: {overdraw:.2f} J")
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,117 @@
+// 保护规则表的主机基准：直接包含PowerManager.cpp，对hfRules/lfRules调用Protection::evaluate计时
+// 目标板上的耗时见errorData.hfState/lfState.maxEvalCycles，这里给出规则表本身在各分支上的相对开销
+//
+//   g++ -O2 -std=gnu++17 -fpermissive -w -ffunction-sections -fdata-sections -Wl,--gc-sections \
+//       -DUSE_HAL_DRIVER -DSTM32G474xx -D__ARM_ARCH_7EM__=1 -ICore/Inc \
+//       -IDrivers/STM32G4xx_HAL_Driver/Inc -IDrivers/STM32G4xx_HAL_Driver/Inc/Legacy \
+//       -IDrivers/CMSIS/Device/ST/STM32G4xx/Include -IDrivers/CMSIS/Include \
+//       tools/rule_bench.cpp -o rule_bench && ./rule_bench
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+// .code_in_ram会把所有中断函数放进同一个段，去掉后--gc-sections才能丢弃用不到的函数，不需要为它们的依赖打桩
+#define section(name) unused
+#include "../Core/Src/PowerManager.cpp"
+#undef section
+
+// 只有规则触发时才会调用到的外部函数
+HRTIM_HandleTypeDef hhrtim1;
+HAL_StatusTypeDef HAL_HRTIM_WaveformOutputStop(HRTIM_HandleTypeDef *, uint32_t) { return HAL_OK; }
+namespace Buzzer {
+void play(uint16_t, uint16_t) {}
+}
+namespace BlackBox {
+void trigger(uint16_t) {}
+}
+namespace EventLog {
+void log(EventType, uint16_t, uint8_t) {}
+}
+
+namespace {
+
+constexpr uint32_t ITERATIONS = 2000000;
+
+struct Scenario {
+    const char *name;
+    bool hf;                        // hfRules或lfRules
+    bool reset;                     // 每次调用前清除规则状态，使每次都进入applyRules
+    bool trip;                      // 清除后把计数置于触发前一次，每次都触发
+    float va, vb, ia, ib;
+};
+
+// 正常运行、计数中、每次开始计数、每次触发
+const Scenario scenarios[] = {
+    {"hf idle", true, false, false, 24.0f, 20.0f, -3.0f, 2.0f},
+    {"hf short A, accumulate", true, false, false, 2.0f, 20.0f, -8.0f, 2.0f},
+    {"hf short A+B, new pending", true, true, false, 2.0f, 2.0f, -8.0f, 8.0f},
+    {"hf short A+B, trip", true, true, true, 2.0f, 2.0f, -8.0f, 8.0f},
+    {"lf idle", false, false, false, 24.0f, 20.0f, -3.0f, 2.0f},
+    {"lf low battery, new pending", false, true, false, 20.5f, 20.0f, -3.0f, 2.0f},
+    {"lf low battery, trip", false, true, true, 20.5f, 20.0f, -3.0f, 2.0f},
+};
+
+void resetErrors(const Scenario &s, ProtectionState &state) {
+    Protection::resetState(state);
+    errorData.errorCode = 0;
+    errorData.errorLevel = NO_ERROR;
+    if (!s.trip) return;
+    const ProtectionRule *rules = s.hf ? Protection::hfRules : Protection::lfRules;
+    uint32_t ruleNum = s.hf ? sizeof(Protection::hfRules) / sizeof(ProtectionRule)
+                            : sizeof(Protection::lfRules) / sizeof(ProtectionRule);
+    for (uint32_t i = 0; i < ruleNum; i++) state.debounceCnt[i] = rules[i].debounce - 1U;
+}
+
+__attribute__((noinline)) void evaluateOnce(const Scenario &s, ProtectionState &state,
+                                            const float (&signal)[SIGNAL_NUM]) {
+    if (s.hf)
+        Protection::evaluate(Protection::hfConditions, Protection::hfRules, signal, state);
+    else
+        Protection::evaluate(Protection::lfConditions, Protection::lfRules, signal, state);
+}
+
+double measureReset(const Scenario &s) {
+    ProtectionState state;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < ITERATIONS; i++) {
+        resetErrors(s, state);
+        asm volatile("" : : "r"(&state) : "memory");
+    }
+    auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(stop - start).count() / ITERATIONS;
+}
+
+double run(const Scenario &s) {
+    ProtectionState state;
+    float signal[SIGNAL_NUM] = {};
+    signal[SIGNAL_VA] = s.va;
+    signal[SIGNAL_VB] = s.vb;
+    signal[SIGNAL_IA_OUT] = s.ia;
+    signal[SIGNAL_IB] = s.ib;
+    resetErrors(s, state);
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < ITERATIONS; i++) {
+        if (s.reset) resetErrors(s, state);
+        evaluateOnce(s, state, signal);
+        // 防止编译器把循环中的检查合并
+        asm volatile("" : : "r"(&state), "r"(signal) : "memory");
+    }
+    auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(stop - start).count() / ITERATIONS;
+}
+
+}  // namespace
+
+int main() {
+    // 每个场景取5次中最快的一次，减去清除状态的开销
+    printf("%-30s %10s\n", "scenario", "ns/call");
+    for (const Scenario &s : scenarios) {
+        double ns = 1e9;
+        for (int repeat = 0; repeat < 5; repeat++)
+            ns = std::min(ns, run(s) - (s.reset ? measureReset(s) : 0.0));
+        printf("%-30s %10.2f\n", s.name, ns);
+    }
+    return 0;
+}
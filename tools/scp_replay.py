@@ -0,0 +1,256 @@
+"""Replay vA/vB/iA/iB traces through the short-circuit rules to measure trip latency and false trips.
+
+Accepted traces:
+  - black-box CSV from `bb read` in slcan_monitor.py (256 samples at 62.5kHz around a trigger)
+  - telemetry CSV from `tele va,vb,ia,ib,status` in slcan_monitor.py, any length
+  - canlog binary log (.sclog, tools/canlog) with 0x059 telemetry frames carrying va, vb, ia and ib
+
+Long normal-operation captures give the false-trip rate in trips per hour for each rule. Telemetry is
+decimated (at least 8 x 16 us), so the rules are evaluated on consecutive telemetry samples: a change
+between two samples is counted as a single-sample step and a short as lasting the whole interval,
+which makes the rate an upper bound. Without real captures --synthetic generates a normal-operation
+trace from a simple model; its rate only shows how the replay works, not how the board behaves.
+
+    python scp_replay.py --normal match_*.sclog                # false trips per hour on logged matches
+    python scp_replay.py --normal telemetry_*.csv --di 3 --dv 1.5
+    python scp_replay.py fault.csv                             # trip times on a black-box fault trace
+    python scp_replay.py --synthetic 10                        # 10 minutes of generated normal operation
+"""
+import argparse
+import csv
+import math
+import os
+import random
+import re
+import struct
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+CONFIG = os.path.join(HERE, '..', 'Core', 'Inc', 'Config.hpp')
+SAMPLE_PERIOD_US = 16
+CAN_ID_TELEMETRY = 0x059
+TELEMETRY_HEADER = struct.Struct('<HBBHH')
+TELEMETRY_CHANNELS = ['va', 'vb', 'ia', 'ib', 'ir', 'il', 'status']
+RULES = [(side, rule) for side in 'AB' for rule in ('slow', 'fast')]
+
+
+def read_config(path=CONFIG):
+    """Read the SCP_* thresholds from Config.hpp so the replay matches the firmware."""
+    values = {}
+    with open(path, encoding='utf-8') as f:
+        for line in f:
+            m = re.match(r'#define\s+(SCP_\w+)\s+([\d.]+)[fU]?', line)
+            if m:
+                values[m.group(1)] = float(m.group(2))
+    return values
+
+
+class Side:
+    """Slow (debounced level) and fast (per-sample rate) rules of one side, as in PowerManager.cpp hfRules."""
+
+    def __init__(self, cfg, hit):
+        self.cfg = cfg
+        self.hit = int(hit)
+        self.trip = int(cfg['SCP_LEAK_TRIP'])
+        self.count = 0
+        self.tripped = False
+        self.last = None
+
+    def reset(self):
+        self.count = 0
+        self.tripped = False
+        self.last = None
+
+    def step(self, v, i_out, checks=1):
+        """checks: 62.5kHz checks this sample stands for (telemetry decimation)."""
+        short = v < self.cfg['SCP_VOLTAGE'] and i_out > self.cfg['SCP_CURRENT']
+        # accumulating debounce: +hit while short, -1 per sample otherwise
+        if short:
+            self.count = min(self.count + self.hit * checks, self.trip)
+        else:
+            self.count = max(self.count - checks, 0)
+        # a short that lasts several samples is one trip
+        slow = self.count >= self.trip and not self.tripped
+        self.tripped = self.count >= self.trip
+
+        fast = False
+        if self.last is not None:
+            dv, di = v - self.last[0], i_out - self.last[1]
+            fast = (i_out > self.cfg['SCP_CURRENT'] and dv < -self.cfg['SCP_DV_STEP']
+                    and di > self.cfg['SCP_DI_STEP'])
+        self.last = (v, i_out)
+        return slow, fast
+
+
+# Every source yields (t_us, output_on, vA, iA, vB, iB, checks, gap); gap marks a sample that does not
+# follow the previous one (lost telemetry frames, a new file), where the rate rules have no previous sample.
+
+def blackbox_samples(rows):
+    for row in rows:
+        yield (float(row['t_us']), int(row['outputAB']), float(row['vA']), float(row['iA']),
+               float(row['vB']), float(row['iB']), 1, False)
+
+
+def telemetry_csv_samples(rows):
+    prev_t = prev_seq = None
+    period = None
+    for row in rows:
+        t, seq = float(row['t_us']), int(row['seq'])
+        if prev_t is not None and period is None and seq == prev_seq:
+            period = t - prev_t
+        checks = max(1, round((period or SAMPLE_PERIOD_US) / SAMPLE_PERIOD_US))
+        # slcan_monitor leaves the time of lost frames out of the rows
+        gap = prev_t is None or (period is not None and t - prev_t > 1.5 * period)
+        prev_t, prev_seq = t, seq
+        yield (t, int(row.get('outputAB', 1)), float(row['va']), float(row['ia']), float(row['vb']),
+               float(row['ib']), checks, gap)
+
+
+def load_csv(filename):
+    with open(filename, newline='') as f:
+        rows = csv.DictReader(f)
+        fields = rows.fieldnames or []
+        if 'vA' in fields:
+            yield from blackbox_samples(rows)
+        elif all(c in fields for c in ('va', 'vb', 'ia', 'ib')):
+            yield from telemetry_csv_samples(rows)
+        else:
+            raise ValueError(f"{filename}: needs black-box columns or telemetry va, vb, ia, ib")
+
+
+def load_sclog(filename):
+    """0x059 frames from a canlog file, timed by the frame sequence like slcan_monitor.parse_telemetry."""
+    sys.path.append(os.path.join(HERE, 'canlog'))
+    from canlog import FLAG_EVENT, read_log
+    index = 0
+    next_seq = None
+    for _ts, can_id, flags, data in read_log(filename):
+        if flags & FLAG_EVENT or can_id & 0x7FF != CAN_ID_TELEMETRY or len(data) != 64:
+            continue
+        seq, mask, num, decimation, _dropped = TELEMETRY_HEADER.unpack_from(data)
+        channels = [name for i, name in enumerate(TELEMETRY_CHANNELS) if mask & (1 << i)]
+        if not all(c in channels for c in ('va', 'vb', 'ia', 'ib')):
+            next_seq = None
+            continue
+        gap = next_seq is None or seq != next_seq
+        if next_seq is not None:
+            index += ((seq - next_seq) & 0xFFFF) * num
+        next_seq = (seq + 1) & 0xFFFF
+        values = struct.unpack_from(f'<{num * len(channels)}h', data, TELEMETRY_HEADER.size)
+        for i in range(num):
+            s = dict(zip(channels, values[i * len(channels):(i + 1) * len(channels)]))
+            output = (s['status'] >> 8) & 1 if 'status' in s else 1
+            yield ((index + i) * decimation * SAMPLE_PERIOD_US, output, s['va'] / 100, s['ia'] / 100,
+                   s['vb'] / 100, s['ib'] / 100, decimation, gap and i == 0)
+        index += num
+
+
+def synthetic_samples(minutes, decimation, glitch_rate, seed=1):
+    """Generated normal operation, NOT a measurement: referee supply with 80 mOhm, chassis current
+    segments (idle, cruise, sprint, regen) slewed by the ESCs, the converter covering the part above a
+    60 W referee limit, ADC noise, and single-sample glitches on each channel independently."""
+    rng = random.Random(seed)
+    period = decimation * SAMPLE_PERIOD_US
+    n = int(minutes * 60e6 / period)
+    vcap, i_chassis, target, hold = 22.0, 2.0, 2.0, 0.0
+    glitch_p = glitch_rate * period * 1e-6
+    for k in range(n):
+        if hold <= 0:
+            target = rng.choice([0.5, 3.0, 5.0, 12.0, 18.0, -5.0])
+            hold = rng.uniform(0.05, 1.5) * 1e6
+        hold -= period
+        # ESC current slew about 50 A/ms
+        i_chassis += max(-0.05 * period, min(0.05 * period, target - i_chassis))
+        i_ref = min(2.5, max(0.0, i_chassis))
+        va = 24.0 - 0.08 * i_ref - 0.02 * i_chassis
+        i_out = i_chassis - i_ref
+        vcap = min(28.8, max(8.0, vcap - va * i_out * period * 1e-6 / (vcap * 4.4)))
+        ib = -i_out * va / vcap
+        va += rng.gauss(0, 0.03)
+        vb = vcap + rng.gauss(0, 0.03)
+        ia = -i_out + rng.gauss(0, 0.1)
+        ib += rng.gauss(0, 0.1)
+        if rng.random() < glitch_p: va -= rng.uniform(0.0, 3.0)
+        if rng.random() < glitch_p: ia -= rng.uniform(0.0, 6.0)
+        if rng.random() < glitch_p: vb -= rng.uniform(0.0, 3.0)
+        if rng.random() < glitch_p: ib += rng.uniform(0.0, 6.0)
+        yield k * period, 1, va, ia, vb, ib, decimation, k == 0
+
+
+def replay(samples, cfg):
+    """Returns (seconds with output on, {(side, rule): [trip times]}). The replay goes on after a trip, as
+    if the error had been cleared, so every trip in a long trace is counted."""
+    sides = {'A': Side(cfg, cfg['SCP_A_HIT']), 'B': Side(cfg, cfg['SCP_B_HIT'])}
+    trips = {k: [] for k in RULES}
+    checks_on = 0
+    for t, output, va, ia, vb, ib, checks, gap in samples:
+        if not output or gap:
+            for side in sides.values():
+                side.reset()
+            if not output:
+                continue
+        checks_on += checks
+        # each rule is replayed on its own so fast and debounced trip times can be compared
+        for name, v, i_out in (('A', va, -ia), ('B', vb, ib)):
+            slow, fast = sides[name].step(v, i_out, checks)
+            if slow: trips[(name, 'slow')].append(t)
+            if fast: trips[(name, 'fast')].append(t)
+    return checks_on * SAMPLE_PERIOD_US * 1e-6, trips
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('files', nargs='*', help='black-box or telemetry CSV files, canlog .sclog files')
+    parser.add_argument('--normal', action='store_true', help='traces contain no faults, every trip is a false trip')
+    parser.add_argument('--synthetic', type=float, metavar='MINUTES', help='replay generated normal operation')
+    parser.add_argument('--decimation', type=int, default=8, help='sample interval of --synthetic in 16 us units')
+    parser.add_argument('--glitch-rate', type=float, default=5.0,
+                        help='single-sample glitches per second and channel in --synthetic')
+    parser.add_argument('--di', type=float, help='override SCP_DI_STEP (A per sample)')
+    parser.add_argument('--dv', type=float, help='override SCP_DV_STEP (V per sample)')
+    args = parser.parse_args()
+    if not args.files and not args.synthetic:
+        parser.error('give trace files or --synthetic')
+
+    cfg = read_config()
+    if args.di is not None: cfg['SCP_DI_STEP'] = args.di
+    if args.dv is not None: cfg['SCP_DV_STEP'] = args.dv
+    print(f"SCP_VOLTAGE {cfg['SCP_VOLTAGE']} V, SCP_CURRENT {cfg['SCP_CURRENT']} A, "
+          f"debounce +{cfg['SCP_A_HIT']:.0f}/+{cfg['SCP_B_HIT']:.0f} to {cfg['SCP_LEAK_TRIP']:.0f}, "
+          f"di {cfg['SCP_DI_STEP']} A, dv {cfg['SCP_DV_STEP']} V")
+
+    traces = [(f, load_sclog(f) if f.endswith('.sclog') else load_csv(f)) for f in args.files]
+    if args.synthetic:
+        traces.append((f"SYNTHETIC {args.synthetic:g} min, decimation {args.decimation}, "
+                       f"{args.glitch_rate:g} glitches/s/channel",
+                       synthetic_samples(args.synthetic, args.decimation, args.glitch_rate)))
+
+    total_seconds = 0.0
+    total = {k: 0 for k in RULES}
+    for name, samples in traces:
+        seconds, trips = replay(samples, cfg)
+        total_seconds += seconds
+        for k, v in trips.items():
+            total[k] += len(v)
+        first = {k: v[0] for k, v in trips.items() if v}
+        detail = ", ".join(f"{side} {rule} x{len(trips[(side, rule)])} first @{t:.0f} us"
+                           for (side, rule), t in sorted(first.items(), key=lambda x: x[1]))
+        print(f"{name}: {seconds:.3f} s with output on, {detail or 'no trip'}")
+
+    print(f"{len(traces)} traces, {total_seconds:.3f} s with output on")
+    if args.normal or args.synthetic:
+        hours = total_seconds / 3600
+        if hours <= 0:
+            return
+        print("false trips per hour of operation (95% upper bound from the count):")
+        for side, rule in RULES:
+            n = total[(side, rule)]
+            # exact Poisson upper bound for n = 0 (rule of three), normal approximation otherwise
+            upper = 3.0 if n == 0 else n + 1.96 * math.sqrt(n) + 1.0
+            print(f"  {side} {rule:4s}: {n:5d} trips, {n / hours:8.2f} /h (< {upper / hours:.2f} /h)")
+        if args.synthetic and not args.files:
+            print("the trace is synthetic: the rates show the replay works, record real matches with canlog for the board's rate")
+
+
+if __name__ == '__main__':
+    main()
@@ -5,7 +5,11 @@ import threading
 import time
 import argparse
 from collections import deque
+import os
 import platform
+import sys
+import zlib
+import csv
 from datetime import datetime
 
 # --- Rich TUI ---
@@ -34,6 +38,176 @@ except ImportError:
 CAN_ID_HOST_COMMAND = 0x061
 CAN_ID_FEEDBACK_OLD = 0x051
 CAN_ID_FEEDBACK_NEW = 0x052
+CAN_ID_FEEDBACK_BURST = 0x053
+CAN_ID_BODE = 0x054
+CAN_ID_BLACKBOX = 0x055
+CAN_ID_EVENTLOG = 0x056
+CAN_ID_HEALTH = 0x057
+CAN_ID_LOSSMAP = 0x058
+CAN_ID_TELEMETRY = 0x059
+CAN_ID_PARAM = 0x05A
+CAN_ID_DIAG = 0x05B
+CAN_ID_SERVICE = 0x062
+NODE_ID_STRIDE = 0x100              # PARALLEL_CAN_ID_STRIDE, all IDs but 0x061 are offset by node * stride
+
+SERVICE_BODE = 0x01
+SERVICE_BLACKBOX = 0x02
+SERVICE_EVENTLOG = 0x03
+SERVICE_HEALTH = 0x04
+SERVICE_LOSSMAP = 0x05
+SERVICE_TELEMETRY = 0x06
+SERVICE_PARAM = 0x07
+BODE_TARGETS = {'off': 0, 'stop': 0, 'il': 1, 'ref': 2}
+BLACKBOX_OPS = {'info': 0, 'read': 1, 'post': 2, 'trigger': 3, 'erase': 4}
+BLACKBOX_STATES = {0: "recording", 1: "triggered", 2: "frozen"}
+BLACKBOX_INFO_OFFSET = 0xFFFF
+BLACKBOX_SAMPLE_RATE = 62500
+
+# BlackBoxHeader / BlackBoxSample, see Core/Inc/BlackBox.hpp
+BLACKBOX_HEADER = struct.Struct('<IHHHHHHHBBIffI')
+BLACKBOX_SAMPLE = struct.Struct('<hhhhhhBB')
+BLACKBOX_MAGIC = 0x58424253
+DCDC_MODES = ["BUCK", "BUCKBOOST", "BOOSTBUCK", "BOOST", "CAL_A", "CAL_B", "CAL"]
+
+# EventRecord, see Core/Inc/EventLog.hpp
+EVENTLOG_OPS = {'info': 0, 'read': 1, 'clear': 2}
+EVENTLOG_INFO_MARKER = 0xFFFFFFFF
+EVENT_RECORD = struct.Struct('<IIHBBHH')
+EVENT_TYPES = {1: "BOOT", 2: "RESET_REQUEST", 3: "ERROR", 4: "ERROR_CLEAR",
+               5: "REFEREE_POWER_OFF", 6: "REFEREE_POWER_ON", 7: "QUEUE_OVERFLOW",
+               8: "WATCHDOG_RESET", 9: "DEADLINE_MISS", 10: "CAN_RX_OVERFLOW",
+               11: "CAN_BUS_OFF", 12: "PARALLEL_PEER_LOST", 13: "PARALLEL_NODE_CONFLICT"}
+SUPERVISOR_TASKS = ["MF", "LF0", "LF1", "LF2", "LF3", "LED", "CAN_RX"]
+SUPERVISOR_STALL_FLAG = 0x8000
+ERROR_LEVELS = {0: "", 1: "AUTO", 2: "MANUAL", 3: "UNRECOVERABLE", 4: "WARNING"}
+# HealthRecord, see Core/Inc/CapHealth.hpp
+HEALTH_OPS = {'info': 0, 'read': 1, 'clear': 2}
+HEALTH_PART_INFO = 0x80
+HEALTH_PART_NUM = 5
+HEALTH_RECORD = struct.Struct('<IHBBHHHHHII3BxH')
+HEALTH_FIELDS = ('seq', 'boot', 'cap_samples', 'esr_samples', 'duration_s', 'capacitance_F', 'esr_mOhm',
+                 'vcap_max', 'vcap_min', 'charge_in_C', 'charge_out_C', 'temp_leg_a', 'temp_leg_b',
+                 'temp_inductor')
+# TxLossMapInfo / TxLossMapData, see Core/Inc/Communication.hpp
+LOSSMAP_OPS = {'info': 0, 'read': 1, 'clear': 2}
+LOSSMAP_INFO_MARKER = 0xFF
+# TelemetryHeader / TelemetryChannel, see Core/Inc/Telemetry.hpp
+TELEMETRY_HEADER = struct.Struct('<HBBHH')
+TELEMETRY_CHANNELS = ['va', 'vb', 'ia', 'ib', 'ir', 'il', 'status']
+TELEMETRY_MIN_DECIMATION = 8
+TELEMETRY_SAMPLE_PERIOD_US = 16
+# ParamId / ParamCmd / TxParamData, see Core/Inc/Param.hpp and Communication.hpp
+PARAM_NAMES = ['ir_ktp', 'ir_kmp', 'ir_ki', 'ir_kd', 'vaclamp_ktp', 'vaclamp_kmp', 'vaclamp_ki', 'vaclamp_kd',
+               'vaclamp_voltage', 'current_limit_ki', 'voltage_limit_ki', 'burst_ki', 'ref_kp', 'ref_ki', 'ref_kd',
+               'ref_energy_buffer', 'caparr_cutoff_voltage', 'caparr_low_voltage', 'caparr_max_current', 'caparr_dcr',
+               'mode_buck_to_buckboost', 'mode_buckboost_to_buck', 'mode_buckboost_to_boostbuck',
+               'mode_boostbuck_to_buck', 'mode_boostbuck_to_buckboost', 'mode_boostbuck_to_boost',
+               'mode_boost_to_buck', 'mode_boost_to_boostbuck', 'feedback_period', 'feedback_power_delta',
+               'feedback_energy_delta', 'diag_period']
+PARAM_UINT16 = {'ref_energy_buffer', 'feedback_period', 'feedback_energy_delta', 'diag_period'}
+PARAM_OPS = {'info': 0, 'get': 1, 'set': 2, 'apply': 3, 'discard': 4, 'save': 5, 'default': 6, 'list': 7}
+PARAM_FIELDS = ['value', 'staged', 'min', 'max', 'default']
+PARAM_STATUS = {0: "ok", 1: "unknown id", 2: "out of range", 3: "constraint violated", 4: "busy", 5: "flash error"}
+PARAM_TYPE_FLOAT = 0
+
+# TxDiagError / TxDiagLoop / TxDiagBus / TxDiagTx, see Core/Inc/Communication.hpp
+LIMIT_FACTORS = ["REFEREE_POWER", "CAPARR_VOLTAGE_MAX", "CAPARR_VOLTAGE_NORMAL", "IB_POSITIVE", "IB_NEGATIVE",
+                 "VA_CLAMP"]
+DCDC_MODES = ["BUCK", "BUCKBOOST", "BOOSTBUCK", "BOOST", "CALIBRATION_A", "CALIBRATION_B", "CALIBRATION"]
+ERROR_BITS = ["POWERSTAGE", "CAPARR", "SCP_A", "SCP_B", "OCP_A", "OCP_B", "OCP_R", "OVP_A", "OVP_B",
+              "LOWBATTERY", "REFEREE_INACCURATE", "COM_TIMEOUT"]
+
+RESET_FLAGS = {0x02: "OBL", 0x04: "PIN", 0x08: "BOR", 0x10: "SW", 0x20: "IWDG", 0x40: "WWDG", 0x80: "LPWR"}
+
+
+def format_event(record):
+    """Format one decoded EventRecord tuple for the log."""
+    seq, timestamp, boot, etype, level, payload, _ = record
+    name = EVENT_TYPES.get(etype, f"TYPE{etype}")
+    if etype == 1:
+        detail = ",".join(v for k, v in RESET_FLAGS.items() if payload & k) or "-"
+    elif etype == 2:
+        detail = {1: "CAN", 2: "button"}.get(payload, str(payload))
+    elif etype in (3, 4):
+        detail = f"{payload:#06x} {ERROR_LEVELS.get(level, level)}"
+    elif etype == 5:
+        detail = f"vA {payload / 100:.2f} V"
+    elif etype == 6:
+        detail = f"off {payload / 10:.1f} s"
+    elif etype == 8 and payload & SUPERVISOR_STALL_FLAG:
+        detail = f"tick stalled after LF{payload & 0xFF}"
+    elif etype in (8, 9):
+        detail = ",".join(t for i, t in enumerate(SUPERVISOR_TASKS) if payload >> i & 1) or "-"
+    else:
+        detail = str(payload)
+    return f"#{seq} boot {boot} {timestamp / 1000:9.3f}s {name} {detail}"
+
+
+def decode_health(raw):
+    """Decode one HealthRecord into a dict with physical units, None if the check fails."""
+    values = HEALTH_RECORD.unpack(raw[:HEALTH_RECORD.size])
+    if zlib.crc32(raw[:HEALTH_RECORD.size - 2]) & 0xFFFF != values[-1]:
+        return None
+    record = dict(zip(HEALTH_FIELDS, values[:-1]))
+    record['capacitance_F'] /= 100
+    record['esr_mOhm'] /= 10
+    record['vcap_max'] /= 100
+    record['vcap_min'] /= 100
+    record['charge_in_C'] /= 10
+    record['charge_out_C'] /= 10
+    return record
+
+
+def merge_health_csv(filename, records):
+    """Merge session records into the per-board CSV, keeping the newest record of each boot."""
+    sessions = {}
+    try:
+        with open(filename, newline='') as f:
+            for row in csv.DictReader(f):
+                sessions[int(row['boot'])] = {k: float(v) if '.' in v else int(v) for k, v in row.items()}
+    except (FileNotFoundError, KeyError, ValueError):
+        pass
+    for record in records:
+        old = sessions.get(record['boot'])
+        if old is None or record['seq'] >= old['seq']:
+            sessions[record['boot']] = record
+    rows = [sessions[k] for k in sorted(sessions)]
+    with open(filename, 'w', newline='') as f:
+        writer = csv.DictWriter(f, fieldnames=HEALTH_FIELDS)
+        writer.writeheader()
+        writer.writerows(rows)
+    return rows
+
+
+def decode_blackbox(raw):
+    """Decode a downloaded black-box record into (header dict, list of sample dicts)."""
+    fields = ('magic', 'version', 'header_size', 'sample_num', 'valid_num', 'post_trigger',
+              'trigger_code', 'error_code', 'error_level', 'reserved', 'trigger_tick',
+              'error_voltage', 'error_current', 'crc')
+    header = dict(zip(fields, BLACKBOX_HEADER.unpack_from(raw, 0)))
+    if header['magic'] != BLACKBOX_MAGIC:
+        raise ValueError(f"bad magic {header['magic']:#010x}")
+    size = header['header_size'] + header['sample_num'] * BLACKBOX_SAMPLE.size
+    crc_offset = BLACKBOX_HEADER.size - 4
+    body = bytearray(raw[:size])
+    body[crc_offset:crc_offset + 4] = b'\0\0\0\0'
+    if zlib.crc32(body) != header['crc']:
+        raise ValueError("CRC mismatch")
+
+    trigger_index = header['sample_num'] - header['post_trigger']
+    first_valid = header['sample_num'] - header['valid_num']
+    samples = []
+    for i in range(first_valid, header['sample_num']):
+        v_a, v_b, i_a, i_b, i_r, i_l, mode, flags = BLACKBOX_SAMPLE.unpack_from(
+            raw, header['header_size'] + i * BLACKBOX_SAMPLE.size)
+        samples.append({
+            't_us': (i - trigger_index) * 1e6 / BLACKBOX_SAMPLE_RATE,
+            'vA': v_a / 100, 'vB': v_b / 100, 'iA': i_a / 100, 'iB': i_b / 100, 'iR': i_r / 100,
+            'iLTarget': i_l / 100,
+            'dcdcMode': DCDC_MODES[mode] if mode < len(DCDC_MODES) else mode,
+            'outputAB': flags & 1, 'limitFactor': flags >> 4,
+        })
+    return header, samples
 
 class KBHit:
     """Cross-platform non-blocking keyboard input."""
@@ -71,20 +245,50 @@ class KBHit:
 
 
 class SuperCapMonitor:
-    def __init__(self, port, baudrate):
-        self.bus = can.interface.Bus(interface='slcan', channel=port, ttyBaudrate=baudrate)
+    def __init__(self, port, baudrate, interface='slcan', node=0):
+        if interface == 'slcan':
+            self.bus = can.interface.Bus(interface='slcan', channel=port, ttyBaudrate=baudrate)
+        elif interface == 'canlog':
+            # tools/canlog owns the bus and records everything, the monitor is a live consumer of its socket
+            sys.path.append(os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'canlog'))
+            from canlog import CanlogBus
+            self.bus = CanlogBus(port)
+        else:
+            # telemetry frames are CAN-FD, slcan adapters only receive classic frames
+            self.bus = can.interface.Bus(interface=interface, channel=port, fd=True)
+        self.id_offset = node * NODE_ID_STRIDE
         self.running = True
         self.sending_enabled = True
         self.command_data = {
             'enableDCDC': True, 'systemRestart': False, 'clearError': False,
             'enableActiveChargingLimit': False, 'useNewFeedbackMessage': False,
-            'refereePowerLimit': 37, 'refereeEnergyBuffer': 57, 'activeChargingLimitRatio': 255
+            'refereePowerLimit': 37, 'refereeEnergyBuffer': 57, 'activeChargingLimitRatio': 255,
+            'burstQueryPower': 0
         }
         # TUI state
         self.console = Console()
         self.command_log = deque(maxlen=100)
         self.command_buffer = ""
         self.latest_feedback = {}
+        self.latest_burst = {}
+        self.latest_diag = {}
+        self.blackbox_size = 0
+        self.blackbox_chunks = {}
+        self.event_first_half = None
+        self.health_board = None
+        self.health_expected = 0
+        self.health_parts = []
+        self.health_records = []
+        self.lossmap_info = None
+        self.lossmap_cells = {}
+        self.tele_mask = 0
+        self.tele_file = None
+        self.tele_writer = None
+        self.tele_seq = None
+        self.tele_index = 0
+        self.tele_lost = 0
+        self.tele_lock = threading.Lock()
+        self.param_list = {}
         self.last_message_time = 0
         self.lock = threading.Lock()
 
@@ -103,7 +307,8 @@ class SuperCapMonitor:
 
     def parse_message(self, msg):
         parsed_data = None
-        if msg.arbitration_id == CAN_ID_FEEDBACK_OLD and msg.dlc == 8:
+        can_id = msg.arbitration_id - self.id_offset
+        if can_id == CAN_ID_FEEDBACK_OLD and msg.dlc == 8:
             try:
                 status, p_chassis, p_limit, cap_energy = struct.unpack('<BfHB', msg.data)
                 parsed_data = self.format_status_code(status)
@@ -116,7 +321,7 @@ class SuperCapMonitor:
                 })
             except struct.error:
                 self.log_command(f"[yellow]WARN: Invalid structure for old feedback (ID {CAN_ID_FEEDBACK_OLD:#05x})[/yellow]")
-        elif msg.arbitration_id == CAN_ID_FEEDBACK_NEW and msg.dlc == 8:
+        elif can_id == CAN_ID_FEEDBACK_NEW and msg.dlc == 8:
             try:
                 status, p_chassis_raw, p_referee_raw, p_limit, cap_energy = struct.unpack('<BHHHB', msg.data)
                 p_chassis = (p_chassis_raw - 16384) / 64.0
@@ -131,12 +336,297 @@ class SuperCapMonitor:
                 })
             except struct.error:
                 self.log_command(f"[yellow]WARN: Invalid structure for new feedback (ID {CAN_ID_FEEDBACK_NEW:#05x})[/yellow]")
+        elif can_id == CAN_ID_BODE and msg.dlc == 8:
+            index, status, freq, mag, phase = struct.unpack('<BBHhh', msg.data)
+            target = {1: "iL", 2: "ref"}.get(status & 0x03, "?")
+            if status & 0x40:
+                self.log_command(f"[yellow]Bode {target}: aborted at point {index}[/yellow]")
+            else:
+                self.log_command(f"[cyan]Bode {target} #{index:3d} {freq:5d} Hz  {mag / 100:7.2f} dB  {phase / 100:7.2f} deg[/cyan]")
+            if status & 0x80:
+                self.log_command(f"[cyan]Bode {target}: sweep finished[/cyan]")
+            return
+        elif can_id == CAN_ID_BLACKBOX and msg.dlc == 8:
+            self.parse_blackbox(bytes(msg.data))
+            return
+        elif can_id == CAN_ID_EVENTLOG and msg.dlc == 8:
+            self.parse_eventlog(bytes(msg.data))
+            return
+        elif can_id == CAN_ID_HEALTH and msg.dlc == 8:
+            self.parse_health(bytes(msg.data))
+            return
+        elif can_id == CAN_ID_LOSSMAP and msg.dlc == 8:
+            self.parse_lossmap(bytes(msg.data))
+            return
+        elif can_id == CAN_ID_TELEMETRY and len(msg.data) == 64:
+            with self.tele_lock:
+                self.parse_telemetry(bytes(msg.data))
+            return
+        elif can_id == CAN_ID_PARAM and msg.dlc == 8:
+            self.parse_param(bytes(msg.data))
+            return
+        elif can_id == CAN_ID_FEEDBACK_BURST and msg.dlc == 8:
+            q_power, q_duration, max_duration, energy = struct.unpack('<HHHH', msg.data)
+            fmt_ms = lambda ms: "[green]unlimited[/green]" if ms == 0xFFFF else f"{ms} ms"
+            with self.lock:
+                self.latest_burst = {
+                    f"Burst @{q_power} W": fmt_ms(q_duration),
+                    "Burst @Limit": fmt_ms(max_duration),
+                    "Usable Energy": f"{energy} J",
+                }
+            return
+
+        elif can_id == CAN_ID_DIAG and msg.dlc == 8:
+            self.parse_diag(msg.data)
+            return
 
         if parsed_data:
             with self.lock:
+                parsed_data.update(self.latest_burst)
+                parsed_data.update(self.latest_diag)
                 self.latest_feedback = parsed_data
                 self.last_message_time = time.time()
 
+    def parse_diag(self, data):
+        page, limit_factor, level = data[0] & 0x03, (data[0] >> 2) & 0x07, data[0] >> 5
+        limit = LIMIT_FACTORS[limit_factor] if limit_factor < len(LIMIT_FACTORS) else str(limit_factor)
+        diag = {"Limit Factor": limit, "Diag Error Level": ERROR_LEVELS.get(level, str(level)) or "[green]none[/green]"}
+        if page == 0:
+            code, v, i, mode = struct.unpack_from('<HhhB', data, 1)
+            bits = [name for n, name in enumerate(ERROR_BITS) if code & (1 << n)]
+            diag.update({
+                "Error Code": f"{code:#06x} {' '.join(bits)}".rstrip(),
+                "Error V/I": f"{v / 100:.2f} V / {i / 100:.2f} A",
+                "DCDC Mode": DCDC_MODES[mode] if mode < len(DCDC_MODES) else str(mode),
+            })
+        elif page == 1:
+            load, il, cap, timeouts = struct.unpack_from('<BhHH', data, 1)
+            diag.update({
+                "IRQ Load (max)": f"{load / 2:.1f} %",
+                "iL Target": f"{il / 100:.2f} A",
+                "Capacitance": f"{cap / 1000:.3f} F",
+                "Rx Timeouts": str(timeouts),
+            })
+        elif page == 2:
+            # Counters are the low 8/16 bits of canBusData and wrap
+            tec, rec, bus_off, passive, recover, coalesced = struct.unpack_from('<BBBBBH', data, 1)
+            diag.update({
+                "CAN TEC/REC": f"{tec} / {rec}",
+                "CAN Bus-off": f"{bus_off} (recovered {recover}), passive {passive}",
+                "CAN Coalesced": str(coalesced),
+            })
+        else:
+            feedback, reply, telemetry, rejected = struct.unpack_from('<HHHB', data, 1)
+            diag.update({
+                "CAN Tx": f"feedback {feedback}, reply {reply}, telemetry {telemetry}",
+                "CAN Rejected": str(rejected),
+            })
+        with self.lock:
+            self.latest_diag.update(diag)
+
+    def parse_blackbox(self, data):
+        offset, = struct.unpack_from('<H', data)
+        if offset == BLACKBOX_INFO_OFFSET:
+            state, valid, size, post = struct.unpack_from('<BBHH', data, 2)
+            self.blackbox_size = size
+            self.log_command(f"[cyan]BlackBox: {BLACKBOX_STATES.get(state, state)}, "
+                             f"record {'valid' if valid else 'empty'}, {size} B, post-trigger {post}[/cyan]")
+            return
+        self.blackbox_chunks[offset] = data[2:]
+        if not self.blackbox_size or offset + 6 < self.blackbox_size:
+            return
+        raw = b''.join(self.blackbox_chunks.get(o, b'') for o in range(0, self.blackbox_size, 6))
+        self.blackbox_chunks = {}
+        if len(raw) < self.blackbox_size:
+            self.log_command(f"[yellow]BlackBox: {self.blackbox_size - len(raw)} B lost, retry 'bb read'[/yellow]")
+            return
+        try:
+            header, samples = decode_blackbox(raw)
+        except (ValueError, struct.error) as e:
+            self.log_command(f"[red]BlackBox: decode failed: {e}[/red]")
+            return
+        filename = f"blackbox_{datetime.now().strftime('%Y%m%d_%H%M%S')}.csv"
+        with open(filename, 'w', newline='') as f:
+            writer = csv.DictWriter(f, fieldnames=list(samples[0].keys()) if samples else ['t_us'])
+            writer.writeheader()
+            writer.writerows(samples)
+        self.log_command(f"[cyan]BlackBox: trigger {header['trigger_code']:#06x} at {header['trigger_tick']} ms, "
+                         f"errorCode {header['error_code']:#06x}, {header['error_voltage']:.2f} V / "
+                         f"{header['error_current']:.2f} A, {len(samples)} samples -> {filename}[/cyan]")
+
+    def parse_eventlog(self, data):
+        marker, count, boot = struct.unpack('<IHH', data)
+        if marker == EVENTLOG_INFO_MARKER:
+            self.event_first_half = None
+            self.log_command(f"[cyan]EventLog: {count} records, boot count {boot}[/cyan]")
+            return
+        if self.event_first_half is None:
+            self.event_first_half = data
+            return
+        raw = self.event_first_half + data
+        self.event_first_half = None
+        record = EVENT_RECORD.unpack(raw)
+        if zlib.crc32(raw[:14]) & 0xFFFF != record[-1]:
+            # a lost frame misaligns the halves, resync on the current frame
+            self.event_first_half = data
+            self.log_command("[yellow]EventLog: check mismatch, frame lost[/yellow]")
+            return
+        self.log_command(f"[cyan]{format_event(record)}[/cyan]")
+
+    def parse_health(self, data):
+        part = data[0]
+        if part == HEALTH_PART_INFO:
+            count, board = struct.unpack_from('<HI', data, 1)
+            self.health_board = board
+            self.health_expected = count + 1      # stored records plus the live session
+            self.health_parts = []
+            self.health_records = []
+            self.log_command(f"[cyan]Health: board {board:08x}, {count} records[/cyan]")
+            return
+        if part != len(self.health_parts):
+            # a lost frame, drop the partial record and wait for the next part 0
+            self.health_parts = [data[1:]] if part == 0 else []
+            return
+        self.health_parts.append(data[1:])
+        if len(self.health_parts) < HEALTH_PART_NUM:
+            return
+        record = decode_health(b''.join(self.health_parts))
+        self.health_parts = []
+        self.health_expected -= 1
+        if record is None:
+            self.log_command("[yellow]Health: check mismatch, record dropped[/yellow]")
+        else:
+            self.health_records.append(record)
+        if self.health_expected > 0 or self.health_board is None:
+            return
+
+        filename = f"health_{self.health_board:08x}.csv"
+        rows = merge_health_csv(filename, self.health_records)
+        self.health_records = []
+        base = next((r['capacitance_F'] for r in rows if r['capacitance_F'] > 0), 0)
+        self.log_command("[cyan]boot    dur     C(F)  dC%  ESR(mOhm)  vCap(V)      in/out(C)    Tpeak A/B/L(C)[/cyan]")
+        for r in rows[-20:]:
+            trend = f"{(r['capacitance_F'] / base - 1) * 100:+4.0f}" if base and r['capacitance_F'] else "   -"
+            esr = f"{r['esr_mOhm']:9.1f}" if r['esr_mOhm'] else "        -"
+            self.log_command(f"[cyan]{r['boot']:5d} {r['duration_s']:6d}s {r['capacitance_F']:6.2f} {trend} {esr}  "
+                             f"{r['vcap_min']:5.2f}-{r['vcap_max']:5.2f} {r['charge_in_C']:7.0f}/{r['charge_out_C']:<7.0f} "
+                             f"{r['temp_leg_a']}/{r['temp_leg_b']}/{r['temp_inductor']}[/cyan]")
+        self.log_command(f"[cyan]Health: {len(rows)} sessions -> {filename}[/cyan]")
+
+    def parse_lossmap(self, data):
+        if data[0] == LOSSMAP_INFO_MARKER:
+            _, mode_num, bin_num, _, step, active = struct.unpack('<BBBBHH', data)
+            self.lossmap_info = (mode_num, bin_num, step, active)
+            self.lossmap_cells = {}
+            self.log_command(f"[cyan]LossMap: {mode_num} modes x {bin_num} bins of {step} W, {active} cells with data[/cyan]")
+            return
+        if self.lossmap_info is None:
+            return
+        cell_time, p_in, loss = struct.unpack('<IHh', data)
+        self.lossmap_cells[cell_time & 0xFF] = (cell_time >> 8) / 100, p_in / 10, loss / 100
+        mode_num, bin_num, step, active = self.lossmap_info
+        if len(self.lossmap_cells) < active:
+            return
+
+        filename = f"lossmap_{datetime.now().strftime('%Y%m%d_%H%M%S')}.csv"
+        with open(filename, 'w', newline='') as f:
+            writer = csv.writer(f)
+            writer.writerow(['mode', 'direction', 'bin_low_W', 'time_s', 'p_in_W', 'loss_W', 'efficiency'])
+            for cell, (t, p, l) in sorted(self.lossmap_cells.items()):
+                mode, rest = divmod(cell, 2 * bin_num)
+                direction, b = divmod(rest, bin_num)
+                writer.writerow([DCDC_MODES[mode], 'discharge' if direction else 'charge', b * step,
+                                 t, p, l, f"{1 - l / p:.4f}" if p else ''])
+
+        # one row per mode and direction, efficiency and loss per power bin
+        header = "".join(f"{b * step:>5d}W+      " for b in range(bin_num))
+        self.log_command(f"[cyan]{'':15s}{header}[/cyan]")
+        for mode in range(mode_num):
+            for direction in range(2):
+                row = ""
+                for b in range(bin_num):
+                    cell = self.lossmap_cells.get((mode * 2 + direction) * bin_num + b)
+                    row += f"{(1 - cell[2] / cell[1]) * 100:5.1f}%{cell[2]:5.1f}W " if cell and cell[1] else f"{'-':>12s} "
+                if row.strip(' -'):
+                    self.log_command(f"[cyan]{DCDC_MODES[mode]:9s} {'dis' if direction else 'chg'}  {row}[/cyan]")
+        self.log_command(f"[cyan]LossMap: -> {filename}[/cyan]")
+        self.lossmap_info = None
+
+    def parse_telemetry(self, data):
+        seq, mask, num, decimation, dropped = TELEMETRY_HEADER.unpack_from(data)
+        channels = [name for i, name in enumerate(TELEMETRY_CHANNELS) if mask & (1 << i)]
+        # frames still queued on the board from a previous selection are skipped
+        if mask != self.tele_mask:
+            return
+        if self.tele_file is None:
+            filename = f"telemetry_{datetime.now().strftime('%Y%m%d_%H%M%S')}.csv"
+            self.tele_file = open(filename, 'w', newline='')
+            self.tele_writer = csv.writer(self.tele_file)
+            columns = [c for c in channels if c != 'status']
+            if 'status' in channels: columns += ['mode', 'outputAB', 'limitFactor']
+            self.tele_writer.writerow(['t_us', 'seq'] + columns)
+            self.tele_seq, self.tele_index, self.tele_lost = seq, 0, 0
+            self.log_command(f"[cyan]Telemetry: {', '.join(channels)} every {decimation * TELEMETRY_SAMPLE_PERIOD_US} us "
+                             f"-> {filename}[/cyan]")
+        # every frame holds the same number of samples, so a seq gap gives the time of the lost samples
+        gap = (seq - self.tele_seq) & 0xFFFF
+        if gap:
+            self.tele_lost += gap
+            self.log_command(f"[yellow]Telemetry: {gap} frames lost before seq {seq} ({dropped} dropped on board)[/yellow]")
+        self.tele_index += gap * num
+        self.tele_seq = (seq + 1) & 0xFFFF
+
+        values = struct.unpack_from(f'<{num * len(channels)}h', data, TELEMETRY_HEADER.size)
+        for i in range(num):
+            sample = dict(zip(channels, values[i * len(channels):(i + 1) * len(channels)]))
+            row = [(self.tele_index + i) * decimation * TELEMETRY_SAMPLE_PERIOD_US, seq]
+            row += [sample[c] / 100 for c in channels if c != 'status']
+            if 'status' in sample:
+                status = sample['status'] & 0xFFFF
+                row += [DCDC_MODES[status & 0xFF] if (status & 0xFF) < len(DCDC_MODES) else status & 0xFF,
+                        (status >> 8) & 1, status >> 12]
+            self.tele_writer.writerow(row)
+        self.tele_index += num
+
+    def stop_telemetry(self):
+        if self.tele_file is not None:
+            self.tele_file.close()
+            self.log_command(f"[cyan]Telemetry: stopped, {self.tele_index} samples, {self.tele_lost} frames lost[/cyan]")
+        self.tele_file = None
+
+    @staticmethod
+    def param_name(pid):
+        return PARAM_NAMES[pid] if pid < len(PARAM_NAMES) else f"#{pid}"
+
+    @staticmethod
+    def param_decode(ptype, raw):
+        return struct.unpack('<f', struct.pack('<I', raw))[0] if ptype == PARAM_TYPE_FLOAT else raw
+
+    def parse_param(self, data):
+        op, pid, field_type, status, raw = struct.unpack('<BBBBI', data)
+        field, ptype = field_type & 0x0F, field_type >> 4
+        op_name = next((k for k, v in PARAM_OPS.items() if v == op), op)
+        if status:
+            self.log_command(f"[yellow]Param {op_name} {self.param_name(pid)}: {PARAM_STATUS.get(status, status)}[/yellow]")
+            return
+        if op == PARAM_OPS['info']:
+            self.log_command(f"[cyan]Param: {pid} parameters, flash {'valid' if field & 1 else 'empty'}, "
+                             f"{'unsaved changes, ' if field & 2 else ''}staged mask {raw:#010x}[/cyan]")
+        elif op in (PARAM_OPS['get'], PARAM_OPS['set']):
+            what = 'staged' if op == PARAM_OPS['set'] else '='
+            self.log_command(f"[cyan]Param {self.param_name(pid)} {what} {self.param_decode(ptype, raw):g}[/cyan]")
+        elif op in (PARAM_OPS['apply'], PARAM_OPS['default'], PARAM_OPS['discard']):
+            names = [self.param_name(i) for i in range(32) if raw & (1 << i)]
+            self.log_command(f"[cyan]Param {op_name}: {', '.join(names) or 'none'}[/cyan]")
+        elif op == PARAM_OPS['save']:
+            self.log_command("[cyan]Param: saved to flash[/cyan]")
+        elif op == PARAM_OPS['list']:
+            entry = self.param_list.setdefault(pid, {})
+            entry[PARAM_FIELDS[field]] = self.param_decode(ptype, raw)
+            if field == PARAM_FIELDS.index('default'):
+                self.log_command(f"[cyan]{pid:3d} {self.param_name(pid):28s} {entry.get('value', 0):10g}  "
+                                 f"[{entry.get('min', 0):g}, {entry.get('max', 0):g}]  default {entry['default']:g}[/cyan]")
+
     def format_status_code(self, status):
         power_on = (status >> 7) & 1
         feedback_fmt_new = (status >> 6) & 1
@@ -154,10 +644,10 @@ class SuperCapMonitor:
                      ((1 if self.command_data['clearError'] else 0) << 5) |
                      ((1 if self.command_data['enableActiveChargingLimit'] else 0) << 6) |
                      ((1 if self.command_data['useNewFeedbackMessage'] else 0) << 7))
-            data = struct.pack('<BHHB', byte0, int(self.command_data['refereePowerLimit']),
+            data = struct.pack('<BHHBH', byte0, int(self.command_data['refereePowerLimit']),
                                int(self.command_data['refereeEnergyBuffer']),
-                               int(self.command_data['activeChargingLimitRatio']))
-            data += b'\x00\x00'
+                               int(self.command_data['activeChargingLimitRatio']),
+                               int(self.command_data['burstQueryPower']))
             msg = can.Message(arbitration_id=CAN_ID_HOST_COMMAND, data=data, is_extended_id=False, dlc=8)
             self.bus.send(msg)
             if self.command_data['systemRestart']: self.command_data['systemRestart'] = False
@@ -165,6 +655,12 @@ class SuperCapMonitor:
         except (can.CanError, struct.error) as e:
             self.log_command(f"[bold red]Send Error: {e}[/bold red]")
 
+    def send_service(self, data):
+        try:
+            self.bus.send(can.Message(arbitration_id=CAN_ID_SERVICE + self.id_offset, data=data, is_extended_id=False, dlc=8))
+        except can.CanError as e:
+            self.log_command(f"[bold red]Send Error: {e}[/bold red]")
+
     def process_command(self, cmd_str):
         self.log_command(f"[bold blue]>> {cmd_str}[/bold blue]")
         cmd_line = cmd_str.strip().lower().split()
@@ -199,6 +695,90 @@ class SuperCapMonitor:
                     self.log_command("[yellow]Usage: buffer <value> (0-60)[/yellow]")
             else:
                 self.log_command("[yellow]Usage: buffer <value> (0-60)[/yellow]")
+        elif cmd == 'burst':
+            if len(cmd_line) > 1:
+                try: self.command_data['burstQueryPower'] = int(cmd_line[1])
+                except ValueError: self.log_command("[yellow]Usage: burst <watts>[/yellow]")
+            else: self.log_command("[yellow]Usage: burst <watts>[/yellow]")
+        elif cmd == 'bode':
+            usage = "[yellow]Usage: bode <il|ref> <amplitude> <start_hz> <stop_hz> <points> | bode stop[/yellow]"
+            if len(cmd_line) > 1 and cmd_line[1] in BODE_TARGETS:
+                target = BODE_TARGETS[cmd_line[1]]
+                try:
+                    if target == 0:
+                        amp, f0, f1, n = 0, 0, 0, 0
+                    else:
+                        amp = float(cmd_line[2])
+                        f0, f1, n = int(cmd_line[3]), int(cmd_line[4]), int(cmd_line[5])
+                        # iL: 0.02A/LSB, ref: 0.2W/LSB
+                        amp = min(255, max(1, round(amp / (0.02 if target == 1 else 0.2))))
+                    self.send_service(struct.pack('<BBBHHB', SERVICE_BODE, target, amp, f0, f1, n))
+                except (IndexError, ValueError, struct.error):
+                    self.log_command(usage)
+            else:
+                self.log_command(usage)
+        elif cmd == 'bb':
+            usage = "[yellow]Usage: bb <info|read|trigger|erase> | bb post <samples>[/yellow]"
+            if len(cmd_line) > 1 and cmd_line[1] in BLACKBOX_OPS:
+                try:
+                    arg = int(cmd_line[2]) if cmd_line[1] == 'post' else 0
+                    if cmd_line[1] == 'read': self.blackbox_chunks = {}
+                    self.send_service(struct.pack('<BBH4x', SERVICE_BLACKBOX, BLACKBOX_OPS[cmd_line[1]], arg))
+                except (IndexError, ValueError, struct.error):
+                    self.log_command(usage)
+            else:
+                self.log_command(usage)
+        elif cmd == 'ev':
+            usage = "[yellow]Usage: ev <info|clear> | ev read [count][/yellow]"
+            if len(cmd_line) > 1 and cmd_line[1] in EVENTLOG_OPS:
+                try:
+                    arg = int(cmd_line[2]) if cmd_line[1] == 'read' and len(cmd_line) > 2 else 0
+                    self.send_service(struct.pack('<BBH4x', SERVICE_EVENTLOG, EVENTLOG_OPS[cmd_line[1]], arg))
+                except (ValueError, struct.error):
+                    self.log_command(usage)
+            else:
+                self.log_command(usage)
+        elif cmd == 'health':
+            if len(cmd_line) > 1 and cmd_line[1] in HEALTH_OPS:
+                self.send_service(struct.pack('<BBH4x', SERVICE_HEALTH, HEALTH_OPS[cmd_line[1]], 0))
+            else:
+                self.log_command("[yellow]Usage: health <info|read|clear>[/yellow]")
+        elif cmd == 'loss':
+            if len(cmd_line) > 1 and cmd_line[1] in LOSSMAP_OPS:
+                self.send_service(struct.pack('<BBH4x', SERVICE_LOSSMAP, LOSSMAP_OPS[cmd_line[1]], 0))
+            else:
+                self.log_command("[yellow]Usage: loss <info|read|clear>[/yellow]")
+        elif cmd == 'param':
+            usage = "[yellow]Usage: param <info|list|apply|discard|save|default> | param get <name> | param set <name> <value>[/yellow]"
+            try:
+                op = PARAM_OPS[cmd_line[1]]
+                pid, raw = 0, 0
+                if op in (PARAM_OPS['get'], PARAM_OPS['set']):
+                    pid = int(cmd_line[2]) if cmd_line[2].isdigit() else PARAM_NAMES.index(cmd_line[2])
+                if op == PARAM_OPS['set']:
+                    value = float(cmd_line[3])
+                    raw = int(value) if PARAM_NAMES[pid] in PARAM_UINT16 else \
+                        struct.unpack('<I', struct.pack('<f', value))[0]
+                if op == PARAM_OPS['list']:
+                    self.param_list = {}
+                self.send_service(struct.pack('<BBBxI', SERVICE_PARAM, op, pid, raw))
+            except (IndexError, KeyError, ValueError, struct.error):
+                self.log_command(usage)
+        elif cmd == 'tele':
+            usage = f"[yellow]Usage: tele <{','.join(TELEMETRY_CHANNELS)}|all> [decimation] | tele stop[/yellow]"
+            try:
+                if cmd_line[1] == 'stop':
+                    mask, decimation = 0, TELEMETRY_MIN_DECIMATION
+                else:
+                    names = TELEMETRY_CHANNELS if cmd_line[1] == 'all' else cmd_line[1].split(',')
+                    mask = sum(1 << TELEMETRY_CHANNELS.index(n) for n in set(names))
+                    decimation = int(cmd_line[2]) if len(cmd_line) > 2 else TELEMETRY_MIN_DECIMATION
+                with self.tele_lock:
+                    self.stop_telemetry()
+                    self.tele_mask = mask
+                self.send_service(struct.pack('<BBH4x', SERVICE_TELEMETRY, mask, decimation))
+            except (IndexError, ValueError, struct.error):
+                self.log_command(usage)
         elif cmd == 'help':
             #self.log_command("[green]Commands: on, off, send <on|off>, restart, clear, format <new|old>, limit <watts>, quit[/green]")
             self.log_command("""
@@ -212,6 +792,21 @@ class SuperCapMonitor:
   format [new|old]  - Set feedback message format, default old but new is recommended
   limit <watts>     - Set referee power limit in watts
   buffer <value>    - Set referee energy buffer (0-60) default 57(disabled buffer feedback)
+  burst <watts>     - Set chassis power used for burst duration prediction (0 = default)
+  bode <il|ref> <amp> <f0> <f1> <n> - Sweep loop frequency response (amp in A for il, W for ref)
+  bode stop          - Abort the frequency response sweep
+  bb <info|read|trigger|erase> - Fault black box status / download to CSV / manual trigger / erase
+  bb post <samples> - Set black box post-trigger sample count
+  ev <info|clear>    - Event log status / erase
+  ev read [count]    - Download the newest <count> events (default all)
+  health <info|read|clear> - Supercap health trend status / download and merge into health_<board>.csv / erase
+  loss <info|read|clear> - Efficiency loss map status / download to table and CSV / reset
+  tele <ch,..|all> [dec] - Stream channels (va,vb,ia,ib,ir,il,status) every dec x 16 us to CSV (CAN-FD)
+  tele stop          - Stop the telemetry stream
+  param list         - Show all runtime parameters with range and default
+  param get <name>   - Read one parameter (name or id)
+  param set <name> <value> - Stage a new value, 'param apply' makes all staged values take effect together
+  param <info|apply|discard|save|default> - Status / apply / drop staged values / save to flash / stage defaults
   quit               - Exit the monitor
 [/green]
                              """)
@@ -303,14 +898,21 @@ class SuperCapMonitor:
         kb.set_normal_term()
         self.running = False
         receiver.join(timeout=1)
+        with self.tele_lock:
+            self.stop_telemetry()
         self.bus.shutdown()
         self.console.print("[bold green]Shutdown complete.[/bold green]")
 
 
 if __name__ == '__main__':
     parser = argparse.ArgumentParser(description='Supercapacitor board monitor using slcan.')
-    parser.add_argument('port', help='Serial port for the slcan adapter (e.g., COM3, /dev/ttyUSB0)')
+    parser.add_argument('port', help='Serial port for the slcan adapter (e.g., COM3, /dev/ttyUSB0), '
+                                     'or the canlog --live socket with --interface canlog')
     parser.add_argument('--baudrate', type=int, default=115200, help='Baudrate for the slcan adapter')
+    parser.add_argument('--interface', default='slcan',
+                        help='python-can interface; use a CAN-FD capable one (e.g. socketcan, pcan) for telemetry, '
+                             'or canlog to attach to a running tools/canlog logger')
+    parser.add_argument('--node', type=int, default=0, help='node id of the board when several run in parallel')
     args = parser.parse_args()
 
     console = Console()
@@ -319,7 +921,7 @@ if __name__ == '__main__':
     console.print("Please ensure you have installed rich: [bold]pip install rich[/bold]")
 
     try:
-        monitor = SuperCapMonitor(args.port, args.baudrate)
+        monitor = SuperCapMonitor(args.port, args.baudrate, args.interface, args.node)
         monitor.run_tui()
     except Exception as e:
         console.print(f"\n[bold red]An unexpected error occurred:[/bold red]")